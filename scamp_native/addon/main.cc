@@ -6,9 +6,11 @@
 #include "MigrationDatabase.h"
 #include "MongoDatabase.h"
 #include "MpFormGameObject.h"
+#include "MsgType.h"
 #include "Networking.h"
 #include "NetworkingCombined.h"
 #include "NetworkingMock.h"
+#include "NetworkingThreaded.h"
 #include "PartOne.h"
 #include "ScriptStorage.h"
 #include "SqliteDatabase.h"
@@ -87,6 +89,12 @@ public:
   Napi::Value SendCustomPacket(const Napi::CallbackInfo& info);
   Napi::Value CreateBot(const Napi::CallbackInfo& info);
   Napi::Value GetUserByActor(const Napi::CallbackInfo& info);
+  Napi::Value GetRateLimitStats(const Napi::CallbackInfo& info);
+  Napi::Value GetGridChurnStats(const Napi::CallbackInfo& info);
+  Napi::Value GetChunkPreloaderStats(const Napi::CallbackInfo& info);
+  Napi::Value GetTimerStats(const Napi::CallbackInfo& info);
+  Napi::Value GetTickStats(const Napi::CallbackInfo& info);
+  Napi::Value GetTrafficStats(const Napi::CallbackInfo& info);
   Napi::Value ExecuteJavaScriptOnChakra(const Napi::CallbackInfo& info);
   Napi::Value SetSendUiMessageImplementation(const Napi::CallbackInfo& info);
   Napi::Value OnUiEvent(const Napi::CallbackInfo& info);
@@ -98,6 +106,7 @@ private:
   std::shared_ptr<PartOne> partOne;
   std::shared_ptr<Networking::IServer> server;
   std::shared_ptr<Networking::MockServer> serverMock;
+  std::shared_ptr<Networking::ReceiveStats> receiveStats;
   std::shared_ptr<ScampServerListener> listener;
   Napi::Env tickEnv;
   Napi::ObjectReference emitter;
@@ -225,6 +234,13 @@ Napi::Object ScampServer::Init(Napi::Env env, Napi::Object exports)
       InstanceMethod<&ScampServer::SetEnabled>("setEnabled"),
       InstanceMethod<&ScampServer::CreateBot>("createBot"),
       InstanceMethod<&ScampServer::GetUserByActor>("getUserByActor"),
+      InstanceMethod<&ScampServer::GetRateLimitStats>("getRateLimitStats"),
+      InstanceMethod<&ScampServer::GetGridChurnStats>("getGridChurnStats"),
+      InstanceMethod<&ScampServer::GetChunkPreloaderStats>(
+        "getChunkPreloaderStats"),
+      InstanceMethod<&ScampServer::GetTimerStats>("getTimerStats"),
+      InstanceMethod<&ScampServer::GetTickStats>("getTickStats"),
+      InstanceMethod<&ScampServer::GetTrafficStats>("getTrafficStats"),
       InstanceMethod<&ScampServer::ExecuteJavaScriptOnChakra>(
         "executeJavaScriptOnChakra"),
       InstanceMethod<&ScampServer::SetSendUiMessageImplementation>(
@@ -333,6 +349,24 @@ ScampServer::ScampServer(const Napi::CallbackInfo& info)
                  partOne->worldState.isPapyrusHotReloadEnabled ? "enabled"
                                                                : "disabled");
 
+    // Keys are cellOrWorld form ids ("0x3c") or "default"
+    auto gridSettings = serverSettings["gridSettings"];
+    for (auto it = gridSettings.begin(); it != gridSettings.end(); ++it) {
+      WorldState::GridSettings settings;
+      settings.cellSize = it.value().value("cellSize", settings.cellSize);
+      settings.viewRadius =
+        it.value().value("viewRadius", settings.viewRadius);
+      if (it.key() == "default") {
+        partOne->worldState.SetDefaultGridSettings(settings);
+      } else {
+        auto cellOrWorld =
+          static_cast<uint32_t>(std::stoul(it.key(), nullptr, 0));
+        partOne->worldState.SetGridSettings(cellOrWorld, settings);
+      }
+      logger->info("Grid of '{}' has cell size {} and view radius {}",
+                   it.key(), settings.cellSize, settings.viewRadius);
+    }
+
     if (serverSettings["dataDir"] != nullptr) {
       dataDir = serverSettings["dataDir"];
     }
@@ -353,13 +387,88 @@ ScampServer::ScampServer(const Napi::CallbackInfo& info)
       (espm::fs::path(dataDir) / "scripts").string());
 
     auto espm = new espm::Loader(dataDir, plugins);
-    auto realServer = Networking::CreateServer(
-      static_cast<uint32_t>(port), static_cast<uint32_t>(maxConnections));
+    Networking::ReceiveBudget receiveBudget;
+    auto rateLimits = serverSettings["rateLimits"];
+    if (rateLimits.is_object()) {
+      if (rateLimits["maxPacketsPerTick"].is_number_unsigned()) {
+        receiveBudget.maxPackets =
+          rateLimits["maxPacketsPerTick"].get<uint32_t>();
+      }
+      if (rateLimits["maxReceiveTimeUs"].is_number_unsigned()) {
+        receiveBudget.maxTime = std::chrono::microseconds(
+          rateLimits["maxReceiveTimeUs"].get<uint32_t>());
+      }
+      logger->info("Receive budget is {} packets, {} us per tick",
+                   receiveBudget.maxPackets, receiveBudget.maxTime.count());
+
+      auto messages = rateLimits["messages"];
+      for (auto it = messages.begin(); it != messages.end(); ++it) {
+        auto type = GetMsgTypeByName(it.key().data());
+        if (type == MsgType::Invalid)
+          throw std::runtime_error("Unknown MsgType in rateLimits: '" +
+                                   it.key() + "'");
+        RateLimiter::Limit limit;
+        limit.ratePerSecond = it.value()["ratePerSecond"].get<float>();
+        limit.burst = it.value().value("burst", limit.ratePerSecond);
+        partOne->GetRateLimiter().SetLimit(type, limit);
+        logger->info("'{}' is limited to {} per second (burst {})",
+                     it.key(), limit.ratePerSecond, limit.burst);
+      }
+    }
+
+    // Keys are phase names ("reloot", "saveCollection", ...). Network apply
+    // can't be interrupted from the outside, so its budget falls back to the
+    // receive budget
+    auto& tickScheduler = partOne->worldState.GetTickScheduler();
+    auto tickBudgetsUs = serverSettings["tickBudgetsUs"];
+    for (size_t i = 0; i < TickScheduler::g_numPhases; ++i) {
+      auto phase = static_cast<TickScheduler::Phase>(i);
+      auto name = TickScheduler::GetPhaseName(phase);
+      if (!tickBudgetsUs.is_object() ||
+          !tickBudgetsUs[name].is_number_unsigned())
+        continue;
+      auto budget =
+        std::chrono::microseconds(tickBudgetsUs[name].get<uint32_t>());
+      tickScheduler.SetBudget(phase, budget);
+      if (phase == TickScheduler::Phase::NetworkApply &&
+          receiveBudget.maxTime.count() == 0)
+        receiveBudget.maxTime = budget;
+      logger->info("Tick phase '{}' has budget of {} us", name,
+                   budget.count());
+    }
+
+    // With the network thread the budget applies to the game thread's
+    // Tick, the I/O thread must keep draining RakNet
+    receiveStats = std::make_shared<Networking::ReceiveStats>();
+    auto networkThread = serverSettings["networkThread"];
+    std::shared_ptr<Networking::IServer> realServer = Networking::CreateServer(
+      static_cast<uint32_t>(port), static_cast<uint32_t>(maxConnections),
+      networkThread.is_object() ? Networking::ReceiveBudget()
+                                : receiveBudget,
+      receiveStats);
+
+    if (networkThread.is_object()) {
+      size_t queueCapacity = 8192;
+      if (networkThread["queueCapacity"].is_number_unsigned())
+        queueCapacity = networkThread["queueCapacity"].get<size_t>();
+      realServer = std::make_shared<Networking::ThreadedServer>(
+        realServer, queueCapacity, std::chrono::microseconds(1000),
+        receiveBudget, receiveStats);
+      logger->info("Network I/O runs on a separate thread (queue capacity {})",
+                   queueCapacity);
+    }
+
     server = Networking::CreateCombinedServer({ realServer, serverMock });
     partOne->SetSendTarget(server.get());
     partOne->worldState.AttachScriptStorage(scriptStorage);
     partOne->AttachEspm(espm);
     this->serverSettings = serverSettings;
+
+    if (serverSettings["chunkPreloading"].is_boolean()) {
+      auto enable = serverSettings["chunkPreloading"].get<bool>();
+      partOne->worldState.EnableChunkPreloading(enable);
+      logger->info("Chunk preloading is {}", enable ? "enabled" : "disabled");
+    }
     this->logger = logger;
 
     auto reloot = serverSettings["reloot"];
@@ -371,6 +480,52 @@ ScampServer::ScampServer(const Napi::CallbackInfo& info)
       logger->info("'{}' will be relooted every {} ms", recordType, timeMs);
     }
 
+    auto updateRateLod = serverSettings["updateRateLod"];
+    if (updateRateLod.is_object() &&
+        updateRateLod["tierDistances"].is_array()) {
+      auto tierDistances =
+        updateRateLod["tierDistances"].get<std::vector<float>>();
+      auto& lod = partOne->GetUpdateRateLod();
+      lod.SetTierDistances(tierDistances);
+      if (updateRateLod["flushDelayMs"].is_number_unsigned()) {
+        lod.SetFlushDelay(std::chrono::milliseconds(
+          updateRateLod["flushDelayMs"].get<uint32_t>()));
+      }
+      logger->info("Update rate LOD uses {} distance tiers",
+                   tierDistances.size());
+    }
+
+    if (serverSettings["outgoingBatchMtu"].is_number_unsigned()) {
+      auto mtu = serverSettings["outgoingBatchMtu"].get<size_t>();
+      partOne->EnableOutgoingBatching(mtu);
+      logger->info("Outgoing batching is {} (MTU {})",
+                   mtu > 0 ? "enabled" : "disabled", mtu);
+    }
+
+    if (serverSettings["trafficStats"].is_boolean()) {
+      auto enable = serverSettings["trafficStats"].get<bool>();
+      partOne->EnableTrafficStats(enable);
+      logger->info("Traffic stats are {}", enable ? "enabled" : "disabled");
+    }
+
+    auto gridHysteresis = serverSettings["gridHysteresis"];
+    if (gridHysteresis.is_object()) {
+      auto margin = gridHysteresis.value("margin", 0.f);
+      auto gracePeriod = std::chrono::milliseconds(
+        gridHysteresis.value("unsubscribeGracePeriodMs", 0u));
+      partOne->worldState.SetGridHysteresis(margin, gracePeriod);
+      logger->info("Grid hysteresis margin is {}, unsubscribe grace period "
+                   "is {} ms",
+                   margin, gracePeriod.count());
+    }
+
+    if (serverSettings["movementKeyframeInterval"].is_number_unsigned()) {
+      auto interval =
+        serverSettings["movementKeyframeInterval"].get<uint32_t>();
+      partOne->GetMovementReplication().SetKeyframeInterval(interval);
+      logger->info("Movement keyframe interval is {}", interval);
+    }
+
     auto res =
       info.Env().RunScript("let require = global.require || "
                            "global.process.mainModule.constructor._load; let "
@@ -397,7 +552,11 @@ Napi::Value ScampServer::Tick(const Napi::CallbackInfo& info)
 {
   try {
     tickEnv = info.Env();
-    server->Tick(PartOne::HandlePacket, partOne.get());
+    partOne->worldState.GetTickScheduler().Run(
+      TickScheduler::Phase::NetworkApply, [&](const TickScheduler::Budget&) {
+        server->Tick(PartOne::HandlePacket, partOne.get());
+        return false;
+      });
     partOne->Tick();
   } catch (std::exception& e) {
     throw Napi::Error::New(info.Env(), (std::string)e.what());
@@ -604,6 +763,103 @@ Napi::Value ScampServer::GetUserByActor(const Napi::CallbackInfo& info)
   return info.Env().Undefined();
 }
 
+Napi::Value ScampServer::GetRateLimitStats(const Napi::CallbackInfo& info)
+{
+  auto res = Napi::Object::New(info.Env());
+  res.Set("ticksOverBudget",
+          Napi::Number::New(info.Env(),
+                            static_cast<double>(
+                              receiveStats->numTicksOverBudget.load())));
+
+  auto dropped = Napi::Object::New(info.Env());
+  auto& rateLimiter = partOne->GetRateLimiter();
+  for (int64_t i = 1; i <= static_cast<int64_t>(MsgType::CustomEvent); ++i) {
+    auto type = static_cast<MsgType>(i);
+    if (auto n = rateLimiter.GetNumDropped(type)) {
+      dropped.Set(GetMsgTypeName(type),
+                  Napi::Number::New(info.Env(), static_cast<double>(n)));
+    }
+  }
+  res.Set("droppedByMsgType", dropped);
+  return res;
+}
+
+Napi::Value ScampServer::GetGridChurnStats(const Napi::CallbackInfo& info)
+{
+  auto& stats = partOne->worldState.GetGridChurnStats();
+  auto res = Napi::Object::New(info.Env());
+  auto set = [&](const char* name, uint64_t value) {
+    res.Set(name,
+            Napi::Number::New(info.Env(), static_cast<double>(value)));
+  };
+  set("cellChangesAvoided", stats.numCellChangesAvoided);
+  set("unsubscribesDeferred", stats.numUnsubscribesDeferred);
+  set("unsubscribesCancelled", stats.numUnsubscribesCancelled);
+  set("unsubscribesExpired", stats.numUnsubscribesExpired);
+  return res;
+}
+
+Napi::Value ScampServer::GetChunkPreloaderStats(
+  const Napi::CallbackInfo& info)
+{
+  auto stats = partOne->worldState.GetChunkPreloaderStats();
+  auto res = Napi::Object::New(info.Env());
+  auto set = [&](const char* name, uint64_t value) {
+    res.Set(name,
+            Napi::Number::New(info.Env(), static_cast<double>(value)));
+  };
+  set("prepared", stats.numPrepared);
+  set("taken", stats.numTaken);
+  set("missed", stats.numMissed);
+  return res;
+}
+
+Napi::Value ScampServer::GetTimerStats(const Napi::CallbackInfo& info)
+{
+  auto stats = partOne->worldState.GetTimerStats();
+  auto res = Napi::Object::New(info.Env());
+  auto set = [&](const char* name, uint64_t value) {
+    res.Set(name,
+            Napi::Number::New(info.Env(), static_cast<double>(value)));
+  };
+  set("timers", stats.numTimers);
+  set("relootTimers", stats.numRelootTimers);
+  set("fired", stats.numFired);
+  set("lastTickNs", stats.lastTickNs);
+  set("maxTickNs", stats.maxTickNs);
+  return res;
+}
+
+Napi::Value ScampServer::GetTickStats(const Napi::CallbackInfo& info)
+{
+  auto& tickScheduler = partOne->worldState.GetTickScheduler();
+  auto res = Napi::Object::New(info.Env());
+  for (size_t i = 0; i < TickScheduler::g_numPhases; ++i) {
+    auto phase = static_cast<TickScheduler::Phase>(i);
+    auto& stats = tickScheduler.GetStats(phase);
+    auto phaseStats = Napi::Object::New(info.Env());
+    auto set = [&](const char* name, uint64_t value) {
+      phaseStats.Set(
+        name, Napi::Number::New(info.Env(), static_cast<double>(value)));
+    };
+    set("budgetUs", tickScheduler.GetBudget(phase).count());
+    set("ticks", stats.numTicks);
+    set("overBudget", stats.numOverBudget);
+    set("lastNs", stats.lastNs);
+    set("maxNs", stats.maxNs);
+
+    // Element i counts durations below 2^i us
+    auto histogram = Napi::Array::New(info.Env(), stats.histogram.size());
+    for (uint32_t j = 0; j < stats.histogram.size(); ++j) {
+      auto n = static_cast<double>(stats.histogram[j]);
+      histogram.Set(j, Napi::Number::New(info.Env(), n));
+    }
+    phaseStats.Set("histogramUs", histogram);
+    res.Set(TickScheduler::GetPhaseName(phase), phaseStats);
+  }
+  return res;
+}
+
 void Err(const Napi::Env& env, std::string msg)
 {
   throw Napi::Error::New(env, msg);
@@ -676,6 +932,62 @@ uint32_t ExtractFormId(const JsValue& v, const char* argName = "formId")
   return GetFormId(v);
 }
 
+double ExtractNumber(const JsValue& v, const char* argName)
+{
+  if (v.GetType() != JsValue::Type::Number) {
+    std::stringstream ss;
+    ss << "Expected '" << argName << "' to be number, but got '";
+    ss << v.ToString();
+    ss << "'";
+    throw std::runtime_error(ss.str());
+  }
+  return static_cast<double>(v);
+}
+
+// Query around a ref. filter is undefined or
+// { baseIds?: number[], baseTypes?: string[] }
+WorldState::SpatialQuery ExtractSpatialQuery(const MpObjectReference& center,
+                                             const JsValue& radius,
+                                             const JsValue& filter)
+{
+  WorldState::SpatialQuery query;
+  query.cellOrWorld = center.GetCellOrWorld();
+  query.center = center.GetPos();
+  query.radius = static_cast<float>(ExtractNumber(radius, "radius"));
+
+  if (filter.GetType() == JsValue::Type::Undefined)
+    return query;
+
+  auto baseIds = filter.GetProperty("baseIds");
+  if (baseIds.GetType() != JsValue::Type::Undefined) {
+    int n = static_cast<int>(baseIds.GetProperty("length"));
+    for (int i = 0; i < n; ++i) {
+      query.baseIds.push_back(
+        ExtractFormId(baseIds.GetProperty(JsValue(i)), "baseIds"));
+    }
+  }
+
+  auto baseTypes = filter.GetProperty("baseTypes");
+  if (baseTypes.GetType() != JsValue::Type::Undefined) {
+    int n = static_cast<int>(baseTypes.GetProperty("length"));
+    for (int i = 0; i < n; ++i) {
+      query.baseTypes.push_back(
+        ExtractString(baseTypes.GetProperty(JsValue(i)), "baseTypes"));
+    }
+  }
+  return query;
+}
+
+JsValue ToFormIdArray(const std::vector<MpObjectReference*>& refs)
+{
+  auto arr = JsValue::Array(refs.size());
+  for (int i = 0; i < static_cast<int>(refs.size()); ++i) {
+    arr.SetProperty(JsValue(i),
+                    JsValue(static_cast<double>(refs[i]->GetFormId())));
+  }
+  return arr;
+}
+
 std::string ExtractNewValueStr(Napi::Value v)
 {
   auto builtinJson = v.Env().Global().Get("JSON").As<Napi::Object>();
@@ -718,6 +1030,22 @@ Napi::Value ParseJson(const Napi::Env& env, const std::string& dump)
   return parse.Call({ Napi::String::New(env, dump) });
 }
 
+Napi::Value ScampServer::GetTrafficStats(const Napi::CallbackInfo& info)
+{
+  try {
+    auto& trafficStats = partOne->GetTrafficStats();
+    auto res = ParseJson(info.Env(), trafficStats.ToJson().dump());
+
+    // Lets the gamemode export deltas instead of totals
+    bool reset = info[0].IsBoolean() && info[0].As<Napi::Boolean>().Value();
+    if (reset)
+      trafficStats.Reset();
+    return res;
+  } catch (std::exception& e) {
+    throw Napi::Error::New(info.Env(), (std::string)e.what());
+  }
+}
+
 JsValue ParseJsonChakra(const std::string& dump)
 {
   auto builtinJson = JsValue::GlobalObject().GetProperty("JSON");
@@ -1128,12 +1456,12 @@ void ScampServer::RegisterChakraApi(std::shared_ptr<JsEngine> chakraEngine)
       // Global properties
       if (formId == 0 && propertyName == "onlinePlayers") {
 
-        auto n = partOne->serverState.userInfo.size();
+        auto& users = partOne->serverState.GetConnectedUsers();
         std::vector<uint32_t> ids;
-        ids.reserve(n);
+        ids.reserve(users.size());
 
-        for (size_t i = 0; i < n; ++i) {
-          if (auto actor = partOne->serverState.ActorByUser(i)) {
+        for (auto userId : users) {
+          if (auto actor = partOne->serverState.ActorByUser(userId)) {
             ids.push_back(actor->GetFormId());
           }
         }
@@ -1337,6 +1665,32 @@ void ScampServer::RegisterChakraApi(std::shared_ptr<JsEngine> chakraEngine)
       return JsValue(static_cast<double>(refr.GetFormId()));
     }));
 
+  // mp.findRefsInRadius(formId, radius, filter?)
+  mp.SetProperty(
+    "findRefsInRadius",
+    JsValue::Function([this, update](const JsFunctionArguments& args) {
+      auto& center = partOne->worldState.GetFormAt<MpObjectReference>(
+        ExtractFormId(args[1]));
+      auto filter = args.GetSize() > 3 ? args[3] : JsValue::Undefined();
+      auto query = ExtractSpatialQuery(center, args[2], filter);
+      return ToFormIdArray(partOne->worldState.FindRefsInRadius(query));
+    }));
+
+  // mp.findNearestRefs(formId, count, radius, filter?)
+  mp.SetProperty(
+    "findNearestRefs",
+    JsValue::Function([this, update](const JsFunctionArguments& args) {
+      auto& center = partOne->worldState.GetFormAt<MpObjectReference>(
+        ExtractFormId(args[1]));
+      auto count = ExtractNumber(args[2], "count");
+      if (!std::isfinite(count) || count < 0)
+        throw std::runtime_error("Expected 'count' to be non-negative");
+      auto filter = args.GetSize() > 4 ? args[4] : JsValue::Undefined();
+      auto query = ExtractSpatialQuery(center, args[3], filter);
+      return ToFormIdArray(partOne->worldState.FindNearestRefs(
+        query, static_cast<size_t>(count)));
+    }));
+
   mp.SetProperty(
     "lookupEspmRecordById",
     JsValue::Function([this, update](const JsFunctionArguments& args) {
@@ -542,9 +542,13 @@ const std::vector<espm::RecordHeader*>& espm::Browser::GetRecordsByType(
 }
 
 const std::vector<espm::RecordHeader*>& espm::Browser::GetRecordsAtPos(
-  uint32_t cellOrWorld, int16_t cellX, int16_t cellY)
+  uint32_t cellOrWorld, int16_t cellX, int16_t cellY) const
 {
-  return pImpl->cellOrWorldChildren[RefrKey(cellOrWorld, cellX, cellY)];
+  // Doesn't insert, so it's safe to call from several threads
+  static const std::vector<espm::RecordHeader*> g_empty;
+  auto& children = pImpl->cellOrWorldChildren;
+  auto it = children.find(RefrKey(cellOrWorld, cellX, cellY));
+  return it == children.end() ? g_empty : it->second;
 }
 
 bool espm::Browser::ReadAny(void* parentGrStack)
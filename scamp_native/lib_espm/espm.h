@@ -51,9 +51,8 @@ public:
   const std::vector<espm::RecordHeader*>& GetRecordsByType(
     const char* type) const;
 
-  const std::vector<espm::RecordHeader*>& GetRecordsAtPos(uint32_t cellOrWorld,
-                                                          int16_t cellX,
-                                                          int16_t cellY);
+  const std::vector<espm::RecordHeader*>& GetRecordsAtPos(
+    uint32_t cellOrWorld, int16_t cellX, int16_t cellY) const;
 
 private:
   struct Impl;
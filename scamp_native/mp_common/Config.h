@@ -1,3 +1,7 @@
 #pragma once
+#include "NetworkingInterface.h"
+#include <cstddef>
 
-constexpr auto g_maxPlayers = MAX_PLAYERS;
\ No newline at end of file
+// Slot count is a runtime parameter. Every slot needs a UserId and
+// InvalidUserId is reserved, that's the only upper bound
+constexpr size_t g_maxPlayers = Networking::InvalidUserId;
\ No newline at end of file
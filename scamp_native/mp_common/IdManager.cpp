@@ -5,48 +5,44 @@ using userid = IdManager::userid;
 IdManager::IdManager(userid maxConnections_)
   : maxConnections(maxConnections_)
 {
-  guidById.resize(maxConnections_, UNASSIGNED_RAKNET_GUID);
 }
 
 userid IdManager::allocateId(const RakNetGUID& guid) noexcept
 {
-  auto& idByGuid = this->idByGuid[guid.g];
-  if (nextId >= maxConnections)
+  userid res;
+  if (!freeIds.empty()) {
+    res = freeIds.top();
+    freeIds.pop();
+  } else if (guidById.size() < maxConnections) {
+    res = static_cast<userid>(guidById.size());
+    guidById.push_back(UNASSIGNED_RAKNET_GUID);
+  } else {
     return Networking::InvalidUserId;
-  const userid res = nextId++;
-  if (nextId < maxConnections) {
-    while (guidById[nextId] != UNASSIGNED_RAKNET_GUID)
-      if (++nextId >= maxConnections)
-        break;
   }
   guidById[res] = guid;
-  idByGuid = res;
+  idByGuid[guid.g] = res;
   return res;
 }
 
 void IdManager::freeId(userid id) noexcept
 {
-  const auto guid = guidById[id];
+  if (id >= guidById.size() || guidById[id] == UNASSIGNED_RAKNET_GUID)
+    return;
+  idByGuid.erase(guidById[id].g);
   guidById[id] = UNASSIGNED_RAKNET_GUID;
-  idByGuid.erase(guid.g);
-  if (id < nextId)
-    nextId = id;
+  freeIds.push(id);
 }
 
 userid IdManager::find(const RakNetGUID& guid) const noexcept
 {
-  userid result;
-  try {
-    result = idByGuid.at(guid.g);
-  } catch (...) {
-    result = Networking::InvalidUserId;
-  }
-  return result;
+  auto it = idByGuid.find(guid.g);
+  return it != idByGuid.end() ? it->second
+                              : static_cast<userid>(Networking::InvalidUserId);
 }
 
 RakNetGUID IdManager::find(userid id) const noexcept
 {
-  if (id < maxConnections)
+  if (id < guidById.size())
     return guidById[id];
   return UNASSIGNED_RAKNET_GUID;
 }
\ No newline at end of file
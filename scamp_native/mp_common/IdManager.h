@@ -1,7 +1,9 @@
 #pragma once
 #include "Networking.h"
 #include "RakNet.h"
+#include <functional>
 #include <map>
+#include <queue>
 #include <sparsepp/spp.h>
 #include <vector>
 
@@ -21,7 +23,12 @@ public:
 
 private:
   spp::sparse_hash_map<uint64_t, userid> idByGuid;
+
+  // Grows with the highest allocated id rather than maxConnections
   std::vector<RakNetGUID> guidById;
-  userid nextId = 0;
+
+  // Freed ids below guidById.size(), the lowest one is reused first
+  std::priority_queue<userid, std::vector<userid>, std::greater<userid>>
+    freeIds;
   const userid maxConnections = 0;
 };
\ No newline at end of file
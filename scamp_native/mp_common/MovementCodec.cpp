@@ -0,0 +1,525 @@
+#include "MovementCodec.h"
+#include "Exceptions.h"
+#include "MsgType.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string_view>
+
+namespace {
+// Position is stored with 1/8 unit precision
+constexpr float g_posScale = 8.f;
+
+// Angles are stored as 16-bit fractions of a full turn
+constexpr float g_angleScale = 65536.f / 360.f;
+
+// Delta replication splits position into 4096-unit cells and 16-bit offsets
+constexpr double g_cellSize = 4096.;
+constexpr double g_offsetScale = 65536. / g_cellSize;
+constexpr float g_byteAngleScale = 256.f / 360.f;
+
+enum Changed : uint8_t
+{
+  ChangedWorldOrCell = 1 << 0,
+  ChangedCell = 1 << 1,
+  ChangedOffsetX = 1 << 2, // Y and Z follow
+  ChangedRot = 1 << 5,
+  ChangedDirection = 1 << 6,
+  ChangedFlags = 1 << 7,
+  ChangedAll = 0xff
+};
+
+enum Flags : uint8_t
+{
+  IsInJumpState = 1 << 0,
+  IsWeapDrawn = 1 << 1,
+  IsSneaking = 1 << 2,
+  IsBlocking = 1 << 3,
+  RunModeShift = 4,
+  RunModeMask = 0x3 << RunModeShift
+};
+
+const char* const g_runModes[] = { "Standing", "Walking", "Running",
+                                   "Sprinting" };
+
+void WriteVarInt(uint32_t v, std::vector<uint8_t>& out)
+{
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+void WriteZigZag(int32_t v, std::vector<uint8_t>& out)
+{
+  WriteVarInt((static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31),
+              out);
+}
+
+void WriteU16(uint16_t v, std::vector<uint8_t>& out)
+{
+  out.push_back(static_cast<uint8_t>(v));
+  out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void WriteAngle(float angle, std::vector<uint8_t>& out)
+{
+  WriteU16(static_cast<uint16_t>(
+             static_cast<int32_t>(std::lround(angle * g_angleScale)) & 0xffff),
+           out);
+}
+
+uint8_t QuantizeByteAngle(float angle)
+{
+  return static_cast<uint8_t>(
+    static_cast<int32_t>(std::lround(angle * g_byteAngleScale)) & 0xff);
+}
+
+bool IsRepresentable(const MovementCodec::Movement& movement)
+{
+  constexpr float maxPos = std::numeric_limits<int32_t>::max() / g_posScale;
+
+  for (int i = 0; i < 3; ++i) {
+    if (!std::isfinite(movement.pos[i]) ||
+        std::fabs(movement.pos[i]) >= maxPos)
+      return false;
+    if (!std::isfinite(movement.rot[i]))
+      return false;
+  }
+  return std::isfinite(movement.direction) &&
+    static_cast<uint8_t>(movement.runMode) < std::size(g_runModes);
+}
+
+uint8_t MakeFlags(const MovementCodec::Movement& movement)
+{
+  uint8_t flags = static_cast<uint8_t>(movement.runMode) << RunModeShift;
+  if (movement.isInJumpState)
+    flags |= IsInJumpState;
+  if (movement.isWeapDrawn)
+    flags |= IsWeapDrawn;
+  if (movement.isSneaking)
+    flags |= IsSneaking;
+  if (movement.isBlocking)
+    flags |= IsBlocking;
+  return flags;
+}
+
+void ApplyFlags(uint8_t flags, MovementCodec::Movement& out)
+{
+  out.isInJumpState = flags & IsInJumpState;
+  out.isWeapDrawn = flags & IsWeapDrawn;
+  out.isSneaking = flags & IsSneaking;
+  out.isBlocking = flags & IsBlocking;
+  out.runMode = static_cast<MovementCodec::RunMode>((flags & RunModeMask) >>
+                                                    RunModeShift);
+}
+
+class Reader
+{
+public:
+  Reader(Networking::PacketData data_, size_t length_)
+    : data(data_)
+    , length(length_)
+  {
+  }
+
+  uint8_t ReadByte()
+  {
+    if (pos >= length)
+      throw PublicError("Unexpected end of binary movement packet");
+    return data[pos++];
+  }
+
+  uint32_t ReadVarInt()
+  {
+    uint32_t res = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b = ReadByte();
+      res |= static_cast<uint32_t>(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return res;
+    }
+    throw PublicError("Malformed varint in binary movement packet");
+  }
+
+  int32_t ReadZigZag()
+  {
+    auto zigzag = ReadVarInt();
+    return static_cast<int32_t>(zigzag >> 1) ^
+      -static_cast<int32_t>(zigzag & 1);
+  }
+
+  uint16_t ReadU16()
+  {
+    uint16_t v = ReadByte();
+    v |= static_cast<uint16_t>(ReadByte()) << 8;
+    return v;
+  }
+
+  float ReadPos() { return ReadZigZag() / g_posScale; }
+
+  float ReadAngle() { return ReadU16() / g_angleScale; }
+
+  MovementCodec::DeltaHeader ReadDeltaHeader()
+  {
+    if (ReadByte() != MovementCodec::PacketId)
+      throw std::runtime_error("Not a binary movement packet");
+
+    auto kind = static_cast<MovementCodec::Kind>(ReadByte());
+    if (kind != MovementCodec::Kind::Delta &&
+        kind != MovementCodec::Kind::Keyframe)
+      throw PublicError("Not a movement delta packet");
+
+    MovementCodec::DeltaHeader res;
+    res.isKeyframe = kind == MovementCodec::Kind::Keyframe;
+    res.idx = ReadVarInt();
+    res.sequence = ReadByte();
+    return res;
+  }
+
+  bool AtEnd() const { return pos == length; }
+
+private:
+  const Networking::PacketData data;
+  const size_t length;
+  size_t pos = 0;
+};
+
+template <class T>
+bool Get(const simdjson::dom::element& j, const char* jsonPointer, T& out)
+{
+  return j.at_pointer(jsonPointer).get(out) == simdjson::SUCCESS;
+}
+}
+
+bool MovementCodec::IsBinary(Networking::PacketData data, size_t length)
+{
+  return length > 0 && data[0] == PacketId;
+}
+
+bool MovementCodec::operator==(const QuantizedMovement& lhs,
+                               const QuantizedMovement& rhs)
+{
+  return lhs.worldOrCell == rhs.worldOrCell &&
+    std::equal(std::begin(lhs.cell), std::end(lhs.cell),
+               std::begin(rhs.cell)) &&
+    std::equal(std::begin(lhs.offset), std::end(lhs.offset),
+               std::begin(rhs.offset)) &&
+    std::equal(std::begin(lhs.rot), std::end(lhs.rot), std::begin(rhs.rot)) &&
+    lhs.direction == rhs.direction && lhs.flags == rhs.flags;
+}
+
+bool MovementCodec::IsHandshake(Networking::PacketData data, size_t length)
+{
+  return length == 2 && data[0] == PacketId;
+}
+
+void MovementCodec::WriteHandshake(uint8_t version, std::vector<uint8_t>& out)
+{
+  out.push_back(PacketId);
+  out.push_back(version);
+}
+
+uint8_t MovementCodec::ReadHandshake(Networking::PacketData data,
+                                     size_t length)
+{
+  if (!IsHandshake(data, length))
+    throw std::runtime_error("Not a movement codec handshake");
+  return data[1];
+}
+
+bool MovementCodec::Serialize(const Movement& movement,
+                              std::vector<uint8_t>& out)
+{
+  if (!IsRepresentable(movement))
+    return false;
+
+  out.push_back(PacketId);
+  out.push_back(static_cast<uint8_t>(Kind::Full));
+  WriteVarInt(movement.idx, out);
+  WriteVarInt(movement.worldOrCell, out);
+  for (float v : movement.pos)
+    WriteZigZag(static_cast<int32_t>(std::lround(v * g_posScale)), out);
+  for (float angle : movement.rot)
+    WriteAngle(angle, out);
+  WriteAngle(movement.direction, out);
+  out.push_back(MakeFlags(movement));
+  return true;
+}
+
+void MovementCodec::Deserialize(Networking::PacketData data, size_t length,
+                                Movement& out)
+{
+  Reader reader(data, length);
+  if (reader.ReadByte() != PacketId)
+    throw std::runtime_error("Not a binary movement packet");
+
+  auto kind = reader.ReadByte();
+  if (kind != static_cast<uint8_t>(Kind::Full))
+    throw PublicError("Unsupported movement packet kind " +
+                      std::to_string(kind));
+
+  Movement res;
+  res.idx = reader.ReadVarInt();
+  res.worldOrCell = reader.ReadVarInt();
+  for (float& v : res.pos)
+    v = reader.ReadPos();
+  for (float& v : res.rot)
+    v = reader.ReadAngle();
+  res.direction = reader.ReadAngle();
+
+  ApplyFlags(reader.ReadByte(), res);
+
+  if (!reader.AtEnd())
+    throw PublicError("Unexpected trailing bytes in binary movement packet");
+
+  out = res;
+}
+
+bool MovementCodec::Quantize(const Movement& movement, QuantizedMovement& out)
+{
+  if (!IsRepresentable(movement))
+    return false;
+
+  QuantizedMovement res;
+  res.worldOrCell = movement.worldOrCell;
+  for (int i = 0; i < 3; ++i) {
+    double cell = std::floor(movement.pos[i] / g_cellSize);
+    auto offset = std::lround((movement.pos[i] - cell * g_cellSize) *
+                              g_offsetScale);
+    res.cell[i] = static_cast<int32_t>(cell);
+    res.offset[i] =
+      static_cast<uint16_t>(std::clamp<long>(offset, 0, 0xffff));
+    res.rot[i] = QuantizeByteAngle(movement.rot[i]);
+  }
+  res.direction = QuantizeByteAngle(movement.direction);
+  res.flags = MakeFlags(movement);
+
+  out = res;
+  return true;
+}
+
+MovementCodec::Movement MovementCodec::Dequantize(
+  uint32_t idx, const QuantizedMovement& movement)
+{
+  Movement res;
+  res.idx = idx;
+  res.worldOrCell = movement.worldOrCell;
+  for (int i = 0; i < 3; ++i) {
+    res.pos[i] = static_cast<float>(movement.cell[i] * g_cellSize +
+                                    movement.offset[i] / g_offsetScale);
+    res.rot[i] = movement.rot[i] / g_byteAngleScale;
+  }
+  res.direction = movement.direction / g_byteAngleScale;
+  ApplyFlags(movement.flags, res);
+  return res;
+}
+
+void MovementCodec::SerializeDelta(uint32_t idx, uint8_t sequence,
+                                   const QuantizedMovement* baseline,
+                                   const QuantizedMovement& current,
+                                   std::vector<uint8_t>& out)
+{
+  uint8_t changed = ChangedAll;
+  if (baseline) {
+    changed = 0;
+    if (baseline->worldOrCell != current.worldOrCell)
+      changed |= ChangedWorldOrCell;
+    if (!std::equal(std::begin(current.cell), std::end(current.cell),
+                    std::begin(baseline->cell)))
+      changed |= ChangedCell;
+    for (int i = 0; i < 3; ++i) {
+      if (baseline->offset[i] != current.offset[i])
+        changed |= ChangedOffsetX << i;
+    }
+    if (!std::equal(std::begin(current.rot), std::end(current.rot),
+                    std::begin(baseline->rot)))
+      changed |= ChangedRot;
+    if (baseline->direction != current.direction)
+      changed |= ChangedDirection;
+    if (baseline->flags != current.flags)
+      changed |= ChangedFlags;
+  }
+
+  out.push_back(PacketId);
+  out.push_back(
+    static_cast<uint8_t>(baseline ? Kind::Delta : Kind::Keyframe));
+  WriteVarInt(idx, out);
+  out.push_back(sequence);
+  out.push_back(changed);
+
+  if (changed & ChangedWorldOrCell)
+    WriteVarInt(current.worldOrCell, out);
+  if (changed & ChangedCell) {
+    for (int32_t v : current.cell)
+      WriteZigZag(v, out);
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (changed & (ChangedOffsetX << i))
+      WriteU16(current.offset[i], out);
+  }
+  if (changed & ChangedRot)
+    out.insert(out.end(), std::begin(current.rot), std::end(current.rot));
+  if (changed & ChangedDirection)
+    out.push_back(current.direction);
+  if (changed & ChangedFlags)
+    out.push_back(current.flags);
+}
+
+bool MovementCodec::IsDelta(Networking::PacketData data, size_t length)
+{
+  return length > 2 && data[0] == PacketId &&
+    (data[1] == static_cast<uint8_t>(Kind::Delta) ||
+     data[1] == static_cast<uint8_t>(Kind::Keyframe));
+}
+
+MovementCodec::DeltaHeader MovementCodec::ReadDeltaHeader(
+  Networking::PacketData data, size_t length)
+{
+  return Reader(data, length).ReadDeltaHeader();
+}
+
+void MovementCodec::ApplyDelta(Networking::PacketData data, size_t length,
+                               QuantizedMovement& inOut)
+{
+  Reader reader(data, length);
+  auto header = reader.ReadDeltaHeader();
+  auto changed = reader.ReadByte();
+  if (header.isKeyframe && changed != ChangedAll)
+    throw PublicError("Keyframe must contain all fields");
+
+  QuantizedMovement res = header.isKeyframe ? QuantizedMovement() : inOut;
+  if (changed & ChangedWorldOrCell)
+    res.worldOrCell = reader.ReadVarInt();
+  if (changed & ChangedCell) {
+    for (int32_t& v : res.cell)
+      v = reader.ReadZigZag();
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (changed & (ChangedOffsetX << i))
+      res.offset[i] = reader.ReadU16();
+  }
+  if (changed & ChangedRot) {
+    for (uint8_t& v : res.rot)
+      v = reader.ReadByte();
+  }
+  if (changed & ChangedDirection)
+    res.direction = reader.ReadByte();
+  if (changed & ChangedFlags)
+    res.flags = reader.ReadByte();
+
+  if (!reader.AtEnd())
+    throw PublicError("Unexpected trailing bytes in movement delta packet");
+
+  inOut = res;
+}
+
+bool MovementCodec::IsKeyframeRequest(Networking::PacketData data,
+                                      size_t length)
+{
+  return length > 2 && data[0] == PacketId &&
+    data[1] == static_cast<uint8_t>(Kind::KeyframeRequest);
+}
+
+void MovementCodec::WriteKeyframeRequest(uint32_t idx,
+                                         std::vector<uint8_t>& out)
+{
+  out.push_back(PacketId);
+  out.push_back(static_cast<uint8_t>(Kind::KeyframeRequest));
+  WriteVarInt(idx, out);
+}
+
+uint32_t MovementCodec::ReadKeyframeRequest(Networking::PacketData data,
+                                            size_t length)
+{
+  if (!IsKeyframeRequest(data, length))
+    throw std::runtime_error("Not a movement keyframe request");
+
+  Reader reader(data, length);
+  reader.ReadByte();
+  reader.ReadByte();
+  auto idx = reader.ReadVarInt();
+  if (!reader.AtEnd())
+    throw PublicError("Unexpected trailing bytes in keyframe request");
+  return idx;
+}
+
+bool MovementCodec::FromJson(const simdjson::dom::element& message,
+                             Movement& out)
+{
+  int64_t t = 0;
+  if (!Get(message, "/t", t) ||
+      t != static_cast<int64_t>(MsgType::UpdateMovement))
+    return false;
+
+  Movement res;
+  int64_t idx = 0, worldOrCell = 0;
+  if (!Get(message, "/idx", idx) || idx < 0 ||
+      idx > std::numeric_limits<uint32_t>::max())
+    return false;
+  res.idx = static_cast<uint32_t>(idx);
+
+  simdjson::dom::element data;
+  if (!Get(message, "/data", data))
+    return false;
+
+  if (!Get(data, "/worldOrCell", worldOrCell) || worldOrCell < 0 ||
+      worldOrCell > std::numeric_limits<uint32_t>::max())
+    return false;
+  res.worldOrCell = static_cast<uint32_t>(worldOrCell);
+
+  const char* const posPointers[] = { "/pos/0", "/pos/1", "/pos/2" };
+  const char* const rotPointers[] = { "/rot/0", "/rot/1", "/rot/2" };
+  for (int i = 0; i < 3; ++i) {
+    double pos, rot;
+    if (!Get(data, posPointers[i], pos) || !Get(data, rotPointers[i], rot))
+      return false;
+    res.pos[i] = static_cast<float>(pos);
+    res.rot[i] = static_cast<float>(rot);
+  }
+
+  double direction;
+  if (!Get(data, "/direction", direction))
+    return false;
+  res.direction = static_cast<float>(direction);
+
+  std::string_view runMode;
+  if (!Get(data, "/runMode", runMode))
+    return false;
+  auto it = std::find(std::begin(g_runModes), std::end(g_runModes), runMode);
+  if (it == std::end(g_runModes))
+    return false;
+  res.runMode = static_cast<RunMode>(it - std::begin(g_runModes));
+
+  if (!Get(data, "/isInJumpState", res.isInJumpState) ||
+      !Get(data, "/isSneaking", res.isSneaking) ||
+      !Get(data, "/isBlocking", res.isBlocking) ||
+      !Get(data, "/isWeapDrawn", res.isWeapDrawn))
+    return false;
+
+  out = res;
+  return true;
+}
+
+void MovementCodec::ToJson(const Movement& movement, std::string& out)
+{
+  auto b = [](bool v) { return v ? "true" : "false"; };
+
+  char buf[512];
+  auto n = snprintf(
+    buf, sizeof(buf),
+    R"({"t":%d,"idx":%u,"data":{"worldOrCell":%u,"pos":[%.9g,%.9g,%.9g],)"
+    R"("rot":[%.9g,%.9g,%.9g],"runMode":"%s","direction":%.9g,)"
+    R"("isInJumpState":%s,)"
+    R"("isSneaking":%s,"isBlocking":%s,"isWeapDrawn":%s}})",
+    static_cast<int>(MsgType::UpdateMovement), movement.idx,
+    movement.worldOrCell, movement.pos[0], movement.pos[1], movement.pos[2],
+    movement.rot[0], movement.rot[1], movement.rot[2],
+    g_runModes[static_cast<uint8_t>(movement.runMode) & 0x3],
+    movement.direction, b(movement.isInJumpState), b(movement.isSneaking),
+    b(movement.isBlocking), b(movement.isWeapDrawn));
+  out.append(buf, static_cast<size_t>(n));
+}
\ No newline at end of file
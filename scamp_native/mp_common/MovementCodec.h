@@ -0,0 +1,140 @@
+#pragma once
+#include "NetworkingInterface.h"
+#include <cstdint>
+#include <simdjson.h>
+#include <string>
+#include <vector>
+
+// Compact binary encoding of MsgType::UpdateMovement. Binary packets start
+// with MovementCodec::PacketId instead of Networking::MinPacketId. A packet
+// consisting of PacketId and a version byte only is a handshake: the client
+// announces the highest version it supports, the server replies with the
+// version to be used for the connection. Peers that never negotiated keep
+// exchanging JSON.
+//
+// Since version 2 the server owns movement replication: instead of full
+// packets it sends each listener quantized deltas against the last state
+// that listener got for the emitter (see QuantizedMovement). The second byte
+// of non-handshake packets is Kind.
+namespace MovementCodec {
+enum : unsigned char
+{
+  PacketId = Networking::MinPacketId + 1
+};
+
+enum : uint8_t
+{
+  NoVersion = 0,
+  MinDeltaVersion = 2,
+  Version = 2
+};
+
+enum class Kind : uint8_t
+{
+  // Version 1 layout, sent in both directions
+  Full = 1,
+
+  // Server to client. Fields that changed since the previous packet the
+  // client got about the same emitter. Its sequence is the previous one + 1
+  Delta = 2,
+
+  // Server to client. All fields, resets the client's baseline and sequence
+  Keyframe = 3,
+
+  // Client to server. Sent when the client detects a lost delta
+  KeyframeRequest = 4
+};
+
+enum class RunMode : uint8_t
+{
+  Standing,
+  Walking,
+  Running,
+  Sprinting
+};
+
+struct Movement
+{
+  uint32_t idx = 0;
+  uint32_t worldOrCell = 0;
+  float pos[3] = { 0, 0, 0 };
+  float rot[3] = { 0, 0, 0 };
+  float direction = 0;
+  RunMode runMode = RunMode::Standing;
+  bool isInJumpState = false;
+  bool isSneaking = false;
+  bool isBlocking = false;
+  bool isWeapDrawn = false;
+};
+
+// Movement quantized for delta replication. Position is split into a
+// 4096-unit cell and a 16-bit offset within the cell (1/16 unit precision),
+// angles are 8-bit fractions of a full turn
+struct QuantizedMovement
+{
+  uint32_t worldOrCell = 0;
+  int32_t cell[3] = { 0, 0, 0 };
+  uint16_t offset[3] = { 0, 0, 0 };
+  uint8_t rot[3] = { 0, 0, 0 };
+  uint8_t direction = 0;
+  uint8_t flags = 0;
+};
+
+bool operator==(const QuantizedMovement& lhs, const QuantizedMovement& rhs);
+
+struct DeltaHeader
+{
+  uint32_t idx = 0;
+  uint8_t sequence = 0;
+  bool isKeyframe = false;
+};
+
+bool IsBinary(Networking::PacketData data, size_t length);
+bool IsHandshake(Networking::PacketData data, size_t length);
+
+// Writes [PacketId, version]
+void WriteHandshake(uint8_t version, std::vector<uint8_t>& out);
+
+// Returns version from a handshake packet
+uint8_t ReadHandshake(Networking::PacketData data, size_t length);
+
+// Returns false if movement can't be represented in binary (unknown runMode,
+// non-finite or out of range position). Callers should send JSON instead
+bool Serialize(const Movement& movement, std::vector<uint8_t>& out);
+
+// Reads Kind::Full packets. Throws on malformed packets or other kinds
+void Deserialize(Networking::PacketData data, size_t length, Movement& out);
+
+// Returns false under the same conditions as Serialize
+bool Quantize(const Movement& movement, QuantizedMovement& out);
+
+Movement Dequantize(uint32_t idx, const QuantizedMovement& movement);
+
+// Writes fields of current that differ from baseline. Null baseline produces
+// a keyframe
+void SerializeDelta(uint32_t idx, uint8_t sequence,
+                    const QuantizedMovement* baseline,
+                    const QuantizedMovement& current,
+                    std::vector<uint8_t>& out);
+
+// True for both Delta and Keyframe packets
+bool IsDelta(Networking::PacketData data, size_t length);
+
+DeltaHeader ReadDeltaHeader(Networking::PacketData data, size_t length);
+
+// Overwrites fields present in the packet. Throws on malformed packets
+void ApplyDelta(Networking::PacketData data, size_t length,
+                QuantizedMovement& inOut);
+
+bool IsKeyframeRequest(Networking::PacketData data, size_t length);
+void WriteKeyframeRequest(uint32_t idx, std::vector<uint8_t>& out);
+
+// Returns idx of the emitter
+uint32_t ReadKeyframeRequest(Networking::PacketData data, size_t length);
+
+// Returns false if message is not a complete UpdateMovement
+bool FromJson(const simdjson::dom::element& message, Movement& out);
+
+// Appends UpdateMovement message in the format clients send it
+void ToJson(const Movement& movement, std::string& out);
+}
\ No newline at end of file
@@ -1,15 +1,21 @@
 #include "MpClientPlugin.h"
+#include "MovementCodec.h"
+#include "NetworkingBatched.h"
 #include <vector>
 
 void MpClientPlugin::CreateClient(State& state, const char* targetHostname,
                                   uint16_t targetPort)
 {
   state.cl = Networking::CreateClient(targetHostname, targetPort);
+  state.movementCodecVersion = MovementCodec::NoVersion;
+  state.movementBaselines.clear();
 }
 
 void MpClientPlugin::DestroyClient(State& state)
 {
   state.cl.reset();
+  state.movementCodecVersion = MovementCodec::NoVersion;
+  state.movementBaselines.clear();
 }
 
 bool MpClientPlugin::IsConnected(State& state)
@@ -17,30 +23,114 @@ bool MpClientPlugin::IsConnected(State& state)
   return state.cl && state.cl->IsConnected();
 }
 
+namespace {
+struct TickState
+{
+  MpClientPlugin::OnPacket onPacket;
+  void* state_;
+  MpClientPlugin::State* pluginState;
+};
+
+// The request is repeated while deltas keep arriving in case the keyframe
+// is lost too
+constexpr uint8_t g_deltasPerKeyframeRequest = 8;
+
+// Returns false if the delta can't be applied until a keyframe arrives
+bool ApplyMovementDelta(MpClientPlugin::State& pluginState,
+                        Networking::PacketData data, size_t length,
+                        std::string& jsonContent)
+{
+  auto header = MovementCodec::ReadDeltaHeader(data, length);
+  auto& baseline = pluginState.movementBaselines[header.idx];
+
+  if (!header.isKeyframe &&
+      (!baseline.isSynced ||
+       static_cast<uint8_t>(baseline.sequence + 1) != header.sequence)) {
+    // A packet has been lost, deltas against the wrong baseline would show
+    // stale fields
+    baseline.isSynced = false;
+    if (baseline.numDropped++ % g_deltasPerKeyframeRequest == 0) {
+      std::vector<uint8_t> request;
+      MovementCodec::WriteKeyframeRequest(header.idx, request);
+      pluginState.cl->Send(request.data(), request.size(), true);
+    }
+    return false;
+  }
+
+  MovementCodec::ApplyDelta(data, length, baseline.movement);
+  baseline.sequence = header.sequence;
+  baseline.isSynced = true;
+  baseline.numDropped = 0;
+
+  MovementCodec::ToJson(
+    MovementCodec::Dequantize(header.idx, baseline.movement), jsonContent);
+  return true;
+}
+
+void HandleMessage(TickState& tickState, Networking::PacketData data,
+                   size_t length, const char* error)
+{
+  auto& pluginState = *tickState.pluginState;
+
+  std::string jsonContent;
+
+  if (MovementCodec::IsHandshake(data, length)) {
+    pluginState.movementCodecVersion =
+      MovementCodec::ReadHandshake(data, length);
+    return;
+  }
+
+  if (MovementCodec::IsDelta(data, length)) {
+    if (!ApplyMovementDelta(pluginState, data, length, jsonContent))
+      return;
+  } else if (MovementCodec::IsBinary(data, length)) {
+    MovementCodec::Movement movement;
+    MovementCodec::Deserialize(data, length, movement);
+    MovementCodec::ToJson(movement, jsonContent);
+  } else if (length > 1) {
+    jsonContent =
+      std::string(reinterpret_cast<const char*>(data) + 1, length - 1);
+  }
+
+  tickState.onPacket((int32_t)Networking::PacketType::Message,
+                     jsonContent.data(), error, tickState.state_);
+}
+}
+
 void MpClientPlugin::Tick(State& state, OnPacket onPacket, void* state_)
 {
   if (!state.cl)
     return;
 
-  std::pair<OnPacket, void*> packetAndState(onPacket, state_);
+  TickState tickState{ onPacket, state_, &state };
 
   state.cl->Tick(
     [](void* state, Networking::PacketType packetType,
        Networking::PacketData data, size_t length, const char* error) {
-      auto onPacketAndState =
-        *reinterpret_cast<std::pair<OnPacket, void*>*>(state);
+      auto& tickState = *reinterpret_cast<TickState*>(state);
+      auto& pluginState = *tickState.pluginState;
 
-      std::string jsonContent;
+      if (packetType == Networking::PacketType::Message) {
+        return Networking::ForEachBatchedPacket(
+          data, length, [&](Networking::PacketData data, size_t length) {
+            HandleMessage(tickState, data, length, error);
+          });
+      }
+
+      if (packetType == Networking::PacketType::ClientSideConnectionAccepted) {
+        std::vector<uint8_t> handshake;
+        MovementCodec::WriteHandshake(MovementCodec::Version, handshake);
+        pluginState.cl->Send(handshake.data(), handshake.size(), true);
+      }
 
-      if (packetType == Networking::PacketType::Message && length > 1) {
-        jsonContent =
-          std::string(reinterpret_cast<const char*>(data) + 1, length - 1);
+      if (packetType == Networking::PacketType::ClientSideDisconnect) {
+        pluginState.movementCodecVersion = MovementCodec::NoVersion;
+        pluginState.movementBaselines.clear();
       }
 
-      onPacketAndState.first((int32_t)packetType, jsonContent.data(), error,
-                             onPacketAndState.second);
+      tickState.onPacket((int32_t)packetType, "", error, tickState.state_);
     },
-    &packetAndState);
+    &tickState);
 }
 
 void MpClientPlugin::Send(State& state, const char* jsonContent, bool reliable)
@@ -48,6 +138,18 @@ void MpClientPlugin::Send(State& state, const char* jsonContent, bool reliable)
   if (!state.cl)
     return;
   auto n = strlen(jsonContent);
+
+  if (state.movementCodecVersion != MovementCodec::NoVersion) {
+    simdjson::dom::element message;
+    MovementCodec::Movement movement;
+    std::vector<uint8_t> buf;
+    if (state.parser.parse(jsonContent, n).get(message) == simdjson::SUCCESS &&
+        MovementCodec::FromJson(message, movement) &&
+        MovementCodec::Serialize(movement, buf)) {
+      return state.cl->Send(buf.data(), buf.size(), reliable);
+    }
+  }
+
   std::vector<uint8_t> buf(n + 1);
   buf[0] = Networking::MinPacketId;
   memcpy(buf.data() + 1, jsonContent, n);
@@ -1,6 +1,9 @@
 #pragma once
+#include "MovementCodec.h"
 #include "Networking.h"
 #include <cstdint>
+#include <simdjson.h>
+#include <unordered_map>
 
 namespace MpClientPlugin {
 typedef void (*OnPacket)(int32_t type, const char* jsonContent,
@@ -9,6 +12,24 @@ typedef void (*OnPacket)(int32_t type, const char* jsonContent,
 struct State
 {
   std::shared_ptr<Networking::IClient> cl;
+
+  // Outgoing UpdateMovement is sent in binary once the server accepted the
+  // handshake, see MovementCodec.h
+  uint8_t movementCodecVersion = 0;
+  simdjson::dom::parser parser;
+
+  struct MovementBaseline
+  {
+    MovementCodec::QuantizedMovement movement;
+    uint8_t sequence = 0;
+
+    // Deltas are dropped until a keyframe if false
+    bool isSynced = false;
+    uint8_t numDropped = 0;
+  };
+
+  // Last known movement of actors by idx, server deltas are applied to it
+  std::unordered_map<uint32_t, MovementBaseline> movementBaselines;
 };
 
 void CreateClient(State& st, const char* targetHostname, uint16_t targetPort);
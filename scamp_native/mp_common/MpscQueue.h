@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace Networking {
+// Bounded lock-free queue for multiple producers and a single consumer.
+// Items are swapped in and out of slots, so buffers owned by items are
+// recycled between producers and the consumer instead of being reallocated
+template <class T>
+class MpscQueue
+{
+public:
+  // Capacity is rounded up to a power of two
+  explicit MpscQueue(size_t capacity)
+  {
+    size_t n = 2;
+    while (n < capacity)
+      n *= 2;
+    mask = n - 1;
+    cells.reset(new Cell[n]);
+    for (size_t i = 0; i < n; ++i)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  size_t GetCapacity() const { return mask + 1; }
+
+  // Returns false if the queue is full. On success item holds a stale value
+  // from the slot
+  bool TryPush(T& item)
+  {
+    Cell* cell;
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (dif == 0) {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed))
+          break;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+    std::swap(cell->data, item);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Must only be called by the consumer thread. Returns false if empty
+  bool TryPop(T& item)
+  {
+    Cell& cell = cells[dequeuePos & mask];
+    size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if (seq != dequeuePos + 1)
+      return false;
+    std::swap(item, cell.data);
+    cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+    ++dequeuePos;
+    return true;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask = 0;
+  alignas(64) std::atomic<size_t> enqueuePos{ 0 };
+  alignas(64) size_t dequeuePos = 0;
+};
+}
\ No newline at end of file
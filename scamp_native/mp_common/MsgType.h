@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 
 enum class MsgType : int64_t
 {
@@ -19,4 +21,31 @@ enum class MsgType : int64_t
   CraftItem = 13,
   Host = 14,
   CustomEvent = 15
-};
\ No newline at end of file
+};
+
+inline const char* GetMsgTypeName(MsgType type)
+{
+  static const char* const names[] = { "Invalid",         "CustomPacket",
+                                       "UpdateMovement",  "UpdateAnimation",
+                                       "UpdateLook",      "UpdateEquipment",
+                                       "Activate",        "UpdateProperty",
+                                       "PutItem",         "TakeItem",
+                                       "FinishSpSnippet", "OnEquip",
+                                       "ConsoleCommand",  "CraftItem",
+                                       "Host",            "CustomEvent" };
+  auto i = static_cast<int64_t>(type);
+  if (i < 0 || i >= static_cast<int64_t>(std::size(names)))
+    return "Unknown";
+  return names[i];
+}
+
+// Returns MsgType::Invalid for unknown names
+inline MsgType GetMsgTypeByName(const char* name)
+{
+  for (int64_t i = 1; i <= static_cast<int64_t>(MsgType::CustomEvent); ++i) {
+    auto type = static_cast<MsgType>(i);
+    if (!strcmp(GetMsgTypeName(type), name))
+      return type;
+  }
+  return MsgType::Invalid;
+}
\ No newline at end of file
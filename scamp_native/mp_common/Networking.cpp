@@ -124,11 +124,15 @@ class Server : public Networking::IServer
 public:
   constexpr static int timeoutTimeMs = 6000;
 
-  Server(unsigned short port_, unsigned short maxConnections)
+  Server(unsigned short port_, unsigned short maxConnections,
+         const Networking::ReceiveBudget& budget_,
+         std::shared_ptr<Networking::ReceiveStats> stats_)
+    : budget(budget_)
+    , stats(stats_)
   {
-    if (maxConnections > g_maxPlayers)
+    if (maxConnections >= g_maxPlayers)
       throw std::runtime_error("Current slots limit is " +
-                               std::to_string(g_maxPlayers));
+                               std::to_string(g_maxPlayers - 1));
 
     idManager.reset(new IdManager(maxConnections));
     peer.reset(new RakPeer);
@@ -155,12 +159,50 @@ public:
                reliable ? RELIABLE_ORDERED : UNRELIABLE, 0, guid, false);
   }
 
+  void SendMany(const std::vector<Networking::UserId>& ids,
+                Networking::PacketData data, size_t length,
+                bool reliable) override
+  {
+    sendManyGuids.clear();
+    for (auto id : ids) {
+      const auto guid = idManager->find(id);
+      if (guid == RakNetGUID(-1))
+        throw std::runtime_error("User with id " + std::to_string(id) +
+                                 " doesn't exist");
+      sendManyGuids.push_back(guid);
+    }
+
+    // Never broadcast even if every connection seems to be a target: users
+    // with a pending disconnect are targets, but not RakNet connections
+    const auto reliability = reliable ? RELIABLE_ORDERED : UNRELIABLE;
+    for (auto& guid : sendManyGuids)
+      peer->Send(reinterpret_cast<const char*>(data), length, MEDIUM_PRIORITY,
+                 reliability, 0, guid, false);
+  }
+
+  ~Server() override
+  {
+    if (deferredPacket)
+      peer->DeallocatePacket(deferredPacket);
+  }
+
   void Tick(OnPacket onPacket, void* state) override
   {
-    while (1) {
-      auto packet = peer->Receive();
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t numPackets = 0;; ++numPackets) {
+      auto packet = deferredPacket ? deferredPacket : peer->Receive();
+      deferredPacket = nullptr;
       if (!packet)
         break;
+
+      // RakNet can't return a packet to its queue, so we hold it instead
+      if (budget.IsExhausted(numPackets, start)) {
+        deferredPacket = packet;
+        if (stats)
+          ++stats->numTicksOverBudget;
+        break;
+      }
+
       PacketGuard guard(peer.get(), packet);
       try {
 
@@ -176,9 +218,13 @@ public:
   }
 
 private:
+  const Networking::ReceiveBudget budget;
+  const std::shared_ptr<Networking::ReceiveStats> stats;
   std::unique_ptr<RakPeerInterface> peer;
   std::unique_ptr<SocketDescriptor> socket;
   std::unique_ptr<IdManager> idManager;
+  std::vector<RakNetGUID> sendManyGuids;
+  Packet* deferredPacket = nullptr;
 };
 }
 
@@ -189,9 +235,10 @@ std::shared_ptr<Networking::IClient> Networking::CreateClient(
 }
 
 std::shared_ptr<Networking::IServer> Networking::CreateServer(
-  unsigned short port, unsigned short maxConnections)
+  unsigned short port, unsigned short maxConnections,
+  const ReceiveBudget& budget, std::shared_ptr<ReceiveStats> stats)
 {
-  return std::make_shared<Server>(port, maxConnections);
+  return std::make_shared<Server>(port, maxConnections, budget, stats);
 }
 
 void Networking::HandlePacketClientside(Networking::IClient::OnPacket onPacket,
@@ -1,6 +1,7 @@
 #pragma once
 #include "NetworkingInterface.h"
 #include "RakNet.h"
+#include "ReceiveBudget.h"
 #include <cstdlib>
 #include <memory>
 #include <vector>
@@ -12,8 +13,11 @@ namespace Networking {
 std::shared_ptr<IClient> CreateClient(const char* serverIp,
                                       unsigned short serverPort,
                                       int timeoutMs = 4000);
-std::shared_ptr<IServer> CreateServer(unsigned short port,
-                                      unsigned short maxConnections);
+
+std::shared_ptr<IServer> CreateServer(
+  unsigned short port, unsigned short maxConnections,
+  const ReceiveBudget& budget = {},
+  std::shared_ptr<ReceiveStats> stats = nullptr);
 
 void HandlePacketClientside(Networking::IClient::OnPacket onPacket,
                             void* state, Packet* packet);
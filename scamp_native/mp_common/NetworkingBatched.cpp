@@ -0,0 +1,141 @@
+#include "NetworkingBatched.h"
+#include <array>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr size_t g_frameHeaderSize = 1;
+constexpr size_t g_lengthPrefixSize = 2;
+constexpr size_t g_maxPacketLength = 0xffff;
+
+struct Batch
+{
+  std::vector<uint8_t> frame;
+  size_t numPackets = 0;
+
+  // Used to unwrap single-packet batches
+  size_t firstPacketLength = 0;
+};
+}
+
+struct Networking::BatchedSendTarget::Impl
+{
+  Impl(ISendTarget& target_, size_t mtu_)
+    : target(target_)
+    , mtu(mtu_)
+  {
+  }
+
+  void SendBatch(UserId userId, bool reliable, Batch& batch)
+  {
+    if (batch.numPackets == 0)
+      return;
+
+    if (batch.numPackets == 1) {
+      // No need to wrap a lone packet, frame header is overhead
+      target.Send(userId,
+                  batch.frame.data() + g_frameHeaderSize + g_lengthPrefixSize,
+                  batch.firstPacketLength, reliable);
+    } else {
+      target.Send(userId, batch.frame.data(), batch.frame.size(), reliable);
+    }
+    batch.frame.clear();
+    batch.numPackets = 0;
+  }
+
+  bool FitsIntoFrame(size_t length) const
+  {
+    return length <= g_maxPacketLength &&
+      g_frameHeaderSize + g_lengthPrefixSize + length <= mtu;
+  }
+
+  Batch& GetBatch(UserId userId, bool reliable)
+  {
+    if (batches.size() <= userId)
+      batches.resize(static_cast<size_t>(userId) + 1);
+    return batches[userId][reliable];
+  }
+
+  ISendTarget& target;
+  const size_t mtu;
+
+  // batches[userId][reliable]
+  std::vector<std::array<Batch, 2>> batches;
+
+  // Batches with at least one packet, in order of first use
+  std::vector<std::pair<UserId, bool>> dirty;
+};
+
+Networking::BatchedSendTarget::BatchedSendTarget(ISendTarget& target,
+                                                 size_t mtu)
+{
+  if (mtu <= g_frameHeaderSize + g_lengthPrefixSize)
+    throw std::runtime_error("Batch MTU is too small (" + std::to_string(mtu) +
+                             ")");
+  pImpl.reset(new Impl(target, mtu));
+}
+
+void Networking::BatchedSendTarget::Send(UserId targetUserId, PacketData data,
+                                         size_t length, bool reliable)
+{
+  auto& batch = pImpl->GetBatch(targetUserId, reliable);
+
+  const size_t lengthInFrame = g_lengthPrefixSize + length;
+
+  // Keep order of packets within the same reliability class
+  if (batch.numPackets > 0 && batch.frame.size() + lengthInFrame > pImpl->mtu)
+    pImpl->SendBatch(targetUserId, reliable, batch);
+
+  if (!pImpl->FitsIntoFrame(length))
+    return pImpl->target.Send(targetUserId, data, length, reliable);
+
+  if (batch.numPackets == 0) {
+    batch.frame.push_back(BatchPacketId);
+    batch.firstPacketLength = length;
+    pImpl->dirty.push_back({ targetUserId, reliable });
+  }
+  batch.frame.push_back(static_cast<uint8_t>(length));
+  batch.frame.push_back(static_cast<uint8_t>(length >> 8));
+  batch.frame.insert(batch.frame.end(), data, data + length);
+  ++batch.numPackets;
+}
+
+void Networking::BatchedSendTarget::SendMany(
+  const std::vector<UserId>& targetUserIds, PacketData data, size_t length,
+  bool reliable)
+{
+  if (pImpl->FitsIntoFrame(length)) {
+    for (auto targetUserId : targetUserIds)
+      Send(targetUserId, data, length, reliable);
+    return;
+  }
+
+  // Keep order of packets within the same reliability class
+  for (auto targetUserId : targetUserIds)
+    pImpl->SendBatch(targetUserId, reliable,
+                     pImpl->GetBatch(targetUserId, reliable));
+  pImpl->target.SendMany(targetUserIds, data, length, reliable);
+}
+
+void Networking::BatchedSendTarget::Flush()
+{
+  for (auto [userId, reliable] : pImpl->dirty) {
+    pImpl->SendBatch(userId, reliable, pImpl->batches[userId][reliable]);
+  }
+  pImpl->dirty.clear();
+}
+
+void Networking::BatchedSendTarget::Discard(UserId userId)
+{
+  if (pImpl->batches.size() <= userId)
+    return;
+  for (auto& batch : pImpl->batches[userId]) {
+    batch.frame.clear();
+    batch.numPackets = 0;
+  }
+}
+
+size_t Networking::BatchedSendTarget::GetMtu() const
+{
+  return pImpl->mtu;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "NetworkingInterface.h"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace Networking {
+// Batch frame is BatchPacketId followed by packets, each prefixed with its
+// length (2 bytes, little-endian)
+enum : unsigned char
+{
+  BatchPacketId = MinPacketId + 2
+};
+
+// Buffers outgoing packets per user and per reliability and sends each
+// buffer as a single batch frame on Flush. A frame never exceeds mtu bytes,
+// packets that don't fit into an empty frame are sent as is
+class BatchedSendTarget : public ISendTarget
+{
+public:
+  BatchedSendTarget(ISendTarget& target, size_t mtu);
+
+  void Send(UserId targetUserId, PacketData data, size_t length,
+            bool reliable) override;
+
+  // Appends the packet to the batch of every target. Packets that don't fit
+  // into a frame are passed to the underlying SendMany
+  void SendMany(const std::vector<UserId>& targetUserIds, PacketData data,
+                size_t length, bool reliable) override;
+
+  void Flush();
+
+  // Drops packets buffered for a disconnected user
+  void Discard(UserId userId);
+
+  size_t GetMtu() const;
+
+private:
+  struct Impl;
+  std::shared_ptr<Impl> pImpl;
+};
+
+// Calls f(data, length) for every packet of a batch frame, or once for any
+// other packet
+template <class F>
+inline void ForEachBatchedPacket(PacketData data, size_t length, const F& f)
+{
+  if (!length || data[0] != BatchPacketId)
+    return f(data, length);
+
+  size_t i = 1;
+  while (i < length) {
+    if (i + 2 > length)
+      throw std::runtime_error("Truncated batch frame");
+    size_t n = data[i] | (static_cast<size_t>(data[i + 1]) << 8);
+    i += 2;
+    if (n == 0 || i + n > length)
+      throw std::runtime_error("Bad packet length in batch frame");
+    f(data + i, n);
+    i += n;
+  }
+}
+}
\ No newline at end of file
@@ -18,19 +18,36 @@ public:
   void Send(Networking::UserId targetUserId, Networking::PacketData data,
             size_t length, bool reliable) override
   {
-    if (realIdByCombined.size() <= targetUserId)
-      throw std::runtime_error("User with id " + std::to_string(targetUserId) +
-                               " doesn't exist");
+    auto& p = GetRealId(targetUserId);
+    childs[p.first]->Send(p.second, data, length, reliable);
+  }
 
-    auto& p = realIdByCombined[targetUserId];
-    auto serverIdx = p.first;
-    auto userId = p.second;
+  void SendMany(const std::vector<Networking::UserId>& targetUserIds,
+                Networking::PacketData data, size_t length,
+                bool reliable) override
+  {
+    for (auto& d : childData)
+      d.sendManyIds.clear();
+
+    for (auto targetUserId : targetUserIds) {
+      auto& p = GetRealId(targetUserId);
+      childData[p.first].sendManyIds.push_back(p.second);
+    }
 
-    if (userId == Networking::InvalidUserId)
+    for (size_t i = 0; i < childs.size(); ++i) {
+      if (!childData[i].sendManyIds.empty())
+        childs[i]->SendMany(childData[i].sendManyIds, data, length, reliable);
+    }
+  }
+
+  const std::pair<size_t, Networking::UserId>& GetRealId(
+    Networking::UserId targetUserId) const
+  {
+    if (realIdByCombined.size() <= targetUserId ||
+        realIdByCombined[targetUserId].second == Networking::InvalidUserId)
       throw std::runtime_error("User with id " + std::to_string(targetUserId) +
                                " doesn't exist");
-
-    childs[serverIdx]->Send(userId, data, length, reliable);
+    return realIdByCombined[targetUserId];
   }
 
   void Tick(OnPacket onPacket, void* state) override
@@ -114,6 +131,7 @@ public:
   struct ChildData
   {
     std::vector<Networking::UserId> combinedIdByReal;
+    std::vector<Networking::UserId> sendManyIds;
   };
 
   std::vector<ChildData> childData;
@@ -47,6 +47,16 @@ class ISendTarget
 public:
   virtual void Send(UserId targetUserId, PacketData data, size_t length,
                     bool reliable) = 0;
+
+  // Sends the same packet to every user in targetUserIds (no duplicates).
+  // Servers override this to share one copy of the payload between
+  // recipients instead of copying it per Send call
+  virtual void SendMany(const std::vector<UserId>& targetUserIds,
+                        PacketData data, size_t length, bool reliable)
+  {
+    for (auto targetUserId : targetUserIds)
+      Send(targetUserId, data, length, reliable);
+  }
 };
 
 class IServer : public ISendTarget
@@ -59,28 +69,4 @@ public:
 
   virtual void Tick(OnPacket onPacket, void* state) = 0;
 };
-
-template <class FormatCallback, class... Ts>
-inline void Format(const FormatCallback& cb, const char* format, Ts... args)
-{
-  auto textSize = (size_t)snprintf(nullptr, 0, format, args...);
-
-  const auto n = textSize + sizeof('\0') + sizeof(MinPacketId);
-  std::vector<char> buf(n);
-
-  buf[0] = MinPacketId;
-  auto len = (size_t)snprintf(buf.data() + 1, n - 1, format, args...);
-
-  cb(reinterpret_cast<Networking::PacketData>(buf.data()), len + 1);
-}
-
-template <class... Ts>
-inline void SendFormatted(Networking::ISendTarget* sendTarget,
-                          Networking::UserId userId, const char* format,
-                          Ts... args)
-{
-  Format([&](Networking::PacketData data,
-             size_t length) { sendTarget->Send(userId, data, length, true); },
-         format, args...);
-}
 }
\ No newline at end of file
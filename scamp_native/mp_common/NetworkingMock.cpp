@@ -8,9 +8,27 @@ namespace NetworkingMock {
 struct Packet
 {
   Networking::PacketType type = Networking::PacketType::Invalid;
-  std::vector<uint8_t> data;
+
+  // Shared between all recipients of MockServer::SendMany
+  std::shared_ptr<const std::vector<uint8_t>> data;
+
   const char* error = "";
+
+  Networking::PacketData GetData() const
+  {
+    return data && !data->empty() ? data->data() : nullptr;
+  }
+
+  size_t GetLength() const { return data ? data->size() : 0; }
 };
+
+std::shared_ptr<const std::vector<uint8_t>> MakePayload(
+  Networking::PacketData data, size_t length)
+{
+  if (!data)
+    return nullptr;
+  return std::make_shared<const std::vector<uint8_t>>(data, data + length);
+}
 }
 
 namespace NetworkingMock {
@@ -44,8 +62,7 @@ public:
   void Tick(OnPacket onPacket, void* state) override
   {
     for (auto& p : packets)
-      onPacket(state, p->type, p->data.empty() ? nullptr : &p->data[0],
-               p->data.size(), p->error);
+      onPacket(state, p->type, p->GetData(), p->GetLength(), p->error);
     packets.clear();
   }
 
@@ -73,6 +90,18 @@ struct Networking::MockServer::Impl
   std::vector<
     std::pair<Networking::UserId, std::unique_ptr<NetworkingMock::Packet>>>
     packets;
+
+  std::shared_ptr<NetworkingMock::MockClient> GetClient(
+    Networking::UserId targetUserId)
+  {
+    auto cl = clients.size() > targetUserId ? clients[targetUserId].lock()
+                                            : nullptr;
+    if (!cl)
+      throw std::runtime_error("No client with id " +
+                               std::to_string(targetUserId) +
+                               " found on MockServer");
+    return cl;
+  }
 };
 
 Networking::MockServer::MockServer()
@@ -89,9 +118,7 @@ std::shared_ptr<Networking::IClient> Networking::MockServer::CreateClient()
       parent->pImpl->packets.push_back(
         { id,
           std::unique_ptr<NetworkingMock::Packet>(new NetworkingMock::Packet(
-            { type,
-              data ? std::vector<uint8_t>(data, data + length)
-                   : std::vector<uint8_t>() })) });
+            { type, NetworkingMock::MakePayload(data, length) })) });
     };
 
   auto it =
@@ -128,25 +155,35 @@ std::shared_ptr<Networking::IClient> Networking::MockServer::CreateClient()
 void Networking::MockServer::Send(UserId targetUserId, PacketData data,
                                   size_t length, bool reliable)
 {
-  if (pImpl->clients.size() <= targetUserId ||
-      pImpl->clients[targetUserId].expired() ||
-      !pImpl->clients[targetUserId].lock())
-    throw std::runtime_error("No client with id " +
-                             std::to_string(targetUserId) +
-                             " found on MockServer");
-  auto cl = pImpl->clients[targetUserId].lock();
+  auto cl = pImpl->GetClient(targetUserId);
   cl->AddPacket(
     std::unique_ptr<NetworkingMock::Packet>(new NetworkingMock::Packet(
       { Networking::PacketType::Message,
-        std::vector<uint8_t>(data, data + length) })));
+        NetworkingMock::MakePayload(data, length) })));
+}
+
+void Networking::MockServer::SendMany(const std::vector<UserId>& targetUserIds,
+                                      PacketData data, size_t length,
+                                      bool reliable)
+{
+  std::vector<std::shared_ptr<NetworkingMock::MockClient>> targets;
+  targets.reserve(targetUserIds.size());
+  for (auto targetUserId : targetUserIds)
+    targets.push_back(pImpl->GetClient(targetUserId));
+
+  auto payload = NetworkingMock::MakePayload(data, length);
+  for (auto& cl : targets) {
+    cl->AddPacket(
+      std::unique_ptr<NetworkingMock::Packet>(new NetworkingMock::Packet(
+        { Networking::PacketType::Message, payload })));
+  }
 }
 
 void Networking::MockServer::Tick(OnPacket onPacket, void* state)
 {
   for (auto& pair : pImpl->packets) {
     auto& p = pair.second;
-    onPacket(state, pair.first, p->type,
-             p->data.empty() ? nullptr : &p->data[0], p->data.size());
+    onPacket(state, pair.first, p->type, p->GetData(), p->GetLength());
   }
   pImpl->packets.clear();
 }
\ No newline at end of file
@@ -13,6 +13,9 @@ public:
   void Send(UserId targetUserId, PacketData data, size_t length,
             bool reliable) override;
 
+  void SendMany(const std::vector<UserId>& targetUserIds, PacketData data,
+                size_t length, bool reliable) override;
+
   void Tick(OnPacket onPacket, void* state) override;
 
 private:
@@ -0,0 +1,390 @@
+#include "NetworkingThreaded.h"
+#include "MovementCodec.h"
+#include "MpscQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+struct Incoming
+{
+  Networking::UserId userId = Networking::InvalidUserId;
+  Networking::PacketType type = Networking::PacketType::Invalid;
+  std::vector<uint8_t> data;
+
+  // JSON messages are parsed by the I/O thread. The parser travels with the
+  // slot and is heap-allocated, so the element stays valid across swaps
+  std::unique_ptr<simdjson::dom::parser> parser;
+  simdjson::dom::element parsed;
+  bool isParsed = false;
+};
+
+struct Outgoing
+{
+  enum class Kind : uint8_t
+  {
+    Packet,
+
+    // The game thread has processed the disconnect of targets[0]
+    DisconnectAck
+  };
+
+  Kind kind = Kind::Packet;
+  bool reliable = false;
+  std::vector<Networking::UserId> targets;
+  std::vector<uint8_t> data;
+};
+
+// Entries swapped out of the queue keep their buffers, so steady traffic
+// doesn't allocate
+thread_local Outgoing g_outgoingScratch;
+
+// The message being delivered by ThreadedServer::Tick on this thread
+struct PreParsed
+{
+  Networking::PacketData data = nullptr;
+  size_t length = 0;
+  const simdjson::dom::element* element = nullptr;
+};
+thread_local PreParsed g_preParsed;
+
+class PreParsedGuard
+{
+public:
+  explicit PreParsedGuard(const Incoming& in)
+  {
+    if (in.isParsed)
+      g_preParsed = { in.data.data(), in.data.size(), &in.parsed };
+  }
+
+  ~PreParsedGuard() { g_preParsed = PreParsed(); }
+};
+}
+
+struct Networking::ThreadedServer::Impl
+{
+  Impl(std::shared_ptr<IServer> server_, size_t queueCapacity,
+       std::chrono::microseconds idleSleep_, const ReceiveBudget& budget_,
+       std::shared_ptr<ReceiveStats> receiveStats_)
+    : server(server_)
+    , incoming(queueCapacity)
+    , outgoing(queueCapacity)
+    , idleSleep(idleSleep_)
+    , budget(budget_)
+    , receiveStats(receiveStats_)
+  {
+    thread = std::thread([this] { IoThreadMain(); });
+  }
+
+  ~Impl()
+  {
+    stop = true;
+    thread.join();
+  }
+
+  // I/O thread
+
+  void IoThreadMain()
+  {
+    while (!stop) {
+      busy = false;
+      try {
+        server->Tick(OnPacketIo, this);
+      } catch (...) {
+        std::lock_guard l(errorMutex);
+        if (!error)
+          error = std::current_exception();
+      }
+
+      FlushIncomingOverflow();
+      SendOutgoingIo();
+
+      if (!busy)
+        std::this_thread::sleep_for(idleSleep);
+    }
+  }
+
+  void SendOutgoingIo()
+  {
+    while (outgoing.TryPop(ioOutgoing)) {
+      busy = true;
+      SendIo(ioOutgoing);
+    }
+
+    // Pushed after everything that is in the queue now
+    {
+      std::lock_guard l(outgoingOverflowMutex);
+      ioOutgoingOverflow.swap(outgoingOverflow);
+      hasOutgoingOverflow = false;
+    }
+    for (auto& out : ioOutgoingOverflow) {
+      busy = true;
+      SendIo(out);
+    }
+    ioOutgoingOverflow.clear();
+  }
+
+  static void OnPacketIo(void* state, UserId userId, PacketType packetType,
+                         PacketData data, size_t length)
+  {
+    auto this_ = reinterpret_cast<Impl*>(state);
+    this_->busy = true;
+
+    auto& in = this_->ioIncoming;
+    in.userId = userId;
+    in.type = packetType;
+    in.data.assign(data, data + length);
+    in.isParsed = false;
+
+    if (packetType == PacketType::ServerSideUserDisconnect)
+      this_->SetDisconnectPending(userId, true);
+
+    // Not returning holds the rest of the packets in the wrapped server
+    // until the game thread catches up. It never waits for this thread, so
+    // keep sending its packets
+    this_->FlushIncomingOverflow();
+    auto& overflow = this_->incomingOverflow;
+    if (overflow.size() >= this_->incoming.GetCapacity()) {
+      ++this_->numIncomingStalls;
+      while (overflow.size() >= this_->incoming.GetCapacity() &&
+             !this_->stop) {
+        this_->SendOutgoingIo();
+        std::this_thread::sleep_for(this_->idleSleep);
+        this_->FlushIncomingOverflow();
+      }
+    }
+
+    if (packetType == PacketType::Message && length > 1 &&
+        !MovementCodec::IsBinary(data, length)) {
+      if (!in.parser)
+        in.parser.reset(new simdjson::dom::parser);
+      in.isParsed =
+        in.parser->parse(in.data.data() + 1, length - 1).get(in.parsed) ==
+        simdjson::SUCCESS;
+    }
+
+    if (overflow.empty() && this_->incoming.TryPush(in))
+      return;
+    overflow.push_back(std::move(in));
+    in = Incoming();
+  }
+
+  void FlushIncomingOverflow()
+  {
+    while (!incomingOverflow.empty() &&
+           incoming.TryPush(incomingOverflow.front()))
+      incomingOverflow.pop_front();
+  }
+
+  void SendIo(Outgoing& out)
+  {
+    if (out.kind == Outgoing::Kind::DisconnectAck) {
+      SetDisconnectPending(out.targets[0], false);
+      return;
+    }
+
+    // Users who disconnected before the game thread noticed it. Their ids
+    // may already belong to new connections
+    auto& targets = out.targets;
+    auto newEnd =
+      std::remove_if(targets.begin(), targets.end(), [this](UserId userId) {
+        return userId < disconnectPending.size() &&
+          disconnectPending[userId];
+      });
+    numDroppedDisconnected += targets.end() - newEnd;
+    targets.erase(newEnd, targets.end());
+
+    try {
+      if (targets.size() == 1)
+        server->Send(targets[0], out.data.data(), out.data.size(),
+                     out.reliable);
+      else if (!targets.empty())
+        server->SendMany(targets, out.data.data(), out.data.size(),
+                         out.reliable);
+    } catch (std::exception&) {
+      ++numFailedSends;
+    }
+  }
+
+  void SetDisconnectPending(UserId userId, bool pending)
+  {
+    if (disconnectPending.size() <= userId)
+      disconnectPending.resize(static_cast<size_t>(userId) + 1, false);
+    disconnectPending[userId] = pending;
+  }
+
+  // Game thread
+
+  // Never waits for the I/O thread. Once the queue is full, packets go to
+  // the overflow until the I/O thread takes it, so the order is kept
+  void Push(Outgoing& out)
+  {
+    if (!hasOutgoingOverflow && outgoing.TryPush(out))
+      return;
+
+    std::lock_guard l(outgoingOverflowMutex);
+    if (out.kind == Outgoing::Kind::Packet && !out.reliable &&
+        outgoingOverflow.size() >= outgoing.GetCapacity()) {
+      ++numDroppedUnreliable;
+      return;
+    }
+    outgoingOverflow.push_back(std::move(out));
+    out = Outgoing();
+    hasOutgoingOverflow = true;
+  }
+
+  void PushDisconnectAck(UserId userId)
+  {
+    auto& out = g_outgoingScratch;
+    out.kind = Outgoing::Kind::DisconnectAck;
+    out.reliable = true;
+    out.targets.assign(1, userId);
+    out.data.clear();
+    Push(out);
+  }
+
+  const std::shared_ptr<IServer> server;
+  Networking::MpscQueue<Incoming> incoming;
+  Networking::MpscQueue<Outgoing> outgoing;
+  const std::chrono::microseconds idleSleep;
+
+  std::atomic<bool> stop = false;
+  std::atomic<uint64_t> numIncomingStalls = 0;
+  std::atomic<uint64_t> numDroppedUnreliable = 0;
+  std::atomic<uint64_t> numDroppedDisconnected = 0;
+  std::atomic<uint64_t> numFailedSends = 0;
+
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  // The queue above is lock-free, the mutex is only taken once it is full.
+  // Reliable packets are never dropped and the game thread never waits, so
+  // the overflow is only bounded for unreliable ones
+  std::mutex outgoingOverflowMutex;
+  std::deque<Outgoing> outgoingOverflow;
+  std::atomic<bool> hasOutgoingOverflow = false;
+
+  // Accessed by the I/O thread only
+  bool busy = false;
+  Incoming ioIncoming;
+  Outgoing ioOutgoing;
+  std::deque<Outgoing> ioOutgoingOverflow;
+  std::vector<bool> disconnectPending;
+
+  // Holds up to the queue capacity, see OnPacketIo
+  std::deque<Incoming> incomingOverflow;
+
+  // Accessed by the thread calling Tick only
+  const ReceiveBudget budget;
+  const std::shared_ptr<ReceiveStats> receiveStats;
+  Incoming gameIncoming;
+  bool isGameIncomingDeferred = false;
+
+  std::thread thread;
+};
+
+Networking::ThreadedServer::ThreadedServer(
+  std::shared_ptr<IServer> server, size_t queueCapacity,
+  std::chrono::microseconds idleSleep, const ReceiveBudget& budget,
+  std::shared_ptr<ReceiveStats> receiveStats)
+{
+  if (!server)
+    throw std::runtime_error("ThreadedServer requires a server to wrap");
+  if (queueCapacity == 0)
+    throw std::runtime_error("Network queue capacity must be positive");
+  pImpl.reset(
+    new Impl(server, queueCapacity, idleSleep, budget, receiveStats));
+}
+
+Networking::ThreadedServer::~ThreadedServer() = default;
+
+void Networking::ThreadedServer::Send(UserId targetUserId, PacketData data,
+                                      size_t length, bool reliable)
+{
+  auto& out = g_outgoingScratch;
+  out.kind = Outgoing::Kind::Packet;
+  out.reliable = reliable;
+  out.targets.assign(1, targetUserId);
+  out.data.assign(data, data + length);
+  pImpl->Push(out);
+}
+
+void Networking::ThreadedServer::SendMany(
+  const std::vector<UserId>& targetUserIds, PacketData data, size_t length,
+  bool reliable)
+{
+  if (targetUserIds.empty())
+    return;
+  auto& out = g_outgoingScratch;
+  out.kind = Outgoing::Kind::Packet;
+  out.reliable = reliable;
+  out.targets.assign(targetUserIds.begin(), targetUserIds.end());
+  out.data.assign(data, data + length);
+  pImpl->Push(out);
+}
+
+void Networking::ThreadedServer::Tick(OnPacket onPacket, void* state)
+{
+  {
+    std::lock_guard l(pImpl->errorMutex);
+    if (pImpl->error) {
+      auto error = pImpl->error;
+      pImpl->error = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+  // Packets arriving while we drain wait for the next Tick
+  const auto start = std::chrono::steady_clock::now();
+  const auto capacity = pImpl->incoming.GetCapacity();
+  auto& in = pImpl->gameIncoming;
+  for (uint32_t numPackets = 0; numPackets < capacity; ++numPackets) {
+    if (!pImpl->isGameIncomingDeferred && !pImpl->incoming.TryPop(in))
+      break;
+    pImpl->isGameIncomingDeferred = false;
+
+    if (pImpl->budget.IsExhausted(numPackets, start)) {
+      pImpl->isGameIncomingDeferred = true;
+      if (pImpl->receiveStats)
+        ++pImpl->receiveStats->numTicksOverBudget;
+      break;
+    }
+
+    const bool isDisconnect =
+      in.type == PacketType::ServerSideUserDisconnect;
+    try {
+      PreParsedGuard guard(in);
+      onPacket(state, in.userId, in.type, in.data.data(), in.data.size());
+    } catch (...) {
+      if (isDisconnect)
+        pImpl->PushDisconnectAck(in.userId);
+      throw;
+    }
+    if (isDisconnect)
+      pImpl->PushDisconnectAck(in.userId);
+  }
+}
+
+Networking::ThreadedServer::Stats Networking::ThreadedServer::GetStats()
+  const
+{
+  Stats res;
+  res.numIncomingStalls = pImpl->numIncomingStalls;
+  res.numDroppedUnreliable = pImpl->numDroppedUnreliable;
+  res.numDroppedDisconnected = pImpl->numDroppedDisconnected;
+  res.numFailedSends = pImpl->numFailedSends;
+  return res;
+}
+
+const simdjson::dom::element* Networking::ThreadedServer::FindPreParsed(
+  PacketData data, size_t length)
+{
+  if (!g_preParsed.element || g_preParsed.data != data ||
+      g_preParsed.length != length)
+    return nullptr;
+  return g_preParsed.element;
+}
\ No newline at end of file
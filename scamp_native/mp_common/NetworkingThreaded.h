@@ -0,0 +1,69 @@
+#pragma once
+#include "NetworkingInterface.h"
+#include "ReceiveBudget.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <simdjson.h>
+
+namespace Networking {
+// Runs the wrapped server on a dedicated I/O thread. Incoming packets are
+// copied out of the wrapped server into a bounded queue and delivered by
+// Tick, outgoing packets travel the opposite way. Packets that don't fit
+// into a full queue go to an overflow buffer. The game thread never waits
+// for the I/O thread. Once the incoming overflow is full too, the I/O thread
+// stops draining the wrapped server until Tick catches up, sending outgoing
+// packets meanwhile. JSON messages are parsed on the I/O thread, see
+// FindPreParsed. The wrapped server must not be used by anyone else while
+// ThreadedServer exists
+class ThreadedServer : public IServer
+{
+public:
+  struct Stats
+  {
+    // Times the I/O thread stopped draining the wrapped server because the
+    // incoming queue and its overflow were full
+    uint64_t numIncomingStalls = 0;
+
+    // Unreliable packets dropped because the outgoing queue and its overflow
+    // were full
+    uint64_t numDroppedUnreliable = 0;
+
+    // Packets addressed to users who have already disconnected
+    uint64_t numDroppedDisconnected = 0;
+
+    // Exceptions thrown by the wrapped server's Send on the I/O thread
+    uint64_t numFailedSends = 0;
+  };
+
+  // budget limits Tick of the game thread, the I/O thread drains the
+  // wrapped server as fast as it can
+  ThreadedServer(
+    std::shared_ptr<IServer> server, size_t queueCapacity,
+    std::chrono::microseconds idleSleep = std::chrono::microseconds(1000),
+    const ReceiveBudget& budget = {},
+    std::shared_ptr<ReceiveStats> receiveStats = nullptr);
+  ~ThreadedServer() override;
+
+  void Send(UserId targetUserId, PacketData data, size_t length,
+            bool reliable) override;
+  void SendMany(const std::vector<UserId>& targetUserIds, PacketData data,
+                size_t length, bool reliable) override;
+
+  // Delivers packets received by the I/O thread since the previous call.
+  // Rethrows exceptions thrown by the wrapped server's Tick
+  void Tick(OnPacket onPacket, void* state) override;
+
+  Stats GetStats() const;
+
+  // Returns the DOM of the JSON message onPacket is called with if the I/O
+  // thread has parsed it. Valid until onPacket returns. Returns nullptr for
+  // any other data
+  static const simdjson::dom::element* FindPreParsed(PacketData data,
+                                                     size_t length);
+
+private:
+  struct Impl;
+  std::shared_ptr<Impl> pImpl;
+};
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "PacketBuilder.h"
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// Most formatted fragments are short, longer ones are formatted twice
+constexpr size_t g_formatReserve = 128;
+
+struct BufferPool
+{
+  std::vector<std::unique_ptr<std::vector<char>>> buffers;
+  size_t numUsed = 0;
+};
+
+thread_local BufferPool g_pool;
+
+std::vector<char>& AcquireBuffer()
+{
+  if (g_pool.numUsed == g_pool.buffers.size())
+    g_pool.buffers.emplace_back(new std::vector<char>);
+  return *g_pool.buffers[g_pool.numUsed++];
+}
+}
+
+Networking::PacketBuilder::PacketBuilder()
+  : buf(AcquireBuffer())
+{
+  buf.clear();
+  buf.push_back(static_cast<char>(MinPacketId));
+}
+
+Networking::PacketBuilder::~PacketBuilder()
+{
+  --g_pool.numUsed;
+}
+
+Networking::PacketBuilder& Networking::PacketBuilder::Append(
+  std::string_view fragment)
+{
+  buf.insert(buf.end(), fragment.begin(), fragment.end());
+  return *this;
+}
+
+Networking::PacketBuilder& Networking::PacketBuilder::Append(char c)
+{
+  buf.push_back(c);
+  return *this;
+}
+
+Networking::PacketBuilder& Networking::PacketBuilder::AppendJsonString(
+  std::string_view s)
+{
+  buf.push_back('"');
+  for (char c : s) {
+    switch (c) {
+      case '"':
+        Append("\\\"");
+        break;
+      case '\\':
+        Append("\\\\");
+        break;
+      case '\n':
+        Append("\\n");
+        break;
+      case '\r':
+        Append("\\r");
+        break;
+      case '\t':
+        Append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+          AppendFormatted("\\u%04x", static_cast<unsigned>(c));
+        else
+          buf.push_back(c);
+        break;
+    }
+  }
+  buf.push_back('"');
+  return *this;
+}
+
+Networking::PacketBuilder& Networking::PacketBuilder::AppendFormatted(
+  const char* format, ...)
+{
+  const size_t pos = buf.size();
+
+  // Format right into the buffer, grow and retry if it's not enough
+  buf.resize(pos + g_formatReserve);
+
+  va_list args;
+  va_start(args, format);
+  va_list argsCopy;
+  va_copy(argsCopy, args);
+  auto n = vsnprintf(buf.data() + pos, buf.size() - pos, format, args);
+  va_end(args);
+
+  if (n < 0) {
+    va_end(argsCopy);
+    buf.resize(pos);
+    throw std::runtime_error("Bad format string '" + std::string(format) +
+                             "'");
+  }
+
+  if (pos + n + 1 > buf.size()) {
+    buf.resize(pos + n + 1);
+    vsnprintf(buf.data() + pos, buf.size() - pos, format, argsCopy);
+  }
+  va_end(argsCopy);
+
+  buf.resize(pos + n);
+  return *this;
+}
+
+Networking::PacketData Networking::PacketBuilder::GetData() const
+{
+  return reinterpret_cast<PacketData>(buf.data());
+}
+
+size_t Networking::PacketBuilder::GetLength() const
+{
+  return buf.size();
+}
+
+void Networking::PacketBuilder::Clear()
+{
+  buf.resize(1);
+}
+
+void Networking::PacketBuilder::Send(ISendTarget& target, UserId userId,
+                                     bool reliable) const
+{
+  target.Send(userId, GetData(), GetLength(), reliable);
+}
\ No newline at end of file
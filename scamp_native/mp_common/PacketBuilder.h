@@ -0,0 +1,45 @@
+#pragma once
+#include "NetworkingInterface.h"
+#include <cstdarg>
+#include <string_view>
+#include <vector>
+
+namespace Networking {
+// Builds an outgoing message starting with MinPacketId. Buffers are pooled
+// per thread and keep their capacity, so once warmed up building a message
+// doesn't allocate. Builders may be nested, each takes its own buffer until
+// destroyed
+class PacketBuilder
+{
+public:
+  PacketBuilder();
+  ~PacketBuilder();
+
+  PacketBuilder(const PacketBuilder&) = delete;
+  PacketBuilder& operator=(const PacketBuilder&) = delete;
+
+  // Appends a pre-serialized fragment as is
+  PacketBuilder& Append(std::string_view fragment);
+  PacketBuilder& Append(char c);
+
+  // Appends s as a quoted and escaped JSON string
+  PacketBuilder& AppendJsonString(std::string_view s);
+
+  PacketBuilder& AppendFormatted(const char* format, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+  PacketData GetData() const;
+  size_t GetLength() const;
+
+  // Drops everything but the MinPacketId prefix
+  void Clear();
+
+  void Send(ISendTarget& target, UserId userId, bool reliable = true) const;
+
+private:
+  std::vector<char>& buf;
+};
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Networking {
+// Limits a single IServer::Tick. Packets over budget wait for the next Tick.
+// Zero means no limit
+struct ReceiveBudget
+{
+  uint32_t maxPackets = 0;
+  std::chrono::microseconds maxTime{ 0 };
+
+  bool IsExhausted(uint32_t numPackets,
+                   std::chrono::steady_clock::time_point start) const
+  {
+    if (maxPackets > 0 && numPackets >= maxPackets)
+      return true;
+    return maxTime.count() > 0 && numPackets > 0 &&
+      std::chrono::steady_clock::now() - start >= maxTime;
+  }
+};
+
+struct ReceiveStats
+{
+  // Ticks that left packets for the next Tick because the budget was
+  // exhausted
+  std::atomic<uint64_t> numTicksOverBudget = 0;
+};
+}
\ No newline at end of file
@@ -3,16 +3,36 @@
 #include "EspmGameObject.h"
 #include "Exceptions.h"
 #include "FindRecipe.h"
+#include "MovementCodec.h"
 #include "MovementValidation.h"
 #include "MsgType.h"
+#include "PacketBuilder.h"
 #include "PapyrusObjectReference.h"
 #include "UserMessageOutput.h"
 #include "Utils.h"
+#include <algorithm>
 
-MpActor* ActionListener::SendToNeighbours(
-  uint32_t idx, const simdjson::dom::element& jMessage,
-  Networking::UserId userId, Networking::PacketData data, size_t length,
-  bool reliable)
+namespace {
+// Fields the server doesn't track are taken from the client's message.
+// Defaults are used if there is no message. Returns false if the message is
+// malformed
+bool ReadUntrackedMovementFields(
+  const IActionListener::RawMessageData& rawMsgData,
+  MovementCodec::Movement& out)
+{
+  if (MovementCodec::IsBinary(rawMsgData.unparsed,
+                              rawMsgData.unparsedLength)) {
+    MovementCodec::Deserialize(rawMsgData.unparsed, rawMsgData.unparsedLength,
+                               out);
+    return true;
+  }
+  return rawMsgData.unparsedLength == 0 ||
+    MovementCodec::FromJson(rawMsgData.parsed, out);
+}
+}
+
+MpActor* ActionListener::FindActorToUpdate(uint32_t idx,
+                                           Networking::UserId userId)
 {
   MpActor* myActor = partOne.serverState.ActorByUser(userId);
   // The old behavior is doing nothing in that case. This is covered by tests
@@ -20,7 +40,7 @@ MpActor* ActionListener::SendToNeighbours(
     return nullptr;
 
   MpActor* actor =
-    dynamic_cast<MpActor*>(partOne.worldState.LookupFormByIdx(idx));
+    FormCast<MpActor>(partOne.worldState.LookupFormByIdx(idx));
   if (!actor)
     throw std::runtime_error("SendToNeighbours - target actor doesn't exist");
 
@@ -36,19 +56,150 @@ MpActor* ActionListener::SendToNeighbours(
     throw PublicError(ss.str());
   }
 
+  return actor;
+}
+
+MpActor* ActionListener::SendToNeighbours(
+  uint32_t idx, const simdjson::dom::element& jMessage,
+  Networking::UserId userId, Networking::PacketData data, size_t length,
+  bool reliable)
+{
+  MpActor* actor = FindActorToUpdate(idx, userId);
+  if (!actor)
+    return nullptr;
+
+  std::vector<Networking::UserId> targets;
   for (auto listener : actor->GetListeners()) {
-    auto listenerAsActor = dynamic_cast<MpActor*>(listener);
+    auto listenerAsActor = FormCast<MpActor>(listener);
     if (listenerAsActor) {
       auto targetuserId = partOne.serverState.UserByActor(listenerAsActor);
       if (targetuserId != Networking::InvalidUserId) {
-        partOne.GetSendTarget().Send(targetuserId, data, length, reliable);
+        targets.push_back(targetuserId);
       }
     }
   }
 
+  if (!targets.empty())
+    partOne.GetSendTarget().SendMany(targets, data, length, reliable);
+
   return actor;
 }
 
+void ActionListener::SelectStateTargets(
+  MpActor& emitter, UpdateRateLod::Channel channel,
+  Networking::PacketData data, size_t length,
+  std::vector<Networking::UserId>& targets)
+{
+  auto& lod = partOne.GetUpdateRateLod();
+  const bool lodEnabled = lod.IsEnabled();
+  const uint32_t sequence =
+    lodEnabled ? lod.NextSequence(emitter.GetFormId(), channel) : 0;
+
+  missedBy.clear();
+  for (auto listener : emitter.GetListeners()) {
+    auto listenerAsActor = FormCast<MpActor>(listener);
+    if (!listenerAsActor)
+      continue;
+    auto targetUserId = partOne.serverState.UserByActor(listenerAsActor);
+    if (targetUserId == Networking::InvalidUserId)
+      continue;
+
+    if (lodEnabled &&
+        !lod.ShouldForward(
+          sequence,
+          (listenerAsActor->GetPos() - emitter.GetPos()).SqrLength()))
+      missedBy.push_back(targetUserId);
+    else
+      targets.push_back(targetUserId);
+  }
+
+  if (lodEnabled)
+    lod.SetPending(emitter.GetFormId(), channel, data, length, missedBy);
+}
+
+void ActionListener::ReplicateMovement(
+  const std::vector<Networking::UserId>& users,
+  const MovementCodec::Movement& movement, Networking::PacketData json,
+  size_t jsonLength)
+{
+  auto& sendTarget = partOne.GetSendTarget();
+
+  std::vector<Networking::UserId> jsonTargets, binaryTargets, deltaTargets;
+
+  for (auto targetUserId : users) {
+    auto version =
+      partOne.serverState.GetMovementCodecVersion(targetUserId);
+    if (version >= MovementCodec::MinDeltaVersion)
+      deltaTargets.push_back(targetUserId);
+    else if (version == MovementCodec::NoVersion)
+      jsonTargets.push_back(targetUserId);
+    else
+      binaryTargets.push_back(targetUserId);
+  }
+
+  auto& replication = partOne.GetMovementReplication();
+  auto& packets = movementPackets;
+  if (!deltaTargets.empty() &&
+      replication.Write(deltaTargets, movement, packets)) {
+    for (auto& packet : packets)
+      sendTarget.SendMany(packet.targets, packet.data.data(),
+                          packet.data.size(), false);
+  } else {
+    binaryTargets.insert(binaryTargets.end(), deltaTargets.begin(),
+                         deltaTargets.end());
+  }
+
+  std::vector<uint8_t> buf;
+  if (!binaryTargets.empty() && !MovementCodec::Serialize(movement, buf))
+    jsonTargets.insert(jsonTargets.end(), binaryTargets.begin(),
+                       binaryTargets.end());
+  else if (!binaryTargets.empty())
+    sendTarget.SendMany(binaryTargets, buf.data(), buf.size(), false);
+
+  if (!jsonTargets.empty())
+    sendTarget.SendMany(jsonTargets, json, jsonLength, false);
+}
+
+void ActionListener::FlushUpdateRateLod()
+{
+  auto& lod = partOne.GetUpdateRateLod();
+  if (!lod.IsEnabled())
+    return;
+
+  std::vector<Networking::UserId> users;
+
+  lod.Flush([&](uint32_t emitterId, UpdateRateLod::Channel channel,
+                Networking::PacketData data, size_t length,
+                const std::vector<Networking::UserId>& missedBy) {
+    auto emitter =
+      FormCast<MpActor>(partOne.worldState.LookupFormById(emitterId).get());
+    if (!emitter)
+      return;
+
+    // Users might have unsubscribed or reconnected with the same id since
+    users.clear();
+    auto& listeners = emitter->GetListeners();
+    for (auto userId : missedBy) {
+      auto actor = partOne.serverState.ActorByUser(userId);
+      if (actor && listeners.count(actor))
+        users.push_back(userId);
+    }
+    if (users.empty())
+      return;
+
+    if (channel != UpdateRateLod::Channel::Movement)
+      return partOne.GetSendTarget().SendMany(users, data, length, false);
+
+    // Pending movement is the JSON built by OnUpdateMovement
+    simdjson::dom::element jMessage;
+    MovementCodec::Movement movement;
+    if (parser.parse(data + 1, length - 1).get(jMessage) ==
+          simdjson::SUCCESS &&
+        MovementCodec::FromJson(jMessage, movement))
+      ReplicateMovement(users, movement, data, length);
+  });
+}
+
 MpActor* ActionListener::SendToNeighbours(uint32_t idx,
                                           const RawMessageData& rawMsgData,
                                           bool reliable)
@@ -70,47 +221,104 @@ void ActionListener::OnUpdateMovement(const RawMessageData& rawMsgData,
                                       const NiPoint3& rot, bool isInJumpState,
                                       bool isWeapDrawn, uint32_t worldOrCell)
 {
-  auto actor = SendToNeighbours(idx, rawMsgData);
-  if (actor) {
-    DummyMessageOutput msgOutputDummy;
-    UserMessageOutput msgOutput(partOne.GetSendTarget(), rawMsgData.userId);
-
-    bool isMe = partOne.serverState.ActorByUser(rawMsgData.userId) == actor;
-
-    bool teleportFlag = actor->GetTeleportFlag();
-    actor->SetTeleportFlag(false);
-
-    static const NiPoint3 reallyWrongPos = {
-      std::numeric_limits<float>::infinity(),
-      std::numeric_limits<float>::infinity(),
-      std::numeric_limits<float>::infinity()
-    };
-
-    if (!MovementValidation::Validate(
-          *actor, teleportFlag ? reallyWrongPos : pos, worldOrCell,
-          isMe ? static_cast<IMessageOutput&>(msgOutput)
-               : static_cast<IMessageOutput&>(msgOutputDummy))) {
-      return;
-    }
+  MpActor* actor = FindActorToUpdate(idx, rawMsgData.userId);
+  if (!actor)
+    return;
 
-    actor->SetPos(pos);
-    actor->SetAngle(rot);
-    actor->SetAnimationVariableBool("bInJumpState", isInJumpState);
-    actor->SetAnimationVariableBool("_skymp_isWeapDrawn", isWeapDrawn);
+  MovementCodec::Movement movement;
+  if (!ReadUntrackedMovementFields(rawMsgData, movement))
+    throw std::runtime_error("UpdateMovement has malformed fields");
 
-    if (partOne.worldState.lastMovUpdateByIdx.size() <= idx) {
-      auto newSize = static_cast<size_t>(idx) + 1;
-      partOne.worldState.lastMovUpdateByIdx.resize(newSize);
-    }
-    partOne.worldState.lastMovUpdateByIdx[idx] =
-      std::chrono::system_clock::now();
+  DummyMessageOutput msgOutputDummy;
+  UserMessageOutput msgOutput(partOne.GetSendTarget(), rawMsgData.userId);
+
+  bool isMe = partOne.serverState.ActorByUser(rawMsgData.userId) == actor;
+
+  bool teleportFlag = actor->GetTeleportFlag();
+  actor->SetTeleportFlag(false);
+
+  static const NiPoint3 reallyWrongPos = {
+    std::numeric_limits<float>::infinity(),
+    std::numeric_limits<float>::infinity(),
+    std::numeric_limits<float>::infinity()
+  };
+
+  if (!MovementValidation::Validate(
+        *actor, teleportFlag ? reallyWrongPos : pos, worldOrCell,
+        isMe ? static_cast<IMessageOutput&>(msgOutput)
+             : static_cast<IMessageOutput&>(msgOutputDummy))) {
+    return;
   }
+
+  actor->SetPos(pos);
+  actor->SetAngle(rot);
+  actor->SetAnimationVariableBool("bInJumpState", isInJumpState);
+  actor->SetAnimationVariableBool("_skymp_isWeapDrawn", isWeapDrawn);
+
+  if (partOne.worldState.lastMovUpdateByIdx.size() <= idx) {
+    auto newSize = static_cast<size_t>(idx) + 1;
+    partOne.worldState.lastMovUpdateByIdx.resize(newSize);
+  }
+  partOne.worldState.lastMovUpdateByIdx[idx] =
+    std::chrono::system_clock::now();
+
+  // Neighbours get the validated state, client bytes are never relayed
+  movement.idx = idx;
+  movement.worldOrCell = worldOrCell;
+  movement.pos[0] = pos.x;
+  movement.pos[1] = pos.y;
+  movement.pos[2] = pos.z;
+  movement.rot[0] = rot.x;
+  movement.rot[1] = rot.y;
+  movement.rot[2] = rot.z;
+  movement.isInJumpState = isInJumpState;
+  movement.isWeapDrawn = isWeapDrawn;
+
+  std::string json;
+  json += Networking::MinPacketId;
+  MovementCodec::ToJson(movement, json);
+  auto jsonData = reinterpret_cast<Networking::PacketData>(json.data());
+
+  std::vector<Networking::UserId> targets;
+  SelectStateTargets(*actor, UpdateRateLod::Channel::Movement, jsonData,
+                     json.size(), targets);
+  if (!targets.empty())
+    ReplicateMovement(targets, movement, jsonData, json.size());
+}
+
+void ActionListener::OnMovementCodecHandshake(
+  const RawMessageData& rawMsgData, uint8_t clientVersion)
+{
+  partOne.serverState.EnsureUserExists(rawMsgData.userId);
+
+  auto version = std::min<uint8_t>(clientVersion, MovementCodec::Version);
+  partOne.serverState.SetMovementCodecVersion(rawMsgData.userId, version);
+
+  std::vector<uint8_t> reply;
+  MovementCodec::WriteHandshake(version, reply);
+  partOne.GetSendTarget().Send(rawMsgData.userId, reply.data(), reply.size(),
+                               true);
+}
+
+void ActionListener::OnMovementKeyframeRequest(
+  const RawMessageData& rawMsgData, uint32_t idx)
+{
+  partOne.GetMovementReplication().RequestKeyframe(rawMsgData.userId, idx);
 }
 
 void ActionListener::OnUpdateAnimation(const RawMessageData& rawMsgData,
                                        uint32_t idx)
 {
-  SendToNeighbours(idx, rawMsgData);
+  MpActor* actor = FindActorToUpdate(idx, rawMsgData.userId);
+  if (!actor)
+    return;
+
+  std::vector<Networking::UserId> targets;
+  SelectStateTargets(*actor, UpdateRateLod::Channel::Animation,
+                     rawMsgData.unparsed, rawMsgData.unparsedLength, targets);
+  if (!targets.empty())
+    partOne.GetSendTarget().SendMany(targets, rawMsgData.unparsed,
+                                     rawMsgData.unparsedLength, false);
 }
 
 void ActionListener::OnUpdateLook(const RawMessageData& rawMsgData,
@@ -203,7 +411,7 @@ void RecalculateWorn(MpObjectReference& refr)
 
   ac->SetEquipment(newEq.ToJson().dump());
   for (auto listener : ac->GetListeners()) {
-    auto actor = dynamic_cast<MpActor*>(listener);
+    auto actor = FormCast<MpActor>(listener);
     if (!actor)
       continue;
     std::string s;
@@ -415,18 +623,20 @@ void ActionListener::OnHostAttempt(const RawMessageData& rawMsgData,
       longFormId += 0x100000000;
     }
 
-    Networking::SendFormatted(&partOne.GetSendTarget(), rawMsgData.userId,
-                              R"({ "type": "hostStart", "target": %llu })",
-                              longFormId);
+    Networking::PacketBuilder hostStart;
+    hostStart.AppendFormatted(R"({ "type": "hostStart", "target": %llu })",
+                              static_cast<unsigned long long>(longFormId));
+    hostStart.Send(partOne.GetSendTarget(), rawMsgData.userId);
 
     if (MpActor* prevHosterActor = dynamic_cast<MpActor*>(
           partOne.worldState.LookupFormById(prevHoster).get())) {
       auto prevHosterUser = partOne.serverState.UserByActor(prevHosterActor);
       if (prevHosterUser != Networking::InvalidUserId &&
           prevHosterUser != rawMsgData.userId) {
-        Networking::SendFormatted(&partOne.GetSendTarget(), prevHosterUser,
-                                  R"({ "type": "hostStop", "target": %llu })",
-                                  longFormId);
+        Networking::PacketBuilder hostStop;
+        hostStop.AppendFormatted(R"({ "type": "hostStop", "target": %llu })",
+                                 static_cast<unsigned long long>(longFormId));
+        hostStop.Send(partOne.GetSendTarget(), prevHosterUser);
       }
     }
   }
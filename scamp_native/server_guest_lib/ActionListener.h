@@ -1,8 +1,11 @@
 #pragma once
 #include "IActionListener.h"
 #include "Loader.h"
+#include "MovementCodec.h"
+#include "MovementReplication.h"
 #include "MpActor.h"
 #include "PartOne.h"
+#include "UpdateRateLod.h"
 
 class ServerState;
 class WorldState;
@@ -23,6 +26,12 @@ public:
                         bool isInJumpState, bool isWeapDrawn,
                         uint32_t worldOrCell) override;
 
+  void OnMovementCodecHandshake(const RawMessageData& rawMsgData,
+                                uint8_t clientVersion) override;
+
+  void OnMovementKeyframeRequest(const RawMessageData& rawMsgData,
+                                 uint32_t idx) override;
+
   void OnUpdateAnimation(const RawMessageData& rawMsgData,
                          uint32_t idx) override;
 
@@ -61,7 +70,14 @@ public:
   void OnCustomEvent(const RawMessageData& rawMsgData, const char* eventName,
                      simdjson::dom::element& e) override;
 
+  // Sends updates skipped by LOD to listeners that missed the newest one
+  void FlushUpdateRateLod();
+
 private:
+  // Returns target actor if the user is allowed to update it, nullptr if the
+  // user has no actor
+  MpActor* FindActorToUpdate(uint32_t idx, Networking::UserId userId);
+
   // Returns user's actor if exists
   MpActor* SendToNeighbours(uint32_t idx,
                             const simdjson::dom::element& jMessage,
@@ -72,5 +88,22 @@ private:
   MpActor* SendToNeighbours(uint32_t idx, const RawMessageData& rawMsgData,
                             bool reliable = false);
 
+  // Fills targets with listeners that should get the state update now,
+  // stores the update for others with respect to update rate LOD
+  void SelectStateTargets(MpActor& emitter, UpdateRateLod::Channel channel,
+                          Networking::PacketData data, size_t length,
+                          std::vector<Networking::UserId>& targets);
+
+  // Sends movement in the format negotiated by each user: deltas, binary or
+  // the given JSON
+  void ReplicateMovement(const std::vector<Networking::UserId>& users,
+                         const MovementCodec::Movement& movement,
+                         Networking::PacketData json, size_t jsonLength);
+
   PartOne& partOne;
+  simdjson::dom::parser parser;
+
+  // Reused by SelectStateTargets and ReplicateMovement
+  std::vector<Networking::UserId> missedBy;
+  MovementReplication::Packets movementPackets;
 };
\ No newline at end of file
@@ -6,7 +6,7 @@ struct AsyncSaveStorage::Impl
   struct UpsertTask
   {
     std::vector<MpChangeForm> changeForms;
-    std::function<void()> callback;
+    UpsertCallback callback;
   };
 
   std::shared_ptr<spdlog::logger> logger;
@@ -31,7 +31,7 @@ struct AsyncSaveStorage::Impl
 
   struct
   {
-    std::vector<std::function<void()>> upsertCallbacksToFire;
+    std::vector<std::pair<UpsertCallback, bool>> upsertCallbacksToFire;
     std::mutex m;
   } share4;
 
@@ -70,15 +70,23 @@ void AsyncSaveStorage::SaverThreadMain(Impl* pImpl)
         pImpl->share3.upsertTasks.clear();
       }
 
-      std::vector<std::function<void()>> callbacksToFire;
+      std::vector<std::pair<UpsertCallback, bool>> callbacksToFire;
 
       {
         std::lock_guard l(pImpl->share.m);
         auto was = clock();
         size_t numChangeForms = 0;
         for (auto& t : tasks) {
-          numChangeForms += pImpl->share.dbImpl->Upsert(t.changeForms);
-          callbacksToFire.push_back(t.callback);
+          // Callers restore what the failed task was to save
+          try {
+            numChangeForms +=
+              pImpl->share.dbImpl->UpsertDirtyFields(t.changeForms);
+            callbacksToFire.push_back({ t.callback, true });
+          } catch (...) {
+            callbacksToFire.push_back({ t.callback, false });
+            std::lock_guard l2(pImpl->share2.m);
+            pImpl->share2.exceptions.push_back(std::current_exception());
+          }
         }
         if (numChangeForms > 0 && pImpl->logger)
           pImpl->logger->info("Saved {} ChangeForms in {} ticks",
@@ -133,8 +141,8 @@ void AsyncSaveStorage::Tick()
     upsertCallbacksToFire = std::move(pImpl->share4.upsertCallbacksToFire);
     pImpl->share4.upsertCallbacksToFire.clear();
   }
-  for (auto& cb : upsertCallbacksToFire) {
+  for (auto& [cb, succeeded] : upsertCallbacksToFire) {
     pImpl->numFinishedUpserts++;
-    cb();
+    cb(succeeded);
   }
 }
\ No newline at end of file
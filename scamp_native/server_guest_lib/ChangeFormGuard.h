@@ -25,8 +25,18 @@ public:
 
   template <class F>
   void EditChangeForm(F f, Mode mode = Mode::RequestSave)
+  {
+    EditChangeForm(f, MpChangeFormREFR::kAllDirty, mode);
+  }
+
+  // dirtyFields are the MpChangeFormREFR::DirtyFields groups f touches
+  template <class F>
+  void EditChangeForm(F f, uint8_t dirtyFields, Mode mode = Mode::RequestSave)
   {
     f(changeForm);
+    changeForm.dirtyFields |= dirtyFields;
+    if (dirtyFields & ~MpChangeFormREFR::kPositionDirty)
+      self->InvalidateSpawnPayload();
     if (!blockSaving && mode == Mode::RequestSave) {
       lastSaveRequest = std::chrono::system_clock::now();
       ChangeFormGuard_::RequestSave(self);
@@ -35,6 +45,13 @@ public:
 
   const T& ChangeForm() const noexcept { return changeForm; }
 
+  void ClearDirtyFields() noexcept { changeForm.dirtyFields = 0; }
+
+  void MarkDirtyFields(uint8_t dirtyFields) noexcept
+  {
+    changeForm.dirtyFields |= dirtyFields;
+  }
+
   auto GetLastSaveRequestMoment() const { return lastSaveRequest; }
 
   bool blockSaving = false;
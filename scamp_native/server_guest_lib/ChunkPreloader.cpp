@@ -0,0 +1,278 @@
+#include "ChunkPreloader.h"
+#include <Combiner.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+
+namespace {
+using ChunkKey = std::tuple<uint32_t, int16_t, int16_t>;
+
+// Prepared chunks nobody took are dropped oldest first
+constexpr size_t g_maxReadyChunks = 256;
+
+NiPoint3 GetRot(const espm::REFR::LocationalData* locationalData)
+{
+  static const auto g_pi = std::acos(-1.f);
+  return { locationalData->rotRadians[0] / g_pi * 180.f,
+           locationalData->rotRadians[1] / g_pi * 180.f,
+           locationalData->rotRadians[2] / g_pi * 180.f };
+}
+}
+
+struct ChunkPreloader::Impl
+{
+  const espm::CombineBrowser* br = nullptr;
+  std::shared_ptr<spdlog::logger> logger;
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<ChunkKey> queue;
+
+  // Requested and not yet prepared. Take erases keys to cancel requests
+  std::set<ChunkKey> pending;
+
+  std::map<ChunkKey, Chunk> ready;
+  std::deque<ChunkKey> readyOrder;
+  Stats stats;
+  bool destroyed = false;
+
+  std::thread thr;
+};
+
+ChunkPreloader::ChunkPreloader(const espm::CombineBrowser& br,
+                               std::shared_ptr<spdlog::logger> logger)
+  : pImpl(new Impl)
+{
+  pImpl->br = &br;
+  pImpl->logger = logger;
+
+  auto p = pImpl.get();
+  pImpl->thr = std::thread([p] { WorkerThreadMain(p); });
+}
+
+ChunkPreloader::~ChunkPreloader()
+{
+  {
+    std::lock_guard l(pImpl->m);
+    pImpl->destroyed = true;
+  }
+  pImpl->cv.notify_all();
+  pImpl->thr.join();
+}
+
+void ChunkPreloader::Request(uint32_t cellOrWorld, int16_t x, int16_t y)
+{
+  ChunkKey key{ cellOrWorld, x, y };
+  {
+    std::lock_guard l(pImpl->m);
+    if (pImpl->pending.count(key) || pImpl->ready.count(key))
+      return;
+    pImpl->pending.insert(key);
+    pImpl->queue.push_back(key);
+  }
+  pImpl->cv.notify_one();
+}
+
+std::optional<ChunkPreloader::Chunk> ChunkPreloader::Take(
+  uint32_t cellOrWorld, int16_t x, int16_t y)
+{
+  ChunkKey key{ cellOrWorld, x, y };
+  std::lock_guard l(pImpl->m);
+
+  auto it = pImpl->ready.find(key);
+  if (it == pImpl->ready.end()) {
+    pImpl->pending.erase(key);
+    ++pImpl->stats.numMissed;
+    return std::nullopt;
+  }
+
+  auto res = std::move(it->second);
+  pImpl->ready.erase(it);
+  auto& order = pImpl->readyOrder;
+  order.erase(std::find(order.begin(), order.end(), key));
+  ++pImpl->stats.numTaken;
+  return res;
+}
+
+ChunkPreloader::Stats ChunkPreloader::GetStats() const
+{
+  std::lock_guard l(pImpl->m);
+  return pImpl->stats;
+}
+
+void ChunkPreloader::WorkerThreadMain(Impl* pImpl)
+{
+  // CompressedFieldsCache isn't thread-safe, the worker has its own
+  espm::CompressedFieldsCache cache;
+
+  while (true) {
+    ChunkKey key;
+    {
+      std::unique_lock l(pImpl->m);
+      pImpl->cv.wait(
+        l, [&] { return pImpl->destroyed || !pImpl->queue.empty(); });
+      if (pImpl->destroyed)
+        return;
+      key = pImpl->queue.front();
+      pImpl->queue.pop_front();
+      if (!pImpl->pending.count(key))
+        continue;
+    }
+
+    auto [cellOrWorld, x, y] = key;
+    Chunk chunk;
+    try {
+      chunk = PrepareChunk(*pImpl->br, cellOrWorld, x, y, cache,
+                           pImpl->logger.get());
+    } catch (std::exception& e) {
+      if (pImpl->logger)
+        pImpl->logger->error("Unable to preload chunk {:x} {} {}: {}",
+                             cellOrWorld, x, y, e.what());
+      std::lock_guard l(pImpl->m);
+      pImpl->pending.erase(key);
+      continue;
+    }
+
+    std::lock_guard l(pImpl->m);
+    if (!pImpl->pending.erase(key))
+      continue; // Taken while we were preparing it
+
+    if (pImpl->readyOrder.size() >= g_maxReadyChunks) {
+      pImpl->ready.erase(pImpl->readyOrder.front());
+      pImpl->readyOrder.pop_front();
+    }
+    pImpl->ready[key] = std::move(chunk);
+    pImpl->readyOrder.push_back(key);
+    ++pImpl->stats.numPrepared;
+  }
+}
+
+ChunkPreloader::Chunk ChunkPreloader::PrepareChunk(
+  const espm::CombineBrowser& br, uint32_t cellOrWorld, int16_t x, int16_t y,
+  espm::CompressedFieldsCache& cache, spdlog::logger* logger)
+{
+  Chunk res;
+  res.cellOrWorld = cellOrWorld;
+  res.x = x;
+  res.y = y;
+
+  // A form overridden by several files is listed by each of them
+  std::unordered_set<uint32_t> formIds;
+
+  auto records = br.GetRecordsAtPos(cellOrWorld, x, y);
+  for (size_t i = 0; i < records.size(); ++i) {
+    auto mapping = br.GetMapping(i);
+    for (auto rec : *records[i]) {
+      auto mappedId = espm::GetMappedId(rec->GetId(), *mapping);
+      if (formIds.insert(mappedId).second)
+        res.forms.push_back(PrepareForm(br, mappedId, cache, logger));
+    }
+  }
+  return res;
+}
+
+ChunkPreloader::Form ChunkPreloader::PrepareForm(
+  const espm::CombineBrowser& br, uint32_t formId,
+  espm::CompressedFieldsCache& cache, spdlog::logger* logger)
+{
+  Form res;
+  res.formId = formId;
+  for (auto& lookupRes : br.LookupByIdAll(formId)) {
+    auto mapping = br.GetMapping(lookupRes.fileIdx);
+    if (auto refr = PrepareRecord(br, lookupRes.rec, *mapping, cache, logger))
+      res.records.push_back(std::move(*refr));
+  }
+  return res;
+}
+
+std::optional<ChunkPreloader::Refr> ChunkPreloader::PrepareRecord(
+  const espm::CombineBrowser& br, espm::RecordHeader* record,
+  const espm::IdMapping& mapping, espm::CompressedFieldsCache& cache,
+  spdlog::logger* logger)
+{
+  auto refr = reinterpret_cast<espm::REFR*>(record);
+  auto data = refr->GetData();
+
+  auto baseId = espm::GetMappedId(data.baseId, mapping);
+  auto base = br.LookupById(baseId);
+  if (!base.rec) {
+    if (logger)
+      logger->info("baseId {} {}", baseId, static_cast<void*>(base.rec));
+    return std::nullopt;
+  }
+
+  espm::Type t = base.rec->GetType();
+  if (t != "NPC_" && t != "FURN" && t != "ACTI" && !espm::IsItem(t) &&
+      t != "DOOR" && t != "CONT" &&
+      (t != "FLOR" ||
+       !reinterpret_cast<espm::FLOR*>(base.rec)->GetData().resultItem) &&
+      (t != "TREE" ||
+       !reinterpret_cast<espm::TREE*>(base.rec)->GetData().resultItem))
+    return std::nullopt;
+
+  // TODO: Load disabled references
+  enum
+  {
+    InitiallyDisabled = 0x800
+  };
+  if (refr->GetFlags() & InitiallyDisabled)
+    return std::nullopt;
+
+  if (t == "NPC_") {
+    auto npcData = reinterpret_cast<espm::NPC_*>(base.rec)->GetData(cache);
+    if (npcData.isEssential || npcData.isProtected)
+      return std::nullopt;
+
+    enum
+    {
+      CrimeFactionsList = 0x26953
+    };
+
+    auto formListLookupRes = br.LookupById(CrimeFactionsList);
+    auto formList = reinterpret_cast<espm::FLST*>(formListLookupRes.rec);
+    auto formIds = formList->GetData().formIds;
+    for (auto& formId : formIds) {
+      formId = formListLookupRes.ToGlobalId(formId);
+    }
+
+    for (auto fact : npcData.factions) {
+      auto it = std::find(formIds.begin(), formIds.end(),
+                          base.ToGlobalId(fact.formId));
+      if (it != formIds.end()) {
+        if (logger)
+          logger->info("Skipping actor {0:x} because it's in faction {0:x}",
+                       record->GetId(), *it);
+        return std::nullopt;
+      }
+    }
+  }
+
+  uint32_t worldOrCell = espm::GetWorldOrCell(record);
+  if (!worldOrCell) {
+    if (logger)
+      logger->info("Anomally: refr without world/cell");
+    return std::nullopt;
+  }
+
+  Refr res;
+  res.baseId = baseId;
+  res.baseType = t.ToString();
+  res.worldOrCell = worldOrCell;
+  if (auto locationalData = data.loc) {
+    res.hasLocationalData = true;
+    res.pos = *reinterpret_cast<const NiPoint3*>(locationalData->pos);
+    res.rot = GetRot(locationalData);
+  }
+  if (data.boundsDiv2) {
+    res.boundsDiv2 =
+      NiPoint3(data.boundsDiv2[0], data.boundsDiv2[1], data.boundsDiv2[2]);
+  }
+  return res;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include "NiPoint3.h"
+#include <cstdint>
+#include <espm.h>
+#include <memory>
+#include <optional>
+#include <spdlog/logger.h>
+#include <string>
+#include <vector>
+
+namespace espm {
+class CombineBrowser;
+}
+
+// Decodes espm references of chunks (espm cells) on a worker thread, so the
+// game thread only has to create forms. WorldState requests chunks ahead of
+// moving refs and takes them when a chunk enters the view window
+class ChunkPreloader
+{
+public:
+  // REFR record the server instantiates
+  struct Refr
+  {
+    uint32_t baseId = 0;
+    std::string baseType;
+    uint32_t worldOrCell = 0;
+    bool hasLocationalData = false;
+    NiPoint3 pos, rot;
+    std::optional<NiPoint3> boundsDiv2;
+  };
+
+  // Records of a form in load order, overrides last
+  struct Form
+  {
+    uint32_t formId = 0;
+    std::vector<Refr> records;
+  };
+
+  struct Chunk
+  {
+    uint32_t cellOrWorld = 0;
+    int16_t x = 0;
+    int16_t y = 0;
+    std::vector<Form> forms;
+  };
+
+  struct Stats
+  {
+    uint64_t numPrepared = 0;
+    uint64_t numTaken = 0;
+
+    // Chunks the game thread had to prepare itself
+    uint64_t numMissed = 0;
+  };
+
+  // logger must support multithreaded writing
+  ChunkPreloader(const espm::CombineBrowser& br,
+                 std::shared_ptr<spdlog::logger> logger = nullptr);
+  ~ChunkPreloader();
+
+  // Ignored if the chunk is already requested or prepared
+  void Request(uint32_t cellOrWorld, int16_t x, int16_t y);
+
+  // Returns nullopt if the chunk isn't prepared yet. Forgets the request
+  // either way, so the chunk is never returned twice
+  std::optional<Chunk> Take(uint32_t cellOrWorld, int16_t x, int16_t y);
+
+  Stats GetStats() const;
+
+  // Used by the worker and by the game thread when a chunk wasn't prepared
+  // in time. cache must not be shared with other threads
+  static Chunk PrepareChunk(const espm::CombineBrowser& br,
+                            uint32_t cellOrWorld, int16_t x, int16_t y,
+                            espm::CompressedFieldsCache& cache,
+                            spdlog::logger* logger);
+  static Form PrepareForm(const espm::CombineBrowser& br, uint32_t formId,
+                          espm::CompressedFieldsCache& cache,
+                          spdlog::logger* logger);
+
+  // Returns nullopt for records the server doesn't load
+  static std::optional<Refr> PrepareRecord(const espm::CombineBrowser& br,
+                                           espm::RecordHeader* record,
+                                           const espm::IdMapping& mapping,
+                                           espm::CompressedFieldsCache& cache,
+                                           spdlog::logger* logger);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> pImpl;
+
+  static void WorkerThreadMain(Impl* pImpl);
+};
\ No newline at end of file
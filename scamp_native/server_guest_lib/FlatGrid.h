@@ -0,0 +1,256 @@
+#pragma once
+#include "DSLine.h"
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Alternative to GridImpl. An object is stored in its own cell only, in a
+// dense vector, so Move is one swap-remove and one push_back. Neighbours are
+// visited through a view over the cells within radius (3x3 by default)
+// instead of a per-cell set. Views are invalidated by Move and Forget
+template <class T>
+class FlatGridImpl
+{
+  struct Obj;
+
+  struct Cell
+  {
+    std::vector<T> ids;
+
+    // owners[i] is the Obj of ids[i], used to patch index on swap-remove
+    std::vector<Obj*> owners;
+  };
+
+  struct Obj
+  {
+    std::pair<int16_t, int16_t> coords = { -32000, -32000 };
+    uint32_t index = 0;
+  };
+
+public:
+  // Objects of the (2 * radius + 1)^2 cells around a position
+  class NeighbourView
+  {
+  public:
+    class Iterator
+    {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const T*;
+      using reference = const T&;
+
+      Iterator(const NeighbourView* view_, size_t cell_, size_t i_)
+        : view(view_)
+        , cell(cell_)
+        , i(i_)
+      {
+        ids = view->GetIds(cell);
+        SkipToValid();
+      }
+
+      const T& operator*() const { return (*ids)[i]; }
+      const T* operator->() const { return &**this; }
+
+      Iterator& operator++()
+      {
+        ++i;
+        SkipToValid();
+        return *this;
+      }
+
+      Iterator operator++(int)
+      {
+        auto res = *this;
+        ++*this;
+        return res;
+      }
+
+      bool operator==(const Iterator& rhs) const
+      {
+        return cell == rhs.cell && i == rhs.i;
+      }
+      bool operator!=(const Iterator& rhs) const { return !(*this == rhs); }
+
+    private:
+      void SkipToValid()
+      {
+        const size_t numCells = view->GetNumCells();
+        while (cell < numCells) {
+          if (ids && i < ids->size()) {
+            if (!view->excluded || (*ids)[i] != *view->excluded)
+              return;
+            ++i;
+            continue;
+          }
+          ids = ++cell < numCells ? view->GetIds(cell) : nullptr;
+          i = 0;
+        }
+        i = 0;
+      }
+
+      const NeighbourView* view;
+      const std::vector<T>* ids = nullptr;
+      size_t cell;
+      size_t i;
+    };
+
+    Iterator begin() const { return Iterator(this, 0, 0); }
+    Iterator end() const { return Iterator(this, GetNumCells(), 0); }
+
+    size_t size() const
+    {
+      size_t n = 0;
+      for (size_t cell = 0; cell < GetNumCells(); ++cell)
+        n += GetIds(cell)->size();
+      return excluded ? n - 1 : n;
+    }
+
+    bool empty() const { return begin() == end(); }
+
+    bool count(const T& id) const
+    {
+      if (excluded && id == *excluded)
+        return false;
+      for (size_t cell = 0; cell < GetNumCells(); ++cell) {
+        for (auto& v : *GetIds(cell)) {
+          if (v == id)
+            return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    friend class FlatGridImpl;
+
+    size_t GetNumCells() const
+    {
+      const size_t side = 2 * grid->radius + 1;
+      return side * side;
+    }
+
+    const std::vector<T>* GetIds(size_t cell) const
+    {
+      const size_t side = 2 * grid->radius + 1;
+      return &grid->At(x - grid->radius + static_cast<int>(cell / side),
+                       y - grid->radius + static_cast<int>(cell % side))
+                .ids;
+    }
+
+    const FlatGridImpl* grid = nullptr;
+    int16_t x = 0;
+    int16_t y = 0;
+
+    // Points to an object of the center cell
+    const T* excluded = nullptr;
+  };
+
+  explicit FlatGridImpl(int16_t radius_ = 1)
+    : radius(radius_)
+  {
+    if (radius < 0)
+      throw std::invalid_argument("grid: radius must not be negative");
+  }
+
+  int16_t GetRadius() const { return radius; }
+
+  void Move(const T& id, int16_t x, int16_t y)
+  {
+    auto [it, inserted] = objects.try_emplace(id);
+    auto& obj = it->second;
+    if (!inserted) {
+      if (obj.coords == std::make_pair(x, y))
+        return;
+      Remove(obj);
+    }
+
+    obj.coords = { x, y };
+    auto& cell = At(x, y);
+    obj.index = static_cast<uint32_t>(cell.ids.size());
+    cell.ids.push_back(id);
+    cell.owners.push_back(&obj);
+  }
+
+  std::pair<int16_t, int16_t> GetPos(const T& id) const
+  {
+    auto it = objects.find(id);
+    if (it == objects.end())
+      throw std::logic_error("grid: id not found");
+    return it->second.coords;
+  }
+
+  void Forget(const T& id)
+  {
+    auto it = objects.find(id);
+    if (it == objects.end())
+      return;
+    Remove(it->second);
+    objects.erase(it);
+  }
+
+  NeighbourView GetNeighboursByPosition(int16_t x, int16_t y) const
+  {
+    // Creating a cell may reallocate its column, so the view only looks
+    // cells up once all of them exist
+    for (int i = -radius; i <= radius; ++i) {
+      for (int j = -radius; j <= radius; ++j)
+        At(x + i, y + j);
+    }
+
+    NeighbourView res;
+    res.grid = this;
+    res.x = x;
+    res.y = y;
+    return res;
+  }
+
+  NeighbourView GetNeighboursAndMe(const T& id) const
+  {
+    auto pos = GetPos(id);
+    return GetNeighboursByPosition(pos.first, pos.second);
+  }
+
+  NeighbourView GetNeighbours(const T& id) const
+  {
+    auto& obj = objects.at(id);
+    auto res = GetNeighboursByPosition(obj.coords.first, obj.coords.second);
+    res.excluded = &At(obj.coords.first, obj.coords.second).ids[obj.index];
+    return res;
+  }
+
+  // Objects of one cell, not including neighbour cells
+  const std::vector<T>& GetCell(int16_t x, int16_t y) const
+  {
+    return At(x, y).ids;
+  }
+
+private:
+  Cell& At(int16_t x, int16_t y) const { return cells.At(x).At(y); }
+
+  void Remove(Obj& obj)
+  {
+    auto& cell = At(obj.coords.first, obj.coords.second);
+    auto last = cell.ids.size() - 1;
+    if (obj.index != last) {
+      cell.ids[obj.index] = std::move(cell.ids[last]);
+      cell.owners[obj.index] = cell.owners[last];
+      cell.owners[obj.index]->index = obj.index;
+    }
+    cell.ids.pop_back();
+    cell.owners.pop_back();
+  }
+
+  const int16_t radius;
+
+  // Node-based, so Obj pointers in cells stay valid
+  std::unordered_map<T, Obj> objects;
+  mutable DSLine<DSLine<Cell>> cells;
+};
+
+using FlatGrid = FlatGridImpl<uint64_t>;
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "FormTable.h"
+
+FormHandle FormTable::Insert(MpForm* form, uint8_t typeFlags)
+{
+  uint32_t slotIdx;
+  if (freeSlots.empty()) {
+    slotIdx = static_cast<uint32_t>(slots.size());
+    slots.push_back(Slot());
+  } else {
+    slotIdx = freeSlots.back();
+    freeSlots.pop_back();
+  }
+
+  auto& slot = slots[slotIdx];
+  slot.form = form;
+  slot.typeFlags = typeFlags;
+  return { slotIdx, slot.generation };
+}
+
+void FormTable::Erase(FormHandle handle)
+{
+  if (!Find(handle))
+    return;
+  auto& slot = slots[handle.slot];
+  slot.form = nullptr;
+  slot.typeFlags = 0;
+  ++slot.generation;
+  freeSlots.push_back(handle.slot);
+}
+
+void FormTable::Clear()
+{
+  for (uint32_t i = 0; i < slots.size(); ++i) {
+    if (slots[i].form)
+      Erase({ i, slots[i].generation });
+  }
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class MpForm;
+class MpObjectReference;
+class MpActor;
+
+// Type flag of a form class. A form stores flags of its class and all its
+// bases, so FormCast is a mask check. Classes without a flag (i.e. test
+// forms) are cast with dynamic_cast
+template <class T>
+struct FormTypeFlag
+{
+  static constexpr uint8_t value = 0;
+};
+
+template <>
+struct FormTypeFlag<MpForm>
+{
+  static constexpr uint8_t value = 1 << 0;
+};
+
+template <>
+struct FormTypeFlag<MpObjectReference>
+{
+  static constexpr uint8_t value = 1 << 1;
+};
+
+template <>
+struct FormTypeFlag<MpActor>
+{
+  static constexpr uint8_t value = 1 << 2;
+};
+
+// Reference to a form in FormTable. Unlike a raw pointer it resolves to
+// nullptr once the form is destroyed, unlike shared_ptr copying it is free
+struct FormHandle
+{
+  static constexpr uint32_t g_invalidSlot = static_cast<uint32_t>(-1);
+
+  uint32_t slot = g_invalidSlot;
+  uint32_t generation = 0;
+
+  bool operator==(const FormHandle& rhs) const
+  {
+    return slot == rhs.slot && generation == rhs.generation;
+  }
+  bool operator!=(const FormHandle& rhs) const { return !(*this == rhs); }
+};
+
+// Dense slots of live forms. Type flags are stored next to form pointers,
+// so resolving a handle to a type touches one slot only
+class FormTable
+{
+public:
+  FormHandle Insert(MpForm* form, uint8_t typeFlags);
+
+  // Does nothing for stale handles
+  void Erase(FormHandle handle);
+
+  // Invalidates all handles
+  void Clear();
+
+  MpForm* Resolve(FormHandle handle) const
+  {
+    auto slot = Find(handle);
+    return slot ? slot->form : nullptr;
+  }
+
+  template <class T>
+  T* Resolve(FormHandle handle) const
+  {
+    auto slot = Find(handle);
+    if (!slot)
+      return nullptr;
+    if constexpr (FormTypeFlag<T>::value != 0) {
+      return (slot->typeFlags & FormTypeFlag<T>::value)
+        ? static_cast<T*>(slot->form)
+        : nullptr;
+    } else {
+      return dynamic_cast<T*>(slot->form);
+    }
+  }
+
+  size_t GetSize() const { return slots.size() - freeSlots.size(); }
+
+private:
+  struct Slot
+  {
+    MpForm* form = nullptr;
+    uint32_t generation = 0;
+    uint8_t typeFlags = 0;
+  };
+
+  const Slot* Find(FormHandle handle) const
+  {
+    if (handle.slot >= slots.size())
+      return nullptr;
+    auto& slot = slots[handle.slot];
+    return slot.form && slot.generation == handle.generation ? &slot
+                                                            : nullptr;
+  }
+
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+};
\ No newline at end of file
@@ -14,6 +14,16 @@ template <class T>
 class GridImpl
 {
 public:
+  // Objects within radius cells of each other are neighbours
+  explicit GridImpl(int16_t radius_ = 1)
+    : radius(radius_)
+  {
+    if (radius < 0)
+      throw std::invalid_argument("grid: radius must not be negative");
+  }
+
+  int16_t GetRadius() const { return radius; }
+
   void Move(const T& id, int16_t x, int16_t y)
   {
     auto& obj = objects[id];
@@ -78,28 +88,30 @@ private:
     auto& obj = objects[id];
 
     if (from) {
-      for (int i = -1; i <= 1; ++i) {
-        for (int j = -1; j <= 1; ++j) {
+      for (int i = -radius; i <= radius; ++i) {
+        for (int j = -radius; j <= radius; ++j) {
           nei.At(from->first + i).At(from->second + j).erase(id);
         }
       }
     }
 
     if (to) {
-      for (int i = -1; i <= 1; ++i) {
-        for (int j = -1; j <= 1; ++j) {
+      for (int i = -radius; i <= radius; ++i) {
+        for (int j = -radius; j <= radius; ++j) {
           nei.At(to->first + i).At(to->second + j).insert(id);
         }
       }
     }
   }
 
+  int16_t radius;
   mutable std::unordered_map<T, Obj> objects;
   mutable DSLine<DSLine<std::set<T>>> nei;
 
-  static bool IsNeighbours(int16_t x1, int16_t y1, int16_t x2, int16_t y2)
+  bool IsNeighbours(int16_t x1, int16_t y1, int16_t x2, int16_t y2) const
   {
-    if (x1 <= x2 + 1 && x1 >= x2 - 1 && y1 <= y2 + 1 && y1 >= y2 - 1)
+    if (x1 <= x2 + radius && x1 >= x2 - radius && y1 <= y2 + radius &&
+        y1 >= y2 - radius)
       return true;
     return false;
   }
@@ -31,6 +31,16 @@ public:
   {
   }
 
+  virtual void OnMovementCodecHandshake(const RawMessageData& rawMsgData,
+                                        uint8_t clientVersion)
+  {
+  }
+
+  virtual void OnMovementKeyframeRequest(const RawMessageData& rawMsgData,
+                                         uint32_t idx)
+  {
+  }
+
   virtual void OnUpdateAnimation(const RawMessageData& rawMsgData,
                                  uint32_t idx)
   {
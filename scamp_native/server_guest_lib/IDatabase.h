@@ -9,5 +9,15 @@ public:
 
   virtual ~IDatabase() = default;
   virtual size_t Upsert(const std::vector<MpChangeForm>& changeForms) = 0;
+
+  // Change forms are complete, but only their dirty field groups may differ
+  // from the stored ones (see MpChangeFormREFR::DirtyFields). Databases able
+  // to write field groups separately override this
+  virtual size_t UpsertDirtyFields(
+    const std::vector<MpChangeForm>& changeForms)
+  {
+    return Upsert(changeForms);
+  }
+
   virtual void Iterate(const IterateCallback& iterateCallback) = 0;
 };
\ No newline at end of file
@@ -10,7 +10,8 @@ class ISaveStorage
 {
 public:
   using IterateSyncCallback = std::function<void(const MpChangeForm&)>;
-  using UpsertCallback = std::function<void()>;
+  // succeeded is false if the change forms weren't written
+  using UpsertCallback = std::function<void(bool succeeded)>;
 
   virtual void IterateSync(const IterateSyncCallback& cb) = 0;
   virtual void Upsert(const std::vector<MpChangeForm>& changeForms,
@@ -18,6 +18,12 @@ size_t MigrationDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
   return pImpl->newDatabase->Upsert(changeForms);
 }
 
+size_t MigrationDatabase::UpsertDirtyFields(
+  const std::vector<MpChangeForm>& changeForms)
+{
+  return pImpl->newDatabase->UpsertDirtyFields(changeForms);
+}
+
 void MigrationDatabase::Iterate(const IterateCallback& iterateCallback)
 {
   std::set<FormDesc> alreadyMigrated;
@@ -7,6 +7,8 @@ public:
   MigrationDatabase(std::shared_ptr<IDatabase> newDatabase,
                     std::shared_ptr<IDatabase> oldDatabase);
   size_t Upsert(const std::vector<MpChangeForm>& changeForms) override;
+  size_t UpsertDirtyFields(
+    const std::vector<MpChangeForm>& changeForms) override;
   void Iterate(const IterateCallback& iterateCallback) override;
 
 private:
@@ -23,6 +23,9 @@ struct MongoDatabase::Impl
   std::shared_ptr<mongocxx::client> client;
   std::shared_ptr<mongocxx::database> db;
   std::shared_ptr<mongocxx::collection> changeFormsCollection;
+
+  size_t Upsert(const std::vector<MpChangeForm>& changeForms,
+                bool dirtyFieldsOnly);
 };
 
 MongoDatabase::MongoDatabase(std::string uri_, std::string name_)
@@ -39,15 +42,38 @@ MongoDatabase::MongoDatabase(std::string uri_, std::string name_)
 
 size_t MongoDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
 {
-  auto bulk = pImpl->changeFormsCollection->create_bulk_write();
+  return pImpl->Upsert(changeForms, false);
+}
+
+size_t MongoDatabase::UpsertDirtyFields(
+  const std::vector<MpChangeForm>& changeForms)
+{
+  return pImpl->Upsert(changeForms, true);
+}
+
+size_t MongoDatabase::Impl::Upsert(
+  const std::vector<MpChangeForm>& changeForms, bool dirtyFieldsOnly)
+{
+  auto bulk = changeFormsCollection->create_bulk_write();
   for (auto& changeForm : changeForms) {
-    auto jChangeForm = MpChangeForm::ToJson(changeForm);
+    // $set leaves fields of clean groups untouched. A missing document gets
+    // them from $setOnInsert, paths of the two must not overlap
+    const uint8_t dirtyFields =
+      dirtyFieldsOnly ? changeForm.dirtyFields : MpChangeForm::kAllDirty;
 
     auto filter = nlohmann::json::object();
     filter["formDesc"] = changeForm.formDesc.ToString();
 
     auto upd = nlohmann::json::object();
-    upd["$set"] = jChangeForm;
+    upd["$set"] = MpChangeForm::ToJson(changeForm, dirtyFields);
+
+    const uint8_t cleanFields = MpChangeForm::kAllDirty & ~dirtyFields;
+    if (cleanFields) {
+      auto jClean = MpChangeForm::ToJson(changeForm, cleanFields);
+      for (auto identityField : { "recType", "formDesc", "baseDesc" })
+        jClean.erase(identityField);
+      upd["$setOnInsert"] = std::move(jClean);
+    }
 
     bulk.append(mongocxx::model::update_one(
                   { std::move(bsoncxx::from_json(filter.dump())),
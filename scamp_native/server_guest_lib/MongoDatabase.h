@@ -7,6 +7,8 @@ class MongoDatabase : public IDatabase
 public:
   MongoDatabase(std::string uri_, std::string name_);
   size_t Upsert(const std::vector<MpChangeForm>& changeForms) override;
+  size_t UpsertDirtyFields(
+    const std::vector<MpChangeForm>& changeForms) override;
   void Iterate(const IterateCallback& iterateCallback) override;
 
 private:
@@ -0,0 +1,99 @@
+#include "MovementReplication.h"
+
+void MovementReplication::SetKeyframeInterval(uint32_t keyframeInterval_)
+{
+  keyframeInterval = keyframeInterval_;
+}
+
+bool MovementReplication::Write(
+  const std::vector<Networking::UserId>& listeners,
+  const MovementCodec::Movement& movement, Packets& out)
+{
+  out.size = 0;
+
+  MovementCodec::QuantizedMovement current;
+  if (!MovementCodec::Quantize(movement, current))
+    return false;
+
+  auto& writeIndex = numWrites[movement.idx];
+  const bool periodicKeyframe =
+    keyframeInterval > 0 && writeIndex % keyframeInterval == 0;
+
+  for (auto listener : listeners) {
+    if (listenerStates.size() <= listener)
+      listenerStates.resize(static_cast<size_t>(listener) + 1);
+    auto& st = listenerStates[listener][movement.idx];
+
+    const bool isKeyframe = st.needsKeyframe || periodicKeyframe ||
+      (keyframeInterval > 0 && st.sinceKeyframe + 1 >= keyframeInterval);
+    if (isKeyframe) {
+      // Clients only see the low byte of the sequence
+      st.sequence = static_cast<uint8_t>(writeIndex);
+      st.sinceKeyframe = 0;
+    } else {
+      ++st.sequence;
+      ++st.sinceKeyframe;
+    }
+
+    auto& packet =
+      FindOrAddPacket(out, isKeyframe ? nullptr : &st.baseline, st.sequence);
+    if (packet.data.empty())
+      MovementCodec::SerializeDelta(movement.idx, st.sequence,
+                                    isKeyframe ? nullptr : &st.baseline,
+                                    current, packet.data);
+    packet.targets.push_back(listener);
+
+    st.baseline = current;
+    st.needsKeyframe = false;
+  }
+
+  ++writeIndex;
+  return true;
+}
+
+void MovementReplication::RequestKeyframe(Networking::UserId listener,
+                                          uint32_t emitterIdx)
+{
+  if (listenerStates.size() <= listener)
+    return;
+  auto it = listenerStates[listener].find(emitterIdx);
+  if (it != listenerStates[listener].end())
+    it->second.needsKeyframe = true;
+}
+
+void MovementReplication::Forget(Networking::UserId listener,
+                                 uint32_t emitterIdx)
+{
+  if (listenerStates.size() > listener)
+    listenerStates[listener].erase(emitterIdx);
+}
+
+void MovementReplication::ForgetListener(Networking::UserId listener)
+{
+  if (listenerStates.size() > listener)
+    listenerStates[listener].clear();
+}
+
+MovementReplication::Packet& MovementReplication::FindOrAddPacket(
+  Packets& packets, const MovementCodec::QuantizedMovement* baseline,
+  uint8_t sequence)
+{
+  const bool isKeyframe = !baseline;
+  for (size_t i = 0; i < packets.size; ++i) {
+    auto& packet = packets.buffer[i];
+    if (packet.isKeyframe == isKeyframe && packet.sequence == sequence &&
+        (isKeyframe || packet.baseline == *baseline))
+      return packet;
+  }
+
+  if (packets.buffer.size() == packets.size)
+    packets.buffer.emplace_back();
+  auto& packet = packets.buffer[packets.size++];
+  packet.isKeyframe = isKeyframe;
+  packet.sequence = sequence;
+  if (baseline)
+    packet.baseline = *baseline;
+  packet.data.clear();
+  packet.targets.clear();
+  return packet;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include "MovementCodec.h"
+#include "NetworkingInterface.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Server-owned UpdateMovement replication for clients that negotiated
+// MovementCodec version 2 or later. Each listener has its own baseline and
+// sequence per emitter, so listeners that skip updates (see UpdateRateLod)
+// still get deltas. Listeners with equal baselines share a packet
+class MovementReplication
+{
+public:
+  struct Packet
+  {
+    bool isKeyframe = false;
+    uint8_t sequence = 0;
+    MovementCodec::QuantizedMovement baseline;
+    std::vector<uint8_t> data;
+    std::vector<Networking::UserId> targets;
+  };
+
+  // Packets written by the last Write. Unused elements keep their capacity
+  struct Packets
+  {
+    const Packet* begin() const { return buffer.data(); }
+    const Packet* end() const { return buffer.data() + size; }
+
+    std::vector<Packet> buffer;
+    size_t size = 0;
+  };
+
+  // Every keyframeInterval-th packet of an emitter is a keyframe for all
+  // listeners. Listeners that skipped it get one later. 0 disables periodic
+  // keyframes
+  void SetKeyframeInterval(uint32_t keyframeInterval);
+
+  // Writes the next packets of the emitter for the listeners. Returns false
+  // if the movement can't be quantized
+  bool Write(const std::vector<Networking::UserId>& listeners,
+             const MovementCodec::Movement& movement, Packets& out);
+
+  // The next packet for the listener about the emitter will be a keyframe
+  void RequestKeyframe(Networking::UserId listener, uint32_t emitterIdx);
+
+  // Must be called when the listener stops seeing the emitter
+  void Forget(Networking::UserId listener, uint32_t emitterIdx);
+
+  void ForgetListener(Networking::UserId listener);
+
+private:
+  struct ListenerState
+  {
+    MovementCodec::QuantizedMovement baseline;
+    uint8_t sequence = 0;
+    uint32_t sinceKeyframe = 0;
+    bool needsKeyframe = true;
+  };
+
+  static Packet& FindOrAddPacket(
+    Packets& packets, const MovementCodec::QuantizedMovement* baseline,
+    uint8_t sequence);
+
+  // Number of Write calls per emitter, aligns sequences of listeners that
+  // get every update so they share packets
+  std::unordered_map<uint32_t, uint32_t> numWrites;
+
+  // listenerStates[listener][emitterIdx]
+  std::vector<std::unordered_map<uint32_t, ListenerState>> listenerStates;
+  uint32_t keyframeInterval = 30;
+};
\ No newline at end of file
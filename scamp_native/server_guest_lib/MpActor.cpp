@@ -21,29 +21,34 @@ MpActor::MpActor(const LocationalData& locationalData_,
   : MpObjectReference(locationalData_, callbacks_,
                       optBaseId == 0 ? 0x7 : optBaseId, "NPC_")
 {
+  typeFlags |= FormTypeFlag<MpActor>::value;
   pImpl.reset(new Impl{ MpChangeForm(), this });
 }
 
 void MpActor::SetRaceMenuOpen(bool isOpen)
 {
   pImpl->EditChangeForm(
-    [&](MpChangeForm& changeForm) { changeForm.isRaceMenuOpen = isOpen; });
+    [&](MpChangeForm& changeForm) { changeForm.isRaceMenuOpen = isOpen; },
+    MpChangeForm::kPropsDirty);
 }
 
 void MpActor::SetLook(const Look* newLook)
 {
-  pImpl->EditChangeForm([&](MpChangeForm& changeForm) {
-    if (newLook)
-      changeForm.lookDump = newLook->ToJson();
-    else
-      changeForm.lookDump.clear();
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeForm& changeForm) {
+      if (newLook)
+        changeForm.lookDump = newLook->ToJson();
+      else
+        changeForm.lookDump.clear();
+    },
+    MpChangeForm::kPropsDirty);
 }
 
 void MpActor::SetEquipment(const std::string& jsonString)
 {
   pImpl->EditChangeForm(
-    [&](MpChangeForm& changeForm) { changeForm.equipmentDump = jsonString; });
+    [&](MpChangeForm& changeForm) { changeForm.equipmentDump = jsonString; },
+    MpChangeForm::kPropsDirty);
 }
 
 void MpActor::VisitProperties(const PropertiesVisitor& visitor,
@@ -98,6 +103,7 @@ MpChangeForm MpActor::GetChangeForm() const
   res.lookDump = achr.lookDump;
   res.isRaceMenuOpen = achr.isRaceMenuOpen;
   res.equipmentDump = achr.equipmentDump;
+  res.dirtyFields |= achr.dirtyFields;
   // achr.dynamicFields isn't really used so I decided to comment this line:
   // res.dynamicFields.merge_patch(achr.dynamicFields);
 
@@ -124,6 +130,12 @@ void MpActor::ApplyChangeForm(const MpChangeForm& newChangeForm)
     Impl::Mode::NoRequestSave);
 }
 
+void MpActor::ClearDirtyFields()
+{
+  MpObjectReference::ClearDirtyFields();
+  pImpl->ClearDirtyFields();
+}
+
 uint32_t MpActor::NextSnippetIndex(
   std::optional<Viet::Promise<VarValue>> promise)
 {
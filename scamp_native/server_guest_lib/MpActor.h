@@ -46,6 +46,7 @@ public:
 
   MpChangeForm GetChangeForm() const override;
   void ApplyChangeForm(const MpChangeForm& changeForm) override;
+  void ClearDirtyFields() override;
 
   uint32_t NextSnippetIndex(
     std::optional<Viet::Promise<VarValue>> promise = std::nullopt);
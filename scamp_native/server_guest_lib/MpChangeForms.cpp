@@ -2,20 +2,36 @@
 #include "JsonUtils.h"
 
 nlohmann::json MpChangeForm::ToJson(const MpChangeForm& changeForm)
+{
+  return ToJson(changeForm, kAllDirty);
+}
+
+nlohmann::json MpChangeForm::ToJson(const MpChangeForm& changeForm,
+                                    uint8_t fieldGroups)
 {
   auto res = nlohmann::json::object();
   res["recType"] = static_cast<int>(changeForm.recType);
   res["formDesc"] = changeForm.formDesc.ToString();
   res["baseDesc"] = changeForm.baseDesc.ToString();
-  res["position"] = { changeForm.position[0], changeForm.position[1],
-                      changeForm.position[2] };
-  res["angle"] = { changeForm.angle[0], changeForm.angle[1],
-                   changeForm.angle[2] };
-  res["worldOrCell"] = changeForm.worldOrCell;
-  res["inv"] = changeForm.inv.ToJson();
+
+  if (fieldGroups & kPositionDirty) {
+    res["position"] = { changeForm.position[0], changeForm.position[1],
+                        changeForm.position[2] };
+    res["angle"] = { changeForm.angle[0], changeForm.angle[1],
+                     changeForm.angle[2] };
+    res["worldOrCell"] = changeForm.worldOrCell;
+  }
+
+  if (fieldGroups & kInventoryDirty) {
+    res["inv"] = changeForm.inv.ToJson();
+    res["baseContainerAdded"] = changeForm.baseContainerAdded;
+  }
+
+  if (!(fieldGroups & kPropsDirty))
+    return res;
+
   res["isHarvested"] = changeForm.isHarvested;
   res["isOpen"] = changeForm.isOpen;
-  res["baseContainerAdded"] = changeForm.baseContainerAdded;
   res["nextRelootDatetime"] = changeForm.nextRelootDatetime;
   res["isDisabled"] = changeForm.isDisabled;
   res["profileId"] = changeForm.profileId;
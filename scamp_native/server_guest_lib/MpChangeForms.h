@@ -23,6 +23,17 @@ public:
     ACHR = 1,
   };
 
+  // Field groups changed since the change form was last passed to the save
+  // storage. Identity fields (recType, formDesc, baseDesc) belong to every
+  // group
+  enum DirtyFields : uint8_t
+  {
+    kPositionDirty = 1 << 0,  // position, angle, worldOrCell
+    kInventoryDirty = 1 << 1, // inv, baseContainerAdded
+    kPropsDirty = 1 << 2,     // the rest
+    kAllDirty = kPositionDirty | kInventoryDirty | kPropsDirty
+  };
+
   int recType = RecType::REFR;
   FormDesc formDesc;
   FormDesc baseDesc;
@@ -48,6 +59,9 @@ public:
   // adding new Actor-related rows
 
   DynamicFields dynamicFields;
+
+  // Not saved. New and loaded change forms are dirty as a whole
+  uint8_t dirtyFields = kAllDirty;
 };
 
 class MpChangeForm : public MpChangeFormREFR
@@ -63,6 +77,10 @@ public:
   }
 
   static nlohmann::json ToJson(const MpChangeForm& changeForm);
+
+  // Identity fields and the given DirtyFields groups only
+  static nlohmann::json ToJson(const MpChangeForm& changeForm,
+                               uint8_t fieldGroups);
   static MpChangeForm JsonToChangeForm(simdjson::dom::element& element);
 };
 
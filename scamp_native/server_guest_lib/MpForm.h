@@ -1,4 +1,5 @@
 #pragma once
+#include "FormTable.h"
 #include "NiPoint3.h"
 #include <cstdint>
 #include <memory>
@@ -51,6 +52,12 @@ public:
 
   auto GetFormId() const noexcept { return id; }
 
+  // FormTypeFlag values of the form's class and its bases
+  auto GetTypeFlags() const noexcept { return typeFlags; }
+
+  // Invalid until the form is added to WorldState
+  auto GetHandle() const noexcept { return handle; }
+
   MpForm(const MpForm&) = delete;
   MpForm& operator=(const MpForm&) = delete;
 
@@ -62,13 +69,36 @@ protected:
                                 const VarValue* arguments = nullptr,
                                 size_t argumentsCount = 0);
 
+  uint8_t typeFlags = FormTypeFlag<MpForm>::value;
+
 private:
   using GameObjectPtr = std::shared_ptr<IGameObject>;
 
   uint32_t id = 0;
+  FormHandle handle;
   WorldState* parent = nullptr;
   mutable GameObjectPtr gameObject;
 
 protected:
   virtual void BeforeDestroy(){};
-};
\ No newline at end of file
+};
+
+// O(1) checked downcast for forms of flagged classes
+template <class T>
+T* FormCast(MpForm* form)
+{
+  if constexpr (FormTypeFlag<T>::value != 0) {
+    return form && (form->GetTypeFlags() & FormTypeFlag<T>::value)
+      ? static_cast<T*>(form)
+      : nullptr;
+  } else {
+    return dynamic_cast<T*>(form);
+  }
+}
+
+template <class T>
+std::shared_ptr<T> FormCast(const std::shared_ptr<MpForm>& form)
+{
+  return FormCast<T>(form.get()) ? std::static_pointer_cast<T>(form)
+                                 : nullptr;
+}
\ No newline at end of file
@@ -5,34 +5,22 @@
 #include "LeveledListUtils.h"
 #include "MpActor.h"
 #include "MpChangeForms.h"
+#include "PacketBuilder.h"
 #include "PapyrusGame.h"
 #include "PapyrusObjectReference.h"
 #include "Primitive.h"
+#include "PropertyMessage.h"
 #include "Reader.h"
 #include "ScopedTask.h"
 #include "ScriptStorage.h"
 #include "ScriptVariablesHolder.h"
 #include "VirtualMachine.h"
 #include "WorldState.h"
-#include <MsgType.h>
+#include <algorithm>
+#include <cstdlib>
 #include <map>
 #include <optional>
 
-namespace {
-std::string CreatePropertyMessage(MpObjectReference* self, const char* name,
-                                  const nlohmann::json& value)
-{
-  nlohmann::json j{ { "idx", self->GetIdx() },
-                    { "t", MsgType::UpdateProperty },
-                    { "propName", name },
-                    { "data", value } };
-  std::string str;
-  str += Networking::MinPacketId;
-  str += j.dump();
-  return str;
-}
-}
-
 class OccupantDestroyEventSink : public MpActor::DestroyEventSink
 {
 public:
@@ -66,9 +54,35 @@ private:
 };
 
 namespace {
-std::pair<int16_t, int16_t> GetGridPos(const NiPoint3& pos) noexcept
+std::pair<int16_t, int16_t> GetGridPos(const NiPoint3& pos,
+                                       float cellSize) noexcept
+{
+  return { int16_t(pos.x / cellSize), int16_t(pos.y / cellSize) };
+}
+
+// Keeps current coordinates while pos is within margin of the current cell
+std::pair<int16_t, int16_t> GetGridPos(const NiPoint3& pos, float cellSize,
+                                       std::pair<int16_t, int16_t> current,
+                                       float margin) noexcept
+{
+  auto res = GetGridPos(pos, cellSize);
+  auto hold = [&](float p, int16_t cur, int16_t& inOut) {
+    if (inOut != cur &&
+        (int16_t((p - margin) / cellSize) == cur ||
+         int16_t((p + margin) / cellSize) == cur))
+      inOut = cur;
+  };
+  hold(pos.x, current.first, res.first);
+  hold(pos.y, current.second, res.second);
+  return res;
+}
+
+float GetCellSize(const MpObjectReference& ref)
 {
-  return { int16_t(pos.x / 4096), int16_t(pos.y / 4096) };
+  auto worldState = ref.GetParent();
+  return worldState
+    ? worldState->GetGridSettings(ref.GetCellOrWorld()).cellSize
+    : WorldState::GridSettings().cellSize;
 }
 }
 
@@ -85,7 +99,55 @@ struct ScriptState
 struct PrimitiveData
 {
   NiPoint3 boundsDiv2;
-  GeoProc::GeoPolygonProc polygonProc;
+  Primitive::OrientedBox orientedBox;
+  Primitive::BoundingBox boundingBox;
+};
+
+// Emitters are stored as raw pointers since Unsubscribe removes them before
+// they are destroyed. Whether we are inside is a bit per slot
+struct MpObjectReference::TriggerSlots
+{
+  void Add(MpObjectReference* emitter)
+  {
+    if (slotByEmitter.count(emitter))
+      return;
+    uint32_t slot;
+    if (freeSlots.empty()) {
+      slot = static_cast<uint32_t>(emitters.size());
+      emitters.push_back(emitter);
+      inside.push_back(false);
+    } else {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+      emitters[slot] = emitter;
+    }
+    slotByEmitter[emitter] = slot;
+  }
+
+  void Remove(MpObjectReference* emitter)
+  {
+    auto it = slotByEmitter.find(emitter);
+    if (it == slotByEmitter.end())
+      return;
+    SetInside(it->second, false);
+    emitters[it->second] = nullptr;
+    freeSlots.push_back(it->second);
+    slotByEmitter.erase(it);
+  }
+
+  void SetInside(uint32_t slot, bool value)
+  {
+    if (inside[slot] != value) {
+      inside[slot] = value;
+      value ? ++numInside : --numInside;
+    }
+  }
+
+  std::unordered_map<MpObjectReference*, uint32_t> slotByEmitter;
+  std::vector<MpObjectReference*> emitters;
+  std::vector<uint32_t> freeSlots;
+  std::vector<bool> inside;
+  size_t numInside = 0;
 };
 
 struct MpObjectReference::Impl : public ChangeFormGuard<MpChangeFormREFR>
@@ -122,6 +184,8 @@ MpObjectReference::MpObjectReference(
   , baseId(baseId_)
   , baseType(baseType_)
 {
+  typeFlags |= FormTypeFlag<MpObjectReference>::value;
+
   MpChangeFormREFR changeForm;
   changeForm.position = locationalData_.pos;
   changeForm.angle = locationalData_.rot;
@@ -152,6 +216,11 @@ const uint32_t& MpObjectReference::GetBaseId() const
   return baseId;
 }
 
+const std::string& MpObjectReference::GetBaseType() const
+{
+  return baseType;
+}
+
 const Inventory& MpObjectReference::GetInventory() const
 {
   return pImpl->ChangeForm().inv;
@@ -202,7 +271,7 @@ bool MpObjectReference::GetAnimationVariableBool(const char* name) const
 bool MpObjectReference::IsPointInsidePrimitive(const NiPoint3& point) const
 {
   if (pImpl->primitive) {
-    return Primitive::IsInside(point, pImpl->primitive->polygonProc);
+    return Primitive::IsInside(point, pImpl->primitive->orientedBox);
   }
   return false;
 }
@@ -270,72 +339,91 @@ void MpObjectReference::Activate(MpObjectReference& activationSource,
 
 void MpObjectReference::SetPos(const NiPoint3& newPos)
 {
-  auto oldGridPos = GetGridPos(pImpl->ChangeForm().position);
-  auto newGridPos = GetGridPos(newPos);
+  const float cellSize = GetCellSize(*this);
+  auto oldGridPos = GetGridPos(pImpl->ChangeForm().position, cellSize);
+  auto newGridPos = GetGridPos(newPos, cellSize);
 
   pImpl->EditChangeForm(
     [&newPos](MpChangeFormREFR& changeForm) { changeForm.position = newPos; },
-    Mode(IsLocationSavingNeeded()));
+    MpChangeFormREFR::kPositionDirty, Mode(IsLocationSavingNeeded()));
 
-  if (oldGridPos != newGridPos || !everSubscribedOrListened)
+  if (!everSubscribedOrListened ||
+      GetSubscriptionGridPos() != subscribedGridPos)
     ForceSubscriptionsUpdate();
+  else if (oldGridPos != newGridPos && GetParent())
+    ++GetParent()->gridChurnStats.numCellChangesAvoided;
+
+  if (!IsDisabled() && triggerSlots) {
+    auto& slots = *triggerSlots;
+    std::vector<std::pair<MpObjectReference*, bool>> changes;
+    for (uint32_t i = 0; slots.numInside > 0 && i < slots.inside.size(); ++i) {
+      if (!slots.inside[i])
+        continue;
+      auto& primitive = *slots.emitters[i]->pImpl->primitive;
+      if (!Primitive::IsInside(newPos, primitive.orientedBox)) {
+        slots.SetInside(i, false);
+        changes.push_back({ slots.emitters[i], false });
+      }
+    }
 
-  if (!IsDisabled()) {
-    if (emittersWithPrimitives) {
-      if (!primitivesWeAreInside)
-        primitivesWeAreInside.reset(new std::set<uint32_t>);
+    // Only triggers indexed in our cell may contain us
+    auto& triggers = GetParent()->GetTriggersAt(GetCellOrWorld(), newPos);
+    static thread_local std::vector<uint8_t> g_insideTriggers;
+    g_insideTriggers.resize(triggers.boxes.size());
+    Primitive::IsInside(newPos, triggers.boxes.data(), triggers.boxes.size(),
+                        g_insideTriggers.data());
+    for (size_t i = 0; i < triggers.refs.size(); ++i) {
+      if (!g_insideTriggers[i])
+        continue;
+      auto emitter = triggers.refs[i];
+      auto it = slots.slotByEmitter.find(emitter);
+      if (it != slots.slotByEmitter.end() && !slots.inside[it->second]) {
+        slots.SetInside(it->second, true);
+        changes.push_back({ emitter, true });
+      }
+    }
 
-      for (auto& [emitterId, wasInside] : *emittersWithPrimitives) {
-        auto& emitter = GetParent()->LookupFormById(emitterId);
-        auto emitterRefr =
-          std::dynamic_pointer_cast<MpObjectReference>(emitter);
-        if (!emitterRefr) {
-          GetParent()->logger->error("Emitter not found ({0:x})", emitterId);
-          continue;
+    for (auto [emitter, inside] : changes) {
+      auto me = ToVarValue();
+
+      // Handles resolve to nullptr once forms are destroyed
+      auto wst = GetParent();
+      auto id = emitter->GetFormId();
+      auto emitterHandle = emitter->GetHandle();
+      auto myHandle = GetHandle();
+      wst->SetTimer(0).Then([wst, id, inside, me, emitterHandle,
+                             myHandle](Viet::Void) {
+        if (!wst->LookupForm(myHandle)) {
+          wst->logger->error("Refr pointer expired", id);
+          return;
         }
-        bool inside = emitterRefr->IsPointInsidePrimitive(newPos);
-        if (wasInside != inside) {
-          wasInside = inside;
-          auto me = ToVarValue();
-
-          auto wst = GetParent();
-          auto id = emitterId;
-          auto myId = GetFormId();
-          wst->SetTimer(0).Then([wst, id, inside, me, myId, this](Viet::Void) {
-            if (wst->LookupFormById(myId).get() != this) {
-              wst->logger->error("Refr pointer expired", id);
-              return;
-            }
-
-            auto& emitter = wst->LookupFormById(id);
-            auto emitterRefr =
-              std::dynamic_pointer_cast<MpObjectReference>(emitter);
-            if (!emitterRefr) {
-              wst->logger->error("Emitter not found in timer ({0:x})", id);
-              return;
-            }
-            emitterRefr->SendPapyrusEvent(
-              inside ? "OnTriggerEnter" : "OnTriggerLeave", &me, 1);
-          });
-
-          if (inside)
-            primitivesWeAreInside->insert(emitterId);
-          else
-            primitivesWeAreInside->erase(emitterId);
+
+        auto emitterRefr = wst->LookupForm<MpObjectReference>(emitterHandle);
+        if (!emitterRefr) {
+          wst->logger->error("Emitter not found in timer ({0:x})", id);
+          return;
         }
-      }
+        emitterRefr->SendPapyrusEvent(
+          inside ? "OnTriggerEnter" : "OnTriggerLeave", &me, 1);
+      });
     }
 
-    if (primitivesWeAreInside) {
+    if (slots.numInside > 0) {
       auto me = ToVarValue();
 
-      // May be modified inside loop, so copying
-      const auto map = *primitivesWeAreInside;
+      // Papyrus may unsubscribe or destroy emitters, so handles are copied
+      std::vector<std::pair<FormHandle, uint32_t>> emitterHandles;
+      for (uint32_t i = 0; i < slots.inside.size(); ++i) {
+        if (!slots.inside[i])
+          continue;
+        auto emitter = slots.emitters[i];
+        emitterHandles.push_back(
+          { emitter->GetHandle(), emitter->GetFormId() });
+      }
 
-      for (auto emitterId : map) {
-        auto& emitter = GetParent()->LookupFormById(emitterId);
+      for (auto [emitterHandle, emitterId] : emitterHandles) {
         auto emitterRefr =
-          std::dynamic_pointer_cast<MpObjectReference>(emitter);
+          GetParent()->LookupForm<MpObjectReference>(emitterHandle);
         if (!emitterRefr) {
           GetParent()->logger->error(
             "Emitter not found ({0:x}) when trying to send OnTrigger event",
@@ -352,15 +440,17 @@ void MpObjectReference::SetAngle(const NiPoint3& newAngle)
 {
   pImpl->EditChangeForm(
     [&](MpChangeFormREFR& changeForm) { changeForm.angle = newAngle; },
-    Mode(IsLocationSavingNeeded()));
+    MpChangeFormREFR::kPositionDirty, Mode(IsLocationSavingNeeded()));
 }
 
 void MpObjectReference::SetHarvested(bool harvested)
 {
   if (harvested != pImpl->ChangeForm().isHarvested) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.isHarvested = harvested;
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.isHarvested = harvested;
+      },
+      MpChangeFormREFR::kPropsDirty);
     SendPropertyToListeners("isHarvested", harvested);
   }
 }
@@ -369,7 +459,8 @@ void MpObjectReference::SetOpen(bool open)
 {
   if (open != pImpl->ChangeForm().isOpen) {
     pImpl->EditChangeForm(
-      [&](MpChangeFormREFR& changeForm) { changeForm.isOpen = open; });
+      [&](MpChangeFormREFR& changeForm) { changeForm.isOpen = open; },
+      MpChangeFormREFR::kPropsDirty);
     SendPropertyToListeners("isOpen", open);
   }
 }
@@ -425,7 +516,9 @@ void MpObjectReference::Disable()
     return;
 
   pImpl->EditChangeForm(
-    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = true; });
+    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = true; },
+    MpChangeFormREFR::kPropsDirty);
+  UnsubscribeFromAll();
   RemoveFromGrid();
 }
 
@@ -435,7 +528,8 @@ void MpObjectReference::Enable()
     return;
 
   pImpl->EditChangeForm(
-    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = false; });
+    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = false; },
+    MpChangeFormREFR::kPropsDirty);
   ForceSubscriptionsUpdate();
 }
 
@@ -451,27 +545,84 @@ void MpObjectReference::ForceSubscriptionsUpdate()
     return;
   InitListenersAndEmitters();
 
-  auto& gridInfo = GetParent()->grids[GetCellOrWorld()];
-  MoveOnGrid(*gridInfo.grid);
+  auto& gridInfo = GetParent()->GetGridInfo(GetCellOrWorld());
+  auto grid = gridInfo.grid.get();
+  MoveOnGrid(*grid);
+  if (pImpl->primitive)
+    AddToTriggerIndex();
+
+  auto pos = GetSubscriptionGridPos();
+  gridInfo.spatialIndex.Move(this, GetBaseId(), pos.first, pos.second);
+  if (everSubscribedOrListened && pos == subscribedGridPos)
+    return;
 
   auto& was = *this->listeners;
-  auto pos = GetGridPos(GetPos());
-  auto& now = GetParent()->GetReferencesAtPosition(GetCellOrWorld(), pos.first,
-                                                   pos.second);
+  auto now = GetParent()->GetReferencesAtPosition(GetCellOrWorld(), pos.first,
+                                                  pos.second);
 
   std::vector<MpObjectReference*> toRemove;
-  std::set_difference(was.begin(), was.end(), now.begin(), now.end(),
-                      std::inserter(toRemove, toRemove.begin()));
+  std::vector<MpObjectReference*> toAdd;
+
+  auto old = subscribedGridPos;
+  const int r = grid->GetRadius();
+  const bool windowsOverlap = everSubscribedOrListened &&
+    std::abs(pos.first - old.first) <= 2 * r &&
+    std::abs(pos.second - old.second) <= 2 * r;
+
+  if (windowsOverlap) {
+    // Listeners are exactly the references in the old window, so only cells
+    // that left or entered the window need to be visited
+    auto inWindow = [r](std::pair<int16_t, int16_t> center, int x, int y) {
+      return std::abs(x - center.first) <= r &&
+        std::abs(y - center.second) <= r;
+    };
+    for (int x = old.first - r; x <= old.first + r; ++x) {
+      for (int y = old.second - r; y <= old.second + r; ++y) {
+        if (inWindow(pos, x, y))
+          continue;
+        for (auto ref : grid->GetCell(x, y)) {
+          if (was.count(ref))
+            toRemove.push_back(ref);
+        }
+      }
+    }
+    for (int x = pos.first - r; x <= pos.first + r; ++x) {
+      for (int y = pos.second - r; y <= pos.second + r; ++y) {
+        if (inWindow(old, x, y))
+          continue;
+        for (auto ref : grid->GetCell(x, y)) {
+          if (!was.count(ref))
+            toAdd.push_back(ref);
+          else if (ref != this)
+            GetParent()->CancelDeferredUnsubscribe(this, ref);
+        }
+      }
+    }
+  } else {
+    std::vector<MpObjectReference*> nowSorted(now.begin(), now.end());
+    std::sort(nowSorted.begin(), nowSorted.end());
+    std::set_difference(was.begin(), was.end(), nowSorted.begin(),
+                        nowSorted.end(), std::back_inserter(toRemove));
+    std::set_difference(nowSorted.begin(), nowSorted.end(), was.begin(),
+                        was.end(), std::back_inserter(toAdd));
+  }
+  subscribedGridPos = pos;
+
+  if (windowsOverlap)
+    GetParent()->PreloadChunksAhead(GetCellOrWorld(), old, pos);
+
   for (auto listener : toRemove) {
+    // Refs pacing along a cell border come back soon, so the pair stays
+    // subscribed for a while. Teleports (the full path) don't wait
+    if (windowsOverlap && this != listener &&
+        GetParent()->DeferUnsubscribe(this, listener))
+      continue;
     Unsubscribe(this, listener);
     // Unsubscribe from self is NEEDED. See comment below
     if (this != listener)
       Unsubscribe(listener, this);
   }
 
-  std::vector<MpObjectReference*> toAdd;
-  std::set_difference(now.begin(), now.end(), was.begin(), was.end(),
-                      std::inserter(toAdd, toAdd.begin()));
   for (auto listener : toAdd) {
     Subscribe(this, listener);
     // Note: Self-subscription is OK this check is performed as we don't want
@@ -487,16 +638,26 @@ void MpObjectReference::ForceSubscriptionsUpdate()
 void MpObjectReference::SetPrimitive(const NiPoint3& boundsDiv2)
 {
   auto vertices = Primitive::GetVertices(GetPos(), GetAngle(), boundsDiv2);
-  pImpl->primitive =
-    PrimitiveData{ boundsDiv2, Primitive::CreateGeoPolygonProc(vertices) };
+  pImpl->primitive = PrimitiveData{
+    boundsDiv2,
+    Primitive::CreateOrientedBox(GetPos(), GetAngle(), boundsDiv2),
+    Primitive::GetBoundingBox(vertices)
+  };
+
+  if (auto worldState = GetParent()) {
+    worldState->RemoveTrigger(this);
+    if (everSubscribedOrListened)
+      AddToTriggerIndex();
+  }
 }
 
 void MpObjectReference::UpdateHoster(uint32_t newHosterId)
 {
-  auto hostedMsg = CreatePropertyMessage(this, "isHostedByOther", true);
-  auto notHostedMsg = CreatePropertyMessage(this, "isHostedByOther", false);
+  Networking::PacketBuilder hostedMsg, notHostedMsg;
+  WritePropertyMessage(hostedMsg, GetIdx(), "isHostedByOther", true);
+  WritePropertyMessage(notHostedMsg, GetIdx(), "isHostedByOther", false);
   for (auto listener : this->GetListeners()) {
-    auto listenerAsActor = dynamic_cast<MpActor*>(listener);
+    auto listenerAsActor = FormCast<MpActor>(listener);
     if (listenerAsActor)
       this->SendPropertyTo(newHosterId != 0 &&
                                newHosterId != listener->GetFormId()
@@ -512,9 +673,11 @@ void MpObjectReference::SetProperty(const std::string& propertyName,
                                     bool isVisibleByOwner,
                                     bool isVisibleByNeighbor)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.dynamicFields.Set(propertyName, newValueChakra);
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.dynamicFields.Set(propertyName, newValueChakra);
+    },
+    MpChangeFormREFR::kPropsDirty);
   if (isVisibleByNeighbor) {
     SendPropertyToListeners(propertyName.data(), newValue);
   } else if (isVisibleByOwner) {
@@ -538,7 +701,7 @@ void MpObjectReference::SetPosAndAngleSilent(const NiPoint3& pos,
       changeForm.position = pos;
       changeForm.angle = rot;
     },
-    Impl::Mode::NoRequestSave);
+    MpChangeFormREFR::kPositionDirty, Impl::Mode::NoRequestSave);
 }
 
 void MpObjectReference::SetAnimationVariableBool(const char* name, bool value)
@@ -553,29 +716,35 @@ void MpObjectReference::SetAnimationVariableBool(const char* name, bool value)
 
 void MpObjectReference::SetInventory(const Inventory& inv)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.baseContainerAdded = true;
-    changeForm.inv = inv;
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.baseContainerAdded = true;
+      changeForm.inv = inv;
+    },
+    MpChangeFormREFR::kInventoryDirty);
   SendInventoryUpdate();
 }
 
 void MpObjectReference::AddItem(uint32_t baseId, uint32_t count)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.baseContainerAdded = true;
-    changeForm.inv.AddItem(baseId, count);
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.baseContainerAdded = true;
+      changeForm.inv.AddItem(baseId, count);
+    },
+    MpChangeFormREFR::kInventoryDirty);
   SendInventoryUpdate();
 }
 
 void MpObjectReference::AddItems(const std::vector<Inventory::Entry>& entries)
 {
   if (entries.size() > 0) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.baseContainerAdded = true;
-      changeForm.inv.AddItems(entries);
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.baseContainerAdded = true;
+        changeForm.inv.AddItems(entries);
+      },
+      MpChangeFormREFR::kInventoryDirty);
     SendInventoryUpdate();
   }
 }
@@ -589,9 +758,9 @@ void MpObjectReference::RemoveItem(uint32_t baseId, uint32_t count,
 void MpObjectReference::RemoveItems(
   const std::vector<Inventory::Entry>& entries, MpObjectReference* target)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.inv.RemoveItems(entries);
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) { changeForm.inv.RemoveItems(entries); },
+    MpChangeFormREFR::kInventoryDirty);
 
   if (target)
     target->AddItems(entries);
@@ -611,7 +780,7 @@ void MpObjectReference::RelootContainer()
     [&](MpChangeFormREFR& changeForm) {
       changeForm.baseContainerAdded = false;
     },
-    Impl::Mode::NoRequestSave);
+    MpChangeFormREFR::kInventoryDirty, Impl::Mode::NoRequestSave);
   EnsureBaseContainerAdded(*GetParent()->espm);
 }
 
@@ -624,20 +793,21 @@ void MpObjectReference::RegisterProfileId(int32_t profileId)
     throw std::runtime_error("Already has a valid profileId");
 
   pImpl->EditChangeForm(
-    [&](MpChangeFormREFR& changeForm) { changeForm.profileId = profileId; });
+    [&](MpChangeFormREFR& changeForm) { changeForm.profileId = profileId; },
+    MpChangeFormREFR::kPropsDirty);
   GetParent()->actorIdByProfileId[profileId].insert(GetFormId());
 }
 
 void MpObjectReference::Subscribe(MpObjectReference* emitter,
                                   MpObjectReference* listener)
 {
-  const bool emitterIsActor = !!dynamic_cast<MpActor*>(emitter);
-  const bool listenerIsActor = !!dynamic_cast<MpActor*>(listener);
+  const bool emitterIsActor = !!FormCast<MpActor>(emitter);
+  const bool listenerIsActor = !!FormCast<MpActor>(listener);
   if (!emitterIsActor && !listenerIsActor)
     return;
 
   if (!emitter->pImpl->onInitEventSent &&
-      listener->GetChangeForm().profileId != -1) {
+      listener->pImpl->ChangeForm().profileId != -1) {
     emitter->pImpl->onInitEventSent = true;
     emitter->SendPapyrusEvent("OnInit");
 
@@ -654,9 +824,9 @@ void MpObjectReference::Subscribe(MpObjectReference* emitter,
     emitter->callbacks->subscribe(emitter, listener);
 
   if (hasPrimitive) {
-    if (!listener->emittersWithPrimitives)
-      listener->emittersWithPrimitives.reset(new std::map<uint32_t, bool>);
-    listener->emittersWithPrimitives->insert({ emitter->GetFormId(), false });
+    if (!listener->triggerSlots)
+      listener->triggerSlots = std::make_shared<TriggerSlots>();
+    listener->triggerSlots->Add(emitter);
   }
 }
 
@@ -664,7 +834,7 @@ void MpObjectReference::Unsubscribe(MpObjectReference* emitter,
                                     MpObjectReference* listener)
 {
   bool bothNonActors =
-    !dynamic_cast<MpActor*>(emitter) && !dynamic_cast<MpActor*>(listener);
+    !FormCast<MpActor>(emitter) && !FormCast<MpActor>(listener);
   if (bothNonActors)
     return;
 
@@ -675,8 +845,8 @@ void MpObjectReference::Unsubscribe(MpObjectReference* emitter,
   emitter->listeners->erase(listener);
   listener->emitters->erase(emitter);
 
-  if (listener->emittersWithPrimitives && hasPrimitive) {
-    listener->emittersWithPrimitives->erase(emitter->GetFormId());
+  if (listener->triggerSlots && hasPrimitive) {
+    listener->triggerSlots->Remove(emitter);
   }
 }
 
@@ -699,10 +869,12 @@ void MpObjectReference::RequestReloot(
     time = GetRelootTime();
 
   if (!pImpl->ChangeForm().nextRelootDatetime) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.nextRelootDatetime = std::chrono::system_clock::to_time_t(
-        std::chrono::system_clock::now() + GetRelootTime());
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.nextRelootDatetime = std::chrono::system_clock::to_time_t(
+          std::chrono::system_clock::now() + GetRelootTime());
+      },
+      MpChangeFormREFR::kPropsDirty);
 
     GetParent()->RequestReloot(*this, *time);
   }
@@ -711,9 +883,9 @@ void MpObjectReference::RequestReloot(
 void MpObjectReference::DoReloot()
 {
   if (pImpl->ChangeForm().nextRelootDatetime) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.nextRelootDatetime = 0;
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) { changeForm.nextRelootDatetime = 0; },
+      MpChangeFormREFR::kPropsDirty);
     SetOpen(false);
     SetHarvested(false);
     RelootContainer();
@@ -745,6 +917,16 @@ MpChangeForm MpObjectReference::GetChangeForm() const
   return res;
 }
 
+void MpObjectReference::ClearDirtyFields()
+{
+  pImpl->ClearDirtyFields();
+}
+
+void MpObjectReference::MarkDirtyFields(uint8_t dirtyFields)
+{
+  pImpl->MarkDirtyFields(dirtyFields);
+}
+
 void MpObjectReference::ApplyChangeForm(const MpChangeForm& changeForm)
 {
   if (pImpl->setPropertyCalled) {
@@ -818,13 +1000,18 @@ void MpObjectReference::SetCellOrWorldObsolete(uint32_t newWorldOrCell)
     return;
 
   everSubscribedOrListened = false;
+  worldState->RemoveTrigger(this);
   auto gridIterator = worldState->grids.find(pImpl->ChangeForm().worldOrCell);
-  if (gridIterator != worldState->grids.end())
+  if (gridIterator != worldState->grids.end()) {
     gridIterator->second.grid->Forget(this);
+    gridIterator->second.spatialIndex.Forget(this);
+  }
 
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.worldOrCell = newWorldOrCell;
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.worldOrCell = newWorldOrCell;
+    },
+    MpChangeFormREFR::kPositionDirty);
 }
 
 void MpObjectReference::VisitNeighbours(const Visitor& visitor)
@@ -841,13 +1028,31 @@ void MpObjectReference::VisitNeighbours(const Visitor& visitor)
     return;
 
   auto& grid = gridIterator->second;
-  auto pos = GetGridPos(GetPos());
-  auto& neighbours = worldState->GetReferencesAtPosition(
+  auto pos = GetSubscriptionGridPos();
+  auto neighbours = worldState->GetReferencesAtPosition(
     GetCellOrWorld(), pos.first, pos.second);
   for (auto neighbour : neighbours)
     visitor(neighbour);
 }
 
+const MpObjectReference::SpawnPayload* MpObjectReference::GetSpawnPayload()
+  const
+{
+  return spawnPayload.get();
+}
+
+const MpObjectReference::SpawnPayload& MpObjectReference::SetSpawnPayload(
+  SpawnPayload payload)
+{
+  spawnPayload.reset(new SpawnPayload(std::move(payload)));
+  return *spawnPayload;
+}
+
+void MpObjectReference::InvalidateSpawnPayload()
+{
+  spawnPayload.reset();
+}
+
 void MpObjectReference::SendPapyrusEvent(const char* eventName,
                                          const VarValue* arguments,
                                          size_t argumentsCount)
@@ -954,16 +1159,14 @@ void MpObjectReference::ProcessActivate(MpObjectReference& activationSource)
                              teleport->rotRadians[1] / g_pi * 180,
                              teleport->rotRadians[2] / g_pi * 180 };
 
-      std::string msg;
-      msg += Networking::MinPacketId;
-      msg += nlohmann::json{
-        { "pos", { teleport->pos[0], teleport->pos[1], teleport->pos[2] } },
-        { "rot", { rot[0], rot[1], rot[2] } },
-        { "worldOrCell", teleportWorldOrCell },
-        { "type", "teleport" }
-      }.dump();
+      Networking::PacketBuilder msg;
+      msg.AppendFormatted(
+        R"({"pos":[%.9g,%.9g,%.9g],"rot":[%.9g,%.9g,%.9g],)"
+        R"("worldOrCell":%u,"type":"teleport"})",
+        teleport->pos[0], teleport->pos[1], teleport->pos[2], rot[0], rot[1],
+        rot[2], teleportWorldOrCell);
       if (actorActivator)
-        actorActivator->SendToUser(msg.data(), msg.size(), true);
+        actorActivator->SendToUser(msg.GetData(), msg.GetLength(), true);
 
       activationSource.SetCellOrWorldObsolete(teleportWorldOrCell);
       activationSource.SetPos(
@@ -1027,9 +1230,13 @@ bool MpObjectReference::MpApiOnActivate(MpObjectReference& caster)
 
 void MpObjectReference::RemoveFromGrid()
 {
+  GetParent()->RemoveTrigger(this);
+
   auto gridIterator = GetParent()->grids.find(GetCellOrWorld());
-  if (gridIterator != GetParent()->grids.end())
+  if (gridIterator != GetParent()->grids.end()) {
     gridIterator->second.grid->Forget(this);
+    gridIterator->second.spatialIndex.Forget(this);
+  }
 
   auto listenersCopy = GetListeners();
   for (auto listener : listenersCopy)
@@ -1098,12 +1305,28 @@ void MpObjectReference::InitScripts()
   }
 }
 
-void MpObjectReference::MoveOnGrid(GridImpl<MpObjectReference*>& grid)
+void MpObjectReference::MoveOnGrid(FlatGridImpl<MpObjectReference*>& grid)
 {
-  auto newGridPos = GetGridPos(GetPos());
+  auto newGridPos = GetSubscriptionGridPos();
   grid.Move(this, newGridPos.first, newGridPos.second);
 }
 
+void MpObjectReference::AddToTriggerIndex()
+{
+  GetParent()->AddTrigger(this, pImpl->primitive->boundingBox,
+                          pImpl->primitive->orientedBox);
+}
+
+std::pair<int16_t, int16_t> MpObjectReference::GetSubscriptionGridPos() const
+{
+  auto worldState = GetParent();
+  const float cellSize = GetCellSize(*this);
+  if (!everSubscribedOrListened || !worldState)
+    return GetGridPos(GetPos(), cellSize);
+  return GetGridPos(GetPos(), cellSize, subscribedGridPos,
+                    worldState->GetGridHysteresisMargin());
+}
+
 void MpObjectReference::InitListenersAndEmitters()
 {
   if (!listeners) {
@@ -1116,13 +1339,11 @@ void MpObjectReference::SendInventoryUpdate()
 {
   auto actor = dynamic_cast<MpActor*>(this);
   if (actor) {
-    std::string msg;
-    msg += Networking::MinPacketId;
-    msg += nlohmann::json{
-      { "inventory", actor->GetInventory().ToJson() },
-      { "type", "setInventory" }
-    }.dump();
-    actor->SendToUser(msg.data(), msg.size(), true);
+    Networking::PacketBuilder msg;
+    msg.Append(R"({"inventory":)");
+    msg.Append(actor->GetInventory().ToJson().dump());
+    msg.Append(R"(,"type":"setInventory"})");
+    actor->SendToUser(msg.GetData(), msg.GetLength(), true);
   }
 }
 
@@ -1130,12 +1351,9 @@ void MpObjectReference::SendOpenContainer(uint32_t targetId)
 {
   auto actor = dynamic_cast<MpActor*>(this);
   if (actor) {
-    std::string msg;
-    msg += Networking::MinPacketId;
-    msg += nlohmann::json{
-      { "target", targetId }, { "type", "openContainer" }
-    }.dump();
-    actor->SendToUser(msg.data(), msg.size(), true);
+    Networking::PacketBuilder msg;
+    msg.AppendFormatted(R"({"target":%u,"type":"openContainer"})", targetId);
+    actor->SendToUser(msg.GetData(), msg.GetLength(), true);
   }
 }
 
@@ -1237,9 +1455,11 @@ void MpObjectReference::EnsureBaseContainerAdded(espm::Loader& espm)
   AddItems(entries);
 
   if (!pImpl->ChangeForm().baseContainerAdded) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.baseContainerAdded = true;
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.baseContainerAdded = true;
+      },
+      MpChangeFormREFR::kInventoryDirty);
   }
 }
 
@@ -1267,11 +1487,12 @@ void MpObjectReference::CheckInteractionAbility(MpObjectReference& refr)
 void MpObjectReference::SendPropertyToListeners(const char* name,
                                                 const nlohmann::json& value)
 {
-  auto str = CreatePropertyMessage(this, name, value);
+  Networking::PacketBuilder msg;
+  WritePropertyMessage(msg, GetIdx(), name, value);
   for (auto listener : GetListeners()) {
-    auto listenerAsActor = dynamic_cast<MpActor*>(listener);
+    auto listenerAsActor = FormCast<MpActor>(listener);
     if (listenerAsActor)
-      listenerAsActor->SendToUser(str.data(), str.size(), true);
+      SendPropertyTo(msg, *listenerAsActor);
   }
 }
 
@@ -1279,14 +1500,16 @@ void MpObjectReference::SendPropertyTo(const char* name,
                                        const nlohmann::json& value,
                                        MpActor& target)
 {
-  auto str = CreatePropertyMessage(this, name, value);
-  SendPropertyTo(str, target);
+  Networking::PacketBuilder msg;
+  WritePropertyMessage(msg, GetIdx(), name, value);
+  SendPropertyTo(msg, target);
 }
 
-void MpObjectReference::SendPropertyTo(const std::string& preparedPropMsg,
-                                       MpActor& target)
+void MpObjectReference::SendPropertyTo(
+  const Networking::PacketBuilder& preparedPropMsg, MpActor& target)
 {
-  target.SendToUser(preparedPropMsg.data(), preparedPropMsg.size(), true);
+  target.SendToUser(preparedPropMsg.GetData(), preparedPropMsg.GetLength(),
+                    true);
 }
 
 void MpObjectReference::BeforeDestroy()
@@ -1,6 +1,6 @@
 #pragma once
+#include "FlatGrid.h"
 #include "FormIndex.h"
-#include "Grid.h"
 #include "IWorldObject.h"
 #include "Inventory.h"
 #include "JsonUtils.h"
@@ -48,6 +48,10 @@ class FormCallbacks;
 
 class FormCallbacks;
 
+namespace Networking {
+class PacketBuilder;
+}
+
 enum class VisitPropertiesMode
 {
   OnlyPublic,
@@ -60,6 +64,7 @@ class MpObjectReference
   , public IWorldObject
 {
   friend class OccupantDestroyEventSink;
+  friend class WorldState;
 
 public:
   static const char* Type() { return "ObjectReference"; }
@@ -74,6 +79,7 @@ public:
   const NiPoint3& GetAngle() const override;
   const uint32_t& GetCellOrWorld() const override;
   const uint32_t& GetBaseId() const;
+  const std::string& GetBaseType() const;
   const Inventory& GetInventory() const;
   const bool& IsHarvested() const;
   const bool& IsOpen() const;
@@ -151,6 +157,12 @@ public:
 
   virtual MpChangeForm GetChangeForm() const;
   virtual void ApplyChangeForm(const MpChangeForm& changeForm);
+
+  // Called once GetChangeForm() result is passed to the save storage
+  virtual void ClearDirtyFields();
+
+  // Sets the groups again if saving them failed
+  void MarkDirtyFields(uint8_t dirtyFields);
   const DynamicFields& GetDynamicFields() const;
 
   // This method removes ObjectReference from a current grid and doesn't attach
@@ -160,6 +172,21 @@ public:
   using Visitor = std::function<void(MpObjectReference*)>;
   void VisitNeighbours(const Visitor& visitor);
 
+  // Parts of createActor that are the same for every listener, except the
+  // transform which changes too often to be cached. Built by PartOne,
+  // dropped on change form edits other than position ones
+  struct SpawnPayload
+  {
+    uint32_t gamemodeApiStateRevision = 0;
+    std::string body;
+    std::string publicProps;
+  };
+
+  // Returns nullptr if there is no valid cached payload
+  const SpawnPayload* GetSpawnPayload() const;
+  const SpawnPayload& SetSpawnPayload(SpawnPayload payload);
+  void InvalidateSpawnPayload();
+
 protected:
   void SendPapyrusEvent(const char* eventName,
                         const VarValue* arguments = nullptr,
@@ -172,7 +199,12 @@ private:
   void AddContainerObject(const espm::CONT::ContainerObject& containerObject,
                           std::map<uint32_t, uint32_t>* itemsToAdd);
   void InitScripts();
-  void MoveOnGrid(GridImpl<MpObjectReference*>& grid);
+  void MoveOnGrid(FlatGridImpl<MpObjectReference*>& grid);
+
+  void AddToTriggerIndex();
+
+  // Grid position with the world's hysteresis margin applied
+  std::pair<int16_t, int16_t> GetSubscriptionGridPos() const;
   void InitListenersAndEmitters();
   void SendInventoryUpdate();
   void SendOpenContainer(uint32_t refId);
@@ -180,19 +212,26 @@ private:
   void SendPropertyToListeners(const char* name, const nlohmann::json& value);
   void SendPropertyTo(const char* name, const nlohmann::json& value,
                       MpActor& target);
-  void SendPropertyTo(const std::string& preparedPropMsg, MpActor& target);
+  void SendPropertyTo(const Networking::PacketBuilder& preparedPropMsg,
+                      MpActor& target);
   bool IsLocationSavingNeeded() const;
   void ProcessActivate(MpObjectReference& activationSource);
   void MpApiOnInit();
   bool MpApiOnActivate(MpObjectReference& caster);
 
   bool everSubscribedOrListened = false;
+
+  // Grid position listeners were last computed for. Valid if
+  // everSubscribedOrListened is true
+  std::pair<int16_t, int16_t> subscribedGridPos;
   std::unique_ptr<std::set<MpObjectReference*>> listeners;
 
   // Should be empty for non-actor refs
   std::unique_ptr<std::set<MpObjectReference*>> emitters;
-  std::unique_ptr<std::map<uint32_t, bool>> emittersWithPrimitives;
-  std::unique_ptr<std::set<uint32_t>> primitivesWeAreInside;
+
+  // Emitters with primitives we are subscribed to
+  struct TriggerSlots;
+  std::shared_ptr<TriggerSlots> triggerSlots;
 
   std::string baseType;
   uint32_t baseId = 0;
@@ -201,6 +240,7 @@ private:
   std::optional<std::chrono::system_clock::duration> relootTimeOverride;
   std::unique_ptr<uint8_t> chanceNoneOverride;
   bool activationBlocked = false;
+  std::unique_ptr<SpawnPayload> spawnPayload;
 
   struct Impl;
   std::shared_ptr<Impl> pImpl;
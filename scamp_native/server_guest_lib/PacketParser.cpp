@@ -1,8 +1,13 @@
 #include "PacketParser.h"
 #include "Exceptions.h"
 #include "JsonUtils.h"
+#include "MovementCodec.h"
 #include "MpActor.h"
+#include "NetworkingThreaded.h"
+#include "RateLimiter.h"
+#include "TrafficStats.h"
 #include <MsgType.h>
+#include <cctype>
 #include <simdjson.h>
 
 namespace FormIdCasts {
@@ -28,11 +33,98 @@ static const JsonPointer t("t"), idx("idx"), content("content"), data("data"),
 struct PacketParser::Impl
 {
   simdjson::dom::parser parser;
+  RateLimiter* rateLimiter = nullptr;
+  TrafficStats* trafficStats = nullptr;
+
+  // Returns false if the message must be dropped
+  bool Admit(Networking::UserId userId, MsgType type, size_t length)
+  {
+    if (trafficStats)
+      trafficStats->AddIncoming(userId, type, length);
+    return !rateLimiter || rateLimiter->Consume(userId, type);
+  }
 };
 
-PacketParser::PacketParser()
+namespace {
+// Finds the top-level "t" without parsing the message, so messages over the
+// rate limit are dropped cheaply. Returns Invalid if "t" is written in any
+// unusual way, the caller parses the message then
+MsgType PeekMsgType(const char* json, size_t length)
+{
+  constexpr int maxDigits = 9;
+  int depth = 0;
+  for (size_t i = 0; i < length; ++i) {
+    if (json[i] == '{' || json[i] == '[') {
+      ++depth;
+    } else if (json[i] == '}' || json[i] == ']') {
+      --depth;
+    } else if (json[i] == '"') {
+      const size_t start = ++i;
+      for (; i < length && json[i] != '"'; ++i) {
+        if (json[i] == '\\')
+          ++i;
+      }
+      if (depth != 1 || i != start + 1 || json[start] != 't')
+        continue;
+
+      size_t j = i + 1;
+      while (j < length && isspace(static_cast<unsigned char>(json[j])))
+        ++j;
+      if (j >= length || json[j] != ':')
+        continue;
+      ++j;
+      while (j < length && isspace(static_cast<unsigned char>(json[j])))
+        ++j;
+
+      int64_t res = 0;
+      int numDigits = 0;
+      for (; j < length && isdigit(static_cast<unsigned char>(json[j])) &&
+           numDigits < maxDigits;
+           ++j, ++numDigits)
+        res = res * 10 + (json[j] - '0');
+      if (numDigits == 0 || numDigits == maxDigits)
+        return MsgType::Invalid;
+      return static_cast<MsgType>(res);
+    }
+  }
+  return MsgType::Invalid;
+}
+
+void TransformBinaryMovementIntoAction(Networking::UserId userId,
+                                       Networking::PacketData data,
+                                       size_t length,
+                                       IActionListener& actionListener)
+{
+  IActionListener::RawMessageData rawMsgData;
+  rawMsgData.unparsed = data;
+  rawMsgData.unparsedLength = length;
+  rawMsgData.userId = userId;
+
+  if (MovementCodec::IsHandshake(data, length)) {
+    auto clientVersion = MovementCodec::ReadHandshake(data, length);
+    return actionListener.OnMovementCodecHandshake(rawMsgData, clientVersion);
+  }
+
+  if (MovementCodec::IsKeyframeRequest(data, length)) {
+    auto idx = MovementCodec::ReadKeyframeRequest(data, length);
+    return actionListener.OnMovementKeyframeRequest(rawMsgData, idx);
+  }
+
+  MovementCodec::Movement m;
+  MovementCodec::Deserialize(data, length, m);
+  actionListener.OnUpdateMovement(
+    rawMsgData, m.idx, { m.pos[0], m.pos[1], m.pos[2] },
+    { m.rot[0], m.rot[1], m.rot[2] }, m.isInJumpState, m.isWeapDrawn,
+    m.worldOrCell);
+}
+}
+
+PacketParser::PacketParser(RateLimiter* rateLimiter,
+                           TrafficStats* trafficStats)
 {
   pImpl.reset(new Impl);
+  pImpl->rateLimiter = rateLimiter;
+  pImpl->trafficStats = trafficStats;
 }
 
 void PacketParser::TransformPacketIntoAction(Networking::UserId userId,
@@ -43,12 +135,41 @@ void PacketParser::TransformPacketIntoAction(Networking::UserId userId,
   if (!length)
     throw std::runtime_error("Zero-length message packets are not allowed");
 
-  auto jMessage = pImpl->parser.parse(data + 1, length - 1).value();
+  auto rateLimiter = pImpl->rateLimiter;
+
+  if (MovementCodec::IsBinary(data, length)) {
+    if (pImpl->trafficStats)
+      pImpl->trafficStats->AddIncoming(userId, MsgType::UpdateMovement,
+                                       length);
+    if (rateLimiter && !MovementCodec::IsHandshake(data, length) &&
+        !rateLimiter->Consume(userId, MsgType::UpdateMovement))
+      return;
+    return TransformBinaryMovementIntoAction(userId, data, length,
+                                             actionListener);
+  }
+
+  const auto peekedType =
+    PeekMsgType(reinterpret_cast<const char*>(data) + 1, length - 1);
+  if (peekedType != MsgType::Invalid &&
+      !pImpl->Admit(userId, peekedType, length))
+    return;
+
+  auto preParsed = Networking::ThreadedServer::FindPreParsed(data, length);
+  auto jMessage = preParsed
+    ? *preParsed
+    : pImpl->parser.parse(data + 1, length - 1).value();
 
   using TypeInt = std::underlying_type<MsgType>::type;
   auto type = MsgType::Invalid;
   Read(jMessage, JsonPointers::t, reinterpret_cast<TypeInt*>(&type));
 
+  if (peekedType == MsgType::Invalid) {
+    if (!pImpl->Admit(userId, type, length))
+      return;
+  } else if (type != peekedType) {
+    throw std::runtime_error("Message type doesn't match the one admitted");
+  }
+
   IActionListener::RawMessageData rawMsgData{ data, length, jMessage, userId };
 
   switch (type) {
@@ -4,10 +4,16 @@
 #include <cstdint>
 #include <memory>
 
+class RateLimiter;
+class TrafficStats;
+
 class PacketParser
 {
 public:
-  PacketParser();
+  // Messages rejected by rateLimiter are dropped without reaching
+  // actionListener. Both are optional
+  explicit PacketParser(RateLimiter* rateLimiter = nullptr,
+                        TrafficStats* trafficStats = nullptr);
   void TransformPacketIntoAction(Networking::UserId userId,
                                  Networking::PacketData packetData,
                                  size_t packetLength,
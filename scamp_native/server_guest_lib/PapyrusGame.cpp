@@ -4,6 +4,7 @@
 #include "EspmGameObject.h"
 #include "MpFormGameObject.h"
 #include "WorldState.h"
+#include <cmath>
 
 VarValue PapyrusGame::IncrementStat(VarValue self,
                                     const std::vector<VarValue>& arguments)
@@ -12,21 +13,58 @@ VarValue PapyrusGame::IncrementStat(VarValue self,
 }
 
 namespace {
-bool ExistsInFormList(const VarValue& formList, uint32_t baseId)
+VarValue FindClosestReference(MpObjectReference& center, float radius,
+                              std::vector<uint32_t> baseIds)
 {
+  // Empty baseIds would match any base
+  if (baseIds.empty() || center.IsDisabled() || radius < 0 ||
+      !std::isfinite(radius))
+    return VarValue::None();
+
+  WorldState::SpatialQuery query;
+  query.cellOrWorld = center.GetCellOrWorld();
+  query.center = center.GetPos();
+  query.radius = radius;
+  query.baseIds = std::move(baseIds);
+
+  auto refs = center.GetParent()->FindNearestRefs(query, 1);
+  if (refs.empty())
+    return VarValue::None();
+  return VarValue(std::make_shared<MpFormGameObject>(refs[0]));
+}
+
+uint32_t GetBaseId(const VarValue& baseObject)
+{
+  auto baseRec = GetRecordPtr(baseObject);
+  return baseRec.rec ? baseRec.ToGlobalId(baseRec.rec->GetId()) : 0;
+}
+
+std::vector<uint32_t> GetBaseIds(const VarValue& formList)
+{
+  std::vector<uint32_t> res;
   int n = static_cast<int>(PapyrusFormList().GetSize(formList, {}));
   for (int i = 0; i < n; ++i) {
     VarValue element = PapyrusFormList().GetAt(formList, { VarValue(i) });
-    auto elementRec = GetRecordPtr(element);
-    if (elementRec.rec &&
-        baseId == elementRec.ToGlobalId(elementRec.rec->GetId())) {
-      return true;
-    }
+    if (auto baseId = GetBaseId(element))
+      res.push_back(baseId);
   }
-  return false;
+  return res;
 }
 }
 
+VarValue PapyrusGame::FindClosestReferenceOfTypeFromRef(
+  VarValue self, const std::vector<VarValue>& arguments)
+{
+  if (arguments.size() >= 3) {
+    auto arCenter = GetFormPtr<MpObjectReference>(arguments[1]);
+    double afRadius = static_cast<double>(arguments[2].CastToFloat());
+    auto baseId = GetBaseId(arguments[0]);
+    if (arCenter && baseId)
+      return FindClosestReference(*arCenter, afRadius, { baseId });
+  }
+  return VarValue::None();
+}
+
 VarValue PapyrusGame::FindClosestReferenceOfAnyTypeInListFromRef(
   VarValue self, const std::vector<VarValue>& arguments)
 {
@@ -34,30 +72,9 @@ VarValue PapyrusGame::FindClosestReferenceOfAnyTypeInListFromRef(
     auto arBaseObjects = arguments[0];
     auto arCenter = GetFormPtr<MpObjectReference>(arguments[1]);
     double afRadius = static_cast<double>(arguments[2].CastToFloat());
-
-    if (arBaseObjects && arCenter && afRadius >= 0) {
-
-      float bestDistance = std::numeric_limits<float>::infinity();
-      MpObjectReference* bestNeighbour = nullptr;
-
-      arCenter->VisitNeighbours([&](MpObjectReference* neighbour) {
-        auto baseId = neighbour->GetBaseId();
-        if (!ExistsInFormList(arBaseObjects, baseId))
-          return;
-
-        float distance = (arCenter->GetPos() - neighbour->GetPos()).Length();
-        if (distance > afRadius)
-          return;
-
-        if (bestDistance > distance) {
-          bestDistance = distance;
-          bestNeighbour = neighbour;
-        }
-      });
-
-      if (bestNeighbour)
-        return VarValue(std::make_shared<MpFormGameObject>(bestNeighbour));
-    }
+    if (arBaseObjects && arCenter)
+      return FindClosestReference(*arCenter, afRadius,
+                                  GetBaseIds(arBaseObjects));
   }
   return VarValue::None();
 }
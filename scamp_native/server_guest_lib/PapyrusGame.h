@@ -13,6 +13,8 @@ public:
 
   VarValue IncrementStat(VarValue self,
                          const std::vector<VarValue>& arguments);
+  VarValue FindClosestReferenceOfTypeFromRef(
+    VarValue self, const std::vector<VarValue>& arguments);
   VarValue FindClosestReferenceOfAnyTypeInListFromRef(
     VarValue self, const std::vector<VarValue>& arguments);
   VarValue GetPlayer(VarValue self, const std::vector<VarValue>& arguments);
@@ -27,6 +29,8 @@ public:
     AddStatic(vm, "DisablePlayerControls",
               &PapyrusGame::DisablePlayerControls);
     AddStatic(vm, "EnablePlayerControls", &PapyrusGame::EnablePlayerControls);
+    AddStatic(vm, "FindClosestReferenceOfTypeFromRef",
+              &PapyrusGame::FindClosestReferenceOfTypeFromRef);
     AddStatic(vm, "FindClosestReferenceOfAnyTypeInListFromRef",
               &PapyrusGame::FindClosestReferenceOfAnyTypeInListFromRef);
     AddStatic(vm, "GetPlayer", &PapyrusGame::GetPlayer);
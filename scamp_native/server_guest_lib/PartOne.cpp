@@ -4,10 +4,14 @@
 #include "FormCallbacks.h"
 #include "IdManager.h"
 #include "JsonUtils.h"
+#include "MovementCodec.h"
 #include "MsgType.h"
+#include "NetworkingBatched.h"
+#include "PacketBuilder.h"
 #include "PacketParser.h"
 #include <array>
 #include <cassert>
+#include <map>
 #include <type_traits>
 #include <vector>
 
@@ -17,7 +21,43 @@ public:
   void Send(Networking::UserId targetUserId, Networking::PacketData data,
             size_t length, bool reliable) override
   {
-    std::string s(reinterpret_cast<const char*>(data + 1), length - 1);
+    Networking::ForEachBatchedPacket(
+      data, length, [&](Networking::PacketData data, size_t length) {
+        AddMessage(targetUserId, data, length, reliable);
+      });
+  }
+
+  std::vector<PartOne::Message> messages;
+
+private:
+  void AddMessage(Networking::UserId targetUserId, Networking::PacketData data,
+                  size_t length, bool reliable)
+  {
+    // Binary movement is stored as its JSON equivalent, handshake replies are
+    // checked via ServerState instead
+    if (MovementCodec::IsHandshake(data, length))
+      return;
+
+    std::string s;
+    if (MovementCodec::IsDelta(data, length)) {
+      auto header = MovementCodec::ReadDeltaHeader(data, length);
+      auto& [baseline, sequence] =
+        movementBaselines[{ targetUserId, header.idx }];
+      if (!header.isKeyframe &&
+          header.sequence != static_cast<uint8_t>(sequence + 1))
+        throw std::runtime_error("Movement delta is out of sequence");
+      sequence = header.sequence;
+      MovementCodec::ApplyDelta(data, length, baseline);
+      MovementCodec::ToJson(MovementCodec::Dequantize(header.idx, baseline),
+                            s);
+    } else if (MovementCodec::IsBinary(data, length)) {
+      MovementCodec::Movement movement;
+      MovementCodec::Deserialize(data, length, movement);
+      MovementCodec::ToJson(movement, s);
+    } else {
+      s.assign(reinterpret_cast<const char*>(data + 1), length - 1);
+    }
+
     PartOne::Message m;
     try {
       m = PartOne::Message{ nlohmann::json::parse(s), targetUserId, reliable };
@@ -29,7 +69,9 @@ public:
     messages.push_back(m);
   }
 
-  std::vector<PartOne::Message> messages;
+  std::map<std::pair<Networking::UserId, uint32_t>,
+           std::pair<MovementCodec::QuantizedMovement, uint8_t>>
+    movementBaselines;
 };
 
 struct PartOne::Impl
@@ -45,17 +87,111 @@ struct PartOne::Impl
   bool enableProductionHacks = false;
 
   std::shared_ptr<PacketParser> packetParser;
-  std::shared_ptr<IActionListener> actionListener;
+  std::shared_ptr<ActionListener> actionListener;
+  UpdateRateLod updateRateLod;
+  MovementReplication movementReplication;
+  RateLimiter rateLimiter;
 
   std::shared_ptr<spdlog::logger> logger;
 
   Networking::ISendTarget* sendTarget = nullptr;
+  Networking::ISendTarget* unbatchedSendTarget = nullptr;
   FakeSendTarget fakeSendTarget;
 
+  size_t batchMtu = 0;
+  std::unique_ptr<Networking::BatchedSendTarget> batchedSendTarget;
+
+  bool trafficStatsEnabled = false;
+  TrafficStats trafficStats;
+  std::unique_ptr<InstrumentedSendTarget> instrumentedSendTarget;
+
   GamemodeApi::State gamemodeApiState;
+  uint32_t gamemodeApiStateRevision = 0;
   std::string updateGamemodeDataMsg;
 };
 
+namespace {
+bool IsPropertyVisible(const GamemodeApi::State& gamemodeApiState,
+                       const char* propName, bool isOwner)
+{
+  auto it = gamemodeApiState.createdProperties.find(propName);
+  if (it == gamemodeApiState.createdProperties.end())
+    return true;
+
+  //  From docs: isVisibleByNeighbors considered to be always false for
+  //  properties with `isVisibleByOwner == false`, in that case, actual
+  //  flag value is ignored.
+  if (!it->second.isVisibleByOwner)
+    return false;
+
+  return it->second.isVisibleByNeighbors || isOwner;
+}
+
+void AppendProperty(std::string& props, const char* propName,
+                    const char* jsonValue)
+{
+  if (props.size() > 0)
+    props += R"(, ")";
+  else
+    props += '"';
+  props += propName;
+  props += R"(": )";
+  props += jsonValue;
+}
+
+std::string VisitVisibleProperties(MpObjectReference& emitter,
+                                   const GamemodeApi::State& gamemodeApiState,
+                                   bool isOwner)
+{
+  std::string props;
+  auto mode =
+    isOwner ? VisitPropertiesMode::All : VisitPropertiesMode::OnlyPublic;
+  emitter.VisitProperties(
+    [&](const char* propName, const char* jsonValue) {
+      if (IsPropertyVisible(gamemodeApiState, propName, isOwner))
+        AppendProperty(props, propName, jsonValue);
+    },
+    mode);
+  return props;
+}
+
+MpObjectReference::SpawnPayload BuildSpawnPayload(
+  MpObjectReference& emitter, const GamemodeApi::State& gamemodeApiState)
+{
+  MpObjectReference::SpawnPayload res;
+
+  auto emitterAsActor = FormCast<MpActor>(&emitter);
+  if (emitterAsActor) {
+    auto jLook = emitterAsActor->GetLookAsJson();
+    if (!jLook.empty()) {
+      res.body += R"(, "look": )";
+      res.body += jLook;
+    }
+    auto jEquipment = emitterAsActor->GetEquipmentAsJson();
+    if (!jEquipment.empty()) {
+      res.body += R"(, "equipment": )";
+      res.body += jEquipment;
+    }
+  }
+
+  long long unsigned int longFormId = emitter.GetFormId();
+  if (emitterAsActor && longFormId < 0xff000000) {
+    longFormId += 0x100000000;
+  }
+  res.body += R"(, "refrId": )";
+  res.body += std::to_string(longFormId);
+
+  if (emitter.GetBaseId() != 0x00000000 &&
+      emitter.GetBaseId() != 0x00000007) {
+    res.body += R"(, "baseId": )";
+    res.body += std::to_string(static_cast<int32_t>(emitter.GetBaseId()));
+  }
+
+  res.publicProps = VisitVisibleProperties(emitter, gamemodeApiState, false);
+  return res;
+}
+}
+
 PartOne::PartOne(Networking::ISendTarget* sendTarget)
 {
   Init();
@@ -72,14 +208,51 @@ PartOne::PartOne(std::shared_ptr<Listener> listener,
 
 PartOne::~PartOne()
 {
-  // worldState may depend on serverState (actorsMap), we should reset it first
+  // worldState may depend on serverState (actors), we should reset it first
   worldState.Clear();
   serverState = {};
 }
 
 void PartOne::SetSendTarget(Networking::ISendTarget* sendTarget)
 {
-  pImpl->sendTarget = sendTarget ? sendTarget : &pImpl->fakeSendTarget;
+  if (pImpl->batchedSendTarget)
+    pImpl->batchedSendTarget->Flush();
+
+  pImpl->unbatchedSendTarget =
+    sendTarget ? sendTarget : &pImpl->fakeSendTarget;
+
+  if (pImpl->batchMtu > 0) {
+    pImpl->batchedSendTarget.reset(new Networking::BatchedSendTarget(
+      *pImpl->unbatchedSendTarget, pImpl->batchMtu));
+    pImpl->sendTarget = pImpl->batchedSendTarget.get();
+  } else {
+    pImpl->batchedSendTarget.reset();
+    pImpl->sendTarget = pImpl->unbatchedSendTarget;
+  }
+
+  // Counts packets before batching so that every message has its own kind
+  if (pImpl->trafficStatsEnabled) {
+    pImpl->instrumentedSendTarget.reset(
+      new InstrumentedSendTarget(*pImpl->sendTarget, pImpl->trafficStats));
+    pImpl->sendTarget = pImpl->instrumentedSendTarget.get();
+  } else {
+    pImpl->instrumentedSendTarget.reset();
+  }
+}
+
+void PartOne::EnableOutgoingBatching(size_t mtu)
+{
+  pImpl->batchMtu = mtu;
+  SetSendTarget(pImpl->unbatchedSendTarget);
+}
+
+void PartOne::EnableTrafficStats(bool enable)
+{
+  pImpl->trafficStatsEnabled = enable;
+  SetSendTarget(pImpl->unbatchedSendTarget);
+
+  // Recreated with the new settings on the next message
+  pImpl->packetParser.reset();
 }
 
 void PartOne::AddListener(std::shared_ptr<Listener> listener)
@@ -95,6 +268,12 @@ bool PartOne::IsConnected(Networking::UserId userId) const
 void PartOne::Tick()
 {
   worldState.TickTimers();
+
+  if (pImpl->actionListener)
+    pImpl->actionListener->FlushUpdateRateLod();
+
+  if (pImpl->batchedSendTarget)
+    pImpl->batchedSendTarget->Flush();
 }
 
 uint32_t PartOne::CreateActor(uint32_t formId, const NiPoint3& pos,
@@ -170,11 +349,11 @@ void PartOne::SetUserActor(Networking::UserId userId, uint32_t actorFormId)
     actor.UnsubscribeFromAll();
     actor.RemoveFromGrid();
 
-    serverState.actorsMap.insert({ userId, &actor });
+    serverState.AttachActor(userId, &actor);
 
     actor.ForceSubscriptionsUpdate();
   } else {
-    serverState.actorsMap.left.erase(userId);
+    serverState.DetachUser(userId);
   }
 }
 
@@ -201,8 +380,9 @@ void PartOne::DestroyActor(uint32_t actorFormId)
 {
   std::shared_ptr<MpActor> destroyedForm;
   worldState.DestroyForm<MpActor>(actorFormId, &destroyedForm);
+  pImpl->updateRateLod.Forget(actorFormId);
 
-  serverState.actorsMap.right.erase(destroyedForm.get());
+  serverState.DetachActor(destroyedForm.get());
 }
 
 void PartOne::SetRaceMenuOpen(uint32_t actorFormId, bool open)
@@ -222,17 +402,20 @@ void PartOne::SetRaceMenuOpen(uint32_t actorFormId, bool open)
     throw std::runtime_error(ss.str());
   }
 
-  Networking::SendFormatted(pImpl->sendTarget, userId,
-                            R"({"type": "setRaceMenuOpen", "open": %s})",
-                            open ? "true" : "false");
+  Networking::PacketBuilder msg;
+  msg.AppendFormatted(R"({"type": "setRaceMenuOpen", "open": %s})",
+                      open ? "true" : "false");
+  msg.Send(*pImpl->sendTarget, userId);
 }
 
 void PartOne::SendCustomPacket(Networking::UserId userId,
                                const std::string& jContent)
 {
-  Networking::SendFormatted(pImpl->sendTarget, userId,
-                            R"({"type": "customPacket", "content":%s})",
-                            jContent.data());
+  Networking::PacketBuilder msg;
+  msg.Append(R"({"type": "customPacket", "content":)");
+  msg.Append(jContent);
+  msg.Append('}');
+  msg.Send(*pImpl->sendTarget, userId);
 }
 
 std::string PartOne::GetActorName(uint32_t actorFormId)
@@ -368,6 +551,12 @@ void PartOne::HandlePacket(void* partOneInstance, Networking::UserId userId,
       this_->serverState.disconnectingUserId = userId;
       for (auto& listener : this_->worldState.listeners)
         listener->OnDisconnect(userId);
+
+      if (this_->pImpl->batchedSendTarget)
+        this_->pImpl->batchedSendTarget->Discard(userId);
+      this_->pImpl->movementReplication.ForgetListener(userId);
+      this_->pImpl->rateLimiter.Forget(userId);
+      this_->pImpl->trafficStats.Forget(userId);
       return;
     }
     case Networking::PacketType::Message:
@@ -385,6 +574,26 @@ Networking::ISendTarget& PartOne::GetSendTarget() const
   return *pImpl->sendTarget;
 }
 
+UpdateRateLod& PartOne::GetUpdateRateLod()
+{
+  return pImpl->updateRateLod;
+}
+
+MovementReplication& PartOne::GetMovementReplication()
+{
+  return pImpl->movementReplication;
+}
+
+RateLimiter& PartOne::GetRateLimiter()
+{
+  return pImpl->rateLimiter;
+}
+
+TrafficStats& PartOne::GetTrafficStats()
+{
+  return pImpl->trafficStats;
+}
+
 void PartOne::NotifyGamemodeApiStateChanged(
   const GamemodeApi::State& newState) noexcept
 {
@@ -412,14 +621,14 @@ void PartOne::NotifyGamemodeApiStateChanged(
   m += j.dump();
   pImpl->updateGamemodeDataMsg = m;
 
-  for (Networking::UserId i = 0; i <= serverState.maxConnectedId; ++i) {
-    if (!serverState.IsConnected(i))
-      continue;
-    GetSendTarget().Send(i, reinterpret_cast<Networking::PacketData>(m.data()),
-                         m.size(), true);
-  }
+  auto& targets = serverState.GetConnectedUsers();
+  if (!targets.empty())
+    GetSendTarget().SendMany(
+      targets, reinterpret_cast<Networking::PacketData>(m.data()), m.size(),
+      true);
 
   pImpl->gamemodeApiState = newState;
+  ++pImpl->gamemodeApiStateRevision;
 }
 
 FormCallbacks PartOne::CreateFormCallbacks()
@@ -476,132 +685,86 @@ void PartOne::Init()
                               MpObjectReference* listener) {
     if (!emitter)
       throw std::runtime_error("nullptr emitter in onSubscribe");
-    auto listenerAsActor = dynamic_cast<MpActor*>(listener);
+    auto listenerAsActor = FormCast<MpActor>(listener);
     if (!listenerAsActor)
       return;
     auto listenerUserId = serverState.UserByActor(listenerAsActor);
     if (listenerUserId == Networking::InvalidUserId)
       return;
 
-    auto& emitterPos = emitter->GetPos();
-    auto& emitterRot = emitter->GetAngle();
-
     bool isMe = emitter == listener;
 
-    auto emitterAsActor = dynamic_cast<MpActor*>(emitter);
-
-    std::string jEquipment, jLook;
-
-    const char *lookPrefix = "", *look = "";
-    if (emitterAsActor) {
-      jLook = emitterAsActor->GetLookAsJson();
-      if (!jLook.empty()) {
-        lookPrefix = R"(, "look": )";
-        look = jLook.data();
-      }
-    }
-
-    const char *equipmentPrefix = "", *equipment = "";
-    if (emitterAsActor) {
-      jEquipment = emitterAsActor->GetEquipmentAsJson();
-      if (!jEquipment.empty()) {
-        equipmentPrefix = R"(, "equipment": )";
-        equipment = jEquipment.data();
-      }
-    }
-
-    const char* refrIdPrefix = "";
-    char refrId[32] = { 0 };
-    refrIdPrefix = R"(, "refrId": )";
-
-    long long unsigned int longFormId = emitter->GetFormId();
-    if (emitterAsActor && longFormId < 0xff000000) {
-      longFormId += 0x100000000;
-    }
-    sprintf(refrId, "%llu", longFormId);
-
-    const char* baseIdPrefix = "";
-    char baseId[32] = { 0 };
-    if (emitter->GetBaseId() != 0x00000000 &&
-        emitter->GetBaseId() != 0x00000007) {
-      baseIdPrefix = R"(, "baseId": )";
-      sprintf(baseId, "%d", emitter->GetBaseId());
+    auto payload = emitter->GetSpawnPayload();
+    if (!payload ||
+        payload->gamemodeApiStateRevision !=
+          pImpl->gamemodeApiStateRevision) {
+      auto newPayload = BuildSpawnPayload(*emitter, pImpl->gamemodeApiState);
+      newPayload.gamemodeApiStateRevision = pImpl->gamemodeApiStateRevision;
+      payload = &emitter->SetSpawnPayload(std::move(newPayload));
     }
 
-    const bool isOwner = emitter == listener;
-
-    std::string props;
-
-    auto mode = VisitPropertiesMode::OnlyPublic;
-    if (isOwner)
-      mode = VisitPropertiesMode::All;
-
-    const char *propsPrefix = "", *propsPostfix = "";
-    auto visitor = [&](const char* propName, const char* jsonValue) {
-      auto it = pImpl->gamemodeApiState.createdProperties.find(propName);
-      if (it != pImpl->gamemodeApiState.createdProperties.end()) {
-        if (!it->second.isVisibleByOwner) {
-          //  From docs: isVisibleByNeighbors considered to be always false for
-          //  properties with `isVisibleByOwner == false`, in that case, actual
-          //  flag value is ignored.
-          return;
-        }
-
-        if (!it->second.isVisibleByNeighbors && !isOwner) {
-          return;
-        }
-      }
-
-      propsPrefix = R"(, "props": { )";
-      propsPostfix = R"( })";
-
-      if (props.size() > 0)
-        props += R"(, ")";
-      else
-        props += '"';
-      props += propName;
-      props += R"(": )";
-      props += jsonValue;
-    };
-    emitter->VisitProperties(visitor, mode);
+    // Owner-only properties are visible to the owner alone, so they aren't
+    // cached
+    std::string ownerProps;
+    if (isMe)
+      ownerProps =
+        VisitVisibleProperties(*emitter, pImpl->gamemodeApiState, true);
+    const std::string& visibleProps = isMe ? ownerProps : payload->publicProps;
 
+    auto emitterAsActor = FormCast<MpActor>(emitter);
     const bool hasUser = emitterAsActor &&
       serverState.UserByActor(emitterAsActor) != Networking::InvalidUserId;
     auto hosterIterator = worldState.hosters.find(emitter->GetFormId());
 
-    if (hasUser ||
-        (hosterIterator != worldState.hosters.end() &&
-         hosterIterator->second != 0 &&
-         hosterIterator->second != listener->GetFormId())) {
-      visitor("isHostedByOther", "true");
-    }
+    const bool isHostedByOther = hasUser ||
+      (hosterIterator != worldState.hosters.end() &&
+       hosterIterator->second != 0 &&
+       hosterIterator->second != listener->GetFormId());
 
-    const char* method = "createActor";
-
-    Networking::SendFormatted(
-      sendTarget, listenerUserId,
-      R"({"type": "%s", "idx": %u, "isMe": %s, "transform": {"pos":
-    [%f,%f,%f], "rot": [%f,%f,%f], "worldOrCell": %u}%s%s%s%s%s%s%s%s%s%s%s})",
-      method, emitter->GetIdx(), isMe ? "true" : "false", emitterPos.x,
-      emitterPos.y, emitterPos.z, emitterRot.x, emitterRot.y, emitterRot.z,
-      emitter->GetCellOrWorld(), lookPrefix, look, equipmentPrefix, equipment,
-      refrIdPrefix, refrId, baseIdPrefix, baseId, propsPrefix, props.data(),
-      propsPostfix);
+    Networking::PacketBuilder msg;
+    auto& emitterPos = emitter->GetPos();
+    auto& emitterRot = emitter->GetAngle();
+    msg.AppendFormatted(R"({"type": "createActor", "idx": %u, "isMe": %s, )",
+                        emitter->GetIdx(), isMe ? "true" : "false");
+    msg.AppendFormatted(
+      R"("transform": {"pos": [%f,%f,%f], "rot": [%f,%f,%f], )"
+      R"("worldOrCell": %u})",
+      emitterPos.x, emitterPos.y, emitterPos.z, emitterRot.x, emitterRot.y,
+      emitterRot.z, emitter->GetCellOrWorld());
+    msg.Append(payload->body);
+
+    if (!visibleProps.empty() || isHostedByOther) {
+      msg.Append(R"(, "props": { )");
+      msg.Append(visibleProps);
+      if (isHostedByOther) {
+        msg.Append(visibleProps.empty() ? R"(")" : R"(, ")");
+        msg.Append(R"(isHostedByOther": true)");
+      }
+      msg.Append(R"( })");
+    }
+    msg.Append('}');
+    msg.Send(*sendTarget, listenerUserId);
   };
 
   pImpl->onUnsubscribe = [this](Networking::ISendTarget* sendTarget,
                                 MpObjectReference* emitter,
                                 MpObjectReference* listener) {
-    auto listenerAsActor = dynamic_cast<MpActor*>(listener);
+    auto listenerAsActor = FormCast<MpActor>(listener);
     if (!listenerAsActor)
       return;
 
     auto listenerUserId = serverState.UserByActor(listenerAsActor);
-    if (listenerUserId != Networking::InvalidUserId &&
-        listenerUserId != serverState.disconnectingUserId)
-      Networking::SendFormatted(sendTarget, listenerUserId,
-                                R"({"type": "destroyActor", "idx": %u})",
-                                emitter->GetIdx());
+    if (listenerUserId == Networking::InvalidUserId)
+      return;
+
+    pImpl->movementReplication.Forget(listenerUserId, emitter->GetIdx());
+
+    if (listenerUserId != serverState.disconnectingUserId) {
+      Networking::PacketBuilder msg;
+      msg.AppendFormatted(R"({"type": "destroyActor", "idx": %u})",
+                          emitter->GetIdx());
+      msg.Send(*sendTarget, listenerUserId);
+    }
   };
 }
 
@@ -626,7 +789,9 @@ void PartOne::HandleMessagePacket(Networking::UserId userId,
     throw std::runtime_error("User with id " + std::to_string(userId) +
                              " doesn't exist");
   if (!pImpl->packetParser)
-    pImpl->packetParser.reset(new PacketParser);
+    pImpl->packetParser.reset(new PacketParser(
+      &pImpl->rateLimiter,
+      pImpl->trafficStatsEnabled ? &pImpl->trafficStats : nullptr));
 
   InitActionListener();
 
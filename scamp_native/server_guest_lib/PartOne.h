@@ -1,11 +1,15 @@
 #pragma once
 #include "GamemodeApi.h"
 #include "ISaveStorage.h"
+#include "MovementReplication.h"
 #include "MpActor.h"
 #include "Networking.h"
 #include "NiPoint3.h"
 #include "PartOneListener.h"
+#include "RateLimiter.h"
 #include "ServerState.h"
+#include "TrafficStats.h"
+#include "UpdateRateLod.h"
 #include "WorldState.h"
 #include <Loader.h>
 #include <memory>
@@ -41,6 +45,13 @@ public:
   bool IsConnected(Networking::UserId userId) const;
   void Tick();
   void EnableProductionHacks();
+
+  // Buffers outgoing packets until the end of Tick and sends them as batch
+  // frames of at most mtu bytes. Zero disables batching
+  void EnableOutgoingBatching(size_t mtu);
+
+  // Counts incoming and outgoing traffic in GetTrafficStats()
+  void EnableTrafficStats(bool enable);
   FormCallbacks CreateFormCallbacks();
   IActionListener& GetActionListener();
   const std::vector<std::shared_ptr<Listener>>& GetListeners() const;
@@ -77,6 +88,10 @@ public:
   ServerState serverState;
 
   Networking::ISendTarget& GetSendTarget() const;
+  UpdateRateLod& GetUpdateRateLod();
+  MovementReplication& GetMovementReplication();
+  RateLimiter& GetRateLimiter();
+  TrafficStats& GetTrafficStats();
 
   void NotifyGamemodeApiStateChanged(
     const GamemodeApi::State& newState) noexcept;
@@ -1,7 +1,91 @@
 #include "Primitive.h"
 #include "GeoPolygon.h"
 #include "GeoPolygonProc.h"
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define PRIMITIVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+static_assert(sizeof(NiPoint3) == sizeof(float) * 3);
+static_assert(sizeof(Primitive::OrientedBox) == sizeof(float) * 8);
+
+namespace {
+#ifdef PRIMITIVE_SSE2
+// Members of OrientedBox, one box per lane
+struct BoxLanes
+{
+  __m128 centerX, centerY, centerZ, halfX, halfY, halfZ, sinZ, cosZ;
+};
+
+BoxLanes BroadcastBox(const Primitive::OrientedBox& box)
+{
+  return { _mm_set1_ps(box.center.x),      _mm_set1_ps(box.center.y),
+           _mm_set1_ps(box.center.z),      _mm_set1_ps(box.halfExtents.x),
+           _mm_set1_ps(box.halfExtents.y), _mm_set1_ps(box.halfExtents.z),
+           _mm_set1_ps(box.sinZ),          _mm_set1_ps(box.cosZ) };
+}
+
+BoxLanes LoadBoxes(const Primitive::OrientedBox* boxes)
+{
+  auto f = reinterpret_cast<const float*>(boxes);
+  BoxLanes res{ _mm_loadu_ps(f),      _mm_loadu_ps(f + 8),
+                _mm_loadu_ps(f + 16), _mm_loadu_ps(f + 24),
+                _mm_loadu_ps(f + 4),  _mm_loadu_ps(f + 12),
+                _mm_loadu_ps(f + 20), _mm_loadu_ps(f + 28) };
+  _MM_TRANSPOSE4_PS(res.centerX, res.centerY, res.centerZ, res.halfX);
+  _MM_TRANSPOSE4_PS(res.halfY, res.halfZ, res.sinZ, res.cosZ);
+  return res;
+}
+
+// Loads 4 points deinterleaving x, y and z
+void LoadPoints(const NiPoint3* points, __m128& x, __m128& y, __m128& z)
+{
+  auto f = reinterpret_cast<const float*>(points);
+  auto a = _mm_loadu_ps(f);     // x0 y0 z0 x1
+  auto b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+  auto c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+  x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)),
+                     _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+                     _MM_SHUFFLE(2, 0, 2, 0));
+  y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                     _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                     _MM_SHUFFLE(2, 0, 2, 0));
+  z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                     _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                     _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// Same math as the scalar IsInside. Bit i is set if lane i is inside
+int IsInsideMask(const BoxLanes& box, __m128 x, __m128 y, __m128 z)
+{
+  const auto signMask = _mm_set1_ps(-0.f);
+  auto dx = _mm_sub_ps(x, box.centerX);
+  auto dy = _mm_sub_ps(y, box.centerY);
+  auto dz = _mm_sub_ps(z, box.centerZ);
+  auto localX =
+    _mm_add_ps(_mm_mul_ps(dx, box.cosZ), _mm_mul_ps(dy, box.sinZ));
+  auto localY =
+    _mm_sub_ps(_mm_mul_ps(dy, box.cosZ), _mm_mul_ps(dx, box.sinZ));
+  auto inside =
+    _mm_and_ps(_mm_cmple_ps(_mm_andnot_ps(signMask, localX), box.halfX),
+               _mm_cmple_ps(_mm_andnot_ps(signMask, localY), box.halfY));
+  inside = _mm_and_ps(
+    inside, _mm_cmple_ps(_mm_andnot_ps(signMask, dz), box.halfZ));
+  return _mm_movemask_ps(inside);
+}
+#endif
+
+void StoreMask(int mask, int numLanes, uint8_t* res)
+{
+  for (int i = 0; i < numLanes; ++i)
+    res[i] = (mask >> i) & 1;
+}
+}
 
 std::vector<NiPoint3> Primitive::GetVertices(NiPoint3 pos, NiPoint3 rotRad,
                                              NiPoint3 boundsDiv2)
@@ -51,4 +135,74 @@ bool Primitive::IsInside(const NiPoint3& point,
 {
   return const_cast<GeoProc::GeoPolygonProc&>(procObj).PointInside3DPolygon(
     point.x, point.y, point.z);
+}
+
+Primitive::BoundingBox Primitive::GetBoundingBox(
+  const std::vector<NiPoint3>& vertices)
+{
+  if (vertices.empty())
+    throw std::runtime_error("Primitive has no vertices");
+
+  BoundingBox res{ vertices[0], vertices[0] };
+  for (auto& v : vertices) {
+    for (int i = 0; i < 3; ++i) {
+      res.min[i] = std::min(res.min[i], v[i]);
+      res.max[i] = std::max(res.max[i], v[i]);
+    }
+  }
+  return res;
+}
+
+Primitive::OrientedBox Primitive::CreateOrientedBox(NiPoint3 pos,
+                                                    NiPoint3 rotRad,
+                                                    NiPoint3 boundsDiv2)
+{
+  // GetVertices puts boundsDiv2[1] along the Z-angle direction
+  OrientedBox res;
+  res.center = pos;
+  res.halfExtents = { boundsDiv2[1], boundsDiv2[0], boundsDiv2[2] };
+  res.sinZ = std::sin(rotRad.z);
+  res.cosZ = std::cos(rotRad.z);
+  return res;
+}
+
+bool Primitive::IsInside(const NiPoint3& point, const OrientedBox& box)
+{
+  auto d = point - box.center;
+  auto localX = d.x * box.cosZ + d.y * box.sinZ;
+  auto localY = d.y * box.cosZ - d.x * box.sinZ;
+  return std::abs(localX) <= box.halfExtents.x &&
+    std::abs(localY) <= box.halfExtents.y &&
+    std::abs(d.z) <= box.halfExtents.z;
+}
+
+void Primitive::IsInside(const NiPoint3* positions, size_t count,
+                         const OrientedBox& box, uint8_t* res)
+{
+  size_t i = 0;
+#ifdef PRIMITIVE_SSE2
+  auto lanes = BroadcastBox(box);
+  for (; i + 4 <= count; i += 4) {
+    __m128 x, y, z;
+    LoadPoints(positions + i, x, y, z);
+    StoreMask(IsInsideMask(lanes, x, y, z), 4, res + i);
+  }
+#endif
+  for (; i < count; ++i)
+    res[i] = IsInside(positions[i], box);
+}
+
+void Primitive::IsInside(const NiPoint3& point, const OrientedBox* boxes,
+                         size_t count, uint8_t* res)
+{
+  size_t i = 0;
+#ifdef PRIMITIVE_SSE2
+  auto x = _mm_set1_ps(point.x);
+  auto y = _mm_set1_ps(point.y);
+  auto z = _mm_set1_ps(point.z);
+  for (; i + 4 <= count; i += 4)
+    StoreMask(IsInsideMask(LoadBoxes(boxes + i), x, y, z), 4, res + i);
+#endif
+  for (; i < count; ++i)
+    res[i] = IsInside(point, boxes[i]);
 }
\ No newline at end of file
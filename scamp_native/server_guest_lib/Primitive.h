@@ -2,12 +2,30 @@
 #include "GeoPolygonProc.h"
 #include "NiPoint3.h"
 #include "espm.h"
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 // Supports only Z-angle. Ignores X-angle and Y-angle
 class Primitive
 {
 public:
+  // Axis-aligned box around the vertices
+  struct BoundingBox
+  {
+    NiPoint3 min, max;
+  };
+
+  // The box GetVertices describes. halfExtents are in box space where the
+  // X axis is (cosZ, sinZ). Batch kernels rely on the 8 floats layout
+  struct OrientedBox
+  {
+    NiPoint3 center;
+    NiPoint3 halfExtents;
+    float sinZ = 0.f;
+    float cosZ = 1.f;
+  };
+
   static std::vector<NiPoint3> GetVertices(NiPoint3 pos, NiPoint3 rotRad,
                                            NiPoint3 boundsDiv2);
   static std::vector<NiPoint3> GetVertices(const espm::REFR* refr);
@@ -15,4 +33,17 @@ public:
     const std::vector<NiPoint3>& vertices);
   static bool IsInside(const NiPoint3& point,
                        const GeoProc::GeoPolygonProc& geoPolygonProc);
+  static BoundingBox GetBoundingBox(const std::vector<NiPoint3>& vertices);
+
+  static OrientedBox CreateOrientedBox(NiPoint3 pos, NiPoint3 rotRad,
+                                       NiPoint3 boundsDiv2);
+  static bool IsInside(const NiPoint3& point, const OrientedBox& box);
+
+  // Sets res[i] to 1 if positions[i] is inside the box, to 0 otherwise
+  static void IsInside(const NiPoint3* positions, size_t count,
+                       const OrientedBox& box, uint8_t* res);
+
+  // Sets res[i] to 1 if the point is inside boxes[i], to 0 otherwise
+  static void IsInside(const NiPoint3& point, const OrientedBox* boxes,
+                       size_t count, uint8_t* res);
 };
\ No newline at end of file
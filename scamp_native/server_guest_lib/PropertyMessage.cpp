@@ -0,0 +1,32 @@
+#include "PropertyMessage.h"
+#include "MsgType.h"
+#include <string>
+
+namespace {
+// json::dump creates a serializer and a string on every call, this one is
+// created once per thread
+struct ValueWriter
+{
+  std::string buf;
+  nlohmann::detail::serializer<nlohmann::json> serializer{
+    nlohmann::detail::output_adapter<char>(buf), ' '
+  };
+};
+
+thread_local ValueWriter g_valueWriter;
+}
+
+void WritePropertyMessage(Networking::PacketBuilder& msg, uint32_t idx,
+                          const char* name, const nlohmann::json& value)
+{
+  auto& writer = g_valueWriter;
+  writer.buf.clear();
+  writer.serializer.dump(value, false, false, 0);
+
+  msg.AppendFormatted(R"({"idx":%u,"t":%d,"propName":)", idx,
+                      static_cast<int>(MsgType::UpdateProperty));
+  msg.AppendJsonString(name);
+  msg.Append(R"(,"data":)");
+  msg.Append(writer.buf);
+  msg.Append('}');
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+#include "PacketBuilder.h"
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// Appends UpdateProperty message to msg. Once warmed up on the calling
+// thread, serializing value doesn't allocate
+void WritePropertyMessage(Networking::PacketBuilder& msg, uint32_t idx,
+                          const char* name, const nlohmann::json& value);
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "RateLimiter.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void RateLimiter::SetLimit(MsgType type, Limit limit)
+{
+  if (limit.ratePerSecond < 0 || limit.burst < 0)
+    throw std::runtime_error("Rate limit must not be negative");
+
+  auto& dst = limits[GetTypeIndex(type)];
+  numLimits -= dst.ratePerSecond > 0;
+  dst = limit;
+  if (dst.ratePerSecond > 0) {
+    // At least one message must pass or the type is simply banned
+    dst.burst = std::max(dst.burst, 1.f);
+    ++numLimits;
+  }
+}
+
+bool RateLimiter::IsEnabled() const
+{
+  return numLimits > 0;
+}
+
+bool RateLimiter::Consume(Networking::UserId userId, MsgType type,
+                          Clock::time_point now)
+{
+  if (numLimits == 0)
+    return true;
+
+  // Unknown types are rejected by PacketParser anyway
+  const auto typeIndex = static_cast<size_t>(type);
+  if (typeIndex >= numTypes)
+    return true;
+
+  const auto& limit = limits[typeIndex];
+  if (limit.ratePerSecond <= 0)
+    return true;
+
+  if (buckets.size() <= userId) {
+    buckets.resize(static_cast<size_t>(userId) + 1);
+    isInitialized.resize(buckets.size(), false);
+  }
+
+  if (!isInitialized[userId]) {
+    for (auto& b : buckets[userId])
+      b = { 0, Clock::time_point() };
+    isInitialized[userId] = true;
+  }
+
+  auto& bucket = buckets[userId][typeIndex];
+  if (bucket.lastRefill == Clock::time_point()) {
+    bucket.tokens = limit.burst;
+  } else {
+    std::chrono::duration<float> elapsed = now - bucket.lastRefill;
+    bucket.tokens = std::min(
+      limit.burst, bucket.tokens + elapsed.count() * limit.ratePerSecond);
+  }
+  bucket.lastRefill = now;
+
+  if (bucket.tokens < 1) {
+    ++numDropped[typeIndex];
+    return false;
+  }
+  bucket.tokens -= 1;
+  return true;
+}
+
+void RateLimiter::Forget(Networking::UserId userId)
+{
+  if (isInitialized.size() > userId)
+    isInitialized[userId] = false;
+}
+
+uint64_t RateLimiter::GetNumDropped(MsgType type) const
+{
+  return numDropped[GetTypeIndex(type)];
+}
+
+size_t RateLimiter::GetTypeIndex(MsgType type)
+{
+  auto i = static_cast<int64_t>(type);
+  if (i < 0 || i >= static_cast<int64_t>(numTypes))
+    throw std::runtime_error("Unknown MsgType: " + std::to_string(i));
+  return static_cast<size_t>(i);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include "MsgType.h"
+#include "NetworkingInterface.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Token buckets per user and per MsgType. A bucket holds up to burst tokens
+// and refills at ratePerSecond, every incoming message of a limited type
+// takes one token. Messages arriving at an empty bucket are dropped
+class RateLimiter
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Limit
+  {
+    float ratePerSecond = 0;
+    float burst = 0;
+  };
+
+  // Zero ratePerSecond removes the limit
+  void SetLimit(MsgType type, Limit limit);
+
+  bool IsEnabled() const;
+
+  // Returns false if the message must be dropped
+  bool Consume(Networking::UserId userId, MsgType type,
+               Clock::time_point now = Clock::now());
+
+  void Forget(Networking::UserId userId);
+
+  uint64_t GetNumDropped(MsgType type) const;
+
+private:
+  static constexpr size_t numTypes =
+    static_cast<size_t>(MsgType::CustomEvent) + 1;
+
+  struct Bucket
+  {
+    float tokens = 0;
+    Clock::time_point lastRefill;
+  };
+
+  static size_t GetTypeIndex(MsgType type);
+
+  std::array<Limit, numTypes> limits;
+  std::array<uint64_t, numTypes> numDropped = {};
+  size_t numLimits = 0;
+
+  // buckets[userId][typeIndex]
+  std::vector<std::array<Bucket, numTypes>> buckets;
+  std::vector<bool> isInitialized;
+};
\ No newline at end of file
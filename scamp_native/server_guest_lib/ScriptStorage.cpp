@@ -71,3 +71,31 @@ const std::set<CIString>& DirectoryScriptStorage::ListScripts(
   }
   return scripts;
 }
+
+SharedScriptStorage::SharedScriptStorage(
+  std::shared_ptr<IScriptStorage> storage_)
+  : storage(storage_)
+{
+  latest =
+    std::make_shared<const std::set<CIString>>(storage->ListScripts(false));
+}
+
+std::vector<uint8_t> SharedScriptStorage::GetScriptPex(const char* scriptName)
+{
+  std::lock_guard l(m);
+  return storage->GetScriptPex(scriptName);
+}
+
+const std::set<CIString>& SharedScriptStorage::ListScripts(
+  bool forceReloadScripts)
+{
+  std::lock_guard l(m);
+  if (forceReloadScripts) {
+    auto& scripts = storage->ListScripts(true);
+    if (scripts != *latest)
+      latest = std::make_shared<const std::set<CIString>>(scripts);
+  }
+  auto& res = pinned[std::this_thread::get_id()];
+  res = latest;
+  return *res;
+}
\ No newline at end of file
@@ -2,8 +2,12 @@
 #include "CIString.h"
 #include <cstdint>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <set>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 class IScriptStorage
@@ -28,4 +32,28 @@ public:
 private:
   const std::string pexDir;
   std::set<CIString> scripts;
+};
+
+// Makes a script storage usable by several WorldStates on different threads.
+// A script list returned by ListScripts stays valid until the same thread
+// calls ListScripts again, reloads by other threads don't affect it
+class SharedScriptStorage : public IScriptStorage
+{
+public:
+  SharedScriptStorage(std::shared_ptr<IScriptStorage> storage);
+
+  std::vector<uint8_t> GetScriptPex(const char* scriptName) override;
+
+  const std::set<CIString>& ListScripts(bool forceReloadScripts) override;
+
+private:
+  const std::shared_ptr<IScriptStorage> storage;
+  std::mutex m;
+  std::shared_ptr<const std::set<CIString>> latest;
+
+  // The list each thread got last. Older lists are freed once no thread
+  // holds them
+  std::unordered_map<std::thread::id,
+                     std::shared_ptr<const std::set<CIString>>>
+    pinned;
 };
\ No newline at end of file
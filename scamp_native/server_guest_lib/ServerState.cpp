@@ -7,51 +7,120 @@
 
 void ServerState::Connect(Networking::UserId userId)
 {
-  userInfo[userId].reset(new UserInfo);
+  Grow(userId);
+  if (connectedIndex[userId] == notConnected) {
+    connectedIndex[userId] = static_cast<uint32_t>(connectedUsers.size());
+    connectedUsers.push_back(userId);
+  }
+  movementCodecVersion[userId] = 0;
   if (maxConnectedId < userId)
     maxConnectedId = userId;
 }
 
 void ServerState::Disconnect(Networking::UserId userId) noexcept
 {
-  userInfo[userId].reset();
+  if (!IsConnected(userId))
+    return;
+
+  DetachUser(userId);
+  movementCodecVersion[userId] = 0;
+
+  // Swap with the last one to keep the list packed
+  auto i = connectedIndex[userId];
+  auto last = connectedUsers.back();
+  connectedUsers[i] = last;
+  connectedIndex[last] = i;
+  connectedUsers.pop_back();
+  connectedIndex[userId] = notConnected;
+
   if (maxConnectedId == userId) {
-    auto it =
-      std::find_if(userInfo.rbegin(), userInfo.rend(),
-                   [](const std::unique_ptr<UserInfo>& v) { return !!v; });
-    if (it != userInfo.rend())
-      maxConnectedId = &*it - &userInfo[0];
-    else
-      maxConnectedId = 0;
+    auto it = std::max_element(connectedUsers.begin(), connectedUsers.end());
+    maxConnectedId = it != connectedUsers.end() ? *it : 0;
   }
-
-  actorsMap.left.erase(userId);
 }
 
 bool ServerState::IsConnected(Networking::UserId userId) const
 {
-  return userId < std::size(userInfo) && userInfo[userId];
+  return userId < connectedIndex.size() &&
+    connectedIndex[userId] != notConnected;
+}
+
+void ServerState::EnsureUserExists(Networking::UserId userId)
+{
+  if (!IsConnected(userId))
+    throw std::runtime_error("User with id " + std::to_string(userId) +
+                             " doesn't exist");
+}
+
+const std::vector<Networking::UserId>& ServerState::GetConnectedUsers() const
+{
+  return connectedUsers;
 }
 
 MpActor* ServerState::ActorByUser(Networking::UserId userId)
 {
-  auto it = actorsMap.left.find(userId);
-  if (it == actorsMap.left.end())
-    return nullptr;
-  return it->second;
+  return userId < actorByUser.size() ? actorByUser[userId] : nullptr;
 }
 
 Networking::UserId ServerState::UserByActor(MpActor* actor)
 {
-  auto it = actorsMap.right.find(actor);
-  if (it == actorsMap.right.end())
+  auto it = userByActor.find(actor);
+  if (it == userByActor.end())
     return Networking::InvalidUserId;
   return it->second;
 }
 
-void ServerState::EnsureUserExists(Networking::UserId userId)
+bool ServerState::AttachActor(Networking::UserId userId, MpActor* actor)
 {
-  if (userInfo.size() <= userId || !userInfo[userId])
-    throw std::runtime_error("User with id " + std::to_string(userId) +
-                             " doesn't exist");
+  Grow(userId);
+  if (actorByUser[userId] || userByActor.count(actor))
+    return false;
+  actorByUser[userId] = actor;
+  userByActor[actor] = userId;
+  return true;
+}
+
+void ServerState::DetachUser(Networking::UserId userId)
+{
+  if (auto actor = ActorByUser(userId)) {
+    userByActor.erase(actor);
+    actorByUser[userId] = nullptr;
+  }
+}
+
+void ServerState::DetachActor(MpActor* actor)
+{
+  auto it = userByActor.find(actor);
+  if (it != userByActor.end()) {
+    actorByUser[it->second] = nullptr;
+    userByActor.erase(it);
+  }
+}
+
+uint8_t ServerState::GetMovementCodecVersion(Networking::UserId userId) const
+{
+  return userId < movementCodecVersion.size() ? movementCodecVersion[userId]
+                                              : 0;
+}
+
+void ServerState::SetMovementCodecVersion(Networking::UserId userId,
+                                          uint8_t version)
+{
+  EnsureUserExists(userId);
+  movementCodecVersion[userId] = version;
+}
+
+void ServerState::Grow(Networking::UserId userId)
+{
+  if (userId == Networking::InvalidUserId)
+    throw std::runtime_error("Invalid user id");
+  if (connectedIndex.size() > userId)
+    return;
+
+  size_t n = std::max<size_t>(static_cast<size_t>(userId) + 1,
+                              connectedIndex.size() * 2);
+  n = std::min<size_t>(n, Networking::InvalidUserId);
+  connectedIndex.resize(n, notConnected);
+  actorByUser.resize(n, nullptr);
+  movementCodecVersion.resize(n, 0);
 }
\ No newline at end of file
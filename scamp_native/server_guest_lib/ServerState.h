@@ -1,35 +1,53 @@
 #pragma once
-#include "Config.h"
 #include <Networking.h>
-#include <array>
-#include <boost/bimap.hpp>
+#include <cstdint>
 #include <memory>
 #include <simdjson.h>
 #include <unordered_map>
+#include <vector>
 
 class MpActor;
 
-struct UserInfo
-{
-  bool isDisconnecting = false;
-};
-
-using ActorsMap = boost::bimaps::bimap<Networking::UserId, MpActor*>;
-
+// Per-user state lives in dense arrays indexed by UserId that grow with the
+// highest connected id. Connected users are also kept in a packed list, so
+// iterating them doesn't depend on the number of slots
 class ServerState
 {
 public:
-  ServerState() { userInfo.resize(g_maxPlayers); }
-
-  std::vector<std::unique_ptr<UserInfo>> userInfo;
   Networking::UserId maxConnectedId = 0;
-  ActorsMap actorsMap;
   Networking::UserId disconnectingUserId = Networking::InvalidUserId;
 
   void Connect(Networking::UserId userId);
   void Disconnect(Networking::UserId userId) noexcept;
   bool IsConnected(Networking::UserId userId) const;
+  void EnsureUserExists(Networking::UserId userId);
+
+  // Unordered
+  const std::vector<Networking::UserId>& GetConnectedUsers() const;
+
   MpActor* ActorByUser(Networking::UserId userId);
   Networking::UserId UserByActor(MpActor* actor);
-  void EnsureUserExists(Networking::UserId userId);
+
+  // Does nothing and returns false if the user already has an actor or the
+  // actor already has a user
+  bool AttachActor(Networking::UserId userId, MpActor* actor);
+  void DetachUser(Networking::UserId userId);
+  void DetachActor(MpActor* actor);
+
+  // MovementCodec version negotiated with the client, NoVersion means JSON
+  uint8_t GetMovementCodecVersion(Networking::UserId userId) const;
+  void SetMovementCodecVersion(Networking::UserId userId, uint8_t version);
+
+private:
+  static constexpr uint32_t notConnected = ~0u;
+
+  void Grow(Networking::UserId userId);
+
+  // Position in connectedUsers, notConnected for free slots
+  std::vector<uint32_t> connectedIndex;
+  std::vector<MpActor*> actorByUser;
+  std::vector<uint8_t> movementCodecVersion;
+
+  std::vector<Networking::UserId> connectedUsers;
+  std::unordered_map<MpActor*, Networking::UserId> userByActor;
 };
\ No newline at end of file
@@ -0,0 +1,585 @@
+#include "ShardHost.h"
+#include "FormCallbacks.h"
+#include "MpActor.h"
+#include "PartOne.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+constexpr ShardHost::ShardId g_noShard = ~ShardHost::ShardId(0);
+
+struct Task
+{
+  Networking::UserId userId = Networking::InvalidUserId;
+  Networking::PacketType type = Networking::PacketType::Invalid;
+  std::vector<uint8_t> data;
+
+  // Connection of the user the task belongs to
+  uint32_t generation = 0;
+
+  // Called instead of PartOne::HandlePacket if set
+  std::function<void(PartOne&)> fn;
+};
+
+struct Outgoing
+{
+  std::vector<Networking::UserId> targets;
+
+  // Connection of each target the shard meant, see QueuedSendTarget
+  std::vector<uint32_t> generations;
+
+  std::vector<uint8_t> data;
+  bool reliable = false;
+};
+
+// Shards send from their threads, packets reach the server in Tick. User ids
+// are reused, so every target is tagged with the connection the shard has
+// last seen for it
+class QueuedSendTarget : public Networking::ISendTarget
+{
+public:
+  void Send(Networking::UserId targetUserId, Networking::PacketData data,
+            size_t length, bool reliable) override
+  {
+    std::lock_guard l(m);
+    queue.push_back({ { targetUserId },
+                      { GetGeneration(targetUserId) },
+                      { data, data + length },
+                      reliable });
+  }
+
+  void SendMany(const std::vector<Networking::UserId>& targetUserIds,
+                Networking::PacketData data, size_t length,
+                bool reliable) override
+  {
+    std::lock_guard l(m);
+    auto& entry = queue.emplace_back();
+    entry.targets = targetUserIds;
+    for (auto userId : targetUserIds)
+      entry.generations.push_back(GetGeneration(userId));
+    entry.data.assign(data, data + length);
+    entry.reliable = reliable;
+  }
+
+  // Called on the shard's thread before the shard sees the user connect
+  void SetGeneration(Networking::UserId userId, uint32_t generation)
+  {
+    if (generations.size() <= userId)
+      generations.resize(static_cast<size_t>(userId) + 1, 0);
+    generations[userId] = generation;
+  }
+
+  void Take(std::vector<Outgoing>& out)
+  {
+    out.clear();
+    std::lock_guard l(m);
+    queue.swap(out);
+  }
+
+private:
+  uint32_t GetGeneration(Networking::UserId userId) const
+  {
+    return generations.size() > userId ? generations[userId] : 0;
+  }
+
+  std::mutex m;
+  std::vector<Outgoing> queue;
+
+  // Used by the shard's thread only
+  std::vector<uint32_t> generations;
+};
+
+struct Shard
+{
+  std::shared_ptr<PartOne> partOne;
+  QueuedSendTarget sendTarget;
+  std::thread thread;
+
+  std::mutex m;
+  std::vector<Task> inbox;
+  std::exception_ptr exception;
+
+  // Used by the shard's thread only
+  std::vector<Task> tasks;
+};
+
+struct Migration
+{
+  enum class Stage
+  {
+    Out,
+    In
+  };
+
+  Stage stage = Stage::Out;
+  ShardHost::MigrationResult result;
+
+  // Shard the user is being loaded into, 'from' when rolling back
+  ShardHost::ShardId loadingInto = g_noShard;
+
+  std::optional<MpChangeForm> changeForm;
+  uint8_t movementCodecVersion = 0;
+  uint32_t generation = 0;
+  std::string error;
+};
+
+void MigrateOut(PartOne& partOne, Migration& migration)
+{
+  auto userId = migration.result.userId;
+  auto& serverState = partOne.serverState;
+
+  if (auto actor = serverState.ActorByUser(userId)) {
+    if (actor->GetFormId() < 0xff000000) {
+      std::stringstream ss;
+      ss << "Actor " << std::hex << actor->GetFormId()
+         << " is not a dynamic form and can't be migrated";
+      throw std::runtime_error(ss.str());
+    }
+
+    // Makes the client destroy forms of this shard
+    actor->UnsubscribeFromAll();
+
+    migration.result.actorId = actor->GetFormId();
+    migration.changeForm = actor->GetChangeForm();
+
+    // GetChangeForm doesn't produce loadable descs without espm files
+    migration.changeForm->formDesc = FormDesc::FromFormId(
+      actor->GetFormId(), partOne.worldState.espmFiles);
+  }
+  migration.movementCodecVersion = serverState.GetMovementCodecVersion(userId);
+
+  PartOne::HandlePacket(&partOne, userId,
+                        Networking::PacketType::ServerSideUserDisconnect,
+                        nullptr, 0);
+
+  if (auto actorId = migration.result.actorId) {
+    partOne.DestroyActor(actorId);
+
+    // The target shard saves the actor, state left by destruction must not
+    // overwrite it
+    partOne.worldState.CancelSave(actorId);
+  }
+}
+
+void MigrateIn(PartOne& partOne, const Migration& migration)
+{
+  auto userId = migration.result.userId;
+  auto actorId = migration.result.actorId;
+
+  if (actorId && partOne.worldState.LookupFormById(actorId)) {
+    std::stringstream ss;
+    ss << "Form " << std::hex << actorId << " already exists";
+    throw std::runtime_error(ss.str());
+  }
+
+  PartOne::HandlePacket(&partOne, userId,
+                        Networking::PacketType::ServerSideUserConnect,
+                        nullptr, 0);
+  partOne.serverState.SetMovementCodecVersion(
+    userId, migration.movementCodecVersion);
+
+  if (migration.changeForm) {
+    partOne.worldState.LoadChangeForm(*migration.changeForm,
+                                      partOne.CreateFormCallbacks());
+    auto& actor = partOne.worldState.GetFormAt<MpActor>(actorId);
+    partOne.worldState.RequestSave(actor);
+    partOne.SetUserActor(userId, actorId);
+  }
+}
+}
+
+struct ShardHost::Impl
+{
+  std::shared_ptr<Networking::IServer> server;
+  std::vector<std::unique_ptr<Shard>> shards;
+
+  std::atomic<bool> started = false;
+  std::atomic<bool> stopping = false;
+  std::chrono::milliseconds tickInterval{ 10 };
+
+  // Host thread state, indexed by UserId
+  std::vector<ShardId> owner;
+  std::vector<ShardId> migrationTarget;
+  std::vector<uint32_t> generation;
+  std::unordered_map<Networking::UserId, std::vector<Task>> buffered;
+
+  std::mutex migrationsMutex;
+  std::vector<std::shared_ptr<Migration>> finishedMigrations;
+
+  std::vector<MigrationResult> results;
+  std::vector<Outgoing> outgoing;
+  std::vector<Networking::UserId> targetsScratch;
+
+  void EnsureUserExists(Networking::UserId userId)
+  {
+    if (owner.size() <= userId) {
+      owner.resize(static_cast<size_t>(userId) + 1, g_noShard);
+      migrationTarget.resize(owner.size(), g_noShard);
+      generation.resize(owner.size(), 0);
+    }
+  }
+
+  void CheckShardExists(ShardId shardId) const
+  {
+    if (shardId >= shards.size())
+      throw std::runtime_error("Shard " + std::to_string(shardId) +
+                               " doesn't exist");
+  }
+
+  bool IsMigrating(Networking::UserId userId) const
+  {
+    return migrationTarget.size() > userId &&
+      migrationTarget[userId] != g_noShard;
+  }
+
+  bool IsOwnedBy(Networking::UserId userId, ShardId shardId) const
+  {
+    return owner.size() > userId &&
+      (owner[userId] == shardId || migrationTarget[userId] == shardId);
+  }
+
+  void Push(ShardId shardId, Task task)
+  {
+    auto& shard = *shards[shardId];
+    std::lock_guard l(shard.m);
+    shard.inbox.push_back(std::move(task));
+  }
+
+  void Route(Task task)
+  {
+    auto userId = task.userId;
+    auto type = task.type;
+
+    if (type == Networking::PacketType::ServerSideUserConnect) {
+      owner[userId] = 0;
+      ++generation[userId];
+    }
+    task.generation = generation[userId];
+
+    auto shardId = owner[userId];
+    if (shardId == g_noShard)
+      return;
+    Push(shardId, std::move(task));
+
+    if (type == Networking::PacketType::ServerSideUserDisconnect)
+      owner[userId] = g_noShard;
+  }
+
+  void PostMigrationStage(const std::shared_ptr<Migration>& migration,
+                          ShardId shardId)
+  {
+    Task task;
+    auto shard = shards[shardId].get();
+    task.fn = [this, migration, shard](PartOne& partOne) {
+      try {
+        if (migration->stage == Migration::Stage::Out) {
+          MigrateOut(partOne, *migration);
+        } else {
+          shard->sendTarget.SetGeneration(migration->result.userId,
+                                          migration->generation);
+          MigrateIn(partOne, *migration);
+        }
+      } catch (std::exception& e) {
+        migration->error = e.what();
+      }
+      std::lock_guard l(migrationsMutex);
+      finishedMigrations.push_back(migration);
+    };
+    Push(shardId, std::move(task));
+  }
+
+  void FinishMigration(Migration& migration, ShardId newOwner)
+  {
+    auto userId = migration.result.userId;
+    owner[userId] = newOwner;
+    migrationTarget[userId] = g_noShard;
+
+    auto it = buffered.find(userId);
+    if (it != buffered.end()) {
+      for (auto& task : it->second)
+        Route(std::move(task));
+      buffered.erase(it);
+    }
+    results.push_back(migration.result);
+  }
+
+  void ProcessMigrations()
+  {
+    std::vector<std::shared_ptr<Migration>> finished;
+    {
+      std::lock_guard l(migrationsMutex);
+      finished.swap(finishedMigrations);
+    }
+
+    for (auto& migration : finished) {
+      auto& result = migration->result;
+
+      if (migration->stage == Migration::Stage::Out) {
+        if (!migration->error.empty()) {
+          result.error = migration->error;
+          FinishMigration(*migration, result.from);
+          continue;
+        }
+        migration->stage = Migration::Stage::In;
+        migration->loadingInto = result.to;
+        PostMigrationStage(migration, result.to);
+        continue;
+      }
+
+      const bool rollingBack = migration->loadingInto == result.from;
+      if (migration->error.empty()) {
+        FinishMigration(*migration, migration->loadingInto);
+      } else if (!rollingBack) {
+        // Return the user to the source shard
+        result.error = migration->error;
+        migration->error.clear();
+        migration->loadingInto = result.from;
+        migrationTarget[result.userId] = result.from;
+        PostMigrationStage(migration, result.from);
+      } else {
+        // Can't load the actor anywhere. The user stays connected to the
+        // source shard without an actor
+        result.error += "; rollback failed: " + migration->error;
+        migration->changeForm.reset();
+        FinishMigration(*migration, result.from);
+      }
+    }
+  }
+
+  void RunShard(Shard& shard)
+  {
+    {
+      std::lock_guard l(shard.m);
+      shard.tasks.swap(shard.inbox);
+    }
+
+    for (auto& task : shard.tasks) {
+      Run(shard, [&] {
+        if (task.fn)
+          return task.fn(*shard.partOne);
+        if (task.type == Networking::PacketType::ServerSideUserConnect)
+          shard.sendTarget.SetGeneration(task.userId, task.generation);
+        PartOne::HandlePacket(shard.partOne.get(), task.userId, task.type,
+                              task.data.data(), task.data.size());
+      });
+    }
+    shard.tasks.clear();
+
+    Run(shard, [&] { shard.partOne->Tick(); });
+  }
+
+  template <class F>
+  void Run(Shard& shard, const F& f)
+  {
+    try {
+      f();
+    } catch (...) {
+      std::lock_guard l(shard.m);
+      if (!shard.exception)
+        shard.exception = std::current_exception();
+    }
+  }
+
+  void SendOutgoing(ShardId shardId)
+  {
+    shards[shardId]->sendTarget.Take(outgoing);
+    for (auto& entry : outgoing) {
+      // Users may disconnect, move to another shard or even be replaced by
+      // a new connection with the same id while shard's packets are in the
+      // queue
+      targetsScratch.clear();
+      for (size_t i = 0; i < entry.targets.size(); ++i) {
+        auto userId = entry.targets[i];
+        if (IsOwnedBy(userId, shardId) &&
+            generation[userId] == entry.generations[i])
+          targetsScratch.push_back(userId);
+      }
+
+      if (targetsScratch.size() == 1) {
+        server->Send(targetsScratch[0], entry.data.data(), entry.data.size(),
+                     entry.reliable);
+      } else if (!targetsScratch.empty()) {
+        server->SendMany(targetsScratch, entry.data.data(), entry.data.size(),
+                         entry.reliable);
+      }
+    }
+  }
+
+  static void HandlePacket(void* state, Networking::UserId userId,
+                           Networking::PacketType packetType,
+                           Networking::PacketData data, size_t length)
+  {
+    auto this_ = reinterpret_cast<Impl*>(state);
+    this_->EnsureUserExists(userId);
+
+    Task task;
+    task.userId = userId;
+    task.type = packetType;
+    task.data.assign(data, data + length);
+
+    if (this_->IsMigrating(userId))
+      this_->buffered[userId].push_back(std::move(task));
+    else
+      this_->Route(std::move(task));
+  }
+};
+
+ShardHost::ShardHost(std::shared_ptr<Networking::IServer> server)
+{
+  if (!server)
+    throw std::runtime_error("ShardHost requires a server");
+  pImpl.reset(new Impl);
+  pImpl->server = std::move(server);
+}
+
+ShardHost::~ShardHost()
+{
+  Stop();
+}
+
+ShardHost::ShardId ShardHost::AddShard(std::shared_ptr<PartOne> partOne)
+{
+  if (pImpl->started)
+    throw std::runtime_error("Shards can't be added after Start");
+  if (!partOne)
+    throw std::runtime_error("Shard must not be null");
+
+  auto shard = std::make_unique<Shard>();
+  shard->partOne = std::move(partOne);
+  shard->partOne->SetSendTarget(&shard->sendTarget);
+  pImpl->shards.push_back(std::move(shard));
+  return pImpl->shards.size() - 1;
+}
+
+size_t ShardHost::GetNumShards() const
+{
+  return pImpl->shards.size();
+}
+
+PartOne& ShardHost::GetShard(ShardId shardId)
+{
+  if (pImpl->started)
+    throw std::runtime_error("Shards can't be accessed directly while "
+                             "ShardHost is started, use Post");
+  pImpl->CheckShardExists(shardId);
+  return *pImpl->shards[shardId]->partOne;
+}
+
+void ShardHost::Start(std::chrono::milliseconds tickInterval)
+{
+  if (pImpl->started)
+    throw std::runtime_error("ShardHost is already started");
+  if (pImpl->shards.empty())
+    throw std::runtime_error("ShardHost has no shards");
+
+  pImpl->tickInterval = tickInterval;
+  pImpl->stopping = false;
+  pImpl->started = true;
+
+  auto impl = pImpl.get();
+  for (auto& shard : pImpl->shards) {
+    auto shardPtr = shard.get();
+    shard->thread = std::thread([impl, shardPtr] {
+      while (!impl->stopping) {
+        auto next = std::chrono::steady_clock::now() + impl->tickInterval;
+        impl->RunShard(*shardPtr);
+        std::this_thread::sleep_until(next);
+      }
+    });
+  }
+}
+
+void ShardHost::Stop()
+{
+  if (!pImpl->started)
+    return;
+  pImpl->stopping = true;
+  for (auto& shard : pImpl->shards) {
+    if (shard->thread.joinable())
+      shard->thread.join();
+  }
+  pImpl->started = false;
+}
+
+void ShardHost::Tick()
+{
+  pImpl->server->Tick(Impl::HandlePacket, pImpl.get());
+
+  if (!pImpl->started) {
+    for (auto& shard : pImpl->shards)
+      pImpl->RunShard(*shard);
+  }
+
+  pImpl->ProcessMigrations();
+
+  for (ShardId i = 0; i < pImpl->shards.size(); ++i)
+    pImpl->SendOutgoing(i);
+
+  for (auto& shard : pImpl->shards) {
+    std::exception_ptr exception;
+    {
+      std::lock_guard l(shard->m);
+      std::swap(exception, shard->exception);
+    }
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+}
+
+void ShardHost::Post(ShardId shardId, std::function<void(PartOne&)> f)
+{
+  pImpl->CheckShardExists(shardId);
+
+  Task task;
+  task.fn = std::move(f);
+  pImpl->Push(shardId, std::move(task));
+}
+
+void ShardHost::MigrateUser(Networking::UserId userId, ShardId target)
+{
+  pImpl->CheckShardExists(target);
+
+  auto from = GetUserShard(userId);
+  if (pImpl->owner.size() <= userId || pImpl->owner[userId] == g_noShard)
+    throw std::runtime_error("User with id " + std::to_string(userId) +
+                             " doesn't exist");
+  if (pImpl->IsMigrating(userId))
+    throw std::runtime_error("User with id " + std::to_string(userId) +
+                             " is already migrating");
+  if (from == target)
+    return;
+
+  auto migration = std::make_shared<Migration>();
+  migration->result.userId = userId;
+  migration->result.from = from;
+  migration->result.to = target;
+  migration->generation = pImpl->generation[userId];
+
+  pImpl->migrationTarget[userId] = target;
+  pImpl->PostMigrationStage(migration, from);
+}
+
+ShardHost::ShardId ShardHost::GetUserShard(Networking::UserId userId) const
+{
+  if (pImpl->owner.size() <= userId || pImpl->owner[userId] == g_noShard)
+    return 0;
+  return pImpl->owner[userId];
+}
+
+bool ShardHost::IsMigrating(Networking::UserId userId) const
+{
+  return pImpl->IsMigrating(userId);
+}
+
+std::vector<ShardHost::MigrationResult> ShardHost::TakeMigrationResults()
+{
+  std::vector<MigrationResult> res;
+  res.swap(pImpl->results);
+  return res;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include "NetworkingInterface.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class PartOne;
+
+// Hosts several PartOne instances (shards) behind one server. Each shard
+// owns a set of users and ticks on its own thread. The server is only
+// touched by the thread calling Tick: incoming packets are routed to the
+// shard owning the user and packets sent by shards are queued until the next
+// Tick. New users join the default shard (0).
+//
+// Shards may share a read-only espm::Loader and a script storage wrapped in
+// SharedScriptStorage. Listeners of a shard are called on its thread
+class ShardHost
+{
+public:
+  using ShardId = size_t;
+
+  struct MigrationResult
+  {
+    Networking::UserId userId = Networking::InvalidUserId;
+    ShardId from = 0;
+    ShardId to = 0;
+
+    // Actor form id, zero if the user had no actor
+    uint32_t actorId = 0;
+
+    // Empty on success. Failed migrations leave the user on shard 'from'
+    std::string error;
+  };
+
+  explicit ShardHost(std::shared_ptr<Networking::IServer> server);
+  ~ShardHost();
+
+  // Must be called before Start. Replaces the send target of partOne
+  ShardId AddShard(std::shared_ptr<PartOne> partOne);
+  size_t GetNumShards() const;
+
+  // Shards are used by their threads once started, so this throws between
+  // Start and Stop. Use Post to access a running shard
+  PartOne& GetShard(ShardId shardId);
+
+  // Starts one thread per shard. Without Start shards tick inside Tick
+  void Start(std::chrono::milliseconds tickInterval =
+               std::chrono::milliseconds(10));
+  void Stop();
+
+  // Ticks the server, routes incoming packets and sends packets queued by
+  // shards. Rethrows exceptions thrown by shards on their threads
+  void Tick();
+
+  // Calls f on the shard's thread before its next tick
+  void Post(ShardId shardId, std::function<void(PartOne&)> f);
+
+  // Moves the user and their actor to another shard. The source shard sees
+  // a disconnect, the target shard sees a connect followed by SetUserActor.
+  // Packets the user sends meanwhile are delivered to the target shard.
+  // Completes during one of the following Ticks
+  void MigrateUser(Networking::UserId userId, ShardId target);
+
+  // Returns shard owning the user, or the default shard for unknown users
+  ShardId GetUserShard(Networking::UserId userId) const;
+
+  bool IsMigrating(Networking::UserId userId) const;
+
+  std::vector<MigrationResult> TakeMigrationResults();
+
+private:
+  struct Impl;
+  std::shared_ptr<Impl> pImpl;
+};
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "SpSnippet.h"
 
 #include "MpActor.h"
-#include "NetworkingInterface.h" // Format
+#include "PacketBuilder.h"
 
 SpSnippet::SpSnippet(const char* cl_, const char* func_, const char* args_,
                      uint32_t selfId_)
@@ -22,12 +22,14 @@ Viet::Promise<VarValue> SpSnippet::Execute(MpActor* actor)
   // See also SpSnippetFunctionGen.cpp
   auto targetSelfId = selfId < 0xff000000 ? selfId : 0x14;
 
-  Networking::Format(
-    [&](Networking::PacketData data, size_t len) {
-      actor->SendToUser(data, len, true);
-    },
-    R"({"type": "spSnippet", "class": "%s", "function": "%s", "arguments": %s, "selfId": %u, "snippetIdx": %u})",
-    cl, func, args, targetSelfId, snippetIdx);
+  Networking::PacketBuilder msg;
+  msg.AppendFormatted(
+    R"({"type": "spSnippet", "class": "%s", "function": "%s", "arguments": )",
+    cl, func);
+  msg.Append(args);
+  msg.AppendFormatted(R"(, "selfId": %u, "snippetIdx": %u})", targetSelfId,
+                      snippetIdx);
+  actor->SendToUser(msg.GetData(), msg.GetLength(), true);
 
   return promise;
 }
\ No newline at end of file
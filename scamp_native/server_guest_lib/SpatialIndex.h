@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Objects by grid cells. Within a cell objects are sorted by a key (base id
+// for refs), so filtering a cell by keys is a binary search per key rather
+// than a scan of the cell
+template <class T>
+class SpatialIndex
+{
+  struct Entry
+  {
+    uint32_t key = 0;
+    T obj;
+
+    bool operator<(const Entry& rhs) const
+    {
+      return std::make_pair(key, obj) < std::make_pair(rhs.key, rhs.obj);
+    }
+  };
+
+  struct Obj
+  {
+    uint32_t key = 0;
+    std::pair<int16_t, int16_t> coords;
+  };
+
+public:
+  void Move(const T& obj, uint32_t key, int16_t x, int16_t y)
+  {
+    auto [it, inserted] = objs.try_emplace(obj);
+    if (!inserted) {
+      if (it->second.key == key && it->second.coords == std::make_pair(x, y))
+        return;
+      Erase(obj, it->second);
+    }
+    it->second = { key, { x, y } };
+
+    auto& entries = cells[GetCellKey(x, y)];
+    Entry entry{ key, obj };
+    entries.insert(std::lower_bound(entries.begin(), entries.end(), entry),
+                   entry);
+  }
+
+  void Forget(const T& obj)
+  {
+    auto it = objs.find(obj);
+    if (it == objs.end())
+      return;
+    Erase(obj, it->second);
+    objs.erase(it);
+  }
+
+  // sortedKeys must be sorted, empty means any key
+  template <class F>
+  void VisitCell(int16_t x, int16_t y, const std::vector<uint32_t>& sortedKeys,
+                 const F& f) const
+  {
+    auto cellIt = cells.find(GetCellKey(x, y));
+    if (cellIt == cells.end())
+      return;
+
+    auto& entries = cellIt->second;
+    if (sortedKeys.empty()) {
+      for (auto& entry : entries)
+        f(entry.obj);
+      return;
+    }
+
+    auto it = entries.begin();
+    for (auto key : sortedKeys) {
+      it = std::lower_bound(it, entries.end(), key,
+                            [](const Entry& entry, uint32_t key) {
+                              return entry.key < key;
+                            });
+      for (; it != entries.end() && it->key == key; ++it)
+        f(it->obj);
+    }
+  }
+
+  template <class F>
+  void VisitAll(const std::vector<uint32_t>& sortedKeys, const F& f) const
+  {
+    for (auto& [cellKey, entries] : cells) {
+      auto x = static_cast<int16_t>(cellKey >> 16);
+      auto y = static_cast<int16_t>(cellKey & 0xffff);
+      VisitCell(x, y, sortedKeys, f);
+    }
+  }
+
+  size_t GetSize() const { return objs.size(); }
+
+  // Cells with at least one object
+  size_t GetNumCells() const { return cells.size(); }
+
+private:
+  static uint32_t GetCellKey(int16_t x, int16_t y)
+  {
+    return (static_cast<uint32_t>(static_cast<uint16_t>(x)) << 16) |
+      static_cast<uint16_t>(y);
+  }
+
+  void Erase(const T& obj, const Obj& data)
+  {
+    auto [x, y] = data.coords;
+    auto cellIt = cells.find(GetCellKey(x, y));
+    auto& entries = cellIt->second;
+    auto it = std::lower_bound(entries.begin(), entries.end(),
+                               Entry{ data.key, obj });
+    entries.erase(it);
+    if (entries.empty())
+      cells.erase(cellIt);
+  }
+
+  std::unordered_map<uint32_t, std::vector<Entry>> cells;
+  std::unordered_map<T, Obj> objs;
+};
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "TickScheduler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+size_t GetPhaseIdx(TickScheduler::Phase phase)
+{
+  auto idx = static_cast<size_t>(phase);
+  if (idx >= TickScheduler::g_numPhases)
+    throw std::runtime_error("Invalid tick phase");
+  return idx;
+}
+}
+
+const char* TickScheduler::GetPhaseName(Phase phase)
+{
+  static const char* g_names[g_numPhases] = {
+    "networkApply", "timers", "reloot", "saveCollection", "scriptEvents"
+  };
+  return g_names[GetPhaseIdx(phase)];
+}
+
+void TickScheduler::SetBudget(Phase phase, std::chrono::microseconds budget)
+{
+  budgets[GetPhaseIdx(phase)] = budget;
+}
+
+std::chrono::microseconds TickScheduler::GetBudget(Phase phase) const
+{
+  return budgets[GetPhaseIdx(phase)];
+}
+
+const TickScheduler::PhaseStats& TickScheduler::GetStats(Phase phase) const
+{
+  return stats[GetPhaseIdx(phase)];
+}
+
+void TickScheduler::Record(Phase phase,
+                           std::chrono::steady_clock::duration duration,
+                           bool workLeft)
+{
+  auto& s = stats[GetPhaseIdx(phase)];
+  const auto budget = budgets[GetPhaseIdx(phase)];
+  const uint64_t ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+
+  size_t bucket = 0;
+  for (uint64_t us = ns / 1000; us > 0 && bucket < s.histogram.size() - 1;
+       us >>= 1)
+    ++bucket;
+  ++s.histogram[bucket];
+
+  ++s.numTicks;
+  if (workLeft || (budget.count() > 0 && duration > budget))
+    ++s.numOverBudget;
+  s.lastNs = ns;
+  s.maxNs = std::max(s.maxNs, ns);
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Splits a server tick into named phases. A phase stops once its budget is
+// exhausted and leaves the rest of its work queued for the next tick
+class TickScheduler
+{
+public:
+  enum class Phase
+  {
+    NetworkApply,
+    Timers,
+    Reloot,
+    SaveCollection,
+    ScriptEvents,
+    Count
+  };
+
+  static constexpr size_t g_numPhases = static_cast<size_t>(Phase::Count);
+
+  static const char* GetPhaseName(Phase phase);
+
+  class Budget
+  {
+  public:
+    explicit Budget(std::chrono::steady_clock::time_point deadline_)
+      : deadline(deadline_)
+    {
+    }
+
+    bool IsExhausted() const
+    {
+      return deadline != std::chrono::steady_clock::time_point::max() &&
+        std::chrono::steady_clock::now() >= deadline;
+    }
+
+  private:
+    const std::chrono::steady_clock::time_point deadline;
+  };
+
+  struct PhaseStats
+  {
+    // Bucket i counts phase durations below 2^i microseconds, the last one
+    // counts the rest
+    static constexpr size_t g_numBuckets = 16;
+    std::array<uint64_t, g_numBuckets> histogram = {};
+
+    uint64_t numTicks = 0;
+
+    // Ticks the phase exceeded its budget or left work for the next tick
+    uint64_t numOverBudget = 0;
+
+    uint64_t lastNs = 0;
+    uint64_t maxNs = 0;
+  };
+
+  // Zero means no limit. Phases always make progress, so a budget may be
+  // exceeded by one unit of work
+  void SetBudget(Phase phase, std::chrono::microseconds budget);
+  std::chrono::microseconds GetBudget(Phase phase) const;
+
+  // f takes const Budget& and returns true if it stopped with work left
+  template <class F>
+  void Run(Phase phase, const F& f)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const auto budget = budgets[static_cast<size_t>(phase)];
+    Budget b(budget.count() > 0
+               ? start + budget
+               : std::chrono::steady_clock::time_point::max());
+    const bool workLeft = f(b);
+    Record(phase, std::chrono::steady_clock::now() - start, workLeft);
+  }
+
+  const PhaseStats& GetStats(Phase phase) const;
+
+private:
+  void Record(Phase phase, std::chrono::steady_clock::duration duration,
+              bool workLeft);
+
+  std::array<std::chrono::microseconds, g_numPhases> budgets = {};
+  std::array<PhaseStats, g_numPhases> stats = {};
+};
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// 4-ary min-heap of timers by finish time. Timers with equal finish fire in
+// insertion order. Heap nodes point to slots which remember heap positions,
+// so a timer is cancelled in O(log n) by its handle
+template <class T>
+class TimerQueue
+{
+public:
+  using TimePoint = std::chrono::system_clock::time_point;
+
+  // Stale once the timer fires or is cancelled
+  struct Handle
+  {
+    uint32_t slot = static_cast<uint32_t>(-1);
+    uint32_t generation = 0;
+  };
+
+  Handle Add(TimePoint finish, T value)
+  {
+    uint32_t slotIdx;
+    if (freeSlots.empty()) {
+      slotIdx = static_cast<uint32_t>(slots.size());
+      slots.emplace_back();
+    } else {
+      slotIdx = freeSlots.back();
+      freeSlots.pop_back();
+    }
+
+    auto& slot = slots[slotIdx];
+    slot.value = std::move(value);
+    heap.push_back({ finish, nextSeq++, slotIdx });
+    SiftUp(heap.size() - 1);
+    return { slotIdx, slot.generation };
+  }
+
+  // Returns false for stale handles
+  bool Cancel(Handle handle)
+  {
+    if (!IsPending(handle))
+      return false;
+    RemoveAt(slots[handle.slot].heapPos);
+    return true;
+  }
+
+  bool IsPending(Handle handle) const
+  {
+    return handle.slot < slots.size() && slots[handle.slot].value &&
+      slots[handle.slot].generation == handle.generation;
+  }
+
+  // Pops timers finished by now in finish order and calls f for each. f may
+  // add and cancel timers. Returns the number of timers fired
+  template <class F>
+  size_t Tick(TimePoint now, const F& f)
+  {
+    return Tick(now, f, [] { return false; });
+  }
+
+  // Same, but stops early once shouldStop returns true. At least one timer
+  // fires, so the queue makes progress on every tick
+  template <class F, class S>
+  size_t Tick(TimePoint now, const F& f, const S& shouldStop)
+  {
+    size_t numFired = 0;
+    while (!heap.empty() && heap.front().finish <= now &&
+           !(numFired > 0 && shouldStop())) {
+      T value = std::move(*slots[heap.front().slot].value);
+      RemoveAt(0);
+      f(value);
+      ++numFired;
+    }
+    return numFired;
+  }
+
+  std::optional<TimePoint> GetNextFinish() const
+  {
+    if (heap.empty())
+      return std::nullopt;
+    return heap.front().finish;
+  }
+
+  size_t GetSize() const { return heap.size(); }
+
+  // Cancels all timers
+  void Clear()
+  {
+    while (!heap.empty())
+      RemoveAt(heap.size() - 1);
+  }
+
+private:
+  struct Node
+  {
+    TimePoint finish;
+    uint64_t seq = 0;
+    uint32_t slot = 0;
+
+    bool operator<(const Node& rhs) const
+    {
+      return finish != rhs.finish ? finish < rhs.finish : seq < rhs.seq;
+    }
+  };
+
+  struct Slot
+  {
+    std::optional<T> value;
+    size_t heapPos = 0;
+    uint32_t generation = 0;
+  };
+
+  void Place(size_t pos, const Node& node)
+  {
+    heap[pos] = node;
+    slots[node.slot].heapPos = pos;
+  }
+
+  void SiftUp(size_t pos)
+  {
+    Node node = heap[pos];
+    while (pos > 0) {
+      size_t parent = (pos - 1) / 4;
+      if (!(node < heap[parent]))
+        break;
+      Place(pos, heap[parent]);
+      pos = parent;
+    }
+    Place(pos, node);
+  }
+
+  void SiftDown(size_t pos)
+  {
+    Node node = heap[pos];
+    while (true) {
+      size_t first = pos * 4 + 1;
+      if (first >= heap.size())
+        break;
+      size_t best = first;
+      size_t last = std::min(first + 4, heap.size());
+      for (size_t child = first + 1; child < last; ++child) {
+        if (heap[child] < heap[best])
+          best = child;
+      }
+      if (!(heap[best] < node))
+        break;
+      Place(pos, heap[best]);
+      pos = best;
+    }
+    Place(pos, node);
+  }
+
+  void RemoveAt(size_t pos)
+  {
+    auto& slot = slots[heap[pos].slot];
+    slot.value.reset();
+    ++slot.generation;
+    freeSlots.push_back(heap[pos].slot);
+
+    Node last = heap.back();
+    heap.pop_back();
+    if (pos == heap.size())
+      return;
+
+    Place(pos, last);
+    if (pos > 0 && last < heap[(pos - 1) / 4])
+      SiftUp(pos);
+    else
+      SiftDown(pos);
+  }
+
+  std::vector<Node> heap;
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+  uint64_t nextSeq = 0;
+};
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "TrafficStats.h"
+#include "MovementCodec.h"
+#include "NetworkingBatched.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+enum : size_t
+{
+  kUnknownKind,
+  kOtherKind,
+  kMovementKind,
+  kBatchKind,
+  kNumSpecialKinds
+};
+
+// MsgType values never need more
+constexpr int g_maxMsgTypeDigits = 4;
+
+size_t SkipWhitespace(Networking::PacketData data, size_t length, size_t i)
+{
+  while (i < length && isspace(data[i]))
+    ++i;
+  return i;
+}
+
+// Returns index of the closing quote
+size_t SkipString(Networking::PacketData data, size_t length, size_t i)
+{
+  while (i < length && data[i] != '"')
+    i += data[i] == '\\' ? 2 : 1;
+  return i;
+}
+
+nlohmann::json HistogramToJson(const TrafficStats::SizeHistogram& histogram)
+{
+  // Trailing empty buckets are omitted
+  size_t n = histogram.size();
+  while (n > 0 && histogram[n - 1] == 0)
+    --n;
+  return std::vector<uint64_t>(histogram.begin(), histogram.begin() + n);
+}
+}
+
+void TrafficStats::Counter::Add(size_t length)
+{
+  ++numPackets;
+  numBytes += length;
+}
+
+void TrafficStats::Counter::Add(size_t length, bool reliable)
+{
+  Add(length);
+  ++(reliable ? numReliable : numUnreliable);
+}
+
+nlohmann::json TrafficStats::Counter::ToJson() const
+{
+  return nlohmann::json{ { "packets", numPackets },
+                         { "bytes", numBytes },
+                         { "reliable", numReliable },
+                         { "unreliable", numUnreliable } };
+}
+
+void TrafficStats::AddIncoming(Networking::UserId userId, MsgType type,
+                               size_t length)
+{
+  totalIn.Add(length);
+  ++sizesIn[GetSizeBucket(length)];
+  auto typeIndex = static_cast<size_t>(type);
+  if (typeIndex < inByMsgType.size())
+    inByMsgType[typeIndex].Add(length);
+  GetUser(userId).in.Add(length);
+}
+
+void TrafficStats::AddOutgoing(Networking::UserId userId,
+                               Networking::PacketData data, size_t length,
+                               bool reliable)
+{
+  totalOut.Add(length, reliable);
+  ++sizesOut[GetSizeBucket(length)];
+  outByKind[GetOutgoingKindIndex(data, length)].Add(length, reliable);
+  GetUser(userId).out.Add(length, reliable);
+}
+
+void TrafficStats::AddOutgoing(const std::vector<Networking::UserId>& userIds,
+                               Networking::PacketData data, size_t length,
+                               bool reliable)
+{
+  if (userIds.empty())
+    return;
+
+  // Classify once, the payload is the same for every user
+  auto& kindCounter = outByKind[GetOutgoingKindIndex(data, length)];
+  for (auto userId : userIds) {
+    totalOut.Add(length, reliable);
+    ++sizesOut[GetSizeBucket(length)];
+    kindCounter.Add(length, reliable);
+    GetUser(userId).out.Add(length, reliable);
+  }
+}
+
+void TrafficStats::Forget(Networking::UserId userId)
+{
+  if (isUserActive.size() > userId) {
+    isUserActive[userId] = false;
+    byUser[userId] = {};
+  }
+}
+
+void TrafficStats::Reset()
+{
+  *this = TrafficStats();
+}
+
+nlohmann::json TrafficStats::ToJson() const
+{
+  auto in = nlohmann::json::object();
+  in["total"] = totalIn.ToJson();
+  in["sizes"] = HistogramToJson(sizesIn);
+  auto& byMsgType = in["byMsgType"] = nlohmann::json::object();
+  for (size_t i = 0; i < inByMsgType.size(); ++i) {
+    if (inByMsgType[i].numPackets > 0)
+      byMsgType[GetMsgTypeName(static_cast<MsgType>(i))] =
+        inByMsgType[i].ToJson();
+  }
+
+  auto out = nlohmann::json::object();
+  out["total"] = totalOut.ToJson();
+  out["sizes"] = HistogramToJson(sizesOut);
+  auto& byKind = out["byKind"] = nlohmann::json::object();
+  for (size_t i = 0; i < outByKind.size(); ++i) {
+    if (outByKind[i].numPackets > 0)
+      byKind[std::string(GetKindName(i))] = outByKind[i].ToJson();
+  }
+
+  auto users = nlohmann::json::object();
+  for (size_t i = 0; i < byUser.size(); ++i) {
+    if (isUserActive[i]) {
+      users[std::to_string(i)] = { { "in", byUser[i].in.ToJson() },
+                                   { "out", byUser[i].out.ToJson() } };
+    }
+  }
+
+  return nlohmann::json{ { "in", in }, { "out", out }, { "byUser", users } };
+}
+
+std::string_view TrafficStats::GetOutgoingKind(Networking::PacketData data,
+                                               size_t length)
+{
+  return GetKindName(GetOutgoingKindIndex(data, length));
+}
+
+size_t TrafficStats::GetOutgoingKindIndex(Networking::PacketData data,
+                                          size_t length)
+{
+  if (length == 0)
+    return kUnknownKind;
+  if (data[0] == MovementCodec::PacketId)
+    return kMovementKind;
+  if (data[0] == Networking::BatchPacketId)
+    return kBatchKind;
+  if (data[0] != Networking::MinPacketId)
+    return kUnknownKind;
+
+  // Looks for "type" or "t" of the top-level object without parsing the
+  // whole message
+  int depth = 0;
+  size_t i = 1;
+  while (i < length) {
+    auto c = data[i];
+    if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      --depth;
+    } else if (c == '"') {
+      size_t keyBegin = i + 1;
+      size_t keyEnd = SkipString(data, length, keyBegin);
+      i = SkipWhitespace(data, length, keyEnd + 1);
+      if (depth != 1 || i >= length || data[i] != ':')
+        continue;
+
+      std::string_view key(reinterpret_cast<const char*>(data) + keyBegin,
+                           keyEnd - keyBegin);
+      i = SkipWhitespace(data, length, i + 1);
+      if (i >= length)
+        break;
+
+      if (key == "type" && data[i] == '"') {
+        size_t valueEnd = SkipString(data, length, i + 1);
+        if (valueEnd >= length)
+          break;
+        std::string_view type(reinterpret_cast<const char*>(data) + i + 1,
+                              valueEnd - i - 1);
+        auto it = std::lower_bound(serverMessageTypes.begin(),
+                                   serverMessageTypes.end(), type);
+        if (it == serverMessageTypes.end() || *it != type)
+          return kOtherKind;
+        return kindServerMessageBegin + (it - serverMessageTypes.begin());
+      }
+      if (key == "t" && isdigit(data[i])) {
+        size_t t = 0;
+        for (int n = 0; i < length && isdigit(data[i]); ++n, ++i) {
+          if (n == g_maxMsgTypeDigits)
+            return kOtherKind;
+          t = t * 10 + (data[i] - '0');
+        }
+        if (t > static_cast<size_t>(MsgType::CustomEvent))
+          return kOtherKind;
+        return kindMsgTypeBegin + t;
+      }
+      continue;
+    }
+    ++i;
+  }
+  return kUnknownKind;
+}
+
+std::string_view TrafficStats::GetKindName(size_t kindIndex)
+{
+  static_assert(kNumSpecialKinds == kindMsgTypeBegin);
+  static constexpr std::string_view names[] = { "unknown", "other",
+                                                "movement", "batch" };
+  if (kindIndex < kindMsgTypeBegin)
+    return names[kindIndex];
+  if (kindIndex < kindServerMessageBegin)
+    return GetMsgTypeName(static_cast<MsgType>(kindIndex - kindMsgTypeBegin));
+  return serverMessageTypes[kindIndex - kindServerMessageBegin];
+}
+
+size_t TrafficStats::GetSizeBucket(size_t length)
+{
+  size_t bucket = 0;
+  while (length > 0 && bucket + 1 < SizeHistogram().size()) {
+    length >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+TrafficStats::UserCounters& TrafficStats::GetUser(Networking::UserId userId)
+{
+  if (byUser.size() <= userId) {
+    byUser.resize(static_cast<size_t>(userId) + 1);
+    isUserActive.resize(byUser.size(), false);
+  }
+  isUserActive[userId] = true;
+  return byUser[userId];
+}
+
+InstrumentedSendTarget::InstrumentedSendTarget(
+  Networking::ISendTarget& target_, TrafficStats& stats_)
+  : target(target_)
+  , stats(stats_)
+{
+}
+
+void InstrumentedSendTarget::Send(Networking::UserId targetUserId,
+                                  Networking::PacketData data, size_t length,
+                                  bool reliable)
+{
+  stats.AddOutgoing(targetUserId, data, length, reliable);
+  target.Send(targetUserId, data, length, reliable);
+}
+
+void InstrumentedSendTarget::SendMany(
+  const std::vector<Networking::UserId>& targetUserIds,
+  Networking::PacketData data, size_t length, bool reliable)
+{
+  stats.AddOutgoing(targetUserIds, data, length, reliable);
+  target.SendMany(targetUserIds, data, length, reliable);
+}
\ No newline at end of file
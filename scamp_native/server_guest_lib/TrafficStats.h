@@ -0,0 +1,107 @@
+#pragma once
+#include "MsgType.h"
+#include "NetworkingInterface.h"
+#include <array>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Counts packets and bytes in both directions. Incoming traffic is split by
+// MsgType, outgoing by message kind ("type" of server messages, "t" of
+// forwarded client messages, "movement" for binary movement). The set of
+// kinds is fixed, anything unexpected is counted as "other"
+class TrafficStats
+{
+public:
+  struct Counter
+  {
+    uint64_t numPackets = 0;
+    uint64_t numBytes = 0;
+    uint64_t numReliable = 0;
+    uint64_t numUnreliable = 0;
+
+    void Add(size_t length);
+    void Add(size_t length, bool reliable);
+    nlohmann::json ToJson() const;
+  };
+
+  // Bucket i counts packets of [2^(i-1), 2^i) bytes, the last one is open
+  using SizeHistogram = std::array<uint64_t, 17>;
+
+  // Reliability of incoming packets is lost in RakNet, only packets and
+  // bytes are counted
+  void AddIncoming(Networking::UserId userId, MsgType type, size_t length);
+  void AddOutgoing(Networking::UserId userId, Networking::PacketData data,
+                   size_t length, bool reliable);
+  void AddOutgoing(const std::vector<Networking::UserId>& userIds,
+                   Networking::PacketData data, size_t length,
+                   bool reliable);
+
+  // Per-user counters are dropped on disconnect
+  void Forget(Networking::UserId userId);
+  void Reset();
+
+  // { in: { total, sizes, byMsgType }, out: { total, sizes, byKind },
+  //   byUser: { [userId]: { in, out } } }
+  nlohmann::json ToJson() const;
+
+  static std::string_view GetOutgoingKind(Networking::PacketData data,
+                                          size_t length);
+
+  // Sorted
+  static constexpr std::array<std::string_view, 11> serverMessageTypes = {
+    "createActor", "customPacket",  "destroyActor", "hostStart",
+    "hostStop",    "openContainer", "setInventory", "setRaceMenuOpen",
+    "spSnippet",   "teleport",      "updateGamemodeData"
+  };
+
+private:
+  // "unknown", "other", "movement", "batch", MsgType names, then
+  // serverMessageTypes
+  static constexpr size_t kindMsgTypeBegin = 4;
+  static constexpr size_t kindServerMessageBegin =
+    kindMsgTypeBegin + static_cast<size_t>(MsgType::CustomEvent) + 1;
+  static constexpr size_t numKinds =
+    kindServerMessageBegin + serverMessageTypes.size();
+
+  static size_t GetOutgoingKindIndex(Networking::PacketData data,
+                                     size_t length);
+  static std::string_view GetKindName(size_t kindIndex);
+
+  struct UserCounters
+  {
+    Counter in, out;
+  };
+
+  static size_t GetSizeBucket(size_t length);
+  UserCounters& GetUser(Networking::UserId userId);
+
+  Counter totalIn, totalOut;
+  SizeHistogram sizesIn = {}, sizesOut = {};
+  std::array<Counter, static_cast<size_t>(MsgType::CustomEvent) + 1>
+    inByMsgType;
+  std::array<Counter, numKinds> outByKind;
+  std::vector<UserCounters> byUser;
+  std::vector<bool> isUserActive;
+};
+
+// Records everything sent through it, then forwards to the wrapped target
+class InstrumentedSendTarget : public Networking::ISendTarget
+{
+public:
+  InstrumentedSendTarget(Networking::ISendTarget& target,
+                         TrafficStats& stats);
+
+  void Send(Networking::UserId targetUserId, Networking::PacketData data,
+            size_t length, bool reliable) override;
+  void SendMany(const std::vector<Networking::UserId>& targetUserIds,
+                Networking::PacketData data, size_t length,
+                bool reliable) override;
+
+private:
+  Networking::ISendTarget& target;
+  TrafficStats& stats;
+};
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "UpdateRateLod.h"
+#include <algorithm>
+#include <stdexcept>
+
+void UpdateRateLod::SetTierDistances(const std::vector<float>& tierDistances)
+{
+  if (!std::is_sorted(tierDistances.begin(), tierDistances.end()))
+    throw std::runtime_error("LOD tier distances must be ascending");
+  if (tierDistances.size() >= 32)
+    throw std::runtime_error("Too many LOD tiers");
+
+  tierDistancesSqr.clear();
+  for (float distance : tierDistances)
+    tierDistancesSqr.push_back(distance * distance);
+}
+
+void UpdateRateLod::SetFlushDelay(std::chrono::milliseconds flushDelay_)
+{
+  flushDelay = flushDelay_;
+}
+
+bool UpdateRateLod::IsEnabled() const
+{
+  return !tierDistancesSqr.empty();
+}
+
+uint32_t UpdateRateLod::GetDivisor(float distanceSqr) const
+{
+  auto tier =
+    std::upper_bound(tierDistancesSqr.begin(), tierDistancesSqr.end(),
+                     distanceSqr) -
+    tierDistancesSqr.begin();
+  return 1u << tier;
+}
+
+uint32_t UpdateRateLod::NextSequence(uint32_t emitterId, Channel channel)
+{
+  return states[MakeKey(emitterId, channel)].sequence++;
+}
+
+bool UpdateRateLod::ShouldForward(uint32_t sequence, float distanceSqr) const
+{
+  return sequence % GetDivisor(distanceSqr) == 0;
+}
+
+void UpdateRateLod::SetPending(uint32_t emitterId, Channel channel,
+                               Networking::PacketData data, size_t length,
+                               const std::vector<Networking::UserId>& missedBy,
+                               Clock::time_point now)
+{
+  auto key = MakeKey(emitterId, channel);
+  auto& st = states[key];
+
+  // Previous pending update is outdated, listeners who got this one are up
+  // to date
+  st.missedBy = missedBy;
+  if (missedBy.empty()) {
+    st.pendingData.clear();
+    return;
+  }
+
+  st.pendingData.assign(data, data + length);
+  st.pendingSince = now;
+  if (!st.queued) {
+    st.queued = true;
+    pendingKeys.push_back(key);
+  }
+}
+
+void UpdateRateLod::Flush(const FlushFn& f, Clock::time_point now)
+{
+  size_t numKept = 0;
+  for (auto key : pendingKeys) {
+    auto& st = states.at(key);
+    if (!st.missedBy.empty() && now - st.pendingSince < flushDelay) {
+      pendingKeys[numKept++] = key;
+      continue;
+    }
+
+    st.queued = false;
+    if (st.missedBy.empty())
+      continue;
+
+    auto emitterId = static_cast<uint32_t>(key >> 1);
+    auto channel = static_cast<Channel>(key & 1);
+
+    f(emitterId, channel, st.pendingData.data(), st.pendingData.size(),
+      st.missedBy);
+
+    // Keep capacity for the next SetPending of the emitter
+    st.pendingData.clear();
+    st.missedBy.clear();
+  }
+  pendingKeys.resize(numKept);
+}
+
+void UpdateRateLod::Forget(uint32_t emitterId)
+{
+  for (auto channel : { Channel::Movement, Channel::Animation }) {
+    auto key = MakeKey(emitterId, channel);
+    auto it = states.find(key);
+    if (it == states.end())
+      continue;
+    if (it->second.queued)
+      pendingKeys.erase(
+        std::find(pendingKeys.begin(), pendingKeys.end(), key));
+    states.erase(it);
+  }
+}
+
+uint64_t UpdateRateLod::MakeKey(uint32_t emitterId, Channel channel)
+{
+  return (static_cast<uint64_t>(emitterId) << 1) |
+    static_cast<uint64_t>(channel);
+}
\ No newline at end of file
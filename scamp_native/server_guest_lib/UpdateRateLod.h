@@ -0,0 +1,75 @@
+#pragma once
+#include "NetworkingInterface.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Distance-based decimation of UpdateMovement/UpdateAnimation forwarding.
+// Listeners farther than tierDistances[i] receive every 2^(i+1)-th update of
+// an emitter. Listeners that missed the newest update get it once the
+// emitter stays silent for flushDelay
+class UpdateRateLod
+{
+public:
+  enum class Channel : uint8_t
+  {
+    Movement,
+    Animation
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  // Distances must be ascending. Empty disables LOD
+  void SetTierDistances(const std::vector<float>& tierDistances);
+  void SetFlushDelay(std::chrono::milliseconds flushDelay);
+
+  bool IsEnabled() const;
+
+  // Returns 1 for full rate, 2 for half rate, etc
+  uint32_t GetDivisor(float distanceSqr) const;
+
+  // Must be called once per incoming update. Returns sequence number to be
+  // passed to ShouldForward
+  uint32_t NextSequence(uint32_t emitterId, Channel channel);
+
+  bool ShouldForward(uint32_t sequence, float distanceSqr) const;
+
+  // Stores the newest update along with listeners who didn't receive it.
+  // Replaces the previously stored update of the emitter
+  void SetPending(uint32_t emitterId, Channel channel,
+                  Networking::PacketData data, size_t length,
+                  const std::vector<Networking::UserId>& missedBy,
+                  Clock::time_point now = Clock::now());
+
+  using FlushFn = std::function<void(
+    uint32_t emitterId, Channel channel, Networking::PacketData data,
+    size_t length, const std::vector<Networking::UserId>& missedBy)>;
+
+  // Calls f for stored updates older than flushDelay and forgets them. f
+  // must not call other methods of UpdateRateLod
+  void Flush(const FlushFn& f, Clock::time_point now = Clock::now());
+
+  void Forget(uint32_t emitterId);
+
+private:
+  struct EmitterChannelState
+  {
+    uint32_t sequence = 0;
+    std::vector<uint8_t> pendingData;
+    std::vector<Networking::UserId> missedBy;
+    Clock::time_point pendingSince;
+    bool queued = false;
+  };
+
+  static uint64_t MakeKey(uint32_t emitterId, Channel channel);
+
+  std::vector<float> tierDistancesSqr;
+  std::chrono::milliseconds flushDelay{ 200 };
+  std::unordered_map<uint64_t, EmitterChannelState> states;
+
+  // Keys of states that may hold a pending update, so Flush doesn't visit
+  // idle emitters
+  std::vector<uint64_t> pendingKeys;
+};
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "WorldState.h"
+#include "ChunkPreloader.h"
 #include "FormCallbacks.h"
 #include "HeuristicPolicy.h"
 #include "ISaveStorage.h"
@@ -19,47 +20,129 @@
 #include "ScopedTask.h"
 #include "ScriptStorage.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <deque>
+#include <limits>
 #include <unordered_map>
 
-struct TimerEntry
+namespace {
+std::chrono::system_clock::time_point GetTimerFinish(float seconds)
 {
-  Viet::Promise<Viet::Void> promise;
-  std::chrono::system_clock::time_point finish;
-};
+  return std::chrono::system_clock::now() +
+    std::chrono::milliseconds(static_cast<int>(seconds * 1000));
+}
 
-namespace {
-inline const NiPoint3& GetPos(const espm::REFR::LocationalData* locationalData)
+template <class T>
+bool HasDueTimers(const TimerQueue<T>& queue,
+                  std::chrono::system_clock::time_point now)
 {
-  return *reinterpret_cast<const NiPoint3*>(locationalData->pos);
+  auto finish = queue.GetNextFinish();
+  return finish && *finish <= now;
+}
+
+uint32_t GetTriggerCellKey(const WorldState::GridSettings& settings,
+                           const NiPoint3& pos)
+{
+  auto x = static_cast<int16_t>(pos.x / settings.cellSize);
+  auto y = static_cast<int16_t>(pos.y / settings.cellSize);
+  return (static_cast<uint32_t>(static_cast<uint16_t>(x)) << 16) |
+    static_cast<uint16_t>(y);
+}
+
+// Calls f for cells at the Chebyshev distance ring from (x, y)
+template <class F>
+void VisitRing(int16_t x, int16_t y, int ring, const F& f)
+{
+  auto visit = [&](int cellX, int cellY) {
+    if (cellX >= std::numeric_limits<int16_t>::min() &&
+        cellX <= std::numeric_limits<int16_t>::max() &&
+        cellY >= std::numeric_limits<int16_t>::min() &&
+        cellY <= std::numeric_limits<int16_t>::max())
+      f(static_cast<int16_t>(cellX), static_cast<int16_t>(cellY));
+  };
+
+  if (ring == 0)
+    return visit(x, y);
+  for (int i = -ring; i <= ring; ++i) {
+    visit(x + i, y - ring);
+    visit(x + i, y + ring);
+  }
+  for (int i = -ring + 1; i < ring; ++i) {
+    visit(x - ring, y + i);
+    visit(x + ring, y + i);
+  }
 }
 
-inline NiPoint3 GetRot(const espm::REFR::LocationalData* locationalData)
+// Espm cells covered by the view window around a grid coordinate
+std::pair<int16_t, int16_t> GetChunkRange(
+  const WorldState::GridSettings& settings, int16_t center)
 {
-  static const auto g_pi = std::acos(-1.f);
-  return { locationalData->rotRadians[0] / g_pi * 180.f,
-           locationalData->rotRadians[1] / g_pi * 180.f,
-           locationalData->rotRadians[2] / g_pi * 180.f };
+  constexpr float espmCellSize = 4096.f;
+  const float from =
+    (center - settings.viewRadius) * settings.cellSize / espmCellSize;
+  const float to =
+    (center + settings.viewRadius + 1) * settings.cellSize / espmCellSize;
+  return { static_cast<int16_t>(std::floor(from)),
+           static_cast<int16_t>(std::ceil(to) - 1) };
 }
 }
 
 struct WorldState::Impl
 {
-  std::unordered_map<uint32_t, MpChangeForm> changes;
+  // nullopt means the form is read when the save batch is collected
+  std::unordered_map<uint32_t, std::optional<MpChangeForm>> changes;
+
+  // Ids of changes in request order, so batches over budget don't starve
+  // any form. Ids erased from changes are skipped
+  std::deque<uint32_t> changeOrder;
+
+  // Change forms of batches the save storage failed to write. Their dirty
+  // fields are restored before the next batch is collected
+  std::vector<std::pair<uint32_t, MpChangeForm>> failedSaves;
   std::shared_ptr<ISaveStorage> saveStorage;
   std::shared_ptr<IScriptStorage> scriptStorage;
   bool saveStorageBusy = false;
   std::shared_ptr<VirtualMachine> vm;
   uint32_t nextId = 0xff000000;
-  std::deque<TimerEntry> timers;
+  TimerQueue<Viet::Promise<Viet::Void>> timers;
+  TimerQueue<uint32_t> relootTimers;
+  TimerQueue<FormHandle> singleUpdates;
+
+  // Pending timers of forms, cancelled on destroy
+  std::unordered_map<uint32_t, TimerQueue<uint32_t>::Handle>
+    relootTimerByFormId;
+  std::unordered_map<uint32_t, TimerQueue<FormHandle>::Handle>
+    singleUpdateByFormId;
+
+  TimerStats timerStats;
   std::shared_ptr<HeuristicPolicy> policy;
   std::unordered_map<uint32_t, MpChangeForm> changeFormsForDeferredLoad;
   bool chunkLoadingInProgress = false;
   bool formLoadingInProgress = false;
   std::map<std::string, std::chrono::system_clock::duration>
     relootTimeForTypes;
+  std::unique_ptr<ChunkPreloader> chunkPreloader;
+
+  // Keyed by ordered form id pairs
+  using FormIdPair = std::pair<uint32_t, uint32_t>;
+  std::chrono::system_clock::duration unsubscribeGracePeriod{ 0 };
+  std::map<FormIdPair, std::chrono::system_clock::time_point>
+    deferredUnsubscribes;
+
+  // In deadline order. Stale entries are skipped
+  std::deque<std::pair<FormIdPair, std::chrono::system_clock::time_point>>
+    deferredUnsubscribesQueue;
 };
 
+namespace {
+std::pair<uint32_t, uint32_t> MakeFormIdPair(MpObjectReference* a,
+                                             MpObjectReference* b)
+{
+  return std::minmax(a->GetFormId(), b->GetFormId());
+}
+}
+
 WorldState::WorldState()
 {
   logger.reset(new spdlog::logger("empty logger"));
@@ -71,8 +154,16 @@ WorldState::WorldState()
 void WorldState::Clear()
 {
   forms.clear();
+  formTable.Clear();
   grids.clear();
   formIdxManager.reset();
+  formHandleByIdx.clear();
+  pImpl->relootTimers.Clear();
+  pImpl->relootTimerByFormId.clear();
+  pImpl->singleUpdates.Clear();
+  pImpl->singleUpdateByFormId.clear();
+  pImpl->deferredUnsubscribes.clear();
+  pImpl->deferredUnsubscribesQueue.clear();
 }
 
 void WorldState::AttachEspm(espm::Loader* espm_,
@@ -108,24 +199,27 @@ void WorldState::AddForm(std::unique_ptr<MpForm> form, uint32_t formId,
         .str());
   }
   form->Init(this, formId, optionalChangeFormToApply != nullptr);
+  form->handle = formTable.Insert(form.get(), form->typeFlags);
 
-  if (auto formIndex = dynamic_cast<FormIndex*>(form.get())) {
+  if (auto formIndex = FormCast<MpObjectReference>(form.get())) {
     if (!formIdxManager)
       formIdxManager.reset(new MakeID(FormIndex::g_invalidIdx - 1));
     if (!formIdxManager->CreateID(formIndex->idx))
       throw std::runtime_error("CreateID failed");
 
-    if (formByIdxUnreliable.size() <= formIndex->idx)
-      formByIdxUnreliable.resize(formIndex->idx + 1, nullptr);
-    formByIdxUnreliable[formIndex->idx] = form.get();
+    if (formHandleByIdx.size() <= formIndex->idx)
+      formHandleByIdx.resize(formIndex->idx + 1);
+    formHandleByIdx[formIndex->idx] = form->handle;
   }
 
   auto it = forms.insert({ formId, std::move(form) }).first;
 
   if (optionalChangeFormToApply) {
-    auto refr = dynamic_cast<MpObjectReference*>(it->second.get());
+    auto refr = FormCast<MpObjectReference>(it->second.get());
     if (!refr) {
-      forms.erase(it); // Rollback changes due to exception
+      // Rollback changes due to exception
+      ReleaseFormSlots(it->second.get());
+      forms.erase(it);
       throw std::runtime_error(
         "Unable to apply ChangeForm, cast to ObjectReference failed");
     }
@@ -133,50 +227,145 @@ void WorldState::AddForm(std::unique_ptr<MpForm> form, uint32_t formId,
   }
 }
 
-void WorldState::TickTimers()
+void WorldState::TickTimers(std::chrono::system_clock::time_point now)
 {
-  const auto now = std::chrono::system_clock::now();
+  using Phase = TickScheduler::Phase;
+  using Budget = TickScheduler::Budget;
+
+  const auto tickStart = std::chrono::steady_clock::now();
+  auto& stats = pImpl->timerStats;
+
+  tickScheduler.Run(Phase::Reloot, [&](const Budget& budget) {
+    stats.numFired += pImpl->relootTimers.Tick(
+      now,
+      [&](uint32_t formId) {
+        pImpl->relootTimerByFormId.erase(formId);
+        auto relootTarget =
+          FormCast<MpObjectReference>(LookupFormById(formId));
+        if (relootTarget)
+          relootTarget->DoReloot();
+      },
+      [&] { return budget.IsExhausted(); });
+    return HasDueTimers(pImpl->relootTimers, now);
+  });
 
-  // Tick Reloot
-  for (auto& p : relootTimers) {
-    auto& list = p.second;
-    while (!list.empty() && list.begin()->second <= now) {
-      uint32_t relootTargetId = list.begin()->first;
-      auto relootTarget = std::dynamic_pointer_cast<MpObjectReference>(
-        LookupFormById(relootTargetId));
-      if (relootTarget)
-        relootTarget->DoReloot();
+  tickScheduler.Run(Phase::SaveCollection, [&](const Budget& budget) {
+    if (!pImpl->saveStorage)
+      return false;
+    pImpl->saveStorage->Tick();
 
-      list.pop_front();
+    auto& changes = pImpl->changes;
+    auto& changeOrder = pImpl->changeOrder;
+    for (auto& [formId, changeForm] : pImpl->failedSaves) {
+      auto [it, inserted] = changes.try_emplace(formId);
+      if (inserted)
+        changeOrder.push_back(formId);
+
+      auto formIt = forms.find(formId);
+      auto refr = formIt == forms.end()
+        ? nullptr
+        : FormCast<MpObjectReference>(formIt->second.get());
+      if (it->second)
+        it->second->dirtyFields |= changeForm.dirtyFields;
+      else if (refr)
+        refr->MarkDirtyFields(changeForm.dirtyFields);
+      else
+        it->second = std::move(changeForm);
     }
-  }
+    pImpl->failedSaves.clear();
 
-  // Tick Save Storage
-  if (pImpl->saveStorage) {
-    pImpl->saveStorage->Tick();
+    if (changes.empty())
+      changeOrder.clear(); // Only cancelled ones are left
+    if (pImpl->saveStorageBusy || changes.empty())
+      return false;
 
-    auto& changes = pImpl->changes;
-    if (!pImpl->saveStorageBusy && !changes.empty()) {
-      pImpl->saveStorageBusy = true;
-      std::vector<MpChangeForm> changeForms;
-      changeForms.reserve(changes.size());
-      for (auto [formId, changeForm] : changes)
-        changeForms.push_back(changeForm);
-      changes.clear();
-
-      auto pImpl_ = pImpl;
-      pImpl->saveStorage->Upsert(
-        changeForms, [pImpl_] { pImpl_->saveStorageBusy = false; });
+    // Changes left over budget go to the next batch
+    pImpl->saveStorageBusy = true;
+    std::vector<uint32_t> formIds;
+    std::vector<MpChangeForm> changeForms;
+    changeForms.reserve(changes.size());
+    while (!changeOrder.empty() &&
+           !(!changeForms.empty() && budget.IsExhausted())) {
+      auto it = changes.find(changeOrder.front());
+      changeOrder.pop_front();
+      if (it == changes.end())
+        continue;
+
+      if (it->second) {
+        formIds.push_back(it->first);
+        changeForms.push_back(std::move(*it->second));
+      } else {
+        auto formIt = forms.find(it->first);
+        auto refr = formIt == forms.end()
+          ? nullptr
+          : FormCast<MpObjectReference>(formIt->second.get());
+        if (refr) {
+          formIds.push_back(it->first);
+          changeForms.push_back(refr->GetChangeForm());
+          refr->ClearDirtyFields();
+        }
+      }
+      changes.erase(it);
+    }
+    if (changeForms.empty()) {
+      pImpl->saveStorageBusy = false;
+      return !changes.empty();
     }
-  }
 
-  // Tick RegisterForSingleUpdate
-  auto& timers = pImpl->timers;
-  while (!timers.empty() && now >= timers.front().finish) {
-    auto front = std::move(timers.front());
-    timers.pop_front();
-    front.promise.Resolve(Viet::Void());
-  }
+    // Dirty fields are cleared on collection, so a failed batch keeps its
+    // change forms to restore them
+    auto pImpl_ = pImpl;
+    auto batch =
+      std::make_shared<std::vector<MpChangeForm>>(std::move(changeForms));
+    pImpl->saveStorage->Upsert(
+      *batch, [pImpl_, batch, formIds = std::move(formIds)](bool succeeded) {
+        pImpl_->saveStorageBusy = false;
+        if (succeeded)
+          return;
+        for (size_t i = 0; i < formIds.size(); ++i)
+          pImpl_->failedSaves.push_back(
+            { formIds[i], std::move((*batch)[i]) });
+      });
+    return !changes.empty() || !pImpl->failedSaves.empty();
+  });
+
+  tickScheduler.Run(Phase::Timers, [&](const Budget& budget) {
+    const bool unsubscribesLeft = TickDeferredUnsubscribes(now, budget);
+    stats.numFired += pImpl->timers.Tick(
+      now,
+      [](Viet::Promise<Viet::Void>& promise) {
+        promise.Resolve(Viet::Void());
+      },
+      [&] { return budget.IsExhausted(); });
+    return unsubscribesLeft || HasDueTimers(pImpl->timers, now);
+  });
+
+  // OnUpdate events of RegisterForSingleUpdate
+  tickScheduler.Run(Phase::ScriptEvents, [&](const Budget& budget) {
+    stats.numFired += pImpl->singleUpdates.Tick(
+      now,
+      [&](FormHandle handle) {
+        if (auto form = LookupForm(handle)) {
+          pImpl->singleUpdateByFormId.erase(form->GetFormId());
+          form->Update();
+        }
+      },
+      [&] { return budget.IsExhausted(); });
+    return HasDueTimers(pImpl->singleUpdates, now);
+  });
+
+  stats.lastTickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - tickStart)
+                       .count();
+  stats.maxTickNs = std::max(stats.maxTickNs, stats.lastTickNs);
+}
+
+WorldState::TimerStats WorldState::GetTimerStats() const
+{
+  auto res = pImpl->timerStats;
+  res.numTimers = pImpl->timers.GetSize() + pImpl->singleUpdates.GetSize();
+  res.numRelootTimers = pImpl->relootTimers.GetSize();
+  return res;
 }
 
 void WorldState::LoadChangeForm(const MpChangeForm& changeForm,
@@ -210,7 +399,7 @@ void WorldState::LoadChangeForm(const MpChangeForm& changeForm,
   if (formId < 0xff000000) {
     auto it = forms.find(formId);
     if (it != forms.end()) {
-      auto refr = std::dynamic_pointer_cast<MpObjectReference>(it->second);
+      auto refr = FormCast<MpObjectReference>(it->second.get());
       if (refr) {
         refr->ApplyChangeForm(changeForm);
       }
@@ -250,47 +439,47 @@ void WorldState::LoadChangeForm(const MpChangeForm& changeForm,
 void WorldState::RequestReloot(MpObjectReference& ref,
                                std::chrono::system_clock::duration time)
 {
-  auto& list = relootTimers[time];
-  list.push_back({ ref.GetFormId(), std::chrono::system_clock::now() + time });
+  // A new request replaces the pending one
+  auto& handle = pImpl->relootTimerByFormId[ref.GetFormId()];
+  pImpl->relootTimers.Cancel(handle);
+  handle = pImpl->relootTimers.Add(std::chrono::system_clock::now() + time,
+                                   ref.GetFormId());
 }
 
 void WorldState::RequestSave(MpObjectReference& ref)
 {
   if (!pImpl->formLoadingInProgress) {
-    pImpl->changes[ref.GetFormId()] = ref.GetChangeForm();
+    auto [it, inserted] = pImpl->changes.try_emplace(ref.GetFormId());
+    if (inserted)
+      pImpl->changeOrder.push_back(ref.GetFormId());
+    else
+      it->second.reset();
   }
 }
 
+void WorldState::CancelSave(uint32_t formId)
+{
+  pImpl->changes.erase(formId);
+}
+
 void WorldState::RegisterForSingleUpdate(const VarValue& self, float seconds)
 {
-  SetTimer(seconds).Then([self](Viet::Void) {
-    if (auto form = GetFormPtr<MpForm>(self))
-      form->Update();
-  });
+  auto form = GetFormPtr<MpForm>(self);
+  if (!form)
+    return;
+
+  // Like in Skyrim, the latest registration replaces the pending one
+  const auto formId = form->GetFormId();
+  auto& handle = pImpl->singleUpdateByFormId[formId];
+  pImpl->singleUpdates.Cancel(handle);
+  handle =
+    pImpl->singleUpdates.Add(GetTimerFinish(seconds), form->GetHandle());
 }
 
 Viet::Promise<Viet::Void> WorldState::SetTimer(float seconds)
 {
   Viet::Promise<Viet::Void> promise;
-
-  auto finish = std::chrono::system_clock::now() +
-    std::chrono::milliseconds(static_cast<int>(seconds * 1000));
-
-  bool sortRequired = false;
-
-  if (!pImpl->timers.empty() && finish > pImpl->timers.front().finish) {
-    sortRequired = true;
-  }
-
-  pImpl->timers.push_front({ promise, finish });
-
-  if (sortRequired) {
-    std::sort(pImpl->timers.begin(), pImpl->timers.end(),
-              [](const TimerEntry& lhs, const TimerEntry& rhs) {
-                return lhs.finish < rhs.finish;
-              });
-  }
-
+  pImpl->timers.Add(GetTimerFinish(seconds), promise);
   return promise;
 }
 
@@ -310,75 +499,9 @@ const std::shared_ptr<MpForm>& WorldState::LookupFormById(uint32_t formId)
   return it->second;
 }
 
-bool WorldState::AttachEspmRecord(const espm::CombineBrowser& br,
-                                  espm::RecordHeader* record,
-                                  const espm::IdMapping& mapping)
+bool WorldState::AttachEspmRecord(uint32_t formId,
+                                  const ChunkPreloader::Refr& record)
 {
-  auto refr = reinterpret_cast<espm::REFR*>(record);
-  auto data = refr->GetData();
-
-  auto baseId = espm::GetMappedId(data.baseId, mapping);
-  auto base = br.LookupById(baseId);
-  if (!base.rec) {
-    logger->info("baseId {} {}", baseId, static_cast<void*>(base.rec));
-    return false;
-  }
-
-  espm::Type t = base.rec->GetType();
-  if (t != "NPC_" && t != "FURN" && t != "ACTI" && !espm::IsItem(t) &&
-      t != "DOOR" && t != "CONT" &&
-      (t != "FLOR" ||
-       !reinterpret_cast<espm::FLOR*>(base.rec)->GetData().resultItem) &&
-      (t != "TREE" ||
-       !reinterpret_cast<espm::TREE*>(base.rec)->GetData().resultItem))
-    return false;
-
-  // TODO: Load disabled references
-  enum
-  {
-    InitiallyDisabled = 0x800
-  };
-  if (refr->GetFlags() & InitiallyDisabled)
-    return false;
-
-  if (t == "NPC_") {
-    auto npcData =
-      reinterpret_cast<espm::NPC_*>(base.rec)->GetData(GetEspmCache());
-    if (npcData.isEssential || npcData.isProtected)
-      return false;
-
-    enum
-    {
-      CrimeFactionsList = 0x26953
-    };
-
-    auto formListLookupRes = br.LookupById(CrimeFactionsList);
-    auto formList = reinterpret_cast<espm::FLST*>(formListLookupRes.rec);
-    auto formIds = formList->GetData().formIds;
-    for (auto& formId : formIds) {
-      formId = formListLookupRes.ToGlobalId(formId);
-    }
-
-    for (auto fact : npcData.factions) {
-      auto it = std::find(formIds.begin(), formIds.end(),
-                          base.ToGlobalId(fact.formId));
-      if (it != formIds.end()) {
-        logger->info("Skipping actor {0:x} because it's in faction {0:x}",
-                     record->GetId(), *it);
-        return false;
-      }
-    }
-  }
-
-  auto formId = espm::GetMappedId(record->GetId(), mapping);
-  auto locationalData = data.loc;
-
-  uint32_t worldOrCell = espm::GetWorldOrCell(record);
-  if (!worldOrCell) {
-    logger->info("Anomally: refr without world/cell");
-    return false;
-  }
-
   // This function dosen't use LookupFormById to prevent recursion
   auto existing = forms.find(formId);
 
@@ -386,36 +509,28 @@ bool WorldState::AttachEspmRecord(const espm::CombineBrowser& br,
     auto existingAsRefr =
       reinterpret_cast<MpObjectReference*>(existing->second.get());
 
-    if (locationalData) {
-      existingAsRefr->SetPosAndAngleSilent(GetPos(locationalData),
-                                           GetRot(locationalData));
+    if (record.hasLocationalData) {
+      existingAsRefr->SetPosAndAngleSilent(record.pos, record.rot);
 
-      assert(existingAsRefr->GetPos() == NiPoint3(GetPos(locationalData)));
+      assert(existingAsRefr->GetPos() == record.pos);
     }
 
   } else {
-    if (!locationalData) {
+    if (!record.hasLocationalData) {
       logger->info("Anomally: refr without locationalData");
       return false;
     }
 
-    std::optional<NiPoint3> primitiveBoundsDiv2;
-    if (data.boundsDiv2)
-      primitiveBoundsDiv2 =
-        NiPoint3(data.boundsDiv2[0], data.boundsDiv2[1], data.boundsDiv2[2]);
-
-    auto typeStr = t.ToString();
     std::unique_ptr<MpForm> form;
-    LocationalData formLocationalData = { GetPos(locationalData),
-                                          GetRot(locationalData),
-                                          worldOrCell };
-    if (t != "NPC_") {
-      form.reset(new MpObjectReference(formLocationalData,
-                                       formCallbacksFactory(), baseId,
-                                       typeStr.data(), primitiveBoundsDiv2));
+    LocationalData formLocationalData = { record.pos, record.rot,
+                                          record.worldOrCell };
+    if (record.baseType != "NPC_") {
+      form.reset(new MpObjectReference(
+        formLocationalData, formCallbacksFactory(), record.baseId,
+        record.baseType.data(), record.boundsDiv2));
     } else {
-      form.reset(
-        new MpActor(formLocationalData, formCallbacksFactory(), baseId));
+      form.reset(new MpActor(formLocationalData, formCallbacksFactory(),
+                             record.baseId));
     }
     AddForm(std::move(form), formId, true);
     // Do not TriggerFormInitEvent here, doing it later after changeForm apply
@@ -425,20 +540,23 @@ bool WorldState::AttachEspmRecord(const espm::CombineBrowser& br,
 }
 
 bool WorldState::LoadForm(uint32_t formId)
+{
+  return LoadPreparedForm(ChunkPreloader::PrepareForm(
+    GetEspm().GetBrowser(), formId, GetEspmCache(), logger.get()));
+}
+
+bool WorldState::LoadPreparedForm(const ChunkPreloader::Form& form)
 {
   bool atLeastOneLoaded = false;
-  auto& br = GetEspm().GetBrowser();
-  auto lookupResults = br.LookupByIdAll(formId);
-  for (auto& lookupRes : lookupResults) {
-    auto mapping = br.GetMapping(lookupRes.fileIdx);
-    if (AttachEspmRecord(br, lookupRes.rec, *mapping)) {
+  for (auto& record : form.records) {
+    if (AttachEspmRecord(form.formId, record)) {
       atLeastOneLoaded = true;
     }
   }
 
   if (atLeastOneLoaded) {
-    auto& refr = GetFormAt<MpObjectReference>(formId);
-    auto it = pImpl->changeFormsForDeferredLoad.find(formId);
+    auto& refr = GetFormAt<MpObjectReference>(form.formId);
+    auto it = pImpl->changeFormsForDeferredLoad.find(form.formId);
     if (it != pImpl->changeFormsForDeferredLoad.end()) {
       refr.ApplyChangeForm(it->second);
       pImpl->changeFormsForDeferredLoad.erase(it);
@@ -450,6 +568,22 @@ bool WorldState::LoadForm(uint32_t formId)
   return atLeastOneLoaded;
 }
 
+void WorldState::LoadChunk(uint32_t cellOrWorld, int16_t x, int16_t y)
+{
+  std::optional<ChunkPreloader::Chunk> chunk;
+  if (pImpl->chunkPreloader)
+    chunk = pImpl->chunkPreloader->Take(cellOrWorld, x, y);
+  if (!chunk) {
+    chunk = ChunkPreloader::PrepareChunk(
+      espm->GetBrowser(), cellOrWorld, x, y, GetEspmCache(), logger.get());
+  }
+
+  for (auto& form : chunk->forms) {
+    assert(form.formId < 0xff000000);
+    LoadPreparedForm(form);
+  }
+}
+
 void WorldState::SendPapyrusEvent(MpForm* form, const char* eventName,
                                   const VarValue* arguments,
                                   size_t argumentsCount)
@@ -463,7 +597,7 @@ void WorldState::SendPapyrusEvent(MpForm* form, const char* eventName,
   return vm.SendEvent(form->ToGameObject(), eventName, args, onEnter);
 }
 
-const std::set<MpObjectReference*>& WorldState::GetReferencesAtPosition(
+WorldState::ReferencesView WorldState::GetReferencesAtPosition(
   uint32_t cellOrWorld, int16_t cellX, int16_t cellY)
 {
   if (espm && !pImpl->chunkLoadingInProgress) {
@@ -475,20 +609,14 @@ const std::set<MpObjectReference*>& WorldState::GetReferencesAtPosition(
       &pImpl->chunkLoadingInProgress);
     pImpl->chunkLoadingInProgress = true;
 
-    auto& br = espm->GetBrowser();
-    for (int16_t x = cellX - 1; x <= cellX + 1; ++x) {
-      for (int16_t y = cellY - 1; y <= cellY + 1; ++y) {
+    const auto settings = GetGridInfo(cellOrWorld).settings;
+    const auto rangeX = GetChunkRange(settings, cellX);
+    const auto rangeY = GetChunkRange(settings, cellY);
+    for (int16_t x = rangeX.first; x <= rangeX.second; ++x) {
+      for (int16_t y = rangeY.first; y <= rangeY.second; ++y) {
         const bool loaded = grids[cellOrWorld].loadedChunks[x][y];
         if (!loaded) {
-          auto records = br.GetRecordsAtPos(cellOrWorld, x, y);
-          for (size_t i = 0; i < espmFiles.size(); ++i) {
-            auto mapping = br.GetMapping(i);
-            for (auto rec : *records[i]) {
-              auto mappedId = espm::GetMappedId(rec->GetId(), *mapping);
-              assert(mappedId < 0xff000000);
-              LoadForm(mappedId);
-            }
-          }
+          LoadChunk(cellOrWorld, x, y);
           // Do not keep "loaded" reference here since LoadForm would
           // invalidate this reference
           grids[cellOrWorld].loadedChunks[x][y] = true;
@@ -497,25 +625,53 @@ const std::set<MpObjectReference*>& WorldState::GetReferencesAtPosition(
     }
   }
 
-  auto& neighbours =
-    grids[cellOrWorld].grid->GetNeighboursByPosition(cellX, cellY);
-  return neighbours;
+  return GetGridInfo(cellOrWorld).grid->GetNeighboursByPosition(cellX, cellY);
 }
 
 MpForm* WorldState::LookupFormByIdx(int idx)
 {
   if (formIdxManager) {
-    if (idx >= 0 && idx < formByIdxUnreliable.size()) {
-      auto form = formByIdxUnreliable[idx];
-      if (auto formIndex = dynamic_cast<FormIndex*>(form)) {
-        if (formIndex->GetIdx() == idx)
-          return form;
-      }
+    if (idx >= 0 && idx < formHandleByIdx.size()) {
+      auto refr = formTable.Resolve<MpObjectReference>(formHandleByIdx[idx]);
+      if (refr && refr->GetIdx() == idx)
+        return refr;
     }
   }
   return nullptr;
 }
 
+void WorldState::ReleaseFormSlots(MpForm* form)
+{
+  SnapshotPendingSave(form);
+
+  if (auto formIndex = FormCast<MpObjectReference>(form)) {
+    if (formIdxManager && !formIdxManager->DestroyID(formIndex->idx))
+      throw std::runtime_error("DestroyID failed");
+  }
+  formTable.Erase(form->handle);
+
+  auto relootIt = pImpl->relootTimerByFormId.find(form->GetFormId());
+  if (relootIt != pImpl->relootTimerByFormId.end()) {
+    pImpl->relootTimers.Cancel(relootIt->second);
+    pImpl->relootTimerByFormId.erase(relootIt);
+  }
+
+  auto updateIt = pImpl->singleUpdateByFormId.find(form->GetFormId());
+  if (updateIt != pImpl->singleUpdateByFormId.end()) {
+    pImpl->singleUpdates.Cancel(updateIt->second);
+    pImpl->singleUpdateByFormId.erase(updateIt);
+  }
+}
+
+void WorldState::SnapshotPendingSave(MpForm* form)
+{
+  auto it = pImpl->changes.find(form->GetFormId());
+  if (it == pImpl->changes.end() || it->second)
+    return;
+  if (auto refr = FormCast<MpObjectReference>(form))
+    it->second = refr->GetChangeForm();
+}
+
 espm::Loader& WorldState::GetEspm() const
 {
   if (!espm)
@@ -687,4 +843,317 @@ std::optional<std::chrono::system_clock::duration> WorldState::GetRelootTime(
     return std::nullopt;
   }
   return it->second;
+}
+
+void WorldState::SetGridHysteresis(
+  float margin, std::chrono::system_clock::duration gracePeriod)
+{
+  gridHysteresisMargin = std::max(margin, 0.f);
+  pImpl->unsubscribeGracePeriod =
+    std::max(gracePeriod, std::chrono::system_clock::duration::zero());
+}
+
+void WorldState::SetGridSettings(uint32_t cellOrWorld,
+                                 const GridSettings& settings)
+{
+  if (settings.cellSize <= 0 || settings.viewRadius < 0)
+    throw std::runtime_error("Invalid grid settings");
+  if (grids.find(cellOrWorld) != grids.end()) {
+    std::stringstream ss;
+    ss << "Grid of " << std::hex << cellOrWorld << " already exists";
+    throw std::runtime_error(ss.str());
+  }
+  gridSettings[cellOrWorld] = settings;
+}
+
+void WorldState::SetDefaultGridSettings(const GridSettings& settings)
+{
+  if (settings.cellSize <= 0 || settings.viewRadius < 0)
+    throw std::runtime_error("Invalid grid settings");
+  if (!grids.empty())
+    throw std::runtime_error("Grids already exist");
+  defaultGridSettings = settings;
+}
+
+const WorldState::GridSettings& WorldState::GetGridSettings(
+  uint32_t cellOrWorld) const
+{
+  auto it = gridSettings.find(cellOrWorld);
+  return it == gridSettings.end() ? defaultGridSettings : it->second;
+}
+
+WorldState::GridInfo& WorldState::GetGridInfo(uint32_t cellOrWorld)
+{
+  auto& gridInfo = grids[cellOrWorld];
+  if (!gridInfo.grid) {
+    gridInfo.settings = GetGridSettings(cellOrWorld);
+    gridInfo.grid = std::make_shared<FlatGridImpl<MpObjectReference*>>(
+      gridInfo.settings.viewRadius);
+  }
+  return gridInfo;
+}
+
+float WorldState::GetGridHysteresisMargin() const
+{
+  return gridHysteresisMargin;
+}
+
+const WorldState::GridChurnStats& WorldState::GetGridChurnStats() const
+{
+  return gridChurnStats;
+}
+
+bool WorldState::DeferUnsubscribe(MpObjectReference* a, MpObjectReference* b)
+{
+  if (pImpl->unsubscribeGracePeriod.count() == 0)
+    return false;
+
+  auto key = MakeFormIdPair(a, b);
+  auto deadline =
+    std::chrono::system_clock::now() + pImpl->unsubscribeGracePeriod;
+  if (pImpl->deferredUnsubscribes.insert({ key, deadline }).second) {
+    pImpl->deferredUnsubscribesQueue.push_back({ key, deadline });
+    ++gridChurnStats.numUnsubscribesDeferred;
+  }
+  return true;
+}
+
+bool WorldState::CancelDeferredUnsubscribe(MpObjectReference* a,
+                                           MpObjectReference* b)
+{
+  if (pImpl->deferredUnsubscribes.erase(MakeFormIdPair(a, b)) == 0)
+    return false;
+  ++gridChurnStats.numUnsubscribesCancelled;
+  return true;
+}
+
+bool WorldState::TickDeferredUnsubscribes(
+  std::chrono::system_clock::time_point now,
+  const TickScheduler::Budget& budget)
+{
+  auto& queue = pImpl->deferredUnsubscribesQueue;
+  size_t numProcessed = 0;
+  while (!queue.empty() && queue.front().second <= now) {
+    if (numProcessed++ > 0 && budget.IsExhausted())
+      return true;
+
+    auto [key, deadline] = queue.front();
+    queue.pop_front();
+
+    auto it = pImpl->deferredUnsubscribes.find(key);
+    if (it == pImpl->deferredUnsubscribes.end() || it->second != deadline)
+      continue;
+    pImpl->deferredUnsubscribes.erase(it);
+
+    auto a = FormCast<MpObjectReference>(LookupFormById(key.first).get());
+    auto b = FormCast<MpObjectReference>(LookupFormById(key.second).get());
+    if (!a || !b || !a->GetListeners().count(b))
+      continue;
+
+    // Both refs may have been moved by teleports or cell changes since
+    const int radius = GetGridSettings(a->GetCellOrWorld()).viewRadius;
+    auto& posA = a->subscribedGridPos;
+    auto& posB = b->subscribedGridPos;
+    const bool neighbours = a->everSubscribedOrListened &&
+      b->everSubscribedOrListened && !a->IsDisabled() && !b->IsDisabled() &&
+      a->GetCellOrWorld() == b->GetCellOrWorld() &&
+      std::abs(posA.first - posB.first) <= radius &&
+      std::abs(posA.second - posB.second) <= radius;
+    if (neighbours)
+      continue;
+
+    MpObjectReference::Unsubscribe(a, b);
+    MpObjectReference::Unsubscribe(b, a);
+    ++gridChurnStats.numUnsubscribesExpired;
+  }
+  return false;
+}
+
+void WorldState::EnableChunkPreloading(bool enable)
+{
+  pImpl->chunkPreloader.reset(
+    enable ? new ChunkPreloader(GetEspm().GetBrowser(), logger) : nullptr);
+}
+
+ChunkPreloader::Stats WorldState::GetChunkPreloaderStats() const
+{
+  return pImpl->chunkPreloader ? pImpl->chunkPreloader->GetStats()
+                               : ChunkPreloader::Stats();
+}
+
+void WorldState::PreloadChunksAhead(uint32_t cellOrWorld,
+                                    std::pair<int16_t, int16_t> from,
+                                    std::pair<int16_t, int16_t> to)
+{
+  if (!pImpl->chunkPreloader)
+    return;
+
+  // The window the ref reaches if it keeps moving in the same direction
+  auto sign = [](int v) { return (v > 0) - (v < 0); };
+  const int16_t aheadX = to.first + sign(to.first - from.first);
+  const int16_t aheadY = to.second + sign(to.second - from.second);
+
+  auto& gridInfo = GetGridInfo(cellOrWorld);
+  const auto rangeX = GetChunkRange(gridInfo.settings, aheadX);
+  const auto rangeY = GetChunkRange(gridInfo.settings, aheadY);
+  for (int16_t x = rangeX.first; x <= rangeX.second; ++x) {
+    auto column = gridInfo.loadedChunks.find(x);
+    for (int16_t y = rangeY.first; y <= rangeY.second; ++y) {
+      const bool loaded = column != gridInfo.loadedChunks.end() &&
+        column->second.count(y) && column->second.at(y);
+      if (!loaded)
+        pImpl->chunkPreloader->Request(cellOrWorld, x, y);
+    }
+  }
+}
+
+void WorldState::AddTrigger(MpObjectReference* ref,
+                            const Primitive::BoundingBox& boundingBox,
+                            const Primitive::OrientedBox& orientedBox)
+{
+  auto& gridInfo = GetGridInfo(ref->GetCellOrWorld());
+  auto [it, inserted] = gridInfo.triggerCells.try_emplace(ref);
+  if (!inserted)
+    return;
+
+  auto& settings = gridInfo.settings;
+  auto from = GetTriggerCellKey(settings, boundingBox.min);
+  auto to = GetTriggerCellKey(settings, boundingBox.max);
+  for (int16_t x = static_cast<int16_t>(from >> 16);
+       x <= static_cast<int16_t>(to >> 16); ++x) {
+    for (int16_t y = static_cast<int16_t>(from & 0xffff);
+         y <= static_cast<int16_t>(to & 0xffff); ++y) {
+      auto key = GetTriggerCellKey(
+        settings, { x * settings.cellSize, y * settings.cellSize, 0 });
+      auto& cell = gridInfo.triggers[key];
+      cell.refs.push_back(ref);
+      cell.boxes.push_back(orientedBox);
+      it->second.push_back(key);
+    }
+  }
+}
+
+void WorldState::RemoveTrigger(MpObjectReference* ref)
+{
+  auto gridIt = grids.find(ref->GetCellOrWorld());
+  if (gridIt == grids.end())
+    return;
+
+  auto& gridInfo = gridIt->second;
+  auto it = gridInfo.triggerCells.find(ref);
+  if (it == gridInfo.triggerCells.end())
+    return;
+
+  for (auto key : it->second) {
+    auto& cell = gridInfo.triggers[key];
+    auto refIt = std::find(cell.refs.begin(), cell.refs.end(), ref);
+    if (refIt != cell.refs.end()) {
+      auto i = refIt - cell.refs.begin();
+      cell.refs[i] = cell.refs.back();
+      cell.boxes[i] = cell.boxes.back();
+      cell.refs.pop_back();
+      cell.boxes.pop_back();
+    }
+  }
+  gridInfo.triggerCells.erase(it);
+}
+
+const WorldState::TriggerCell& WorldState::GetTriggersAt(
+  uint32_t cellOrWorld, const NiPoint3& pos)
+{
+  static const TriggerCell g_empty;
+
+  auto gridIt = grids.find(cellOrWorld);
+  if (gridIt == grids.end())
+    return g_empty;
+
+  auto& gridInfo = gridIt->second;
+  auto it = gridInfo.triggers.find(GetTriggerCellKey(gridInfo.settings, pos));
+  return it == gridInfo.triggers.end() ? g_empty : it->second;
+}
+
+std::vector<MpObjectReference*> WorldState::FindRefsInRadius(
+  const SpatialQuery& query)
+{
+  return FindNearestRefs(query, std::numeric_limits<size_t>::max());
+}
+
+std::vector<MpObjectReference*> WorldState::FindNearestRefs(
+  const SpatialQuery& query, size_t count)
+{
+  if (!std::isfinite(query.radius) || query.radius < 0)
+    throw std::runtime_error("Invalid radius");
+
+  std::vector<MpObjectReference*> res;
+  auto gridIt = grids.find(query.cellOrWorld);
+  if (gridIt == grids.end() || count == 0)
+    return res;
+
+  auto& gridInfo = gridIt->second;
+  auto& spatialIndex = gridInfo.spatialIndex;
+  const float cellSize = gridInfo.settings.cellSize;
+
+  auto baseIds = query.baseIds;
+  std::sort(baseIds.begin(), baseIds.end());
+  baseIds.erase(std::unique(baseIds.begin(), baseIds.end()), baseIds.end());
+
+  // Squared distances
+  std::vector<std::pair<float, MpObjectReference*>> found;
+  const float radiusSquared = query.radius * query.radius;
+  auto visit = [&](MpObjectReference* ref) {
+    auto& baseTypes = query.baseTypes;
+    if (!baseTypes.empty() &&
+        std::find(baseTypes.begin(), baseTypes.end(), ref->GetBaseType()) ==
+          baseTypes.end())
+      return;
+    auto d = ref->GetPos() - query.center;
+    auto distanceSquared = d * d;
+    if (distanceSquared <= radiusSquared)
+      found.push_back({ distanceSquared, ref });
+  };
+  auto closer = [](const std::pair<float, MpObjectReference*>& lhs,
+                   const std::pair<float, MpObjectReference*>& rhs) {
+    if (lhs.first != rhs.first)
+      return lhs.first < rhs.first;
+    return lhs.second->GetFormId() < rhs.second->GetFormId();
+  };
+
+  // Refs are indexed by subscription grid positions which may be up to the
+  // hysteresis margin away from their cells
+  const float margin = gridHysteresisMargin;
+  const int maxRing =
+    static_cast<int>(std::ceil((query.radius + margin) / cellSize)) + 1;
+  const double numRingCells = std::pow(2.0 * maxRing + 1, 2);
+
+  if (numRingCells > spatialIndex.GetNumCells()) {
+    // The radius covers most of the world, rings would visit empty cells
+    spatialIndex.VisitAll(baseIds, visit);
+  } else {
+    auto x = static_cast<int16_t>(query.center.x / cellSize);
+    auto y = static_cast<int16_t>(query.center.y / cellSize);
+    for (int ring = 0; ring <= maxRing; ++ring) {
+      VisitRing(x, y, ring, [&](int16_t cellX, int16_t cellY) {
+        spatialIndex.VisitCell(cellX, cellY, baseIds, visit);
+      });
+      if (found.size() < count)
+        continue;
+
+      std::nth_element(found.begin(), found.begin() + count - 1, found.end(),
+                       closer);
+      found.resize(count);
+
+      // Cells of the next rings are at least this far from the center
+      float minDistance = ring * cellSize - margin;
+      if (minDistance > 0 && found.back().first <= minDistance * minDistance)
+        break;
+    }
+  }
+
+  std::sort(found.begin(), found.end(), closer);
+  if (found.size() > count)
+    found.resize(count);
+  res.reserve(found.size());
+  for (auto& [distanceSquared, ref] : found)
+    res.push_back(ref);
+  return res;
 }
\ No newline at end of file
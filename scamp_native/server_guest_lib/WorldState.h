@@ -1,10 +1,16 @@
 #pragma once
+#include "ChunkPreloader.h"
+#include "FlatGrid.h"
 #include "FormIndex.h"
-#include "Grid.h"
+#include "FormTable.h"
 #include "GridElement.h"
 #include "MpChangeForms.h"
 #include "NiPoint3.h"
 #include "PartOneListener.h"
+#include "Primitive.h"
+#include "SpatialIndex.h"
+#include "TickScheduler.h"
+#include "TimerQueue.h"
 #include "VirtualMachine.h"
 #include <Loader.h>
 #include <MakeID.h>
@@ -19,6 +25,7 @@
 #include <sparsepp/spp.h>
 #include <spdlog/spdlog.h>
 #include <sstream>
+#include <unordered_map>
 
 #ifdef AddForm
 #  undef AddForm
@@ -57,25 +64,60 @@ public:
   void LoadChangeForm(const MpChangeForm& changeForm,
                       const FormCallbacks& callbacks);
 
-  void TickTimers();
+  void TickTimers(std::chrono::system_clock::time_point now =
+                    std::chrono::system_clock::now());
 
   void RequestReloot(MpObjectReference& ref,
                      std::chrono::system_clock::duration time);
 
   void RequestSave(MpObjectReference& ref);
 
+  // Forgets changes not yet passed to the save storage
+  void CancelSave(uint32_t formId);
+
   void RegisterForSingleUpdate(const VarValue& self, float seconds);
 
   Viet::Promise<Viet::Void> SetTimer(float seconds);
 
+  struct TimerStats
+  {
+    // Pending timers
+    uint64_t numTimers = 0;
+    uint64_t numRelootTimers = 0;
+
+    uint64_t numFired = 0;
+
+    // Wall time of TickTimers
+    uint64_t lastTickNs = 0;
+    uint64_t maxTickNs = 0;
+  };
+
+  TimerStats GetTimerStats() const;
+
+  // TickTimers runs reloot, save collection, timers and script events
+  // phases within their budgets. The host runs network apply
+  TickScheduler& GetTickScheduler() { return tickScheduler; }
+
   const std::shared_ptr<MpForm>& LookupFormById(uint32_t formId);
 
   MpForm* LookupFormByIdx(int idx);
 
+  // Returns nullptr if the form is destroyed or is not F
+  template <class F = MpForm>
+  F* LookupForm(FormHandle handle) const
+  {
+    return formTable.Resolve<F>(handle);
+  }
+
   void SendPapyrusEvent(MpForm* form, const char* eventName,
                         const VarValue* arguments, size_t argumentsCount);
 
-  const std::set<MpObjectReference*>& GetReferencesAtPosition(
+  using ReferencesView = FlatGridImpl<MpObjectReference*>::NeighbourView;
+
+  // Loads espm references of the cells within the view radius of the grid
+  // position (see GridSettings). The view is invalidated by any movement on
+  // the grid
+  ReferencesView GetReferencesAtPosition(
     uint32_t cellOrWorld, int16_t cellX, int16_t cellY);
 
   template <class F>
@@ -88,7 +130,7 @@ public:
       throw std::runtime_error(ss.str());
     }
 
-    auto typedForm = std::dynamic_pointer_cast<F>(form);
+    auto typedForm = FormCast<F>(form.get());
     if (!typedForm) {
       std::stringstream ss;
       ss << "Form with id " << std::hex << formId << " is not " << F::Type();
@@ -112,7 +154,7 @@ public:
     }
 
     auto& form = it->second;
-    if (!dynamic_cast<FormType*>(form.get())) {
+    if (!FormCast<FormType>(form.get())) {
       std::stringstream s;
       s << "Expected form " << std::hex << formId << " to be "
         << MpForm::GetFormType<FormType>() << ", but got "
@@ -121,14 +163,12 @@ public:
     }
 
     if (outDestroyedForm)
-      *outDestroyedForm = std::dynamic_pointer_cast<FormType>(it->second);
+      *outDestroyedForm = FormCast<FormType>(it->second);
 
+    SnapshotPendingSave(form.get());
     it->second->BeforeDestroy();
 
-    if (auto formIndex = dynamic_cast<FormIndex*>(form.get())) {
-      if (formIdxManager && !formIdxManager->DestroyID(formIndex->idx))
-        throw std::runtime_error("DestroyID failed");
-    }
+    ReleaseFormSlots(form.get());
 
     forms.erase(it);
   };
@@ -145,6 +185,67 @@ public:
   std::optional<std::chrono::system_clock::duration> GetRelootTime(
     std::string recordType) const;
 
+  struct GridSettings
+  {
+    // Units per grid cell side
+    float cellSize = 4096.f;
+
+    // Refs see refs up to viewRadius cells away
+    int16_t viewRadius = 1;
+  };
+
+  // Must be called before refs enter the cellOrWorld. The default applies
+  // to every cellOrWorld without its own settings
+  void SetGridSettings(uint32_t cellOrWorld, const GridSettings& settings);
+  void SetDefaultGridSettings(const GridSettings& settings);
+  const GridSettings& GetGridSettings(uint32_t cellOrWorld) const;
+
+  // Espm references of chunks ahead of moving refs are decoded on a worker
+  // thread. Requires espm
+  void EnableChunkPreloading(bool enable);
+  ChunkPreloader::Stats GetChunkPreloaderStats() const;
+
+  struct GridChurnStats
+  {
+    // Grid cell crossings that didn't change the subscription cell
+    uint64_t numCellChangesAvoided = 0;
+
+    uint64_t numUnsubscribesDeferred = 0;
+
+    // Deferred unsubscriptions dropped because refs became neighbours again
+    uint64_t numUnsubscribesCancelled = 0;
+
+    uint64_t numUnsubscribesExpired = 0;
+  };
+
+  // A ref keeps its subscription cell until it moves margin units past the
+  // cell border. Neighbours leaving the view window stay subscribed for
+  // gracePeriod and remain so if they come back in time. Zero disables
+  void SetGridHysteresis(float margin,
+                         std::chrono::system_clock::duration gracePeriod);
+  float GetGridHysteresisMargin() const;
+  const GridChurnStats& GetGridChurnStats() const;
+
+  struct SpatialQuery
+  {
+    uint32_t cellOrWorld = 0;
+    NiPoint3 center;
+    float radius = 0.f;
+
+    // Empty means any
+    std::vector<uint32_t> baseIds;
+    std::vector<std::string> baseTypes;
+  };
+
+  // Refs on the grid within the radius, closest first
+  std::vector<MpObjectReference*> FindRefsInRadius(const SpatialQuery& query);
+
+  // At most count closest refs on the grid within the radius, closest first.
+  // Visits cells in rings around the center until farther cells can't have
+  // closer refs
+  std::vector<MpObjectReference*> FindNearestRefs(const SpatialQuery& query,
+                                                  size_t count);
+
   std::vector<std::string> espmFiles;
   std::unordered_map<int32_t, std::set<uint32_t>> actorIdByProfileId;
   std::shared_ptr<spdlog::logger> logger;
@@ -160,30 +261,87 @@ public:
   bool isPapyrusHotReloadEnabled = false;
 
 private:
+  // Boxes are stored side by side to be tested in one batch
+  struct TriggerCell
+  {
+    std::vector<MpObjectReference*> refs;
+    std::vector<Primitive::OrientedBox> boxes;
+  };
+
   struct GridInfo
   {
-    std::shared_ptr<GridImpl<MpObjectReference*>> grid =
-      std::make_shared<GridImpl<MpObjectReference*>>();
+    GridSettings settings;
+    std::shared_ptr<FlatGridImpl<MpObjectReference*>> grid;
+
+    // Keyed by espm cell coordinates which don't depend on settings
     std::map<int16_t, std::map<int16_t, bool>> loadedChunks;
+
+    // Refs with primitives by grid cells their bounding boxes overlap
+    std::unordered_map<uint32_t, TriggerCell> triggers;
+    std::unordered_map<MpObjectReference*, std::vector<uint32_t>>
+      triggerCells;
+
+    // Refs by subscription grid positions and base ids
+    SpatialIndex<MpObjectReference*> spatialIndex;
   };
 
+  // Creates the grid with the cellOrWorld's settings if needed
+  GridInfo& GetGridInfo(uint32_t cellOrWorld);
+
+  // Owns forms, formTable is for handles and checked casts
   spp::sparse_hash_map<uint32_t, std::shared_ptr<MpForm>> forms;
+  FormTable formTable;
   spp::sparse_hash_map<uint32_t, GridInfo> grids;
   std::unique_ptr<MakeID> formIdxManager;
-  std::vector<MpForm*> formByIdxUnreliable;
-  std::map<
-    std::chrono::system_clock::duration,
-    std::list<std::pair<uint32_t, std::chrono::system_clock::time_point>>>
-    relootTimers;
+  std::vector<FormHandle> formHandleByIdx;
   espm::Loader* espm = nullptr;
   FormCallbacksFactory formCallbacksFactory;
   std::unique_ptr<espm::CompressedFieldsCache> espmCache;
 
-  bool AttachEspmRecord(const espm::CombineBrowser& br,
-                        espm::RecordHeader* record,
-                        const espm::IdMapping& mapping);
+  // Frees the form's idx and handle, cancels its timers
+  void ReleaseFormSlots(MpForm* form);
+
+  // Pending saves read forms when collected. Forms about to be destroyed
+  // must be read before
+  void SnapshotPendingSave(MpForm* form);
+
+  bool AttachEspmRecord(uint32_t formId, const ChunkPreloader::Refr& record);
 
   bool LoadForm(uint32_t formId);
+  bool LoadPreparedForm(const ChunkPreloader::Form& form);
+  void LoadChunk(uint32_t cellOrWorld, int16_t x, int16_t y);
+
+  // Requests chunks the ref moving from one grid position to another is
+  // likely to need next
+  void PreloadChunksAhead(uint32_t cellOrWorld,
+                          std::pair<int16_t, int16_t> from,
+                          std::pair<int16_t, int16_t> to);
+
+  // Indexes a ref with a primitive in its current cellOrWorld. Does nothing
+  // if the ref is indexed already
+  void AddTrigger(MpObjectReference* ref,
+                  const Primitive::BoundingBox& boundingBox,
+                  const Primitive::OrientedBox& orientedBox);
+  void RemoveTrigger(MpObjectReference* ref);
+
+  // Refs whose primitive bounding boxes overlap the grid cell of pos
+  const TriggerCell& GetTriggersAt(uint32_t cellOrWorld, const NiPoint3& pos);
+
+  // Returns false if the grace period is disabled
+  bool DeferUnsubscribe(MpObjectReference* a, MpObjectReference* b);
+
+  // Returns false if there was no deferred unsubscription
+  bool CancelDeferredUnsubscribe(MpObjectReference* a, MpObjectReference* b);
+
+  // Returns true if the budget ran out before all due entries were handled
+  bool TickDeferredUnsubscribes(std::chrono::system_clock::time_point now,
+                                const TickScheduler::Budget& budget);
+
+  GridSettings defaultGridSettings;
+  std::unordered_map<uint32_t, GridSettings> gridSettings;
+  float gridHysteresisMargin = 0;
+  GridChurnStats gridChurnStats;
+  TickScheduler tickScheduler;
 
   struct Impl;
   std::shared_ptr<Impl> pImpl;
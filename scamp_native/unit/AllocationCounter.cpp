@@ -0,0 +1,30 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local size_t g_numAllocations = 0;
+}
+
+size_t AllocationCounter::Get()
+{
+  return g_numAllocations;
+}
+
+void* operator new(std::size_t size)
+{
+  ++g_numAllocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+
+// Counts global operator new calls made by the current thread. The
+// replacements are defined in AllocationCounter.cpp
+namespace AllocationCounter {
+size_t Get();
+}
\ No newline at end of file
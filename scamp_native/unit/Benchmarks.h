@@ -1,8 +1,19 @@
+#include "AllocationCounter.h"
+#include "FlatGrid.h"
+#include "Grid.h"
+#include "PacketBuilder.h"
 #include "PartOne.h"
+#include "Primitive.h"
+#include "PropertyMessage.h"
 #include "TestUtils.hpp"
+#include "TimerQueue.h"
+#include <algorithm>
 #include <catch2/catch.hpp>
 #include <chrono>
+#include <cmath>
+#include <deque>
 #include <iostream>
+#include <random>
 
 class EmptySendTarget : public Networking::ISendTarget
 {
@@ -13,49 +24,688 @@ public:
   }
 };
 
-int n = 10;
+namespace LoadBenchmark {
+enum class Distribution
+{
+  SingleCell,
+  Clustered,
+  Uniform
+};
 
-std::string GetTimePassed(std::chrono::system_clock::time_point was)
+const char* GetDistributionName(Distribution distribution)
 {
-  auto count = std::chrono::duration_cast<std::chrono::microseconds>(
-                 std::chrono::system_clock::now() - was)
-                 .count() /
-    n;
-  return std::to_string(count) + " microseconds";
+  switch (distribution) {
+    case Distribution::SingleCell:
+      return "singleCell";
+    case Distribution::Clustered:
+      return "clustered";
+    case Distribution::Uniform:
+      return "uniform";
+  }
+  return "";
 }
 
-PartOne& GetPartOne();
+struct Config
+{
+  int numBots = 100;
+  Distribution distribution = Distribution::SingleCell;
+  int numTicks = 100;
+
+  // Client-side rates at 20 ticks per second: movement every tick,
+  // animation every second, equipment/activation/inventory less often
+  int animationPeriod = 20;
+  int equipmentPeriod = 200;
+  int activationPeriod = 100;
+  int inventoryPeriod = 200;
+};
+
+class CountingSendTarget : public Networking::ISendTarget
+{
+public:
+  void Send(Networking::UserId targetUserId, Networking::PacketData data,
+            size_t length, bool reliable) override
+  {
+    ++numPackets;
+    numBytes += length;
+  }
+
+  void SendMany(const std::vector<Networking::UserId>& targetUserIds,
+                Networking::PacketData data, size_t length,
+                bool reliable) override
+  {
+    numPackets += targetUserIds.size();
+    numBytes += length * targetUserIds.size();
+  }
+
+  uint64_t numPackets = 0;
+  uint64_t numBytes = 0;
+};
 
-void ExecuteBenchmark(int numPlayers)
+struct Bot
 {
-  PartOne& p = GetPartOne();
-  p.SetSendTarget(new EmptySendTarget);
+  uint32_t actorId = 0;
+  uint32_t idx = 0;
+  float pos[3] = { 0, 0, 0 };
+  float angleZ = 0;
+};
+
+constexpr uint32_t g_worldspace = 0x3c; // Tamriel
+constexpr float g_cellSize = 4096.f;
+constexpr float g_speedPerTick = 15.f; // Running at 20 ticks per second
+
+NiPoint3 GenerateSpawnPoint(Distribution distribution, std::mt19937& rng,
+                            const std::vector<NiPoint3>& clusters)
+{
+  std::uniform_real_distribution<float> cell(0, g_cellSize);
+  switch (distribution) {
+    case Distribution::SingleCell:
+      return { cell(rng), cell(rng), 0 };
+    case Distribution::Clustered: {
+      std::uniform_int_distribution<size_t> pick(0, clusters.size() - 1);
+      std::uniform_real_distribution<float> offset(-g_cellSize, g_cellSize);
+      auto& center = clusters[pick(rng)];
+      return { center.x + offset(rng), center.y + offset(rng), 0 };
+    }
+    case Distribution::Uniform:
+      break;
+  }
+  // Roughly the playable area of Tamriel
+  std::uniform_real_distribution<float> x(-200000, 200000),
+    y(-150000, 200000);
+  return { x(rng), y(rng), 0 };
+}
+
+double GetPercentile(std::vector<double> v, double q)
+{
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  auto i = std::min(v.size() - 1, static_cast<size_t>(q * v.size()));
+  return v[i];
+}
+
+// Simulates numBots connected players and returns per-tick statistics.
+// Messages of a tick are built before the tick is measured, so latency and
+// allocations belong to the server only. Activation and container
+// inventory need espm records, without them Activate messages are rejected
+// by the server and counted in rejectedMessages
+nlohmann::json Run(const Config& config)
+{
+  nlohmann::json res{
+    { "bots", config.numBots },
+    { "distribution", GetDistributionName(config.distribution) },
+    { "ticks", config.numTicks }
+  };
+
+  CountingSendTarget sendTarget;
+  PartOne partOne(&sendTarget);
+
+  std::mt19937 rng(1337);
+  std::vector<NiPoint3> clusters(16);
+  for (auto& center : clusters)
+    center = GenerateSpawnPoint(Distribution::Uniform, rng, {});
+
+  std::vector<Bot> bots(config.numBots);
+  std::uniform_real_distribution<float> angle(0, 360);
+  for (int i = 0; i < config.numBots; ++i) {
+    auto& bot = bots[i];
+    auto pos = GenerateSpawnPoint(config.distribution, rng, clusters);
+    bot.actorId = 0xff000000 + i;
+    bot.pos[0] = pos.x;
+    bot.pos[1] = pos.y;
+    bot.pos[2] = pos.z;
+    bot.angleZ = angle(rng);
+
+    DoConnect(partOne, i);
+    partOne.CreateActor(bot.actorId, pos, bot.angleZ, g_worldspace);
+    partOne.SetUserActor(i, bot.actorId);
+    bot.idx = partOne.worldState.GetFormAt<MpActor>(bot.actorId).GetIdx();
+  }
+
+  std::vector<double> tickUs;
+  uint64_t numBytes = 0, numPackets = 0, numAllocations = 0,
+           numIncoming = 0, numRejected = 0;
+  std::vector<std::pair<Networking::UserId, std::string>> incoming;
+
+  for (int tick = 0; tick < config.numTicks; ++tick) {
+    incoming.clear();
+    for (int i = 0; i < config.numBots; ++i) {
+      auto& bot = bots[i];
+
+      // Keep walking, turning a bit every tick
+      bot.angleZ += std::uniform_real_distribution<float>(-10, 10)(rng);
+      float radians = bot.angleZ / 180.f * acos(-1.f);
+      bot.pos[0] += g_speedPerTick * sin(radians);
+      bot.pos[1] += g_speedPerTick * cos(radians);
+
+      auto jMyMovement = jMovement;
+      jMyMovement["idx"] = bot.idx;
+      jMyMovement["data"]["pos"] = { bot.pos[0], bot.pos[1], bot.pos[2] };
+      jMyMovement["data"]["rot"] = { 0, 0, bot.angleZ };
+      jMyMovement["data"]["runMode"] = "Running";
+      incoming.push_back({ i, MakeMessage(jMyMovement) });
+
+      // Staggered so that every tick carries a share of each kind
+      if ((tick + i) % config.animationPeriod == 0) {
+        incoming.push_back(
+          { i,
+            MakeMessage({ { "t", MsgType::UpdateAnimation },
+                          { "idx", bot.idx },
+                          { "data",
+                            { { "animEventName", "JumpStandingStart" },
+                              { "numChanges", tick } } } }) });
+      }
+      if ((tick + i) % config.equipmentPeriod == 0) {
+        auto jMyEquipment = jEquipment;
+        jMyEquipment["idx"] = bot.idx;
+        incoming.push_back({ i, MakeMessage(jMyEquipment) });
+      }
+      if ((tick + i) % config.activationPeriod == 0) {
+        incoming.push_back(
+          { i,
+            MakeMessage({ { "t", MsgType::Activate },
+                          { "data",
+                            { { "caster", 0x14 },
+                              { "target", bots[(i + 1) % bots.size()]
+                                            .actorId } } } }) });
+      }
+    }
+    numIncoming += incoming.size();
+
+    const auto allocationsWere = AllocationCounter::Get();
+    const auto bytesWere = sendTarget.numBytes;
+    const auto packetsWere = sendTarget.numPackets;
+    const auto was = std::chrono::steady_clock::now();
+
+    for (auto& [userId, s] : incoming) {
+      try {
+        PartOne::HandlePacket(
+          &partOne, userId, Networking::PacketType::Message,
+          reinterpret_cast<Networking::PacketData>(s.data()), s.size());
+      } catch (std::exception&) {
+        ++numRejected;
+      }
+    }
+
+    // Server-side inventory changes, like looting or crafting results
+    for (int i = tick % config.inventoryPeriod; i < config.numBots;
+         i += config.inventoryPeriod) {
+      auto& actor = partOne.worldState.GetFormAt<MpActor>(bots[i].actorId);
+      actor.AddItem(0xf, 10); // Gold
+    }
+
+    partOne.Tick();
+
+    tickUs.push_back(std::chrono::duration<double, std::micro>(
+                       std::chrono::steady_clock::now() - was)
+                       .count());
+    numAllocations += AllocationCounter::Get() - allocationsWere;
+    numBytes += sendTarget.numBytes - bytesWere;
+    numPackets += sendTarget.numPackets - packetsWere;
+  }
+
+  const double numTicks = std::max(config.numTicks, 1);
+  res["tickUs"] = { { "p50", GetPercentile(tickUs, 0.5) },
+                    { "p99", GetPercentile(tickUs, 0.99) },
+                    { "max", GetPercentile(tickUs, 1) } };
+  res["incomingPerTick"] = numIncoming / numTicks;
+  res["outgoingPacketsPerTick"] = numPackets / numTicks;
+  res["outgoingBytesPerTick"] = numBytes / numTicks;
+  res["allocationsPerTick"] = numAllocations / numTicks;
+  res["rejectedMessages"] = numRejected;
+  return res;
+}
+
+nlohmann::json RunAll(const std::vector<int>& numBots, int numTicks)
+{
+  auto res = nlohmann::json::array();
+  for (int n : numBots) {
+    for (auto distribution : { Distribution::SingleCell,
+                               Distribution::Clustered,
+                               Distribution::Uniform }) {
+      Config config;
+      config.numBots = n;
+      config.distribution = distribution;
+      config.numTicks = numTicks;
+      res.push_back(Run(config));
+    }
+  }
+  return res;
+}
+}
+
+// Hidden, run with `unit [Benchmarks]`
+TEST_CASE("Load", "[.][Benchmarks]")
+{
+  auto res = LoadBenchmark::RunAll({ 100 }, 20);
+  std::cout << res.dump() << std::endl;
+  for (auto& run : res) {
+    REQUIRE(run["outgoingPacketsPerTick"] > 0);
+    REQUIRE(run["tickUs"]["p99"] >= run["tickUs"]["p50"]);
+  }
+}
+
+// Hidden, run with `unit [LoadBenchmark]` and keep the JSON between releases
+TEST_CASE("Load (full)", "[.][LoadBenchmark]")
+{
+  auto res = LoadBenchmark::RunAll({ 100, 500, 1000, 2000, 5000 }, 200);
+  std::cout << res.dump(2) << std::endl;
+}
+
+namespace GridBenchmark {
+struct Result
+{
+  double moveNs = 0;
+  double queryNs = 0;
+  uint64_t moveAllocations = 0;
+};
+
+// Objects random walk over side x side cells. Every step moves each object
+// by one cell with probability moveChance, then visits neighbours of every
+// object
+template <class GridT>
+Result Run(int numObjects, int side, int numSteps, double moveChance)
+{
+  GridT grid;
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> coord(0, side - 1), delta(-1, 1);
+  std::bernoulli_distribution shouldMove(moveChance);
+
+  std::vector<std::pair<int16_t, int16_t>> pos(numObjects);
+  for (int i = 0; i < numObjects; ++i) {
+    pos[i] = { coord(rng), coord(rng) };
+    grid.Move(i, pos[i].first, pos[i].second);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration moveTime{}, queryTime{};
+  uint64_t numMoves = 0, numQueries = 0, allocations = 0, sum = 0;
+
+  for (int step = 0; step < numSteps; ++step) {
+    auto allocationsWere = AllocationCounter::Get();
+    auto was = Clock::now();
+    for (int i = 0; i < numObjects; ++i) {
+      if (!shouldMove(rng))
+        continue;
+      auto& p = pos[i];
+      p.first = std::clamp(p.first + delta(rng), 0, side - 1);
+      p.second = std::clamp(p.second + delta(rng), 0, side - 1);
+      grid.Move(i, p.first, p.second);
+      ++numMoves;
+    }
+    moveTime += Clock::now() - was;
+    allocations += AllocationCounter::Get() - allocationsWere;
+
+    was = Clock::now();
+    for (int i = 0; i < numObjects; ++i) {
+      for (auto neighbour : grid.GetNeighbours(i))
+        sum += neighbour;
+      ++numQueries;
+    }
+    queryTime += Clock::now() - was;
+  }
+
+  // Keeps the query loop from being optimized out
+  REQUIRE(sum > 0);
 
-  REQUIRE(g_maxPlayers >= numPlayers);
-  for (int i = 0; i < numPlayers; ++i) {
-    DoConnect(p, i);
-    p.CreateActor(0xff000000 + i, { 0, 0, 0 }, 1, 0x3c);
-    p.SetUserActor(i, 0xff000000 + i);
+  auto toNs = [](Clock::duration d, uint64_t n) {
+    return n ? std::chrono::duration<double, std::nano>(d).count() / n : 0.0;
+  };
+  return { toNs(moveTime, numMoves), toNs(queryTime, numQueries),
+           numMoves ? allocations / numMoves : 0 };
+}
+
+nlohmann::json RunAll(int numObjects, int numSteps)
+{
+  auto res = nlohmann::json::array();
+  struct Workload
+  {
+    const char* name;
+    int side;
+    double moveChance;
+  };
+  for (auto workload : { Workload{ "moveHeavy", 32, 1.0 },
+                         Workload{ "queryHeavy", 8, 0.05 } }) {
+    auto setGrid = Run<Grid>(numObjects, workload.side, numSteps,
+                             workload.moveChance);
+    auto flatGrid = Run<FlatGrid>(numObjects, workload.side, numSteps,
+                                  workload.moveChance);
+    for (auto& [backend, r] : { std::make_pair("set", setGrid),
+                                std::make_pair("flat", flatGrid) }) {
+      res.push_back({ { "workload", workload.name },
+                      { "backend", backend },
+                      { "objects", numObjects },
+                      { "moveNs", r.moveNs },
+                      { "queryNs", r.queryNs },
+                      { "allocationsPerMove", r.moveAllocations } });
+    }
   }
+  return res;
+}
+}
+
+TEST_CASE("Grid", "[Benchmarks]")
+{
+  auto res = GridBenchmark::RunAll(500, 10);
+  std::cout << res.dump() << std::endl;
+}
+
+// Hidden, run with `unit [GridBenchmark]`
+TEST_CASE("Grid (full)", "[.][GridBenchmark]")
+{
+  std::cout << GridBenchmark::RunAll(5000, 100).dump(2) << std::endl;
+}
+
+TEST_CASE("PacketBuilder", "[Benchmarks]")
+{
+  EmptySendTarget target;
+  std::string props = R"({"isOpen": true, "isHarvested": false})";
+  nlohmann::json propValue = { { "name", "Iron Sword \"Dawn\"" },
+                               { "weight", 9.5 },
+                               { "enchantments", { 0x1a, 0x2b } } };
+
+  auto sendMessage = [&](uint32_t idx) {
+    Networking::PacketBuilder msg;
+    msg.AppendFormatted(R"({"type": "createActor", "idx": %u, "isMe": %s, )",
+                        idx, "false");
+    msg.AppendFormatted(R"("transform": {"pos": [%f,%f,%f]})", 1.f, 2.f, 3.f);
+    msg.Append(R"(, "props": )").Append(props).Append('}');
+    msg.Send(target, 0);
+
+    Networking::PacketBuilder propMsg;
+    WritePropertyMessage(propMsg, idx, "inventoryName", propValue);
+    propMsg.Send(target, 0);
+  };
 
+  // The longest message grows the pooled buffer, so the result doesn't
+  // depend on the tests that ran before
+  constexpr int numMessages = 10000;
+  sendMessage(numMessages);
+
+  auto allocationsWere = AllocationCounter::Get();
   auto was = std::chrono::system_clock::now();
+  for (int i = 0; i < numMessages; ++i)
+    sendMessage(i);
+  auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now() - was)
+                .count() /
+    numMessages;
+  auto allocations = AllocationCounter::Get() - allocationsWere;
+
+  std::cout << "PacketBuilder took " << took << " ns per message, "
+            << allocations << " heap allocations" << std::endl;
+  REQUIRE(allocations == 0);
+}
 
-  for (int i = 0; i < n; ++i) {
-    DoMessage(p, 0, jMovement);
+namespace PrimitiveBenchmark {
+// Random Z-rotated boxes and positions around them, half of them inside
+struct Scene
+{
+  std::vector<Primitive::OrientedBox> boxes;
+  std::vector<GeoProc::GeoPolygonProc> polygonProcs;
+  std::vector<NiPoint3> positions;
+};
+
+Scene CreateScene(int numBoxes, int numPositions)
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> coord(-2000.f, 2000.f),
+    angle(-3.14f, 3.14f), bound(50.f, 500.f);
+
+  Scene res;
+  for (int i = 0; i < numBoxes; ++i) {
+    NiPoint3 pos(coord(rng), coord(rng), coord(rng) / 10);
+    NiPoint3 rot(0, 0, angle(rng));
+    NiPoint3 boundsDiv2(bound(rng), bound(rng), bound(rng));
+    res.boxes.push_back(Primitive::CreateOrientedBox(pos, rot, boundsDiv2));
+    res.polygonProcs.push_back(Primitive::CreateGeoPolygonProc(
+      Primitive::GetVertices(pos, rot, boundsDiv2)));
+  }
+  for (int i = 0; i < numPositions; ++i) {
+    res.positions.push_back(
+      { coord(rng) / 4, coord(rng) / 4, coord(rng) / 40 });
   }
+  return res;
+}
 
-  std::cout << "DoMessage for " << numPlayers << " users took "
-            << GetTimePassed(was) << std::endl;
+template <class F>
+double MeasureNs(uint64_t numTests, F f)
+{
+  auto was = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::nano>(
+           std::chrono::steady_clock::now() - was)
+           .count() /
+    numTests;
 }
 
-TEST_CASE("SendToNeighbours", "[Benchmarks]")
+nlohmann::json Run(int numBoxes, int numPositions)
 {
-  ExecuteBenchmark(1);
-  //ExecuteBenchmark(50);
-  //ExecuteBenchmark(100);
-  //ExecuteBenchmark(200);
-#ifdef NDEBUG
-  //ExecuteBenchmark(500);
-  //ExecuteBenchmark(1000);
-#endif
+  auto scene = CreateScene(numBoxes, numPositions);
+  uint64_t numTests = uint64_t(numBoxes) * numPositions;
+
+  // Results of all tests, so every variant writes the same amount
+  std::vector<uint8_t> polygonProcRes(numTests), scalarRes(numTests),
+    positionsBatchRes(numTests), boxesBatchRes(numTests);
+
+  auto polygonProcNs = MeasureNs(numTests, [&] {
+    for (int i = 0; i < numBoxes; ++i)
+      for (int j = 0; j < numPositions; ++j)
+        polygonProcRes[i * numPositions + j] = Primitive::IsInside(
+          scene.positions[j], scene.polygonProcs[i]);
+  });
+  auto scalarNs = MeasureNs(numTests, [&] {
+    for (int i = 0; i < numBoxes; ++i)
+      for (int j = 0; j < numPositions; ++j)
+        scalarRes[i * numPositions + j] =
+          Primitive::IsInside(scene.positions[j], scene.boxes[i]);
+  });
+  auto positionsBatchNs = MeasureNs(numTests, [&] {
+    for (int i = 0; i < numBoxes; ++i) {
+      Primitive::IsInside(scene.positions.data(), numPositions,
+                          scene.boxes[i],
+                          &positionsBatchRes[i * numPositions]);
+    }
+  });
+  auto boxesBatchNs = MeasureNs(numTests, [&] {
+    for (int j = 0; j < numPositions; ++j)
+      Primitive::IsInside(scene.positions[j], scene.boxes.data(), numBoxes,
+                          &boxesBatchRes[j * numBoxes]);
+  });
+
+  auto count = [](const std::vector<uint8_t>& res) {
+    return std::count(res.begin(), res.end(), 1);
+  };
+  REQUIRE(count(polygonProcRes) > 0);
+  REQUIRE(count(scalarRes) == count(positionsBatchRes));
+  REQUIRE(count(scalarRes) == count(boxesBatchRes));
+
+  return { { "boxes", numBoxes },
+           { "positions", numPositions },
+           { "geoPolygonProcNs", polygonProcNs },
+           { "orientedBoxNs", scalarNs },
+           { "positionsBatchNs", positionsBatchNs },
+           { "boxesBatchNs", boxesBatchNs } };
 }
+}
+
+TEST_CASE("Primitive", "[Benchmarks]")
+{
+  std::cout << PrimitiveBenchmark::Run(64, 1000).dump() << std::endl;
+}
+
+namespace FormTableBenchmark {
+// Connected actors are spread over side x side cells, so listener sets come
+// from the grid. Movers send UpdateMovement and UpdateEquipment (fanned out
+// by ActionListener::SendToNeighbours) through PartOne. "Before" and
+// "after" repeat the listener loop of SendToNeighbours with dynamic_cast and
+// per-user Send like before the form table, and with FormCast and SendMany
+// like now
+nlohmann::json Run(int numActors, int side, int numMovers)
+{
+  LoadBenchmark::CountingSendTarget sendTarget;
+  PartOne partOne(&sendTarget);
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> coord(
+    0, side * LoadBenchmark::g_cellSize);
+  for (int i = 0; i < numActors; ++i) {
+    NiPoint3 pos = { coord(rng), coord(rng), 0 };
+    DoConnect(partOne, i);
+    partOne.CreateActor(0xff000000 + i, pos, 0, LoadBenchmark::g_worldspace);
+    partOne.SetUserActor(i, 0xff000000 + i);
+  }
+
+  std::vector<MpActor*> movers;
+  std::vector<std::string> movements, equipments;
+  uint64_t numListeners = 0;
+  for (int i = 0; i < numMovers; ++i) {
+    auto& actor = partOne.worldState.GetFormAt<MpActor>(0xff000000 + i);
+    movers.push_back(&actor);
+    numListeners += actor.GetListeners().size();
+
+    auto jMyMovement = jMovement;
+    jMyMovement["idx"] = actor.GetIdx();
+    auto pos = actor.GetPos();
+    jMyMovement["data"]["pos"] = { pos.x + 1, pos.y, pos.z };
+    movements.push_back(MakeMessage(jMyMovement));
+
+    auto jMyEquipment = jEquipment;
+    jMyEquipment["idx"] = actor.GetIdx();
+    equipments.push_back(MakeMessage(jMyEquipment));
+  }
+
+  auto handleAll = [&](std::vector<std::string>& messages) {
+    for (int i = 0; i < numMovers; ++i) {
+      auto& s = messages[i];
+      PartOne::HandlePacket(
+        &partOne, i, Networking::PacketType::Message,
+        reinterpret_cast<Networking::PacketData>(s.data()), s.size());
+    }
+  };
+
+  auto packetsWere = sendTarget.numPackets;
+  auto updateMovementNs = PrimitiveBenchmark::MeasureNs(
+    numMovers, [&] { handleAll(movements); });
+  auto movementPackets = sendTarget.numPackets - packetsWere;
+
+  packetsWere = sendTarget.numPackets;
+  auto sendToNeighboursNs = PrimitiveBenchmark::MeasureNs(
+    numMovers, [&] { handleAll(equipments); });
+  auto equipmentPackets = sendTarget.numPackets - packetsWere;
+
+  auto data = reinterpret_cast<Networking::PacketData>(movements[0].data());
+  auto length = movements[0].size();
+
+  packetsWere = sendTarget.numPackets;
+  auto beforeFanOutNs = PrimitiveBenchmark::MeasureNs(numMovers, [&] {
+    for (auto mover : movers) {
+      for (auto listener : mover->GetListeners()) {
+        auto listenerAsActor = dynamic_cast<MpActor*>(listener);
+        if (!listenerAsActor)
+          continue;
+        auto userId = partOne.serverState.UserByActor(listenerAsActor);
+        if (userId != Networking::InvalidUserId)
+          sendTarget.Send(userId, data, length, true);
+      }
+    }
+  });
+  auto beforePackets = sendTarget.numPackets - packetsWere;
+
+  packetsWere = sendTarget.numPackets;
+  std::vector<Networking::UserId> targets;
+  auto afterFanOutNs = PrimitiveBenchmark::MeasureNs(numMovers, [&] {
+    for (auto mover : movers) {
+      targets.clear();
+      for (auto listener : mover->GetListeners()) {
+        auto listenerAsActor = FormCast<MpActor>(listener);
+        if (!listenerAsActor)
+          continue;
+        auto userId = partOne.serverState.UserByActor(listenerAsActor);
+        if (userId != Networking::InvalidUserId)
+          targets.push_back(userId);
+      }
+      sendTarget.SendMany(targets, data, length, true);
+    }
+  });
+  auto afterPackets = sendTarget.numPackets - packetsWere;
+
+  REQUIRE(movementPackets > 0);
+  REQUIRE(equipmentPackets == beforePackets);
+  REQUIRE(beforePackets == afterPackets);
+
+  return { { "actors", numActors },
+           { "side", side },
+           { "movers", numMovers },
+           { "listenersPerMover", double(numListeners) / numMovers },
+           { "updateMovementNs", updateMovementNs },
+           { "sendToNeighboursNs", sendToNeighboursNs },
+           { "beforeFanOutNs", beforeFanOutNs },
+           { "afterFanOutNs", afterFanOutNs } };
+}
+}
+
+TEST_CASE("FormTable", "[Benchmarks]")
+{
+  std::cout << FormTableBenchmark::Run(300, 4, 100).dump() << std::endl;
+}
+
+namespace TimerBenchmark {
+using TimePoint = std::chrono::system_clock::time_point;
+
+// Timers with random deadlines are added one by one, then all of them fire.
+// "Before" is the former SetTimer: a deque sorted on every insertion that
+// isn't the earliest
+nlohmann::json Run(int numTimers, bool measureDeque)
+{
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> ms(0, 60 * 60 * 1000);
+  std::vector<TimePoint> finishes;
+  for (int i = 0; i < numTimers; ++i)
+    finishes.push_back(TimePoint() + std::chrono::milliseconds(ms(rng)));
+  const auto end = TimePoint() + std::chrono::hours(2);
+
+  nlohmann::json res = { { "timers", numTimers } };
+
+  if (measureDeque) {
+    std::deque<std::pair<TimePoint, int>> timers;
+    res["dequeAddNs"] = PrimitiveBenchmark::MeasureNs(numTimers, [&] {
+      for (int i = 0; i < numTimers; ++i) {
+        bool sortRequired =
+          !timers.empty() && finishes[i] > timers.front().first;
+        timers.push_front({ finishes[i], i });
+        if (sortRequired)
+          std::sort(timers.begin(), timers.end());
+      }
+    });
+    res["dequeTickNs"] = PrimitiveBenchmark::MeasureNs(numTimers, [&] {
+      while (!timers.empty() && timers.front().first <= end)
+        timers.pop_front();
+    });
+  }
+
+  TimerQueue<int> queue;
+  std::vector<TimerQueue<int>::Handle> handles(numTimers);
+  res["queueAddNs"] = PrimitiveBenchmark::MeasureNs(numTimers, [&] {
+    for (int i = 0; i < numTimers; ++i)
+      handles[i] = queue.Add(finishes[i], i);
+  });
+  res["queueCancelNs"] = PrimitiveBenchmark::MeasureNs(numTimers / 2, [&] {
+    for (int i = 0; i < numTimers; i += 2)
+      queue.Cancel(handles[i]);
+  });
+  size_t numFired = 0;
+  res["queueTickNs"] =
+    PrimitiveBenchmark::MeasureNs(numTimers - numTimers / 2, [&] {
+      numFired = queue.Tick(end, [](int) {});
+    });
+  REQUIRE(numFired == numTimers - numTimers / 2);
+  return res;
+}
+}
+
+TEST_CASE("Timers", "[Benchmarks]")
+{
+  std::cout << TimerBenchmark::Run(2000, true).dump() << std::endl;
+  std::cout << TimerBenchmark::Run(50000, false).dump() << std::endl;
+}
\ No newline at end of file
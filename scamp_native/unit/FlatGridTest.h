@@ -0,0 +1,68 @@
+#include "FlatGrid.h"
+#include "Grid.h"
+#include <catch2/catch.hpp>
+#include <random>
+#include <set>
+
+namespace {
+template <class View>
+std::set<uint64_t> ToSet(const View& view)
+{
+  return std::set<uint64_t>(view.begin(), view.end());
+}
+}
+
+TEST_CASE("FlatGrid GetNeighbours", "[FlatGrid]")
+{
+  FlatGrid gr;
+  gr.Move(0xFF00, 645, 232);
+  gr.Move(0xABCD, 644, 232);
+  gr.Move(0xFF0F0000, 645, 233);
+  gr.Move(0xABCF, 644, 233);
+  gr.Move(0x1234, 642, 233);
+
+  auto neighbours = gr.GetNeighbours(0xABCF);
+  REQUIRE(ToSet(neighbours) ==
+          std::set<uint64_t>({ 0xABCD, 0xFF00, 0xFF0F0000 }));
+  REQUIRE(neighbours.size() == 3);
+  REQUIRE(neighbours.count(0xABCD));
+  REQUIRE(!neighbours.count(0xABCF));
+  REQUIRE(gr.GetNeighboursAndMe(0xABCF).count(0xABCF));
+
+  gr.Forget(0xFF00);
+  REQUIRE(ToSet(gr.GetNeighbours(0xABCF)) ==
+          std::set<uint64_t>({ 0xABCD, 0xFF0F0000 }));
+  REQUIRE_THROWS(gr.GetPos(0xFF00));
+  REQUIRE(gr.GetPos(0xABCF) == std::pair<int16_t, int16_t>(644, 233));
+  REQUIRE(gr.GetNeighboursByPosition(-5, -5).empty());
+}
+
+TEST_CASE("FlatGrid matches Grid", "[FlatGrid]")
+{
+  for (int16_t radius : { 0, 1, 2 }) {
+    Grid grid(radius);
+    FlatGrid flatGrid(radius);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> coord(-4, 4);
+    std::uniform_int_distribution<uint64_t> id(0, 63);
+
+    for (int i = 0; i < 5000; ++i) {
+      auto objId = id(rng);
+      if (i % 7 == 0) {
+        grid.Forget(objId);
+        flatGrid.Forget(objId);
+        continue;
+      }
+
+      int16_t x = coord(rng), y = coord(rng);
+      grid.Move(objId, x, y);
+      flatGrid.Move(objId, x, y);
+
+      REQUIRE(ToSet(flatGrid.GetNeighbours(objId)) ==
+              grid.GetNeighbours(objId));
+      REQUIRE(ToSet(flatGrid.GetNeighboursByPosition(y, x)) ==
+              grid.GetNeighboursByPosition(y, x));
+    }
+  }
+}
\ No newline at end of file
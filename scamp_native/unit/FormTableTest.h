@@ -0,0 +1,71 @@
+#include "MpActor.h"
+#include "WorldState.h"
+#include <catch2/catch.hpp>
+
+namespace {
+class FormTableTestForm : public MpForm
+{
+};
+}
+
+TEST_CASE("FormTable resolves stale handles to nullptr", "[FormTable]")
+{
+  FormTable table;
+  MpForm a, b;
+
+  auto handleA = table.Insert(&a, a.GetTypeFlags());
+  REQUIRE(table.Resolve(handleA) == &a);
+  REQUIRE(table.GetSize() == 1);
+
+  table.Erase(handleA);
+  REQUIRE(table.Resolve(handleA) == nullptr);
+  REQUIRE(table.GetSize() == 0);
+
+  // The slot is reused with a new generation
+  auto handleB = table.Insert(&b, b.GetTypeFlags());
+  REQUIRE(handleB.slot == handleA.slot);
+  REQUIRE(handleB != handleA);
+  REQUIRE(table.Resolve(handleA) == nullptr);
+  REQUIRE(table.Resolve(handleB) == &b);
+
+  table.Erase(handleA);
+  REQUIRE(table.Resolve(handleB) == &b);
+
+  table.Clear();
+  REQUIRE(table.Resolve(handleB) == nullptr);
+  REQUIRE(table.Resolve(FormHandle()) == nullptr);
+}
+
+TEST_CASE("FormCast matches dynamic_cast", "[FormTable]")
+{
+  WorldState worldState;
+  worldState.AddForm(std::make_unique<MpForm>(), 0xff000000);
+  worldState.AddForm(
+    std::make_unique<MpObjectReference>(LocationalData(),
+                                        FormCallbacks::DoNothing(), 0, "STAT"),
+    0xff000001);
+  worldState.AddForm(
+    std::make_unique<MpActor>(LocationalData(), FormCallbacks::DoNothing()),
+    0xff000002);
+  worldState.AddForm(std::make_unique<FormTableTestForm>(), 0xff000003);
+
+  for (uint32_t id = 0xff000000; id <= 0xff000003; ++id) {
+    auto form = worldState.LookupFormById(id).get();
+    REQUIRE(FormCast<MpForm>(form) == form);
+    REQUIRE(FormCast<MpObjectReference>(form) ==
+            dynamic_cast<MpObjectReference*>(form));
+    REQUIRE(FormCast<MpActor>(form) == dynamic_cast<MpActor*>(form));
+    REQUIRE(FormCast<FormTableTestForm>(form) ==
+            dynamic_cast<FormTableTestForm*>(form));
+
+    auto handle = form->GetHandle();
+    REQUIRE(worldState.LookupForm(handle) == form);
+    REQUIRE(worldState.LookupForm<MpActor>(handle) ==
+            dynamic_cast<MpActor*>(form));
+  }
+
+  auto handle = worldState.LookupFormById(0xff000002)->GetHandle();
+  worldState.DestroyForm(0xff000002);
+  REQUIRE(worldState.LookupForm(handle) == nullptr);
+  REQUIRE(worldState.LookupForm<MpActor>(handle) == nullptr);
+}
\ No newline at end of file
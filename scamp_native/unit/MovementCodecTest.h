@@ -0,0 +1,198 @@
+#pragma once
+#include "TestUtils.hpp"
+
+#include "MovementCodec.h"
+
+namespace {
+MovementCodec::Movement MovementFromJson(const nlohmann::json& j)
+{
+  simdjson::dom::parser p;
+  MovementCodec::Movement res;
+  REQUIRE(MovementCodec::FromJson(p.parse(j.dump()).value(), res));
+  return res;
+}
+
+void DoBinaryMessage(PartOne& partOne, Networking::UserId id,
+                     const std::vector<uint8_t>& data)
+{
+  PartOne::HandlePacket(&partOne, id, Networking::PacketType::Message,
+                        data.data(), data.size());
+}
+}
+
+TEST_CASE("MovementCodec round trip", "[MovementCodec]")
+{
+  auto j = jMovement;
+  j["idx"] = 0x1234;
+  j["data"]["pos"] = { 101234.125, -45678.5, -3.25 };
+  j["data"]["rot"] = { 10, 350, 179 };
+  j["data"]["runMode"] = "Sprinting";
+  j["data"]["direction"] = 90;
+  j["data"]["isInJumpState"] = true;
+  j["data"]["isBlocking"] = true;
+
+  auto movement = MovementFromJson(j);
+
+  std::vector<uint8_t> data;
+  REQUIRE(MovementCodec::Serialize(movement, data));
+  REQUIRE(data.size() < 32);
+  REQUIRE(MovementCodec::IsBinary(data.data(), data.size()));
+  REQUIRE(!MovementCodec::IsHandshake(data.data(), data.size()));
+
+  MovementCodec::Movement res;
+  MovementCodec::Deserialize(data.data(), data.size(), res);
+  REQUIRE(res.idx == 0x1234);
+  REQUIRE(res.worldOrCell == 0x3c);
+  REQUIRE(res.pos[0] == 101234.125f);
+  REQUIRE(res.pos[1] == -45678.5f);
+  REQUIRE(res.pos[2] == -3.25f);
+  REQUIRE(std::abs(res.rot[0] - 10) < 0.01);
+  REQUIRE(std::abs(res.rot[1] - 350) < 0.01);
+  REQUIRE(std::abs(res.rot[2] - 179) < 0.01);
+  REQUIRE(std::abs(res.direction - 90) < 0.01);
+  REQUIRE(res.runMode == MovementCodec::RunMode::Sprinting);
+  REQUIRE(res.isInJumpState);
+  REQUIRE(res.isBlocking);
+  REQUIRE(!res.isSneaking);
+  REQUIRE(!res.isWeapDrawn);
+
+  std::string json;
+  MovementCodec::ToJson(res, json);
+  auto parsed = nlohmann::json::parse(json);
+  REQUIRE(parsed["t"] == static_cast<int>(MsgType::UpdateMovement));
+  REQUIRE(parsed["data"]["runMode"] == "Sprinting");
+  REQUIRE(parsed["data"]["pos"][0].get<double>() == 101234.125);
+}
+
+TEST_CASE("MovementCodec rejects what it can't represent", "[MovementCodec]")
+{
+  auto j = jMovement;
+  j["data"]["runMode"] = "Flying";
+  simdjson::dom::parser p;
+  MovementCodec::Movement movement;
+  REQUIRE(!MovementCodec::FromJson(p.parse(j.dump()).value(), movement));
+
+  movement = MovementFromJson(jMovement);
+  movement.pos[0] = std::numeric_limits<float>::infinity();
+  std::vector<uint8_t> data;
+  REQUIRE(!MovementCodec::Serialize(movement, data));
+
+  movement = MovementFromJson(jMovement);
+  REQUIRE(MovementCodec::Serialize(movement, data));
+  data[1] = static_cast<uint8_t>(MovementCodec::Kind::Delta);
+  REQUIRE_THROWS_WITH(
+    MovementCodec::Deserialize(data.data(), data.size(), movement),
+    Contains("Unsupported movement packet kind"));
+
+  data[1] = static_cast<uint8_t>(MovementCodec::Kind::Full);
+  data.pop_back();
+  REQUIRE_THROWS_WITH(
+    MovementCodec::Deserialize(data.data(), data.size(), movement),
+    Contains("Unexpected end"));
+}
+
+TEST_CASE("UpdateMovement is forwarded in negotiated format",
+          "[MovementCodec]")
+{
+  PartOne partOne;
+
+  for (Networking::UserId i = 0; i < 2; ++i) {
+    DoConnect(partOne, i);
+    partOne.CreateActor(i + 0xff000ABC, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+    partOne.SetUserActor(i, i + 0xff000ABC);
+  }
+
+  std::vector<uint8_t> handshake;
+  MovementCodec::WriteHandshake(MovementCodec::Version + 1, handshake);
+  DoBinaryMessage(partOne, 1, handshake);
+  REQUIRE(partOne.serverState.GetMovementCodecVersion(0) ==
+          MovementCodec::NoVersion);
+  REQUIRE(partOne.serverState.GetMovementCodecVersion(1) ==
+          MovementCodec::Version);
+
+  // JSON from user 0 reaches user 1 as a delta keyframe (stored by the fake
+  // send target as decoded JSON) and user 0 as JSON
+  partOne.Messages().clear();
+  DoMessage(partOne, 0, jMovement);
+  REQUIRE(partOne.Messages().size() == 2);
+  for (auto& m : partOne.Messages()) {
+    REQUIRE(m.j["idx"] == 0);
+    REQUIRE(m.j["data"]["pos"] == nlohmann::json{ 1, -1, 1 });
+    REQUIRE(std::abs(m.j["data"]["rot"][2].get<double>() - 179) <
+            360. / 256);
+  }
+
+  // Binary from user 1 is applied as a regular UpdateMovement
+  auto movement = MovementFromJson(jMovement);
+  movement.idx = partOne.worldState.GetFormAt<MpActor>(0xff000ABD).GetIdx();
+  movement.pos[0] = 2.5f;
+  std::vector<uint8_t> data;
+  REQUIRE(MovementCodec::Serialize(movement, data));
+
+  partOne.Messages().clear();
+  DoBinaryMessage(partOne, 1, data);
+  REQUIRE(partOne.worldState.GetFormAt<MpActor>(0xff000ABD).GetPos() ==
+          NiPoint3{ 2.5f, -1, 1 });
+  REQUIRE(partOne.Messages().size() == 2);
+  REQUIRE(partOne.Messages()[0].j["data"]["pos"][0] == 2.5);
+}
+
+TEST_CASE("MovementCodec deltas contain changed fields only",
+          "[MovementCodec]")
+{
+  auto movement = MovementFromJson(jMovement);
+  movement.pos[0] = 5000.5f;
+  movement.pos[1] = -4096.f;
+  movement.pos[2] = -3.3f;
+
+  MovementCodec::QuantizedMovement q;
+  REQUIRE(MovementCodec::Quantize(movement, q));
+  REQUIRE(q.cell[0] == 1);
+  REQUIRE(q.cell[1] == -1);
+  REQUIRE(q.offset[1] == 0);
+  REQUIRE(q.cell[2] == -1);
+
+  auto res = MovementCodec::Dequantize(0, q);
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(std::abs(res.pos[i] - movement.pos[i]) <= 1.f / 32);
+  REQUIRE(std::abs(res.rot[2] - 179) < 360. / 256);
+
+  std::vector<uint8_t> keyframe;
+  MovementCodec::SerializeDelta(7, 0, nullptr, q, keyframe);
+  REQUIRE(MovementCodec::IsDelta(keyframe.data(), keyframe.size()));
+  REQUIRE(MovementCodec::ReadDeltaHeader(keyframe.data(), keyframe.size())
+            .isKeyframe);
+
+  MovementCodec::QuantizedMovement client;
+  MovementCodec::ApplyDelta(keyframe.data(), keyframe.size(), client);
+  REQUIRE(client == q);
+
+  // Small step within the cell changes one offset only
+  movement.pos[0] += 1.f;
+  auto prev = q;
+  REQUIRE(MovementCodec::Quantize(movement, q));
+  std::vector<uint8_t> delta;
+  MovementCodec::SerializeDelta(7, 1, &prev, q, delta);
+  REQUIRE(delta.size() == 7);
+  REQUIRE(delta.size() < keyframe.size());
+
+  auto header = MovementCodec::ReadDeltaHeader(delta.data(), delta.size());
+  REQUIRE(header.idx == 7);
+  REQUIRE(header.sequence == 1);
+  REQUIRE(!header.isKeyframe);
+
+  MovementCodec::ApplyDelta(delta.data(), delta.size(), client);
+  REQUIRE(client == q);
+
+  delta.push_back(0);
+  REQUIRE_THROWS_WITH(
+    MovementCodec::ApplyDelta(delta.data(), delta.size(), client),
+    Contains("Unexpected trailing bytes"));
+
+  std::vector<uint8_t> request;
+  MovementCodec::WriteKeyframeRequest(300, request);
+  REQUIRE(MovementCodec::IsKeyframeRequest(request.data(), request.size()));
+  REQUIRE(!MovementCodec::IsDelta(request.data(), request.size()));
+  REQUIRE(MovementCodec::ReadKeyframeRequest(request.data(),
+                                             request.size()) == 300);
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#pragma once
+#include "TestUtils.hpp"
+
+#include "MovementCodec.h"
+#include "MovementReplication.h"
+
+namespace {
+using UserIds = std::vector<Networking::UserId>;
+
+// Targets of each keyframe and delta packet in the order of writing
+void RequireTargets(const MovementReplication::Packets& packets,
+                    const std::vector<UserIds>& keyframeTargets,
+                    const std::vector<UserIds>& deltaTargets)
+{
+  std::vector<UserIds> keyframes, deltas;
+  for (auto& packet : packets) {
+    REQUIRE(!packet.data.empty());
+    auto kind = packet.isKeyframe ? MovementCodec::Kind::Keyframe
+                                  : MovementCodec::Kind::Delta;
+    REQUIRE(packet.data[1] == static_cast<uint8_t>(kind));
+    (packet.isKeyframe ? keyframes : deltas).push_back(packet.targets);
+  }
+  REQUIRE(keyframes == keyframeTargets);
+  REQUIRE(deltas == deltaTargets);
+}
+
+uint8_t GetSequence(const MovementReplication::Packet& packet)
+{
+  return MovementCodec::ReadDeltaHeader(packet.data.data(),
+                                        packet.data.size())
+    .sequence;
+}
+}
+
+TEST_CASE("MovementReplication shares packets between listeners",
+          "[MovementReplication]")
+{
+  MovementReplication replication;
+  replication.SetKeyframeInterval(4);
+  MovementReplication::Packets packets;
+
+  MovementCodec::Movement movement;
+  movement.idx = 5;
+
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, { { 0, 1 } }, {});
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, {}, { { 0, 1 } });
+
+  // Listener 1 skips an update and gets a delta against its own baseline
+  movement.pos[0] = 1;
+  REQUIRE(replication.Write({ 0 }, movement, packets));
+  RequireTargets(packets, {}, { { 0 } });
+  movement.pos[0] = 2;
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, {}, { { 0 }, { 1 } });
+  REQUIRE(GetSequence(*packets.begin()) == 3);
+  REQUIRE(GetSequence(*(packets.begin() + 1)) == 2);
+
+  // Periodic keyframe
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, { { 0, 1 } }, {});
+
+  replication.RequestKeyframe(0, 5);
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, { { 0 } }, { { 1 } });
+
+  replication.Forget(0, 5);
+  replication.ForgetListener(1);
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, { { 0, 1 } }, {});
+
+  // Listeners that got every update share sequence numbers
+  REQUIRE(replication.Write({ 0, 1 }, movement, packets));
+  RequireTargets(packets, {}, { { 0, 1 } });
+  REQUIRE(GetSequence(*packets.begin()) == 7);
+
+  movement.pos[0] = std::numeric_limits<float>::quiet_NaN();
+  REQUIRE(!replication.Write({ 0 }, movement, packets));
+  RequireTargets(packets, {}, {});
+}
+
+TEST_CASE("MovementReplication keyframes listeners that miss periodic "
+          "keyframes",
+          "[MovementReplication]")
+{
+  MovementReplication replication;
+  replication.SetKeyframeInterval(2);
+  MovementReplication::Packets packets;
+
+  MovementCodec::Movement movement;
+  movement.idx = 5;
+
+  // Listener 1 only gets updates between periodic keyframes
+  REQUIRE(replication.Write({ 0 }, movement, packets));
+  RequireTargets(packets, { { 0 } }, {});
+  REQUIRE(replication.Write({ 1 }, movement, packets));
+  RequireTargets(packets, { { 1 } }, {});
+  REQUIRE(replication.Write({ 0 }, movement, packets));
+  RequireTargets(packets, { { 0 } }, {});
+  REQUIRE(replication.Write({ 1 }, movement, packets));
+  RequireTargets(packets, {}, { { 1 } });
+  REQUIRE(replication.Write({ 0 }, movement, packets));
+  RequireTargets(packets, { { 0 } }, {});
+  REQUIRE(replication.Write({ 1 }, movement, packets));
+  RequireTargets(packets, { { 1 } }, {});
+}
+
+TEST_CASE("UpdateMovement is replicated from validated server state",
+          "[MovementReplication]")
+{
+  PartOne partOne;
+
+  for (Networking::UserId i = 0; i < 2; ++i) {
+    DoConnect(partOne, i);
+    partOne.CreateActor(i + 0xff000ABC, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+    partOne.SetUserActor(i, i + 0xff000ABC);
+  }
+
+  std::vector<uint8_t> handshake;
+  MovementCodec::WriteHandshake(MovementCodec::Version, handshake);
+  DoBinaryMessage(partOne, 1, handshake);
+
+  // User 1 decodes deltas against the keyframe
+  for (int x : { 1, 3, 7 }) {
+    auto m = jMovement;
+    m["data"]["pos"][0] = x;
+    m["data"]["isSneaking"] = true;
+    partOne.Messages().clear();
+    DoMessage(partOne, 0, m);
+    REQUIRE(partOne.Messages().size() == 2);
+    auto it =
+      std::find_if(partOne.Messages().begin(), partOne.Messages().end(),
+                   [](auto& msg) { return msg.userId == 1; });
+    REQUIRE(it != partOne.Messages().end());
+    REQUIRE(it->j["data"]["pos"][0] == x);
+    REQUIRE(it->j["data"]["isSneaking"] == true);
+  }
+
+  std::vector<uint8_t> request;
+  MovementCodec::WriteKeyframeRequest(0, request);
+  DoBinaryMessage(partOne, 1, request);
+
+  MovementReplication::Packets packets;
+  MovementCodec::Movement movement;
+  movement.idx = 0;
+  REQUIRE(partOne.GetMovementReplication().Write({ 1 }, movement, packets));
+  RequireTargets(packets, { { 1 } }, {});
+
+  // Malformed messages are rejected instead of replicated with defaults
+  auto malformed = jMovement;
+  malformed["data"]["pos"][0] = 2;
+  malformed["data"]["runMode"] = 1;
+  partOne.Messages().clear();
+  REQUIRE_THROWS(DoMessage(partOne, 0, malformed));
+  REQUIRE(partOne.Messages().empty());
+  REQUIRE(partOne.worldState.GetFormAt<MpActor>(0xff000ABC).GetPos().x == 7);
+
+  // Movement rejected by validation isn't replicated
+  auto m = jMovement;
+  m["data"]["pos"] = { 100000, 0, 0 };
+  partOne.Messages().clear();
+  DoMessage(partOne, 0, m);
+  REQUIRE(std::none_of(
+    partOne.Messages().begin(), partOne.Messages().end(),
+    [](auto& msg) { return msg.j["t"] == MsgType::UpdateMovement; }));
+}
+
+TEST_CASE("Decimated listeners get deltas against their own baseline",
+          "[MovementReplication][UpdateRateLod]")
+{
+  PartOne partOne;
+  partOne.GetUpdateRateLod().SetTierDistances({ 1000 });
+  partOne.GetUpdateRateLod().SetFlushDelay(std::chrono::milliseconds(0));
+
+  std::vector<uint8_t> handshake;
+  MovementCodec::WriteHandshake(MovementCodec::Version, handshake);
+
+  // User 1 is near the emitter and gets every update, user 2 every other one
+  const NiPoint3 positions[] = { { 1.f, -1.f, 1.f },
+                                 { 0.f, 0.f, 0.f },
+                                 { 3000.f, 0.f, 0.f } };
+  for (Networking::UserId i = 0; i < 3; ++i) {
+    DoConnect(partOne, i);
+    partOne.CreateActor(i + 0xff000000, positions[i], 180.f, 0x3c);
+    partOne.SetUserActor(i, i + 0xff000000);
+    DoBinaryMessage(partOne, i, handshake);
+  }
+
+  auto getPosXSentTo = [&](Networking::UserId userId) {
+    std::vector<float> res;
+    for (auto& m : partOne.Messages()) {
+      if (m.userId == userId && m.j["t"] == MsgType::UpdateMovement)
+        res.push_back(m.j["data"]["pos"][0].get<float>());
+    }
+    return res;
+  };
+
+  // The last update reaches user 2 on Tick. Deltas out of sequence would
+  // throw in PartOne's send target
+  partOne.Messages().clear();
+  for (int x = 1; x <= 4; ++x) {
+    auto m = jMovement;
+    m["data"]["pos"][0] = x;
+    DoMessage(partOne, 0, m);
+  }
+  partOne.Tick();
+  REQUIRE(getPosXSentTo(1) == std::vector<float>{ 1, 2, 3, 4 });
+  REQUIRE(getPosXSentTo(2) == std::vector<float>{ 1, 3, 4 });
+
+  // Neither listener needs a keyframe after the flush
+  MovementReplication::Packets packets;
+  MovementCodec::Movement movement;
+  movement.idx = 0;
+  REQUIRE(partOne.GetMovementReplication().Write({ 1, 2 }, movement, packets));
+  RequireTargets(packets, {}, { { 1 }, { 2 } });
+}
\ No newline at end of file
@@ -8,7 +8,7 @@ using namespace std::chrono_literals;
 
 TEST_CASE("Handler destroys the client", "[Networking]")
 {
-  auto server = Networking::CreateServer(7778, MAX_PLAYERS);
+  auto server = Networking::CreateServer(7778, 1000);
   static auto client = Networking::CreateClient("127.0.0.1", 7778, 500);
 
   static bool reset = false;
@@ -31,7 +31,7 @@ TEST_CASE("Handler destroys the client", "[Networking]")
 
 TEST_CASE("Connect/disconnect", "[Networking]")
 {
-  auto server = Networking::CreateServer(7778, MAX_PLAYERS);
+  auto server = Networking::CreateServer(7778, 1000);
   auto client = Networking::CreateClient("127.0.0.1", 7778, 500);
 
   REQUIRE(!client->IsConnected());
@@ -51,11 +51,11 @@ TEST_CASE("Connect/disconnect", "[Networking]")
 
 TEST_CASE("Ctors", "[Networking]")
 {
-  auto server = Networking::CreateServer(7778, MAX_PLAYERS);
+  auto server = Networking::CreateServer(7778, 1000);
   auto client = Networking::CreateClient("127.0.0.1", 7778);
 
   try {
-    Networking::CreateServer(7778, MAX_PLAYERS);
+    Networking::CreateServer(7778, 1000);
     REQUIRE(false);
   } catch (std::exception& e) {
     REQUIRE(e.what() == std::string("Peer startup failed with code 5"));
@@ -0,0 +1,167 @@
+#include "NetworkingBatched.h"
+#include "TestUtils.hpp"
+#include <catch2/catch.hpp>
+
+namespace {
+class RecordingSendTarget : public Networking::ISendTarget
+{
+public:
+  void Send(Networking::UserId targetUserId, Networking::PacketData data,
+            size_t length, bool reliable) override
+  {
+    sent.push_back({ targetUserId, std::string(data, data + length) });
+  }
+
+  void SendMany(const std::vector<Networking::UserId>& targetUserIds,
+                Networking::PacketData data, size_t length,
+                bool reliable) override
+  {
+    ++numSendManyCalls;
+    ISendTarget::SendMany(targetUserIds, data, length, reliable);
+  }
+
+  std::vector<std::pair<Networking::UserId, std::string>> sent;
+  size_t numSendManyCalls = 0;
+};
+
+std::vector<std::string> Unpack(const std::string& frame)
+{
+  std::vector<std::string> res;
+  Networking::ForEachBatchedPacket(
+    reinterpret_cast<Networking::PacketData>(frame.data()), frame.size(),
+    [&](Networking::PacketData data, size_t length) {
+      res.push_back(std::string(data, data + length));
+    });
+  return res;
+}
+
+std::string MakePacket(const std::string& content)
+{
+  return static_cast<char>(Networking::MinPacketId) + content;
+}
+
+void SendString(Networking::ISendTarget& target, Networking::UserId userId,
+                const std::string& s, bool reliable = true)
+{
+  target.Send(userId, reinterpret_cast<Networking::PacketData>(s.data()),
+              s.size(), reliable);
+}
+}
+
+TEST_CASE("Batched: packets are buffered until Flush", "[Networking]")
+{
+  RecordingSendTarget target;
+  Networking::BatchedSendTarget batched(target, 1000);
+
+  SendString(batched, 0, MakePacket("abc"));
+  SendString(batched, 0, MakePacket("de"));
+  SendString(batched, 1, MakePacket("f"));
+  SendString(batched, 0, MakePacket("unreliable"), false);
+  REQUIRE(target.sent.empty());
+
+  batched.Flush();
+  REQUIRE(target.sent.size() == 3);
+
+  // Two packets for user 0 share a frame, lone packets are sent unwrapped
+  REQUIRE(target.sent[0].first == 0);
+  REQUIRE(static_cast<uint8_t>(target.sent[0].second[0]) ==
+          Networking::BatchPacketId);
+  REQUIRE(Unpack(target.sent[0].second) ==
+          std::vector<std::string>{ MakePacket("abc"), MakePacket("de") });
+  REQUIRE(target.sent[1].first == 1);
+  REQUIRE(target.sent[1].second == MakePacket("f"));
+  REQUIRE(target.sent[2].second == MakePacket("unreliable"));
+
+  target.sent.clear();
+  batched.Flush();
+  REQUIRE(target.sent.empty());
+}
+
+TEST_CASE("Batched: frames don't exceed MTU", "[Networking]")
+{
+  RecordingSendTarget target;
+  Networking::BatchedSendTarget batched(target, 16);
+
+  for (int i = 0; i < 5; ++i)
+    SendString(batched, 0, MakePacket("abcd"));
+  SendString(batched, 0, MakePacket(std::string(100, 'x')));
+  batched.Flush();
+
+  std::vector<std::string> received;
+  for (auto& [userId, frame] : target.sent) {
+    for (auto& packet : Unpack(frame))
+      received.push_back(packet);
+  }
+
+  // Order is kept, oversized packet is sent as is
+  REQUIRE(received.size() == 6);
+  REQUIRE(received.back() == MakePacket(std::string(100, 'x')));
+  for (int i = 0; i < 5; ++i)
+    REQUIRE(received[i] == MakePacket("abcd"));
+  for (size_t i = 0; i + 1 < target.sent.size(); ++i)
+    REQUIRE(target.sent[i].second.size() <= 16);
+}
+
+TEST_CASE("Batched: SendMany appends to the batch of every target",
+          "[Networking]")
+{
+  RecordingSendTarget target;
+  Networking::BatchedSendTarget batched(target, 16);
+
+  auto small = MakePacket("ab");
+  auto big = MakePacket(std::string(100, 'x'));
+  SendString(batched, 1, MakePacket("c"));
+  batched.SendMany({ 0, 1 },
+                   reinterpret_cast<Networking::PacketData>(small.data()),
+                   small.size(), true);
+  REQUIRE(target.sent.empty());
+  REQUIRE(target.numSendManyCalls == 0);
+
+  // Oversized packets go to the underlying SendMany after pending batches
+  batched.SendMany({ 0, 1 },
+                   reinterpret_cast<Networking::PacketData>(big.data()),
+                   big.size(), true);
+  REQUIRE(target.numSendManyCalls == 1);
+  REQUIRE(target.sent.size() == 4);
+  REQUIRE(target.sent[0].first == 0);
+  REQUIRE(target.sent[0].second == small);
+  REQUIRE(target.sent[1].first == 1);
+  REQUIRE(Unpack(target.sent[1].second) ==
+          std::vector<std::string>{ MakePacket("c"), small });
+  REQUIRE(target.sent[2].first == 0);
+  REQUIRE(target.sent[2].second == big);
+  REQUIRE(target.sent[3].first == 1);
+  REQUIRE(target.sent[3].second == big);
+
+  target.sent.clear();
+  batched.Flush();
+  REQUIRE(target.sent.empty());
+}
+
+TEST_CASE("Batched: Discard drops buffered packets", "[Networking]")
+{
+  RecordingSendTarget target;
+  Networking::BatchedSendTarget batched(target, 1000);
+
+  SendString(batched, 3, MakePacket("abc"));
+  batched.Discard(3);
+  batched.Flush();
+  REQUIRE(target.sent.empty());
+}
+
+TEST_CASE("Batched: PartOne flushes outgoing packets on Tick", "[PartOne]")
+{
+  PartOne partOne;
+  partOne.EnableOutgoingBatching(1200);
+
+  DoConnect(partOne, 0);
+  partOne.CreateActor(0xff000ABC, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+  partOne.SetUserActor(0, 0xff000ABC);
+  DoMessage(partOne, 0, jMovement);
+  REQUIRE(partOne.Messages().empty());
+
+  partOne.Tick();
+  REQUIRE(partOne.Messages().size() == 2);
+  REQUIRE(partOne.Messages()[0].j["type"] == "createActor");
+  REQUIRE(partOne.Messages()[1].j == jMovement);
+}
\ No newline at end of file
@@ -126,4 +126,34 @@ TEST_CASE("Combined: Messages are transferred to clients")
     },
     nullptr);
   REQUIRE(received);
+}
+
+TEST_CASE("Combined: SendMany is split between child servers")
+{
+  auto s1 = std::make_shared<MockServer>();
+  auto s2 = std::make_shared<MockServer>();
+  auto svr = CreateCombinedServer({ s1, s2 });
+
+  auto cl0 = s1->CreateClient();
+  auto cl1 = s2->CreateClient();
+  auto cl2 = s2->CreateClient();
+
+  DECLARE_CB;
+
+  svr->Tick(tickCb, nullptr);
+  svr->SendMany({ 0, 1, 2 }, (PacketData) "df", 2, true);
+
+  static int numReceived = 0;
+  auto onPacket = [](void* state, PacketType packetType, PacketData data,
+                     size_t length, const char* error) {
+    if (data && length == 2 && !memcmp(data, "df", 2))
+      ++numReceived;
+  };
+  cl0->Tick(onPacket, nullptr);
+  cl1->Tick(onPacket, nullptr);
+  cl2->Tick(onPacket, nullptr);
+  REQUIRE(numReceived == 3);
+
+  REQUIRE_THROWS_WITH(svr->SendMany({ 0, 3 }, (PacketData) "df", 2, true),
+                      Catch::Contains("User with id 3 doesn't exist"));
 }
\ No newline at end of file
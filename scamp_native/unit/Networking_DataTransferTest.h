@@ -7,7 +7,7 @@ using namespace std::chrono_literals;
 
 TEST_CASE("Data transfer", "[Networking]")
 {
-  static auto server = Networking::CreateServer(7778, MAX_PLAYERS);
+  static auto server = Networking::CreateServer(7778, 1000);
   static auto client = Networking::CreateClient("127.0.0.1", 7778);
 
   std::string res;
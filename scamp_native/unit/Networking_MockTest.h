@@ -105,4 +105,34 @@ TEST_CASE("MockServer - connect/disconnect", "[Networking]")
       nullptr);
     REQUIRE(serverTicked);
   }
+}
+
+TEST_CASE("MockServer - SendMany shares payload between clients",
+          "[Networking]")
+{
+  MockServer mockServer;
+  auto cl0 = mockServer.CreateClient();
+  auto cl1 = mockServer.CreateClient();
+  auto cl2 = mockServer.CreateClient();
+
+  mockServer.SendMany({ 0, 2 }, (uint8_t*)"abcd", 4, true);
+
+  static std::vector<PacketData> received;
+  received.clear();
+  auto onPacket = [](void* state, PacketType packetType, PacketData data,
+                     size_t length, const char* error) {
+    if (packetType == PacketType::Message && length == 4 &&
+        !memcmp(data, "abcd", 4))
+      received.push_back(data);
+  };
+  cl0->Tick(onPacket, nullptr);
+  cl1->Tick(onPacket, nullptr);
+  cl2->Tick(onPacket, nullptr);
+
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0] == received[1]);
+
+  REQUIRE_THROWS_WITH(
+    mockServer.SendMany({ 0, 3 }, (uint8_t*)"abcd", 4, true),
+    Catch::Contains("No client with id 3 found on MockServer"));
 }
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include "MpscQueue.h"
+#include "NetworkingThreaded.h"
+#include "TestUtils.hpp"
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace {
+// Thread-safe IServer with packets injected by the test
+class IoTestServer : public Networking::IServer
+{
+public:
+  void Send(Networking::UserId targetUserId, Networking::PacketData data,
+            size_t length, bool reliable) override
+  {
+    std::lock_guard l(m);
+    sent.push_back({ targetUserId, std::string(data, data + length) });
+  }
+
+  void Tick(OnPacket onPacket, void* state) override
+  {
+    std::vector<std::tuple<Networking::UserId, Networking::PacketType,
+                           std::string>>
+      packets;
+    {
+      std::lock_guard l(m);
+      packets.swap(toDeliver);
+    }
+    for (auto& [userId, type, s] : packets)
+      onPacket(state, userId, type,
+               reinterpret_cast<Networking::PacketData>(s.data()), s.size());
+    ++numTicks;
+  }
+
+  void Inject(Networking::UserId userId, Networking::PacketType type,
+              const std::string& s = "")
+  {
+    std::lock_guard l(m);
+    toDeliver.push_back({ userId, type, s });
+  }
+
+  std::vector<std::pair<Networking::UserId, std::string>> GetSent()
+  {
+    std::lock_guard l(m);
+    return sent;
+  }
+
+  // Waits until everything injected has passed through the I/O thread
+  void WaitDelivered()
+  {
+    auto start = numTicks.load();
+    while (numTicks < start + 2)
+      std::this_thread::yield();
+  }
+
+  std::atomic<uint64_t> numTicks = 0;
+
+private:
+  std::mutex m;
+  std::vector<
+    std::tuple<Networking::UserId, Networking::PacketType, std::string>>
+    toDeliver;
+  std::vector<std::pair<Networking::UserId, std::string>> sent;
+};
+
+struct ReceivedPacket
+{
+  Networking::UserId userId;
+  Networking::PacketType type;
+  std::string data;
+};
+
+std::vector<ReceivedPacket> TickThreaded(Networking::IServer& server)
+{
+  std::vector<ReceivedPacket> res;
+  server.Tick(
+    [](void* state, Networking::UserId userId,
+       Networking::PacketType packetType, Networking::PacketData data,
+       size_t length) {
+      reinterpret_cast<std::vector<ReceivedPacket>*>(state)->push_back(
+        { userId, packetType, std::string(data, data + length) });
+    },
+    &res);
+  return res;
+}
+
+void SendThreaded(Networking::IServer& server, Networking::UserId userId,
+                  const std::string& s)
+{
+  server.Send(userId, reinterpret_cast<Networking::PacketData>(s.data()),
+              s.size(), true);
+}
+
+template <class F>
+void WaitFor(const F& f)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!f()) {
+    REQUIRE(std::chrono::steady_clock::now() < deadline);
+    std::this_thread::yield();
+  }
+}
+}
+
+TEST_CASE("MpscQueue delivers items of all producers", "[Networking]")
+{
+  Networking::MpscQueue<int> queue(100);
+  REQUIRE(queue.GetCapacity() == 128);
+
+  constexpr int numProducers = 4, numItems = 10000;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < numProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < numItems; ++i) {
+        int v = p * numItems + i;
+        while (!queue.TryPush(v))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  std::vector<int> lastByProducer(numProducers, -1);
+  int numReceived = 0, v;
+  while (numReceived < numProducers * numItems) {
+    if (!queue.TryPop(v))
+      continue;
+    // Order is kept within a producer
+    REQUIRE(v % numItems > lastByProducer[v / numItems]);
+    lastByProducer[v / numItems] = v % numItems;
+    ++numReceived;
+  }
+  for (auto& t : producers)
+    t.join();
+  REQUIRE(!queue.TryPop(v));
+
+  v = 1;
+  for (size_t i = 0; i < queue.GetCapacity(); ++i)
+    REQUIRE(queue.TryPush(v));
+  REQUIRE(!queue.TryPush(v));
+}
+
+TEST_CASE("Threaded: packets pass through the I/O thread", "[Networking]")
+{
+  auto inner = std::make_shared<IoTestServer>();
+  Networking::ThreadedServer server(inner, 16,
+                                    std::chrono::microseconds(100));
+
+  inner->Inject(3, Networking::PacketType::ServerSideUserConnect);
+  inner->Inject(3, Networking::PacketType::Message, "abc");
+  inner->WaitDelivered();
+
+  auto received = TickThreaded(server);
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0].type == Networking::PacketType::ServerSideUserConnect);
+  REQUIRE(received[1].userId == 3);
+  REQUIRE(received[1].data == "abc");
+  REQUIRE(TickThreaded(server).empty());
+
+  SendThreaded(server, 3, "de");
+  server.SendMany({ 3, 4 }, reinterpret_cast<Networking::PacketData>("f"), 1,
+                  true);
+  WaitFor([&] { return inner->GetSent().size() == 3; });
+  auto sent = inner->GetSent();
+  REQUIRE(sent[0] == std::make_pair(Networking::UserId(3), std::string("de")));
+  REQUIRE(sent[1] == std::make_pair(Networking::UserId(3), std::string("f")));
+  REQUIRE(sent[2] == std::make_pair(Networking::UserId(4), std::string("f")));
+}
+
+TEST_CASE("Threaded: packets to a disconnected user are dropped until the "
+          "game thread processes the disconnect",
+          "[Networking]")
+{
+  auto inner = std::make_shared<IoTestServer>();
+  Networking::ThreadedServer server(inner, 16,
+                                    std::chrono::microseconds(100));
+
+  inner->Inject(0, Networking::PacketType::ServerSideUserConnect);
+  inner->WaitDelivered();
+  TickThreaded(server);
+
+  // The id is reused by a new connection right away
+  inner->Inject(0, Networking::PacketType::ServerSideUserDisconnect);
+  inner->Inject(0, Networking::PacketType::ServerSideUserConnect);
+  inner->WaitDelivered();
+
+  // Game thread hasn't seen the disconnect yet, so this is meant for the old
+  // user
+  SendThreaded(server, 0, "old");
+  WaitFor([&] { return server.GetStats().numDroppedDisconnected == 1; });
+
+  REQUIRE(TickThreaded(server).size() == 2);
+  SendThreaded(server, 0, "new");
+  WaitFor([&] { return inner->GetSent().size() == 1; });
+  REQUIRE(inner->GetSent()[0].second == "new");
+}
+
+TEST_CASE("Threaded: a slow game thread pauses receiving, nothing is dropped",
+          "[Networking]")
+{
+  auto inner = std::make_shared<IoTestServer>();
+  Networking::ThreadedServer server(inner, 16,
+                                    std::chrono::microseconds(100));
+
+  // Queue and overflow hold 16 messages each, the rest waits in the wrapped
+  // server until the game thread ticks
+  for (int i = 0; i < 40; ++i)
+    inner->Inject(1, Networking::PacketType::Message, std::to_string(i));
+  inner->Inject(1, Networking::PacketType::ServerSideUserDisconnect);
+  WaitFor([&] { return server.GetStats().numIncomingStalls == 1; });
+
+  // The game thread never waits for the I/O thread, which keeps sending
+  for (int i = 0; i < 100; ++i)
+    SendThreaded(server, 2, std::to_string(i));
+  WaitFor([&] { return inner->GetSent().size() == 100; });
+  auto sent = inner->GetSent();
+  for (int i = 0; i < 100; ++i)
+    REQUIRE(sent[i].second == std::to_string(i));
+
+  std::vector<ReceivedPacket> received;
+  WaitFor([&] {
+    for (auto& packet : TickThreaded(server))
+      received.push_back(packet);
+    return received.size() == 41;
+  });
+  for (int i = 0; i < 40; ++i)
+    REQUIRE(received[i].data == std::to_string(i));
+  REQUIRE(received[40].type ==
+          Networking::PacketType::ServerSideUserDisconnect);
+}
+
+TEST_CASE("Threaded: JSON messages are parsed by the I/O thread",
+          "[Networking]")
+{
+  auto inner = std::make_shared<IoTestServer>();
+  Networking::ThreadedServer server(inner, 16,
+                                    std::chrono::microseconds(100));
+
+  inner->Inject(1, Networking::PacketType::Message, "_{\"t\":7}");
+  inner->WaitDelivered();
+
+  int64_t t = 0;
+  server.Tick(
+    [](void* state, Networking::UserId userId,
+       Networking::PacketType packetType, Networking::PacketData data,
+       size_t length) {
+      auto preParsed =
+        Networking::ThreadedServer::FindPreParsed(data, length);
+      REQUIRE(preParsed);
+      REQUIRE(!Networking::ThreadedServer::FindPreParsed(data, length - 1));
+      *reinterpret_cast<int64_t*>(state) = (*preParsed)["t"].get_int64();
+    },
+    &t);
+  REQUIRE(t == 7);
+}
+
+
+TEST_CASE("Threaded: Tick respects the receive budget", "[Networking]")
+{
+  auto inner = std::make_shared<IoTestServer>();
+  auto stats = std::make_shared<Networking::ReceiveStats>();
+  Networking::ReceiveBudget budget;
+  budget.maxPackets = 2;
+  Networking::ThreadedServer server(
+    inner, 16, std::chrono::microseconds(100), budget, stats);
+
+  for (int i = 0; i < 4; ++i)
+    inner->Inject(1, Networking::PacketType::Message, std::to_string(i));
+  inner->WaitDelivered();
+
+  auto received = TickThreaded(server);
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[1].data == "1");
+  REQUIRE(stats->numTicksOverBudget == 1);
+
+  // Exactly maxPackets left, nothing is deferred
+  received = TickThreaded(server);
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0].data == "2");
+  REQUIRE(stats->numTicksOverBudget == 1);
+  REQUIRE(TickThreaded(server).empty());
+}
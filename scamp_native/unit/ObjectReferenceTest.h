@@ -1,5 +1,7 @@
 #include "TestUtils.hpp"
+#include <algorithm>
 #include <catch2/catch.hpp>
+#include <random>
 
 namespace {
 MpObjectReference& CreateMpObjectReference_(WorldState& worldState,
@@ -10,6 +12,30 @@ MpObjectReference& CreateMpObjectReference_(WorldState& worldState,
   worldState.AddForm(std::move(refr), id);
   return worldState.GetFormAt<MpObjectReference>(id);
 }
+
+class TriggerTestReference : public MpObjectReference
+{
+public:
+  TriggerTestReference(const LocationalData& locationalData,
+                       const NiPoint3& primitiveBoundsDiv2)
+    : MpObjectReference(locationalData, FormCallbacks::DoNothing(), 0,
+                        "ACTI", primitiveBoundsDiv2)
+  {
+  }
+
+  void SendPapyrusEvent(const char* eventName, const VarValue*,
+                        size_t) override
+  {
+    events.push_back(eventName);
+  }
+
+  size_t CountEvents(const char* eventName) const
+  {
+    return std::count(events.begin(), events.end(), eventName);
+  }
+
+  std::vector<std::string> events;
+};
 }
 
 TEST_CASE("Disable makes ref invisible", "[ObjectReference]")
@@ -38,4 +64,258 @@ TEST_CASE("Disable makes ref invisible", "[ObjectReference]")
 
   ref.Enable();
   REQUIRE(ref.GetListeners() == std::set<MpObjectReference*>{ &ac });
+}
+
+TEST_CASE("Listeners follow the 3x3 window of moving refs",
+          "[ObjectReference]")
+{
+  PartOne p;
+
+  constexpr uint32_t numActors = 24;
+  std::vector<MpActor*> actors;
+  for (uint32_t i = 0; i < numActors; ++i) {
+    p.CreateActor(0xff000000 + i, { 0, 0, 0 }, 0, 0x3c);
+    actors.push_back(&p.worldState.GetFormAt<MpActor>(0xff000000 + i));
+    actors.back()->SetPos({ 0, 0, 0 });
+  }
+
+  auto cellOf = [](MpActor* ac) {
+    return std::make_pair(static_cast<int>(ac->GetPos().x / 4096),
+                          static_cast<int>(ac->GetPos().y / 4096));
+  };
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> actorIdx(0, numActors - 1),
+    step(-2 * 4096, 2 * 4096);
+  std::uniform_real_distribution<float> withinCell(0.f, 4096.f);
+
+  for (int i = 0; i < 2000; ++i) {
+    auto ac = actors[actorIdx(rng)];
+    if (i % 50 == 0) {
+      ac->IsDisabled() ? ac->Enable() : ac->Disable();
+    } else if (i % 3 == 0) {
+      // Stays in the same cell
+      auto cell = cellOf(ac);
+      ac->SetPos({ cell.first * 4096.f + withinCell(rng),
+                   cell.second * 4096.f + withinCell(rng), 0 });
+    } else {
+      auto pos = ac->GetPos();
+      ac->SetPos({ std::clamp(pos.x + step(rng), 0.f, 40000.f),
+                   std::clamp(pos.y + step(rng), 0.f, 40000.f), 0 });
+    }
+
+    for (auto listener : actors) {
+      if (listener->IsDisabled())
+        continue;
+      std::set<MpObjectReference*> expected;
+      for (auto other : actors) {
+        auto a = cellOf(listener), b = cellOf(other);
+        if (!other->IsDisabled() && std::abs(a.first - b.first) <= 1 &&
+            std::abs(a.second - b.second) <= 1)
+          expected.insert(other);
+      }
+      REQUIRE(listener->GetListeners() == expected);
+    }
+  }
+}
+
+TEST_CASE("Grid hysteresis keeps neighbours pacing along a cell border",
+          "[ObjectReference]")
+{
+  PartOne p;
+  p.worldState.SetGridHysteresis(512.f, std::chrono::milliseconds(10));
+
+  p.CreateActor(0xff000000, { 100, 0, 0 }, 0, 0x3c);
+  p.CreateActor(0xff000001, { 4096 * 2 + 100, 0, 0 }, 0, 0x3c);
+  auto& ac = p.worldState.GetFormAt<MpActor>(0xff000000);
+  auto& other = p.worldState.GetFormAt<MpActor>(0xff000001);
+  ac.SetPos({ 100, 0, 0 });
+  other.SetPos({ 4096 * 2 + 100, 0, 0 });
+  auto& stats = p.worldState.GetGridChurnStats();
+  REQUIRE(!ac.GetListeners().count(&other));
+
+  // Within the margin of cell 0
+  ac.SetPos({ 4096 + 100, 0, 0 });
+  REQUIRE(stats.numCellChangesAvoided == 1);
+  REQUIRE(!ac.GetListeners().count(&other));
+
+  ac.SetPos({ 4096 + 700, 0, 0 });
+  REQUIRE(ac.GetListeners().count(&other));
+
+  // Within the margin of cell 1
+  ac.SetPos({ 4096 - 100, 0, 0 });
+  REQUIRE(stats.numCellChangesAvoided == 2);
+  REQUIRE(ac.GetListeners().count(&other));
+
+  // Leaves and comes back during the grace period
+  ac.SetPos({ 100, 0, 0 });
+  REQUIRE(stats.numUnsubscribesDeferred == 1);
+  REQUIRE(ac.GetListeners().count(&other));
+  REQUIRE(other.GetListeners().count(&ac));
+  ac.SetPos({ 4096 + 700, 0, 0 });
+  REQUIRE(stats.numUnsubscribesCancelled == 1);
+  REQUIRE(ac.GetListeners().count(&other));
+
+  ac.SetPos({ 100, 0, 0 });
+  REQUIRE(stats.numUnsubscribesDeferred == 2);
+  p.worldState.TickTimers();
+  REQUIRE(stats.numUnsubscribesExpired == 0);
+  p.worldState.TickTimers(std::chrono::system_clock::now() +
+                          std::chrono::milliseconds(10));
+  REQUIRE(stats.numUnsubscribesExpired == 1);
+  REQUIRE(!ac.GetListeners().count(&other));
+  REQUIRE(!other.GetListeners().count(&ac));
+}
+
+TEST_CASE("Grid settings apply per cellOrWorld", "[ObjectReference]")
+{
+  PartOne p;
+  p.worldState.SetGridSettings(0x1234, { 1000.f, 0 });
+  p.worldState.SetGridSettings(0x5678, { 4096.f, 3 });
+  REQUIRE_THROWS_WITH(p.worldState.SetGridSettings(0x1234, { 0.f, 1 }),
+                      Contains("Invalid grid settings"));
+
+  auto createActors = [&](uint32_t firstId, uint32_t cellOrWorld,
+                          float distance) {
+    p.CreateActor(firstId, { 100, 0, 0 }, 0, cellOrWorld);
+    p.CreateActor(firstId + 1, { 100 + distance, 0, 0 }, 0, cellOrWorld);
+    auto& a = p.worldState.GetFormAt<MpActor>(firstId);
+    auto& b = p.worldState.GetFormAt<MpActor>(firstId + 1);
+    a.SetPos(a.GetPos());
+    b.SetPos(b.GetPos());
+    return a.GetListeners().count(&b) > 0;
+  };
+
+  REQUIRE(createActors(0xff000000, 0x3c, 4096));
+  REQUIRE(!createActors(0xff000002, 0x3c, 4096 * 2));
+  REQUIRE(!createActors(0xff000004, 0x1234, 1000));
+  REQUIRE(createActors(0xff000006, 0x1234, 500));
+  REQUIRE(createActors(0xff000008, 0x5678, 4096 * 3));
+  REQUIRE(!createActors(0xff00000a, 0x5678, 4096 * 4));
+
+  REQUIRE_THROWS_WITH(p.worldState.SetGridSettings(0x1234, { 4096.f, 1 }),
+                      Contains("Grid of 1234 already exists"));
+}
+
+TEST_CASE("Triggers overlapping several cells see refs from each of them",
+          "[ObjectReference]")
+{
+  PartOne p;
+
+  p.worldState.AddForm(
+    std::make_unique<TriggerTestReference>(
+      LocationalData{ { 4096, 0, 0 }, { 0, 0, 0 }, 0x3c },
+      NiPoint3{ 200, 200, 200 }),
+    0xff000000);
+  auto& trigger = p.worldState.GetFormAt<TriggerTestReference>(0xff000000);
+  trigger.SetPos(trigger.GetPos());
+
+  p.CreateActor(0xff000001, { 3000, 0, 0 }, 0, 0x3c);
+  auto& ac = p.worldState.GetFormAt<MpActor>(0xff000001);
+  ac.SetPos(ac.GetPos());
+  REQUIRE(trigger.events.empty());
+
+  ac.SetPos({ 4000, 0, 0 });
+  p.worldState.TickTimers();
+  REQUIRE(trigger.CountEvents("OnTriggerEnter") == 1);
+  REQUIRE(trigger.CountEvents("OnTrigger") == 1);
+
+  // Crosses the cell border while staying inside
+  ac.SetPos({ 4200, 0, 0 });
+  p.worldState.TickTimers();
+  REQUIRE(trigger.CountEvents("OnTriggerEnter") == 1);
+  REQUIRE(trigger.CountEvents("OnTrigger") == 2);
+
+  // Above the box
+  ac.SetPos({ 4290, 0, 250 });
+  p.worldState.TickTimers();
+  REQUIRE(trigger.CountEvents("OnTriggerLeave") == 1);
+  REQUIRE(trigger.CountEvents("OnTrigger") == 2);
+
+  ac.SetPos({ 4200, 0, 0 });
+  ac.SetPos({ 4500, 0, 0 });
+  p.worldState.TickTimers();
+  REQUIRE(trigger.CountEvents("OnTriggerEnter") == 2);
+  REQUIRE(trigger.CountEvents("OnTriggerLeave") == 2);
+
+  p.worldState.DestroyForm(0xff000000);
+  ac.SetPos({ 4000, 0, 0 });
+  p.worldState.TickTimers();
+}
+
+TEST_CASE("Spatial queries match a brute force scan", "[ObjectReference]")
+{
+  PartOne p;
+  p.worldState.SetGridHysteresis(300.f, std::chrono::seconds(0));
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> coord(-20000.f, 20000.f);
+  std::uniform_int_distribution<uint32_t> baseIdx(0, 3);
+  const char* baseTypes[] = { "FURN", "FURN", "ACTI", "CONT" };
+
+  std::vector<MpObjectReference*> refs;
+  for (uint32_t i = 0; i < 500; ++i) {
+    auto baseId = baseIdx(rng);
+    p.worldState.AddForm(
+      std::make_unique<MpObjectReference>(
+        LocationalData{ { coord(rng), coord(rng), 0 }, { 0, 0, 0 }, 0x3c },
+        FormCallbacks::DoNothing(), 0x100 + baseId, baseTypes[baseId]),
+      0xff000000 + i);
+    refs.push_back(&p.worldState.GetFormAt<MpObjectReference>(0xff000000 + i));
+    refs.back()->SetPos(refs.back()->GetPos());
+  }
+
+  // Small moves stay within the hysteresis margin of indexed cells
+  std::uniform_real_distribution<float> delta(-400.f, 400.f);
+  for (auto ref : refs) {
+    auto pos = ref->GetPos();
+    ref->SetPos({ pos.x + delta(rng), pos.y + delta(rng), 0 });
+  }
+
+  for (int i = 0; i < 50; ++i) {
+    WorldState::SpatialQuery query;
+    query.cellOrWorld = 0x3c;
+    query.center = { coord(rng), coord(rng), 0 };
+    query.radius = std::uniform_real_distribution<float>(0, 15000)(rng);
+    if (i % 3 == 1)
+      query.baseIds = { 0x100, 0x103 };
+    if (i % 3 == 2)
+      query.baseTypes = { "FURN" };
+
+    std::vector<std::pair<float, MpObjectReference*>> expected;
+    for (auto ref : refs) {
+      auto d = ref->GetPos() - query.center;
+      bool baseIdMatches = query.baseIds.empty() ||
+        std::count(query.baseIds.begin(), query.baseIds.end(),
+                   ref->GetBaseId());
+      bool baseTypeMatches = query.baseTypes.empty() ||
+        ref->GetBaseType() == query.baseTypes[0];
+      if (d * d <= query.radius * query.radius && baseIdMatches &&
+          baseTypeMatches)
+        expected.push_back({ d * d, ref });
+    }
+    std::sort(expected.begin(), expected.end(),
+              [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+
+    auto found = p.worldState.FindRefsInRadius(query);
+    REQUIRE(found.size() == expected.size());
+    for (size_t j = 0; j < found.size(); ++j)
+      REQUIRE(found[j] == expected[j].second);
+
+    auto nearest = p.worldState.FindNearestRefs(query, 3);
+    REQUIRE(nearest.size() == std::min<size_t>(3, expected.size()));
+    for (size_t j = 0; j < nearest.size(); ++j)
+      REQUIRE(nearest[j] == expected[j].second);
+  }
+
+  refs[0]->Disable();
+  WorldState::SpatialQuery query;
+  query.cellOrWorld = 0x3c;
+  query.center = refs[0]->GetPos();
+  query.radius = 1.f;
+  REQUIRE(p.worldState.FindRefsInRadius(query).empty());
+
+  query.radius = -1.f;
+  REQUIRE_THROWS_WITH(p.worldState.FindNearestRefs(query, 1),
+                      Contains("Invalid radius"));
 }
\ No newline at end of file
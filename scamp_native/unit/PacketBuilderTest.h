@@ -0,0 +1,71 @@
+#pragma once
+#include "PacketBuilder.h"
+#include "PropertyMessage.h"
+#include "TestUtils.hpp"
+
+namespace {
+std::string ToString(const Networking::PacketBuilder& msg)
+{
+  return std::string(reinterpret_cast<const char*>(msg.GetData()),
+                     msg.GetLength());
+}
+}
+
+TEST_CASE("PacketBuilder writes MinPacketId prefix and fragments",
+          "[PacketBuilder]")
+{
+  Networking::PacketBuilder msg;
+  REQUIRE(msg.GetLength() == 1);
+  REQUIRE(msg.GetData()[0] == Networking::MinPacketId);
+
+  msg.AppendFormatted(R"({"idx": %u, "name": )", 5u);
+  msg.AppendJsonString("a\"b\\c\n\x01");
+  msg.Append(R"(, "content": )").Append(R"({"x":1})").Append('}');
+
+  auto s = ToString(msg);
+  REQUIRE(s[0] == static_cast<char>(Networking::MinPacketId));
+  auto j = nlohmann::json::parse(s.substr(1));
+  REQUIRE(j["idx"] == 5);
+  REQUIRE(j["name"] == "a\"b\\c\n\x01");
+  REQUIRE(j["content"]["x"] == 1);
+
+  msg.Clear();
+  REQUIRE(msg.GetLength() == 1);
+
+  // Formatted output longer than the reserve is formatted again
+  std::string longString(1000, 'x');
+  msg.AppendFormatted("%s", longString.data());
+  REQUIRE(ToString(msg).substr(1) == longString);
+}
+
+TEST_CASE("Nested PacketBuilders use different buffers", "[PacketBuilder]")
+{
+  Networking::PacketBuilder outer;
+  outer.Append("outer");
+  {
+    Networking::PacketBuilder inner;
+    inner.Append("inner");
+    REQUIRE(ToString(inner).substr(1) == "inner");
+  }
+  REQUIRE(ToString(outer).substr(1) == "outer");
+}
+
+TEST_CASE("WritePropertyMessage serializes the value like json::dump",
+          "[PacketBuilder]")
+{
+  nlohmann::json value = { { "name", "a\"b" }, { "weight", 9.5 } };
+
+  for (int i = 0; i < 2; ++i) {
+    Networking::PacketBuilder msg;
+    WritePropertyMessage(msg, 7, "inventory", value);
+
+    auto s = ToString(msg);
+    REQUIRE(s.substr(s.find(R"("data":)") + 7) == value.dump() + "}");
+    auto j = nlohmann::json::parse(s.substr(1));
+    REQUIRE(j["idx"] == 7);
+    REQUIRE(j["t"] == MsgType::UpdateProperty);
+    REQUIRE(j["propName"] == "inventory");
+    REQUIRE(j["data"] == value);
+    value = 1;
+  }
+}
\ No newline at end of file
@@ -106,4 +106,35 @@ TEST_CASE("RegisterForSingleUpdate order", "[Papyrus][Form]")
 
   REQUIRE(OrderCountingForm().Order() ==
           std::vector<uint32_t>{ 0xff000000, 0xff000001, 0xff000002 });
+}
+
+TEST_CASE("RegisterForSingleUpdate replaces the pending update",
+          "[Papyrus][Form]")
+{
+  class CountingForm : public MpForm
+  {
+  public:
+    void Update() override { counter++; }
+
+    int counter = 0;
+  };
+
+  PartOne p;
+  p.worldState.AddForm(std::make_unique<CountingForm>(), 0xff000000);
+  p.worldState.AddForm(std::make_unique<CountingForm>(), 0xff000001);
+
+  auto& form = p.worldState.GetFormAt<CountingForm>(0xff000000);
+  PapyrusForm().RegisterForSingleUpdate(form.ToVarValue(), { VarValue(0.f) });
+  PapyrusForm().RegisterForSingleUpdate(form.ToVarValue(), { VarValue(0.f) });
+  REQUIRE(p.worldState.GetTimerStats().numTimers == 1);
+  p.worldState.TickTimers();
+  REQUIRE(form.counter == 1);
+
+  // Destroyed forms don't keep their timers
+  auto& other = p.worldState.GetFormAt<CountingForm>(0xff000001);
+  PapyrusForm().RegisterForSingleUpdate(other.ToVarValue(),
+                                        { VarValue(0.f) });
+  p.worldState.DestroyForm(0xff000001);
+  REQUIRE(p.worldState.GetTimerStats().numTimers == 0);
+  p.worldState.TickTimers();
 }
\ No newline at end of file
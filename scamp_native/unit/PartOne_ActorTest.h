@@ -238,4 +238,47 @@ TEST_CASE("'isRaceMenuOpen' property should present in 'createActor'",
   REQUIRE(partOne.Messages().size() == 1);
   REQUIRE(partOne.Messages()[0].j["type"] == "createActor");
   REQUIRE(partOne.Messages()[0].j["props"]["isRaceMenuOpen"] == true);
+}
+
+TEST_CASE("'createActor' payload is shared by listeners until emitter changes",
+          "[PartOne]")
+{
+  PartOne partOne;
+  DoConnect(partOne, 0);
+  DoConnect(partOne, 1);
+
+  partOne.CreateActor(0xff000000, { 1, 1, 1 }, 3, 0x3c);
+  auto& ac = partOne.worldState.GetFormAt<MpActor>(0xff000000);
+  ac.AddItem(0x12eb7, 3);
+  partOne.SetUserActor(0, 0xff000000);
+  REQUIRE(ac.GetSpawnPayload());
+
+  partOne.CreateActor(0xff000001, { 1, 1, 1 }, 3, 0x3c);
+  partOne.Messages().clear();
+  partOne.SetUserActor(1, 0xff000001);
+  REQUIRE(ac.GetSpawnPayload());
+
+  // The owner-only inventory isn't spliced into the neighbour's message
+  auto it = std::find_if(
+    partOne.Messages().begin(), partOne.Messages().end(), [](auto& m) {
+      return m.userId == 1 && m.j["type"] == "createActor" && m.j["idx"] == 0;
+    });
+  REQUIRE(it != partOne.Messages().end());
+  REQUIRE(it->j["isMe"] == false);
+  REQUIRE(it->j["props"] == nlohmann::json{ { "isHostedByOther", true } });
+  REQUIRE(it->j["transform"]["pos"] == nlohmann::json{ 1, 1, 1 });
+
+  // The transform isn't cached, so moving keeps the payload
+  ac.SetPos({ 2, 2, 2 });
+  REQUIRE(ac.GetSpawnPayload());
+  auto& listener = partOne.worldState.GetFormAt<MpActor>(0xff000001);
+  MpObjectReference::Unsubscribe(&ac, &listener);
+  partOne.Messages().clear();
+  MpObjectReference::Subscribe(&ac, &listener);
+  REQUIRE(partOne.Messages().size() == 1);
+  REQUIRE(partOne.Messages()[0].j["transform"]["pos"] ==
+          nlohmann::json{ 2, 2, 2 });
+
+  ac.SetRaceMenuOpen(true);
+  REQUIRE(!ac.GetSpawnPayload());
 }
\ No newline at end of file
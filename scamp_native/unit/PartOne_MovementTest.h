@@ -8,7 +8,6 @@ TEST_CASE("Hypothesis: UpdateMovement may send nothing when actor without "
   PartOne partOne;
 
   constexpr uint32_t n = 20;
-  static_assert(n <= MAX_PLAYERS - 1);
 
   for (uint32_t i = 0; i < n; ++i) {
     partOne.CreateActor(i + 0xff000000, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
@@ -3,6 +3,8 @@
 
 #include "Loader.h"
 #include "Primitive.h"
+#include <cmath>
+#include <random>
 
 extern espm::Loader l;
 
@@ -43,4 +45,68 @@ TEST_CASE("IsInsidePrimitive", "[primitive]")
   REQUIRE(Primitive::IsInside({ 23872.0000f, -10176.0000f, -3392.0000f },
                               Primitive::CreateGeoPolygonProc(
                                 Primitive::GetVertices(refr))) == false);
+}
+
+TEST_CASE("OrientedBox matches GeoPolygonProc", "[primitive]")
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> coord(-1000.f, 1000.f),
+    angle(-3.14f, 3.14f), bound(10.f, 300.f), offset(-1.5f, 1.5f);
+
+  for (int i = 0; i < 100; ++i) {
+    NiPoint3 pos(coord(rng), coord(rng), coord(rng));
+    NiPoint3 rot(0, 0, angle(rng));
+    NiPoint3 boundsDiv2(bound(rng), bound(rng), bound(rng));
+    auto box = Primitive::CreateOrientedBox(pos, rot, boundsDiv2);
+    auto polygonProc = Primitive::CreateGeoPolygonProc(
+      Primitive::GetVertices(pos, rot, boundsDiv2));
+
+    std::vector<NiPoint3> points;
+    while (points.size() < 37) {
+      // Local coordinates in units of half extents
+      NiPoint3 local(offset(rng), offset(rng), offset(rng));
+      if (std::abs(std::abs(local.x) - 1) < 0.01f ||
+          std::abs(std::abs(local.y) - 1) < 0.01f ||
+          std::abs(std::abs(local.z) - 1) < 0.01f)
+        continue;
+      auto x = local.x * box.halfExtents.x, y = local.y * box.halfExtents.y;
+      points.push_back({ pos.x + x * box.cosZ - y * box.sinZ,
+                         pos.y + x * box.sinZ + y * box.cosZ,
+                         pos.z + local.z * box.halfExtents.z });
+    }
+
+    std::vector<uint8_t> res(points.size());
+    Primitive::IsInside(points.data(), points.size(), box, res.data());
+    for (size_t j = 0; j < points.size(); ++j) {
+      auto expected = Primitive::IsInside(points[j], polygonProc);
+      REQUIRE(Primitive::IsInside(points[j], box) == expected);
+      REQUIRE(res[j] == expected);
+    }
+  }
+}
+
+TEST_CASE("OrientedBox batch of boxes matches single tests", "[primitive]")
+{
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> coord(-300.f, 300.f),
+    angle(-3.14f, 3.14f), bound(10.f, 300.f);
+
+  std::vector<Primitive::OrientedBox> boxes;
+  for (int i = 0; i < 37; ++i) {
+    boxes.push_back(Primitive::CreateOrientedBox(
+      { coord(rng), coord(rng), coord(rng) }, { 0, 0, angle(rng) },
+      { bound(rng), bound(rng), bound(rng) }));
+  }
+
+  std::vector<uint8_t> res(boxes.size());
+  size_t numInside = 0;
+  for (int i = 0; i < 100; ++i) {
+    NiPoint3 point(coord(rng), coord(rng), coord(rng));
+    Primitive::IsInside(point, boxes.data(), boxes.size(), res.data());
+    for (size_t j = 0; j < boxes.size(); ++j) {
+      REQUIRE(res[j] == Primitive::IsInside(point, boxes[j]));
+      numInside += res[j];
+    }
+  }
+  REQUIRE(numInside > 0);
 }
\ No newline at end of file
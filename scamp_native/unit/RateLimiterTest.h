@@ -0,0 +1,92 @@
+#pragma once
+#include "TestUtils.hpp"
+
+#include "RateLimiter.h"
+
+TEST_CASE("RateLimiter token buckets", "[RateLimiter]")
+{
+  RateLimiter limiter;
+  REQUIRE(!limiter.IsEnabled());
+  REQUIRE(limiter.Consume(0, MsgType::UpdateAnimation));
+
+  limiter.SetLimit(MsgType::UpdateAnimation, { 10.f, 3.f });
+  REQUIRE(limiter.IsEnabled());
+
+  auto t = RateLimiter::Clock::now();
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(limiter.Consume(0, MsgType::UpdateAnimation, t));
+  REQUIRE(!limiter.Consume(0, MsgType::UpdateAnimation, t));
+  REQUIRE(limiter.GetNumDropped(MsgType::UpdateAnimation) == 1);
+
+  // Other users and unlimited types have their own budget
+  REQUIRE(limiter.Consume(1, MsgType::UpdateAnimation, t));
+  REQUIRE(limiter.Consume(0, MsgType::CustomPacket, t));
+
+  // 10 per second refills one token in 100ms
+  t += std::chrono::milliseconds(110);
+  REQUIRE(limiter.Consume(0, MsgType::UpdateAnimation, t));
+  REQUIRE(!limiter.Consume(0, MsgType::UpdateAnimation, t));
+
+  // Buckets never exceed burst
+  t += std::chrono::seconds(10);
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(limiter.Consume(0, MsgType::UpdateAnimation, t));
+  REQUIRE(!limiter.Consume(0, MsgType::UpdateAnimation, t));
+
+  // A reconnected user starts with a full bucket
+  limiter.Forget(0);
+  REQUIRE(limiter.Consume(0, MsgType::UpdateAnimation, t));
+
+  limiter.SetLimit(MsgType::UpdateAnimation, {});
+  REQUIRE(!limiter.IsEnabled());
+  REQUIRE_THROWS_WITH(limiter.SetLimit(MsgType::Activate, { -1.f, 1.f }),
+                      Contains("must not be negative"));
+}
+
+TEST_CASE("PartOne drops messages over the rate limit", "[RateLimiter]")
+{
+  PartOne partOne;
+  partOne.GetRateLimiter().SetLimit(MsgType::UpdateMovement,
+                                    { 0.001f, 2.f });
+
+  for (Networking::UserId i = 0; i < 2; ++i) {
+    DoConnect(partOne, i);
+    partOne.CreateActor(0xff000000 + i, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+    partOne.SetUserActor(i, 0xff000000 + i);
+  }
+  partOne.Messages().clear();
+
+  for (int i = 0; i < 5; ++i)
+    DoUpdateMovement(partOne, 0xff000000, 0);
+
+  auto numForwarded =
+    std::count_if(partOne.Messages().begin(), partOne.Messages().end(),
+                  [](const PartOne::Message& m) { return m.userId == 1; });
+  REQUIRE(numForwarded == 2);
+  REQUIRE(partOne.GetRateLimiter().GetNumDropped(MsgType::UpdateMovement) ==
+          3);
+}
+
+TEST_CASE("Messages over the rate limit are dropped before parsing",
+          "[RateLimiter]")
+{
+  PartOne partOne;
+  partOne.GetRateLimiter().SetLimit(MsgType::CustomEvent, { 0.001f, 1.f });
+  DoConnect(partOne, 0);
+
+  auto send = [&](const std::string& json) {
+    std::string s(1, static_cast<char>(Networking::MinPacketId));
+    s += json;
+    PartOne* ptr = &partOne;
+    PartOne::HandlePacket(ptr, 0, Networking::PacketType::Message,
+                          reinterpret_cast<Networking::PacketData>(s.data()),
+                          s.size());
+  };
+  const auto t = std::to_string(static_cast<int>(MsgType::CustomEvent));
+
+  // The first one takes the only token and fails to parse
+  REQUIRE_THROWS(send("{ \"t\" : " + t + ", \"args\": ["));
+  REQUIRE_NOTHROW(send("{\"t\":" + t + ",\"args\":["));
+  REQUIRE_NOTHROW(send("{\"x\":{\"t\":1},\"t\":" + t + ",\"args\":["));
+  REQUIRE(partOne.GetRateLimiter().GetNumDropped(MsgType::CustomEvent) == 2);
+}
@@ -4,6 +4,7 @@
 #include "FileDatabase.h"
 #include "MpChangeForms.h"
 #include <filesystem>
+#include <set>
 
 std::shared_ptr<ISaveStorage> MakeSaveStorage()
 {
@@ -26,7 +27,7 @@ MpChangeForm CreateChangeForm(const char* descStr)
 void UpsertSync(ISaveStorage& st, std::vector<MpChangeForm> changeForms)
 {
   bool finished = false;
-  st.Upsert(changeForms, [&] { finished = true; });
+  st.Upsert(changeForms, [&](bool) { finished = true; });
 
   int i = 0;
   while (!finished) {
@@ -158,4 +159,146 @@ TEST_CASE("Changes are transferred to SaveStorage", "[save]")
 
   WaitForNextUpsert(*st, p.worldState);
   REQUIRE(ISaveStorageUtils::CountSync(*st) == 1);
+}
+
+TEST_CASE("FileDatabase writes complete change forms", "[save]")
+{
+  auto st = MakeSaveStorage();
+
+  auto f = CreateChangeForm("1");
+  f.position = { 1, 2, 3 };
+  f.inv.AddItem(0x12eb7, 1);
+  UpsertSync(*st, { f });
+
+  f.position = { 4, 5, 6 };
+  f.inv.AddItem(0x12eb7, 1);
+  f.isDisabled = true;
+  f.dirtyFields = MpChangeForm::kPositionDirty;
+  UpsertSync(*st, { f });
+
+  auto res = ISaveStorageUtils::FindAllSync(*st)[{ 1, "" }];
+  REQUIRE(res.position == NiPoint3(4, 5, 6));
+  REQUIRE(res.inv.GetItemCount(0x12eb7) == 2);
+  REQUIRE(res.isDisabled == true);
+}
+
+TEST_CASE("Saved refs collect only new dirty field groups", "[save]")
+{
+  PartOne p;
+  auto st = MakeSaveStorage();
+  p.AttachSaveStorage(st);
+
+  p.CreateActor(0xffaaaeee, { 1, 1, 1 }, 1, 0x3c);
+  auto& ac = p.worldState.GetFormAt<MpActor>(0xffaaaeee);
+  REQUIRE(ac.GetChangeForm().dirtyFields == MpChangeForm::kAllDirty);
+
+  WaitForNextUpsert(*st, p.worldState);
+  REQUIRE(ac.GetChangeForm().dirtyFields == 0);
+
+  ac.AddItem(0x12eb7, 2);
+  REQUIRE(ac.GetChangeForm().dirtyFields == MpChangeForm::kInventoryDirty);
+
+  ac.SetRaceMenuOpen(false);
+  REQUIRE(ac.GetChangeForm().dirtyFields ==
+          (MpChangeForm::kInventoryDirty | MpChangeForm::kPropsDirty));
+
+  WaitForNextUpsert(*st, p.worldState);
+  REQUIRE(ac.GetChangeForm().dirtyFields == 0);
+
+  auto res = ISaveStorageUtils::FindAllSync(*st)[{ 0xffaaaeee, "" }];
+  REQUIRE(res.inv.GetItemCount(0x12eb7) == 2);
+  REQUIRE(res.position == NiPoint3(1, 1, 1));
+}
+
+namespace {
+// Finishes upserts right away and records each batch
+class RecordingSaveStorage : public ISaveStorage
+{
+public:
+  void IterateSync(const IterateSyncCallback& cb) override {}
+
+  void Upsert(const std::vector<MpChangeForm>& changeForms,
+              const UpsertCallback& cb) override
+  {
+    batches.push_back(changeForms);
+    cb(!failUpserts);
+  }
+
+  uint32_t GetNumFinishedUpserts() const override
+  {
+    return static_cast<uint32_t>(batches.size());
+  }
+
+  void Tick() override {}
+
+  std::vector<std::vector<MpChangeForm>> batches;
+  bool failUpserts = false;
+};
+}
+
+TEST_CASE("Save batches over budget don't starve forms", "[save]")
+{
+  WorldState worldState;
+  auto st = std::make_shared<RecordingSaveStorage>();
+  worldState.AttachSaveStorage(st);
+  worldState.GetTickScheduler().SetBudget(
+    TickScheduler::Phase::SaveCollection, std::chrono::microseconds(1));
+
+  constexpr uint32_t numForms = 10;
+  for (uint32_t i = 0; i < numForms; ++i) {
+    worldState.AddForm(
+      std::make_unique<MpObjectReference>(
+        LocationalData(), FormCallbacks::DoNothing(), 0, "STAT"),
+      0xff000000 + i);
+    worldState.RequestSave(
+      worldState.GetFormAt<MpObjectReference>(0xff000000 + i));
+  }
+
+  // Every batch takes at least one form. Saved forms change again right
+  // away, still each form is saved once in numForms batches
+  std::set<uint32_t> saved;
+  for (uint32_t tick = 0; tick < numForms; ++tick) {
+    worldState.TickTimers();
+    REQUIRE(st->batches.size() == tick + 1);
+    for (auto& changeForm : st->batches.back()) {
+      auto id = changeForm.formDesc.shortFormId;
+      saved.insert(id);
+      worldState.RequestSave(worldState.GetFormAt<MpObjectReference>(id));
+    }
+  }
+  REQUIRE(saved.size() == numForms);
+}
+
+TEST_CASE("Failed save batches restore dirty fields", "[save]")
+{
+  WorldState worldState;
+  auto st = std::make_shared<RecordingSaveStorage>();
+  worldState.AttachSaveStorage(st);
+
+  worldState.AddForm(
+    std::make_unique<MpObjectReference>(
+      LocationalData(), FormCallbacks::DoNothing(), 0, "STAT"),
+    0xff000000);
+  auto& refr = worldState.GetFormAt<MpObjectReference>(0xff000000);
+  worldState.RequestSave(refr);
+  worldState.TickTimers();
+  REQUIRE(refr.GetChangeForm().dirtyFields == 0);
+
+  st->failUpserts = true;
+  refr.SetOpen(true);
+  worldState.TickTimers();
+  REQUIRE(st->batches.size() == 2);
+  REQUIRE(st->batches[1][0].dirtyFields == MpChangeForm::kPropsDirty);
+
+  // Groups changed after the failed batch are saved along with it
+  st->failUpserts = false;
+  refr.AddItem(0x12eb7, 1);
+  worldState.TickTimers();
+  REQUIRE(st->batches.size() == 3);
+  REQUIRE(st->batches[2][0].dirtyFields ==
+          (MpChangeForm::kPropsDirty | MpChangeForm::kInventoryDirty));
+  REQUIRE(refr.GetChangeForm().dirtyFields == 0);
+
+  worldState.TickTimers();
+  REQUIRE(st->batches.size() == 3);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ServerState.h"
 #include "MsgType.h"
+#include <algorithm>
 #include <catch2/catch.hpp>
 #include <nlohmann/json.hpp>
 
@@ -7,11 +8,11 @@ TEST_CASE("Connect/Disconnect", "[ServerState]")
 {
   ServerState st;
 
-  REQUIRE(!st.userInfo[1]);
+  REQUIRE(!st.IsConnected(1));
   st.Connect(1);
-  REQUIRE(st.userInfo[1]);
+  REQUIRE(st.IsConnected(1));
   st.Disconnect(1);
-  REQUIRE(!st.userInfo[1]);
+  REQUIRE(!st.IsConnected(1));
 }
 
 TEST_CASE("maxConnectedId", "[ServerState]")
@@ -36,4 +37,38 @@ TEST_CASE("maxConnectedId", "[ServerState]")
   REQUIRE(st.maxConnectedId == 0);
   st.Disconnect(0);
   REQUIRE(st.maxConnectedId == 0);
+}
+
+TEST_CASE("Connected users are kept packed", "[ServerState]")
+{
+  ServerState st;
+
+  // Tables grow on demand, there is no compile-time slot limit
+  st.Connect(5000);
+  st.Connect(3);
+  st.Connect(70);
+  REQUIRE(st.maxConnectedId == 5000);
+
+  auto users = st.GetConnectedUsers();
+  std::sort(users.begin(), users.end());
+  REQUIRE(users == std::vector<Networking::UserId>{ 3, 70, 5000 });
+
+  st.Disconnect(3);
+  st.Disconnect(3);
+  users = st.GetConnectedUsers();
+  std::sort(users.begin(), users.end());
+  REQUIRE(users == std::vector<Networking::UserId>{ 70, 5000 });
+  REQUIRE(!st.IsConnected(3));
+  REQUIRE(st.IsConnected(70));
+
+  auto actor = reinterpret_cast<MpActor*>(0x1000);
+  REQUIRE(st.AttachActor(70, actor));
+  REQUIRE(!st.AttachActor(5000, actor));
+  REQUIRE(st.ActorByUser(70) == actor);
+  REQUIRE(st.UserByActor(actor) == 70);
+
+  st.Disconnect(70);
+  REQUIRE(st.ActorByUser(70) == nullptr);
+  REQUIRE(st.UserByActor(actor) == Networking::InvalidUserId);
+  REQUIRE(st.ActorByUser(60000) == nullptr);
 }
\ No newline at end of file
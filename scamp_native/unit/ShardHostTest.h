@@ -0,0 +1,218 @@
+#include "ShardHost.h"
+#include "TestUtils.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+class ShardTestServer : public Networking::IServer
+{
+public:
+  void Send(Networking::UserId targetUserId, Networking::PacketData data,
+            size_t length, bool reliable) override
+  {
+    sent.push_back({ targetUserId, std::string(data, data + length) });
+  }
+
+  void Tick(OnPacket onPacket, void* state) override
+  {
+    auto packets = std::move(toDeliver);
+    toDeliver.clear();
+    for (auto& [userId, type, s] : packets)
+      onPacket(state, userId, type,
+               reinterpret_cast<Networking::PacketData>(s.data()), s.size());
+  }
+
+  void Inject(Networking::UserId userId, Networking::PacketType type,
+              const std::string& s = "")
+  {
+    toDeliver.push_back({ userId, type, s });
+  }
+
+  std::vector<
+    std::tuple<Networking::UserId, Networking::PacketType, std::string>>
+    toDeliver;
+  std::vector<std::pair<Networking::UserId, std::string>> sent;
+};
+
+std::string MakeCustomPacket(const char* x)
+{
+  return MakeMessage(nlohmann::json{ { "t", MsgType::CustomPacket },
+                                     { "content", { { "x", x } } } });
+}
+
+std::vector<ShardHost::MigrationResult> TickUntilMigrated(ShardHost& host)
+{
+  for (int i = 0; i < 1000; ++i) {
+    host.Tick();
+    auto results = host.TakeMigrationResults();
+    if (!results.empty())
+      return results;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  throw std::runtime_error("Migration timed out");
+}
+}
+
+TEST_CASE("ShardHost routes users and migrates actors", "[ShardHost]")
+{
+  auto server = std::make_shared<ShardTestServer>();
+  auto lst0 = FakeListener::New(), lst1 = FakeListener::New();
+  auto shard0 = std::make_shared<PartOne>(lst0);
+  auto shard1 = std::make_shared<PartOne>(lst1);
+
+  ShardHost host(server);
+  REQUIRE(host.AddShard(shard0) == 0);
+  REQUIRE(host.AddShard(shard1) == 1);
+
+  server->Inject(0, Networking::PacketType::ServerSideUserConnect);
+  host.Tick();
+  REQUIRE(lst0->str() == "OnConnect(0)\n");
+  REQUIRE(lst1->str() == "");
+
+  host.Post(0, [](PartOne& partOne) {
+    partOne.CreateActor(0xff000ABC, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+    partOne.SetUserActor(0, 0xff000ABC);
+  });
+  host.Tick();
+
+  host.MigrateUser(0, 1);
+  REQUIRE(host.IsMigrating(0));
+
+  // Sent while migrating, must reach the target shard
+  server->Inject(0, Networking::PacketType::Message, MakeCustomPacket("y"));
+
+  auto results = TickUntilMigrated(host);
+  REQUIRE(results.size() == 1);
+  REQUIRE(results[0].error == "");
+  REQUIRE(results[0].actorId == 0xff000ABC);
+  REQUIRE(host.GetUserShard(0) == 1);
+  REQUIRE(!host.IsMigrating(0));
+
+  REQUIRE(!shard0->worldState.LookupFormById(0xff000ABC));
+  REQUIRE(!shard0->IsConnected(0));
+  REQUIRE(shard1->GetUserActor(0) == 0xff000ABC);
+  REQUIRE(shard1->GetActorPos(0xff000ABC) == NiPoint3{ 1.f, 2.f, 3.f });
+
+  host.Tick();
+  REQUIRE_THAT(lst0->str(), Contains("OnDisconnect(0)"));
+  REQUIRE_THAT(lst1->str(),
+               Contains("OnConnect(0)\nOnCustomPacket(0, {\"x\":\"y\"})"));
+
+  REQUIRE(!server->sent.empty());
+  REQUIRE_THAT(server->sent.back().second, Contains("createActor"));
+
+  server->Inject(0, Networking::PacketType::ServerSideUserDisconnect);
+  host.Tick();
+  REQUIRE_THAT(lst1->str(), Contains("OnDisconnect(0)"));
+  REQUIRE_THROWS_WITH(host.MigrateUser(0, 0),
+                      Contains("User with id 0 doesn't exist"));
+}
+
+TEST_CASE("ShardHost returns the user if the target shard refuses",
+          "[ShardHost]")
+{
+  auto server = std::make_shared<ShardTestServer>();
+  auto shard0 = std::make_shared<PartOne>();
+  auto shard1 = std::make_shared<PartOne>();
+
+  ShardHost host(server);
+  host.AddShard(shard0);
+  host.AddShard(shard1);
+
+  // Occupies the actor's form id in the target shard
+  shard1->CreateActor(0xff000ABC, { 0, 0, 0 }, 0.f, 0x3c);
+
+  server->Inject(3, Networking::PacketType::ServerSideUserConnect);
+  host.Tick();
+  host.Post(0, [](PartOne& partOne) {
+    partOne.CreateActor(0xff000ABC, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+    partOne.SetUserActor(3, 0xff000ABC);
+  });
+  host.MigrateUser(3, 1);
+
+  auto results = TickUntilMigrated(host);
+  REQUIRE(results.size() == 1);
+  REQUIRE_THAT(results[0].error, Contains("Form ff000abc already exists"));
+  REQUIRE(host.GetUserShard(3) == 0);
+  REQUIRE(shard0->GetUserActor(3) == 0xff000ABC);
+  REQUIRE(!shard1->IsConnected(3));
+}
+
+TEST_CASE("ShardHost ticks shards on their threads", "[ShardHost]")
+{
+  auto server = std::make_shared<ShardTestServer>();
+  auto lst0 = FakeListener::New(), lst1 = FakeListener::New();
+  auto shard0 = std::make_shared<PartOne>(lst0);
+  auto shard1 = std::make_shared<PartOne>(lst1);
+
+  ShardHost host(server);
+  host.AddShard(shard0);
+  host.AddShard(shard1);
+  host.Start(std::chrono::milliseconds(1));
+
+  for (Networking::UserId userId = 0; userId < 4; ++userId)
+    server->Inject(userId, Networking::PacketType::ServerSideUserConnect);
+  host.Tick();
+
+  host.MigrateUser(1, 1);
+  host.MigrateUser(3, 1);
+  size_t numMigrated = 0;
+  while (numMigrated < 2)
+    numMigrated += TickUntilMigrated(host).size();
+
+  for (Networking::UserId userId = 0; userId < 4; ++userId)
+    server->Inject(userId, Networking::PacketType::Message,
+                   MakeCustomPacket(std::to_string(userId).data()));
+  host.Tick();
+
+  // Shards run tasks in order, so these run after the packets
+  std::atomic<int> numShardsDone = 0;
+  for (ShardHost::ShardId shardId = 0; shardId < 2; ++shardId)
+    host.Post(shardId, [&](PartOne&) { ++numShardsDone; });
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (numShardsDone < 2) {
+    REQUIRE(std::chrono::steady_clock::now() < deadline);
+    std::this_thread::yield();
+  }
+  host.Stop();
+
+  REQUIRE_THAT(lst0->str(), Contains("OnCustomPacket(0, {\"x\":\"0\"})"));
+  REQUIRE_THAT(lst0->str(), Contains("OnCustomPacket(2, {\"x\":\"2\"})"));
+  REQUIRE_THAT(lst1->str(), Contains("OnCustomPacket(1, {\"x\":\"1\"})"));
+  REQUIRE_THAT(lst1->str(), Contains("OnCustomPacket(3, {\"x\":\"3\"})"));
+  REQUIRE_THAT(lst0->str(), !Contains("OnCustomPacket(1"));
+}
+
+TEST_CASE("ShardHost doesn't deliver packets meant for the previous user "
+          "with the same id",
+          "[ShardHost]")
+{
+  auto server = std::make_shared<ShardTestServer>();
+  ShardHost host(server);
+  host.AddShard(std::make_shared<PartOne>());
+
+  server->Inject(0, Networking::PacketType::ServerSideUserConnect);
+  host.Tick();
+  server->sent.clear();
+
+  // Queued by the shard before it sees the id reused
+  host.Post(0, [](PartOne& partOne) {
+    partOne.SendCustomPacket(0, R"({"x":"old"})");
+  });
+  server->Inject(0, Networking::PacketType::ServerSideUserDisconnect);
+  server->Inject(0, Networking::PacketType::ServerSideUserConnect);
+  host.Tick();
+  REQUIRE(server->sent.empty());
+
+  host.Post(0, [](PartOne& partOne) {
+    partOne.SendCustomPacket(0, R"({"x":"new"})");
+  });
+  host.Tick();
+  REQUIRE(server->sent.size() == 1);
+  REQUIRE_THAT(server->sent[0].second, Contains("new"));
+
+  host.Start(std::chrono::milliseconds(1));
+  REQUIRE_THROWS_WITH(host.GetShard(0), Contains("use Post"));
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "SpatialIndex.h"
+#include <catch2/catch.hpp>
+#include <set>
+
+namespace {
+std::set<int> VisitCellToSet(const SpatialIndex<int>& index, int16_t x,
+                             int16_t y, const std::vector<uint32_t>& keys)
+{
+  std::set<int> res;
+  index.VisitCell(x, y, keys, [&](int obj) { res.insert(obj); });
+  return res;
+}
+}
+
+TEST_CASE("SpatialIndex filters cells by keys", "[SpatialIndex]")
+{
+  SpatialIndex<int> index;
+  index.Move(1, 0xa, 0, 0);
+  index.Move(2, 0xb, 0, 0);
+  index.Move(3, 0xa, 0, 0);
+  index.Move(4, 0xc, 0, 0);
+  index.Move(5, 0xa, -1, 0);
+
+  REQUIRE(VisitCellToSet(index, 0, 0, {}) == std::set<int>{ 1, 2, 3, 4 });
+  REQUIRE(VisitCellToSet(index, 0, 0, { 0xa }) == std::set<int>{ 1, 3 });
+  REQUIRE(VisitCellToSet(index, 0, 0, { 0xa, 0xc }) ==
+          std::set<int>{ 1, 3, 4 });
+  REQUIRE(VisitCellToSet(index, 0, 0, { 0xd }).empty());
+  REQUIRE(VisitCellToSet(index, -1, 0, { 0xa }) == std::set<int>{ 5 });
+  REQUIRE(index.GetNumCells() == 2);
+
+  index.Move(3, 0xa, -1, 0);
+  REQUIRE(VisitCellToSet(index, 0, 0, { 0xa }) == std::set<int>{ 1 });
+  REQUIRE(VisitCellToSet(index, -1, 0, { 0xa }) == std::set<int>{ 3, 5 });
+
+  index.Forget(3);
+  index.Forget(5);
+  index.Forget(5);
+  REQUIRE(VisitCellToSet(index, -1, 0, {}).empty());
+  REQUIRE(index.GetNumCells() == 1);
+  REQUIRE(index.GetSize() == 3);
+
+  std::set<int> all;
+  index.VisitAll({ 0xb, 0xc }, [&](int obj) { all.insert(obj); });
+  REQUIRE(all == std::set<int>{ 2, 4 });
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "TickScheduler.h"
+#include "WorldState.h"
+#include <catch2/catch.hpp>
+#include <thread>
+
+TEST_CASE("TickScheduler records phase durations", "[TickScheduler]")
+{
+  using Phase = TickScheduler::Phase;
+
+  TickScheduler scheduler;
+  scheduler.SetBudget(Phase::Reloot, std::chrono::microseconds(1));
+  REQUIRE(scheduler.GetBudget(Phase::Reloot).count() == 1);
+  REQUIRE(std::string(TickScheduler::GetPhaseName(Phase::Reloot)) ==
+          "reloot");
+
+  scheduler.Run(Phase::Reloot, [](const TickScheduler::Budget& budget) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    REQUIRE(budget.IsExhausted());
+    return false;
+  });
+  scheduler.Run(Phase::Timers, [](const TickScheduler::Budget& budget) {
+    REQUIRE(!budget.IsExhausted());
+    return true;
+  });
+
+  auto& reloot = scheduler.GetStats(Phase::Reloot);
+  REQUIRE(reloot.numTicks == 1);
+  REQUIRE(reloot.numOverBudget == 1);
+  REQUIRE(reloot.lastNs >= 3'000'000);
+  REQUIRE(reloot.maxNs == reloot.lastNs);
+
+  // Durations in [2^(i-1), 2^i) us fall into bucket i
+  size_t bucket = 0;
+  for (auto us = reloot.lastNs / 1000; us > 0; us >>= 1)
+    ++bucket;
+  REQUIRE(bucket >= 12);
+  for (size_t i = 0; i < reloot.histogram.size(); ++i)
+    REQUIRE(reloot.histogram[i] == (i == bucket ? 1 : 0));
+
+  // Work left means over budget even without a budget
+  REQUIRE(scheduler.GetStats(Phase::Timers).numOverBudget == 1);
+  REQUIRE(scheduler.GetStats(Phase::ScriptEvents).numTicks == 0);
+}
+
+TEST_CASE("Timers over the tick budget are carried over", "[TickScheduler]")
+{
+  WorldState worldState;
+  worldState.GetTickScheduler().SetBudget(TickScheduler::Phase::Timers,
+                                          std::chrono::microseconds(1));
+
+  int numFired = 0;
+  for (int i = 0; i < 3; ++i) {
+    worldState.SetTimer(0).Then([&](Viet::Void) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      ++numFired;
+    });
+  }
+
+  for (int tick = 1; tick <= 3; ++tick) {
+    worldState.TickTimers();
+    REQUIRE(numFired == tick);
+  }
+  worldState.TickTimers();
+  REQUIRE(numFired == 3);
+
+  auto& stats =
+    worldState.GetTickScheduler().GetStats(TickScheduler::Phase::Timers);
+  REQUIRE(stats.numTicks == 4);
+  REQUIRE(stats.numOverBudget >= 3);
+}
\ No newline at end of file
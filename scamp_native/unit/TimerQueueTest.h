@@ -0,0 +1,88 @@
+#include "TimerQueue.h"
+#include <catch2/catch.hpp>
+#include <random>
+
+namespace {
+using TimerQueueTestTime = std::chrono::system_clock::time_point;
+
+TimerQueueTestTime TimerQueueTestAt(int ms)
+{
+  return TimerQueueTestTime() + std::chrono::milliseconds(ms);
+}
+}
+
+TEST_CASE("TimerQueue fires timers in finish order", "[TimerQueue]")
+{
+  TimerQueue<int> queue;
+  queue.Add(TimerQueueTestAt(30), 3);
+  queue.Add(TimerQueueTestAt(10), 1);
+  queue.Add(TimerQueueTestAt(20), 2);
+
+  // Equal finish fires in insertion order
+  queue.Add(TimerQueueTestAt(20), 22);
+
+  std::vector<int> fired;
+  auto push = [&](int v) { fired.push_back(v); };
+  REQUIRE(queue.Tick(TimerQueueTestAt(5), push) == 0);
+  REQUIRE(queue.Tick(TimerQueueTestAt(20), push) == 3);
+  REQUIRE(fired == std::vector<int>{ 1, 2, 22 });
+  REQUIRE(queue.GetNextFinish() == TimerQueueTestAt(30));
+  REQUIRE(queue.Tick(TimerQueueTestAt(100), push) == 1);
+  REQUIRE(queue.GetSize() == 0);
+  REQUIRE(!queue.GetNextFinish());
+}
+
+TEST_CASE("TimerQueue cancels timers by handles", "[TimerQueue]")
+{
+  TimerQueue<int> queue;
+  auto a = queue.Add(TimerQueueTestAt(10), 1);
+  auto b = queue.Add(TimerQueueTestAt(20), 2);
+
+  REQUIRE(queue.Cancel(a));
+  REQUIRE(!queue.Cancel(a));
+  REQUIRE(!queue.IsPending(a));
+  REQUIRE(queue.IsPending(b));
+
+  // The slot is reused, the old handle stays stale
+  auto c = queue.Add(TimerQueueTestAt(5), 3);
+  REQUIRE(c.slot == a.slot);
+  REQUIRE(!queue.Cancel(a));
+
+  std::vector<int> fired;
+  queue.Tick(TimerQueueTestAt(100), [&](int v) { fired.push_back(v); });
+  REQUIRE(fired == std::vector<int>{ 3, 2 });
+  REQUIRE(!queue.IsPending(b));
+}
+
+TEST_CASE("TimerQueue matches a sorted list", "[TimerQueue]")
+{
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> ms(0, 1000);
+
+  TimerQueue<int> queue;
+  std::vector<std::pair<int, int>> expected;
+  std::vector<TimerQueue<int>::Handle> handles;
+  for (int i = 0; i < 2000; ++i) {
+    int finish = ms(rng);
+    handles.push_back(queue.Add(TimerQueueTestAt(finish), i));
+    expected.push_back({ finish, i });
+  }
+  for (int i = 0; i < 2000; i += 3) {
+    REQUIRE(queue.Cancel(handles[i]));
+    expected[i].first = -1;
+  }
+  expected.erase(std::remove_if(expected.begin(), expected.end(),
+                                [](auto& p) { return p.first < 0; }),
+                 expected.end());
+  std::stable_sort(
+    expected.begin(), expected.end(),
+    [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+
+  std::vector<int> fired;
+  for (int now = 0; now <= 1000; now += 50) {
+    queue.Tick(TimerQueueTestAt(now), [&](int v) { fired.push_back(v); });
+  }
+  REQUIRE(fired.size() == expected.size());
+  for (size_t i = 0; i < fired.size(); ++i)
+    REQUIRE(fired[i] == expected[i].second);
+}
\ No newline at end of file
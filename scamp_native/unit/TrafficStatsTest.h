@@ -0,0 +1,75 @@
+#pragma once
+#include "TestUtils.hpp"
+
+#include "TrafficStats.h"
+
+namespace {
+std::string_view GetKind(const std::string& s)
+{
+  return TrafficStats::GetOutgoingKind(
+    reinterpret_cast<Networking::PacketData>(s.data()), s.size());
+}
+}
+
+TEST_CASE("TrafficStats classifies outgoing messages", "[TrafficStats]")
+{
+  auto json = [](const std::string& s) {
+    return static_cast<char>(Networking::MinPacketId) + s;
+  };
+
+  REQUIRE(GetKind(json(R"({"type": "createActor", "idx": 1})")) ==
+          "createActor");
+  REQUIRE(GetKind(json(R"({"target":1,"type":"openContainer"})")) ==
+          "openContainer");
+  REQUIRE(GetKind(json(R"({"t":3,"idx":5,"data":{}})")) ==
+          "UpdateAnimation");
+
+  // Nested keys and string values don't count
+  auto nested = R"({"a": {"type": "x"}, "b": "type", "type": "teleport"})";
+  REQUIRE(GetKind(json(nested)) == "teleport");
+  REQUIRE(GetKind(json(R"({"s": "\"type\": \"x\""})")) == "unknown");
+
+  // Kinds are never made up from the message
+  REQUIRE(GetKind(json(R"({"type": "y"})")) == "other");
+  REQUIRE(GetKind(json(R"({"t":16})")) == "other");
+  REQUIRE(GetKind(json(R"({"t":99999999999999999999999})")) == "other");
+  REQUIRE(std::is_sorted(TrafficStats::serverMessageTypes.begin(),
+                         TrafficStats::serverMessageTypes.end()));
+
+  std::string binary(1, static_cast<char>(MovementCodec::PacketId));
+  REQUIRE(GetKind(binary) == "movement");
+  REQUIRE(GetKind("") == "unknown");
+}
+
+TEST_CASE("PartOne counts traffic by user and kind", "[TrafficStats]")
+{
+  PartOne partOne;
+  partOne.EnableTrafficStats(true);
+
+  for (Networking::UserId i = 0; i < 2; ++i) {
+    DoConnect(partOne, i);
+    partOne.CreateActor(0xff000000 + i, { 1.f, 2.f, 3.f }, 180.f, 0x3c);
+    partOne.SetUserActor(i, 0xff000000 + i);
+  }
+  DoUpdateMovement(partOne, 0xff000000, 0);
+
+  auto j = partOne.GetTrafficStats().ToJson();
+  REQUIRE(j["in"]["byMsgType"]["UpdateMovement"]["packets"] == 1);
+  REQUIRE(j["in"]["total"]["packets"] == 1);
+  REQUIRE(j["out"]["byKind"]["createActor"]["packets"] == 4);
+  REQUIRE(j["out"]["byKind"]["createActor"]["reliable"] == 4);
+  // Forwarded to both users, the emitter included
+  REQUIRE(j["out"]["byKind"]["UpdateMovement"]["unreliable"] == 2);
+  REQUIRE(j["byUser"]["0"]["in"]["packets"] == 1);
+  REQUIRE(j["byUser"]["1"]["out"]["packets"] > 0);
+  REQUIRE(j["out"]["total"]["packets"] ==
+          j["byUser"]["0"]["out"]["packets"].get<uint64_t>() +
+            j["byUser"]["1"]["out"]["packets"].get<uint64_t>());
+
+  DoDisconnect(partOne, 1);
+  REQUIRE(partOne.GetTrafficStats().ToJson()["byUser"].count("1") == 0);
+
+  partOne.GetTrafficStats().Reset();
+  REQUIRE(partOne.GetTrafficStats().ToJson()["out"]["total"]["packets"] ==
+          0);
+}
\ No newline at end of file
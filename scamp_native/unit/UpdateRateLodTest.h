@@ -0,0 +1,141 @@
+#pragma once
+#include "TestUtils.hpp"
+
+#include "UpdateRateLod.h"
+
+TEST_CASE("UpdateRateLod tiers", "[UpdateRateLod]")
+{
+  UpdateRateLod lod;
+  REQUIRE(!lod.IsEnabled());
+  REQUIRE(lod.GetDivisor(1e9f) == 1);
+
+  lod.SetTierDistances({ 100, 200, 400 });
+  REQUIRE(lod.IsEnabled());
+  REQUIRE(lod.GetDivisor(50 * 50) == 1);
+  REQUIRE(lod.GetDivisor(150 * 150) == 2);
+  REQUIRE(lod.GetDivisor(300 * 300) == 4);
+  REQUIRE(lod.GetDivisor(1000 * 1000) == 8);
+
+  int numForwarded = 0;
+  for (int i = 0; i < 16; ++i) {
+    auto sequence =
+      lod.NextSequence(0xff000000, UpdateRateLod::Channel::Movement);
+    numForwarded += lod.ShouldForward(sequence, 300 * 300);
+  }
+  REQUIRE(numForwarded == 4);
+
+  REQUIRE_THROWS_WITH(lod.SetTierDistances({ 200, 100 }),
+                      Contains("must be ascending"));
+}
+
+TEST_CASE("UpdateRateLod delivers the newest update after flush delay",
+          "[UpdateRateLod]")
+{
+  UpdateRateLod lod;
+  lod.SetTierDistances({ 100 });
+  lod.SetFlushDelay(std::chrono::milliseconds(100));
+
+  auto t = UpdateRateLod::Clock::now();
+  auto channel = UpdateRateLod::Channel::Animation;
+
+  std::vector<std::string> flushed;
+  auto flush = [&](uint32_t emitterId, UpdateRateLod::Channel,
+                   Networking::PacketData data, size_t length,
+                   const std::vector<Networking::UserId>& missedBy) {
+    REQUIRE(emitterId == 0xff000000);
+    REQUIRE(missedBy == std::vector<Networking::UserId>{ 1 });
+    flushed.push_back(std::string(data, data + length));
+  };
+
+  lod.SetPending(0xff000000, channel, (Networking::PacketData) "a", 1, { 1 },
+                 t);
+  lod.SetPending(0xff000000, channel, (Networking::PacketData) "b", 1, { 1 },
+                 t);
+  lod.Flush(flush, t + std::chrono::milliseconds(50));
+  REQUIRE(flushed.empty());
+
+  lod.Flush(flush, t + std::chrono::milliseconds(100));
+  REQUIRE(flushed == std::vector<std::string>{ "b" });
+
+  // Update that reached everyone clears the pending one
+  lod.SetPending(0xff000000, channel, (Networking::PacketData) "c", 1, { 1 },
+                 t);
+  lod.SetPending(0xff000000, channel, (Networking::PacketData) "d", 1, {}, t);
+  lod.Flush(flush, t + std::chrono::milliseconds(1000));
+  REQUIRE(flushed.size() == 1);
+}
+
+TEST_CASE("UpdateRateLod flushes only emitters that are still pending",
+          "[UpdateRateLod]")
+{
+  UpdateRateLod lod;
+  lod.SetTierDistances({ 100 });
+  lod.SetFlushDelay(std::chrono::milliseconds(0));
+
+  auto t = UpdateRateLod::Clock::now();
+  auto channel = UpdateRateLod::Channel::Movement;
+
+  std::vector<uint32_t> flushed;
+  auto flush = [&](uint32_t emitterId, UpdateRateLod::Channel,
+                   Networking::PacketData, size_t,
+                   const std::vector<Networking::UserId>&) {
+    flushed.push_back(emitterId);
+  };
+
+  for (uint32_t id = 0xff000000; id < 0xff000004; ++id)
+    lod.SetPending(id, channel, (Networking::PacketData) "a", 1, { 1 }, t);
+  lod.Forget(0xff000001);
+  lod.SetPending(0xff000002, channel, (Networking::PacketData) "a", 1, {},
+                 t);
+  lod.Flush(flush, t);
+  REQUIRE(flushed == std::vector<uint32_t>{ 0xff000000, 0xff000003 });
+
+  // Forgotten emitter pending again is flushed exactly once
+  flushed.clear();
+  lod.SetPending(0xff000001, channel, (Networking::PacketData) "a", 1, { 1 },
+                 t);
+  lod.SetPending(0xff000001, channel, (Networking::PacketData) "b", 1, { 1 },
+                 t);
+  lod.Flush(flush, t);
+  lod.Flush(flush, t);
+  REQUIRE(flushed == std::vector<uint32_t>{ 0xff000001 });
+}
+
+TEST_CASE("UpdateMovement is decimated for distant listeners",
+          "[UpdateRateLod]")
+{
+  PartOne partOne;
+  partOne.GetUpdateRateLod().SetTierDistances({ 1000 });
+  partOne.GetUpdateRateLod().SetFlushDelay(std::chrono::milliseconds(0));
+
+  DoConnect(partOne, 0);
+  partOne.CreateActor(0xff000000, { 1.f, -1.f, 1.f }, 180.f, 0x3c);
+  partOne.SetUserActor(0, 0xff000000);
+
+  DoConnect(partOne, 1);
+  partOne.CreateActor(0xff000001, { 3000.f, 0.f, 0.f }, 180.f, 0x3c);
+  partOne.SetUserActor(1, 0xff000001);
+
+  auto countMessagesTo = [&](Networking::UserId userId) {
+    return std::count_if(
+      partOne.Messages().begin(), partOne.Messages().end(),
+      [&](const PartOne::Message& m) { return m.userId == userId; });
+  };
+
+  partOne.Messages().clear();
+  for (int i = 0; i < 4; ++i)
+    DoMessage(partOne, 0, jMovement);
+  REQUIRE(countMessagesTo(0) == 4);
+  REQUIRE(countMessagesTo(1) == 2);
+
+  // The last update was dropped for user 1, it is delivered on Tick
+  partOne.Messages().clear();
+  partOne.Tick();
+  REQUIRE(countMessagesTo(0) == 0);
+  REQUIRE(countMessagesTo(1) == 1);
+  REQUIRE(partOne.Messages()[0].j == jMovement);
+
+  partOne.Messages().clear();
+  partOne.Tick();
+  REQUIRE(partOne.Messages().empty());
+}
\ No newline at end of file
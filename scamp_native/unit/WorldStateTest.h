@@ -1,4 +1,5 @@
 #include "WorldState.h"
+#include "ChunkPreloader.h"
 #include "FormCallbacks.h"
 #include "MpActor.h"
 #include "MpForm.h"
@@ -6,6 +7,7 @@
 #include "PartOne.h"
 #include <catch2/catch.hpp>
 #include <nlohmann/json.hpp>
+#include <thread>
 
 using namespace Catch;
 
@@ -142,4 +144,56 @@ TEST_CASE("Loads VirtualMachine with all scripts", "[WorldState]")
 {
   auto& p = GetPartOne();
   p.worldState.GetPapyrusVm();
+}
+
+extern espm::Loader l;
+
+TEST_CASE("ChunkPreloader prepares the same forms as the game thread",
+          "[WorldState]")
+{
+  auto& br = l.GetBrowser();
+  ChunkPreloader preloader(br);
+
+  constexpr int16_t radius = 2;
+  for (int16_t x = -radius; x <= radius; ++x) {
+    for (int16_t y = -radius; y <= radius; ++y)
+      preloader.Request(0x3c, x, y);
+  }
+
+  constexpr auto numChunks = (2 * radius + 1) * (2 * radius + 1);
+  for (int i = 0; i < 1000; ++i) {
+    if (preloader.GetStats().numPrepared == numChunks)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  REQUIRE(preloader.GetStats().numPrepared == numChunks);
+
+  espm::CompressedFieldsCache cache;
+  size_t numForms = 0;
+  for (int16_t x = -radius; x <= radius; ++x) {
+    for (int16_t y = -radius; y <= radius; ++y) {
+      auto chunk = preloader.Take(0x3c, x, y);
+      REQUIRE(chunk);
+      auto expected =
+        ChunkPreloader::PrepareChunk(br, 0x3c, x, y, cache, nullptr);
+      REQUIRE(chunk->forms.size() == expected.forms.size());
+      for (size_t i = 0; i < expected.forms.size(); ++i) {
+        auto& form = chunk->forms[i];
+        REQUIRE(form.formId == expected.forms[i].formId);
+        REQUIRE(form.records.size() == expected.forms[i].records.size());
+        for (size_t j = 0; j < form.records.size(); ++j) {
+          REQUIRE(form.records[j].baseId ==
+                  expected.forms[i].records[j].baseId);
+          REQUIRE(form.records[j].pos == expected.forms[i].records[j].pos);
+        }
+      }
+      numForms += chunk->forms.size();
+    }
+  }
+  REQUIRE(numForms > 0);
+
+  // Taken chunks are forgotten
+  REQUIRE(!preloader.Take(0x3c, 0, 0));
+  REQUIRE(preloader.GetStats().numTaken == numChunks);
+  REQUIRE(preloader.GetStats().numMissed == 1);
 }
\ No newline at end of file
@@ -33,22 +33,29 @@ std::string dataDir = DATA_DIR;
 #include "ConsoleCommandTest.h"
 #include "CraftTest.h"
 #include "EspmTest.h"
+#include "FlatGridTest.h"
 #include "FormDescTest.h"
+#include "FormTableTest.h"
 #include "GridTest.h"
 #include "Grid_MoveTest.h"
 #include "HeuristicPolicyTest.h"
 #include "IdManagerTest.h"
 #include "LeveledListUtilsTest.h"
 #include "MigrationDatabaseTest.h"
+#include "MovementCodecTest.h"
+#include "MovementReplicationTest.h"
 #include "MovementValidationTest.h"
 #include "NetworkingTest.h"
+#include "Networking_BatchedTest.h"
 #include "Networking_CombinedTest.h"
 #include "Networking_DataTransferTest.h"
 #include "Networking_HandlePacketClientsideTest.h"
 #include "Networking_HandlePacketServersideTest.h"
 #include "Networking_MockTest.h"
+#include "Networking_ThreadedTest.h"
 #include "NpcExists.h"
 #include "ObjectReferenceTest.h"
+#include "PacketBuilderTest.h"
 #include "PapyrusCompatibilityTest.h"
 #include "PapyrusDebugTest.h"
 #include "PapyrusFormListTest.h"
@@ -66,8 +73,15 @@ std::string dataDir = DATA_DIR;
 #include "PartOne_UpdateEquipmentTest.h"
 #include "PartOne_UpdateLookTest.h"
 #include "PrimitiveTest.h"
+#include "RateLimiterTest.h"
 #include "SaveStorageTest.h"
 #include "ServerStateTest.h"
+#include "ShardHostTest.h"
+#include "SpatialIndexTest.h"
+#include "TickSchedulerTest.h"
+#include "TimerQueueTest.h"
+#include "TrafficStatsTest.h"
+#include "UpdateRateLodTest.h"
 #include "VarValueTest.h"
 #include "VirtualMachineTest.h"
 #include "WorldStateTest.h"
\ No newline at end of file